@@ -0,0 +1,119 @@
+#include "bench.h"
+
+#include <cstdio>
+#include <cmath>
+
+#include "core/simulation.h"
+
+// an eccentric comet (perihelion 0.5 AU, eccentricity 0.95) through one perihelion passage,
+// force evaluations against the comet's position error for the fixed step integrators
+// and the adaptive dormand-prince integrator at several tolerances
+
+static const double s_Day = 86400.0;
+static const double s_Duration = 7300.0 * s_Day; // about 20 years, the comet starts at aphelion
+
+struct AdaptiveCase
+{
+    const char* name;
+    SimIntegrator integrator;
+    double timeStep;  // fixed step, largest hermite block step or dormand-prince output interval
+    float tolerance;
+};
+
+struct AdaptiveRun
+{
+    double x, y;      // final comet position
+    double energyError;
+    uint64_t evaluations;
+    uint64_t rejected;
+    double seconds;
+};
+
+static void createWorld(SimWorld* world)
+{
+    sim::initSolarSystem(world);
+
+    const double perihelion = 0.5 * AU;
+    const double eccentricity = 0.95;
+    const double a = perihelion / (1.0 - eccentricity);
+    const double aphelion = a * (1.0 + eccentricity);
+    const double speed = std::sqrt(G_CONSTANT * SUN_MASS * (1.0 - eccentricity) / (a * (1.0 + eccentricity)));
+
+    SimBody comet{};
+    comet.mass = 1e13f;
+    comet.distance = (float)aphelion;
+    comet.pos = { (float)-aphelion, 0.0f };
+    comet.vel = { 0.0f, (float)-speed };
+    sim::addBody(&world->bodies, comet);
+}
+
+static AdaptiveRun runCase(const AdaptiveCase& c)
+{
+    SimSettings settings;
+    sim::initSettings(&settings);
+    settings.integrator = c.integrator;
+    settings.timeStep = (float)c.timeStep;
+    settings.tolerance = c.tolerance;
+
+    SimWorld world;
+    createWorld(&world);
+    uint32_t comet = world.bodies.count - 1;
+
+    double startEnergy = sim::computeEnergy(world.bodies);
+    uint64_t steps = (uint64_t)std::llround(s_Duration / c.timeStep);
+
+    double start = bench::now();
+    for (uint64_t i = 0; i < steps; i++)
+        sim::step(&world, settings);
+
+    AdaptiveRun run;
+    run.seconds = bench::now() - start;
+    run.x = world.bodies.x[comet];
+    run.y = world.bodies.y[comet];
+    if (c.integrator == Sim_Integrator_DormandPrince)
+    {
+        // the bodies only hold the rounded state, it would hide errors below a float ulp (some 10 km out there)
+        run.x = world.dormandPrince.x[comet];
+        run.y = world.dormandPrince.y[comet];
+    }
+    run.x *= world.bodies.units.length;
+    run.y *= world.bodies.units.length;
+    run.energyError = std::fabs((sim::computeEnergy(world.bodies) - startEnergy) / startEnergy);
+    run.evaluations = world.evaluations;
+    run.rejected = world.dormandPrince.rejected;
+    return run;
+}
+
+namespace bench
+{
+    int adaptive(int argc, char** argv)
+    {
+        const AdaptiveCase reference = { "reference", Sim_Integrator_DormandPrince, 73.0 * s_Day, 1e-13f };
+        const AdaptiveCase cases[] = {
+            { "leapfrog, 1 day",          Sim_Integrator_Leapfrog,      s_Day,         0.0f },
+            { "leapfrog, 0.25 days",      Sim_Integrator_Leapfrog,      0.25 * s_Day,  0.0f },
+            { "yoshida4, 4 days",         Sim_Integrator_Yoshida4,      4.0 * s_Day,   0.0f },
+            { "yoshida4, 1 day",          Sim_Integrator_Yoshida4,      s_Day,         0.0f },
+            { "hermite, max 73 days",     Sim_Integrator_Hermite,       73.0 * s_Day,  0.0f },
+            { "dormand-prince, 1e-6",     Sim_Integrator_DormandPrince, 73.0 * s_Day,  1e-6f },
+            { "dormand-prince, 1e-8",     Sim_Integrator_DormandPrince, 73.0 * s_Day,  1e-8f },
+            { "dormand-prince, 1e-10",    Sim_Integrator_DormandPrince, 73.0 * s_Day,  1e-10f },
+            { "dormand-prince, 1e-12",    Sim_Integrator_DormandPrince, 73.0 * s_Day,  1e-12f },
+        };
+
+        AdaptiveRun exact = runCase(reference);
+
+        printf("solar system and a comet (q = 0.5 AU, e = 0.95) for %.0f days, comet position error against dormand-prince at %.0e\n", s_Duration / s_Day, reference.tolerance);
+        printf("  %-24s %12s %10s %16s %16s %10s\n", "integrator", "evaluations", "rejected", "comet error km", "rel. energy err", "seconds");
+
+        for (const AdaptiveCase& c : cases)
+        {
+            AdaptiveRun run = runCase(c);
+            double error = std::sqrt((run.x - exact.x) * (run.x - exact.x) + (run.y - exact.y) * (run.y - exact.y));
+            printf("  %-24s %12llu %10llu %16.1f %16.3e %10.3f\n", c.name, (unsigned long long)run.evaluations, (unsigned long long)run.rejected,
+                error / 1000.0, run.energyError, run.seconds);
+        }
+
+        return 0;
+    }
+}
@@ -0,0 +1,112 @@
+#include "bench.h"
+
+#include <cstdio>
+#include <cmath>
+#include <vector>
+
+#include "core/simulation.h"
+#include "core/gravity.h"
+#include "core/barnes_hut.h"
+
+// accuracy of the barnes-hut solver for several opening angles, and its cost against direct summation
+
+static const uint32_t s_ErrorSamples = 1000;
+
+static void createWorld(SimWorld* world, uint32_t count)
+{
+    sim::initSolarSystem(world);
+    if (count > world->bodies.count)
+        sim::addAsteroidBelt(world, count - world->bodies.count, 2.2f * AU, 3.2f * AU);
+}
+
+// equal masses spread uniformly over a disk 10 AU across: every body is pulled by the whole disk, so the error of
+// the far field isn't hidden under the exact pull of a sun that dwarfs it (the solar system sits at float rounding)
+static void createDisk(SimWorld* world, uint32_t count)
+{
+    sim::clearBodies(&world->bodies, Sim_Units_Astronomical);
+    uint32_t seed = 1;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        double r = 5.0 * AU * std::sqrt((seed >> 8) * (1.0 / 16777216.0));
+        seed = seed * 1664525u + 1013904223u;
+        double angle = (seed >> 8) * (1.0 / 16777216.0) * 2.0 * 3.14159265358979;
+
+        SimBody body = {};
+        body.mass = (float)(SUN_MASS / count);
+        body.pos = { (float)(r * std::cos(angle)), (float)(r * std::sin(angle)) };
+        sim::addBody(&world->bodies, body);
+    }
+
+    world->forcesCurrent = false;
+}
+
+namespace bench
+{
+    int barnesHut(int argc, char** argv)
+    {
+        const float thetas[] = { 0.2f, 0.3f, 0.5f, 0.7f, 1.0f };
+        const uint32_t counts[] = { 1000, 4000, 16000, 64000, 256000 };
+        const uint32_t accuracyCount = 20000;
+        const uint32_t maxDirectCount = 64000;
+
+        // accuracy vs theta, self-gravitating disk of equal masses
+        {
+            SimWorld world;
+            createDisk(&world, accuracyCount);
+            SimBodies& bodies = world.bodies;
+            std::vector<float> ax(sim::paddedCount(bodies.count)), ay(sim::paddedCount(bodies.count));
+
+            printf("barnes-hut accuracy, disk of N = %u equal masses, relative acceleration error on %u bodies\n", bodies.count, s_ErrorSamples);
+            printf("%8s %-12s %12s %12s %12s\n", "theta", "moments", "rms error", "max error", "ms");
+
+            for (float theta : thetas)
+            {
+                for (int quadrupole = 0; quadrupole < 2; quadrupole++)
+                {
+                    double start = now();
+                    sim::computeAccelerationsBarnesHut(&world.tree, bodies, theta, quadrupole != 0, ax.data(), ay.data());
+                    double ms = (now() - start) * 1e3;
+
+                    SimForceError error = sim::measureForceError(bodies, ax.data(), ay.data(), s_ErrorSamples);
+                    printf("%8.2f %-12s %12.3e %12.3e %12.2f\n", theta, quadrupole ? "quadrupole" : "monopole", error.rms, error.max, ms);
+                }
+            }
+        }
+
+        // time vs N, theta 0.5
+        printf("\ntime per force pass vs N (barnes-hut theta 0.5, direct is the pairwise %s kernel)\n", sim::getKernelName(sim::getKernel()));
+        printf("%8s %14s %14s %14s %10s\n", "N", "direct ms", "bh ms", "bh quad ms", "speedup");
+
+        for (uint32_t count : counts)
+        {
+            SimWorld world;
+            createWorld(&world, count);
+            SimBodies& bodies = world.bodies;
+            std::vector<float> ax(sim::paddedCount(bodies.count)), ay(sim::paddedCount(bodies.count));
+
+            double directMs = -1.0;
+            if (count <= maxDirectCount)
+            {
+                double start = now();
+                sim::computeAccelerationsPairwise(sim::getKernel(), bodies, ax.data(), ay.data());
+                directMs = (now() - start) * 1e3;
+            }
+
+            double start = now();
+            sim::computeAccelerationsBarnesHut(&world.tree, bodies, 0.5f, false, ax.data(), ay.data());
+            double bhMs = (now() - start) * 1e3;
+
+            start = now();
+            sim::computeAccelerationsBarnesHut(&world.tree, bodies, 0.5f, true, ax.data(), ay.data());
+            double quadMs = (now() - start) * 1e3;
+
+            if (directMs >= 0.0)
+                printf("%8u %14.2f %14.2f %14.2f %9.2fx\n", count, directMs, bhMs, quadMs, directMs / bhMs);
+            else
+                printf("%8u %14s %14.2f %14.2f %10s\n", count, "-", bhMs, quadMs, "-");
+        }
+
+        return 0;
+    }
+}
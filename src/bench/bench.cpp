@@ -0,0 +1,148 @@
+#include "bench.h"
+
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+struct BenchEntry
+{
+    const char* name;
+    const char* description;
+    int (*run)(int argc, char** argv);
+};
+
+static const BenchEntry s_Benchmarks[] =
+{
+    { "layout", "array of structs vs structure of arrays body storage", bench::layout },
+    { "kernels", "gravity kernels speed and agreement with the reference kernel", bench::kernels },
+    { "barnes-hut", "barnes-hut accuracy vs opening angle and time vs N against direct summation", bench::barnesHut },
+    { "fmm", "fast multipole accuracy vs expansion order and time vs N against barnes-hut and direct summation", bench::fmm },
+    { "scaling", "speedup of the force passes and the step with the number of worker threads", bench::scaling },
+    { "hermite", "force evaluations per simulated year and energy error of the hermite block steps", bench::hermite },
+    { "integrators", "energy drift of the symplectic integrators vs time step on the solar system", bench::integrators },
+    { "adaptive", "force evaluations vs accuracy of the adaptive integrator on an eccentric comet", bench::adaptive },
+    { "precision", "speed vs long term orbit error of the float, kahan and double integrator states", bench::precision },
+    { "units", "agreement of the same runs in si and astronomical units", bench::units },
+    { "particles", "massless test particles against massless bodies and cost per step of large belts", bench::particles },
+    { "kepler", "analytic two-body propagation against closed form orbits and its cost per particle vs time step", bench::kepler },
+    { "collisions", "swept collision responses against conserved totals and the cost of the spatial hash grid vs belt size", bench::collisions },
+    { "encounters", "regularized close encounters against a tight adaptive run, their cost per step and softened test particles", bench::encounters },
+    { "determinism", "checksums of the state after every step with 1 thread against more, and the cost of the fixed order sums", bench::determinism },
+    { "diagnostics", "potential energy of the force pass against a double sum, conservation drift of the integrators and its cost", bench::diagnostics },
+    { "ensemble", "unperturbed ensemble member against a world, outcomes of perturbed members and member-years per second", bench::ensemble },
+    { "sweep", "checksums of sweep points run one at a time against side by side, and points per second", bench::sweep },
+    { "small", "pair pass of small systems specialized for their body count against the tiled pass", bench::small },
+    { "dispatch", "cpu features, the kernel picked at startup, and kicks, drifts and steps of every runnable kernel against scalar", bench::dispatch },
+    { "retarded", "finite speed of gravity: history lookups, retarded forces against instantaneous, a deleted sun and the cost", bench::retarded },
+};
+
+namespace bench
+{
+#ifdef __linux__
+    static int openPerfEvent(uint32_t type, uint64_t config)
+    {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+
+    static uint64_t readPerfEvent(int fd)
+    {
+        uint64_t value = 0;
+        if (fd < 0 || read(fd, &value, sizeof(value)) != sizeof(value)) return 0;
+        return value;
+    }
+#endif
+
+    double now()
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void initPerfCounters(BenchPerfCounters* counters)
+    {
+        *counters = { -1, -1, false };
+
+#ifdef __linux__
+        counters->l1Fd = openPerfEvent(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+        counters->llcFd = openPerfEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+        counters->available = counters->l1Fd >= 0 || counters->llcFd >= 0;
+#endif
+    }
+
+    void uninitPerfCounters(BenchPerfCounters* counters)
+    {
+#ifdef __linux__
+        if (counters->l1Fd >= 0) close(counters->l1Fd);
+        if (counters->llcFd >= 0) close(counters->llcFd);
+#endif
+        *counters = { -1, -1, false };
+    }
+
+    void startPerfCounters(BenchPerfCounters* counters)
+    {
+#ifdef __linux__
+        const int fds[] = { counters->l1Fd, counters->llcFd };
+        for (int fd : fds)
+        {
+            if (fd < 0) continue;
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    BenchPerfResult stopPerfCounters(BenchPerfCounters* counters)
+    {
+        BenchPerfResult result{};
+#ifdef __linux__
+        const int fds[] = { counters->l1Fd, counters->llcFd };
+        for (int fd : fds)
+        {
+            if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        }
+        result.l1Misses = readPerfEvent(counters->l1Fd);
+        result.llcMisses = readPerfEvent(counters->llcFd);
+#endif
+        return result;
+    }
+}
+
+static void printUsage()
+{
+    printf("usage: solarSystemBench <benchmark> [args]\n");
+    for (const BenchEntry& entry : s_Benchmarks)
+        printf("  %-12s %s\n", entry.name, entry.description);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        printUsage();
+        return -1;
+    }
+
+    for (const BenchEntry& entry : s_Benchmarks)
+    {
+        if (strcmp(argv[1], entry.name) == 0)
+            return entry.run(argc - 1, argv + 1);
+    }
+
+    printf("unknown benchmark '%s'\n", argv[1]);
+    printUsage();
+    return -1;
+}
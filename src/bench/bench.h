@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+
+// benchmarks for the simulation core
+// usage: solarSystemBench <benchmark> [args]
+
+struct BenchPerfCounters
+{
+    int l1Fd;        // l1 data cache read misses
+    int llcFd;       // last level cache misses
+    bool available;
+};
+
+struct BenchPerfResult
+{
+    uint64_t l1Misses;
+    uint64_t llcMisses;
+};
+
+namespace bench
+{
+    double now(); // seconds
+
+    // hardware cache miss counters (linux perf events), available is false when they can't be opened
+    void initPerfCounters(BenchPerfCounters* counters);
+    void uninitPerfCounters(BenchPerfCounters* counters);
+    void startPerfCounters(BenchPerfCounters* counters);
+    BenchPerfResult stopPerfCounters(BenchPerfCounters* counters);
+
+    // benchmarks
+    int layout(int argc, char** argv);
+    int kernels(int argc, char** argv);
+    int barnesHut(int argc, char** argv);
+    int fmm(int argc, char** argv);
+    int scaling(int argc, char** argv);
+    int hermite(int argc, char** argv);
+    int integrators(int argc, char** argv);
+    int adaptive(int argc, char** argv);
+    int precision(int argc, char** argv);
+    int units(int argc, char** argv);
+    int particles(int argc, char** argv);
+    int kepler(int argc, char** argv);
+    int collisions(int argc, char** argv);
+    int encounters(int argc, char** argv);
+    int determinism(int argc, char** argv);
+    int diagnostics(int argc, char** argv);
+    int ensemble(int argc, char** argv);
+    int sweep(int argc, char** argv);
+    int small(int argc, char** argv);
+    int dispatch(int argc, char** argv);
+    int retarded(int argc, char** argv);
+}
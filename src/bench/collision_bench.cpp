@@ -0,0 +1,185 @@
+#include "bench.h"
+
+#include <cstdio>
+#include <cmath>
+
+#include "core/simulation.h"
+#include "core/collision.h"
+
+// head-on impacts fast enough that the bodies pass through each other within one step, a test at the end
+// of the step alone misses them: merging has to conserve mass and momentum, an elastic bounce also the
+// kinetic energy, fragmenting mass and momentum, and a particle through a body is absorbed, fails when
+// one of them is off, then the cost of the collision stage alone on belts of growing size
+
+static const double s_Tolerance = 1e-5; // relative, the state is stored in float
+
+struct CollisionTotals
+{
+    double mass, px, py, kinetic;
+};
+
+static CollisionTotals getTotals(const SimBodies& bodies)
+{
+    CollisionTotals totals = {};
+    for (uint32_t i = 0; i < bodies.count; i++)
+    {
+        totals.mass += bodies.mass[i];
+        totals.px += (double)bodies.mass[i] * bodies.vx[i];
+        totals.py += (double)bodies.mass[i] * bodies.vy[i];
+        totals.kinetic += 0.5 * bodies.mass[i] * ((double)bodies.vx[i] * bodies.vx[i] + (double)bodies.vy[i] * bodies.vy[i]);
+    }
+
+    return totals;
+}
+
+// collision stage around a straight line drift, without gravity so the totals only change through the response
+static void driftAndCollide(SimWorld* world, SimCollisionResponse response, float restitution, double timeStep)
+{
+    SimBodies& bodies = world->bodies;
+    SimParticles& particles = world->particles;
+    sim::beginCollisions(&world->collisions, bodies, particles);
+
+    for (uint32_t i = 0; i < bodies.count; i++)
+    {
+        bodies.x[i] += (float)(bodies.vx[i] * timeStep);
+        bodies.y[i] += (float)(bodies.vy[i] * timeStep);
+    }
+    for (uint32_t i = 0; i < particles.count; i++)
+    {
+        particles.x[i] += (float)(particles.vx[i] * timeStep);
+        particles.y[i] += (float)(particles.vy[i] * timeStep);
+    }
+
+    sim::findCollisions(&world->collisions, bodies, particles);
+    sim::resolveCollisions(&world->collisions, world, response, restitution, timeStep);
+}
+
+// two bodies 2e8 m apart closing at 100 km/s, 8.6e9 m in a day
+static void setupImpact(SimWorld* world)
+{
+    sim::initSolarSystem(world);
+    sim::clearBodies(&world->bodies, Sim_Units_Astronomical);
+
+    SimBody a = {};
+    a.mass = 1e24f;
+    a.radius = 1e6f;
+    a.pos = { -1e8f, 0.0f };
+    a.vel = { 5e4f, 100.0f };
+    sim::addBody(&world->bodies, a);
+
+    SimBody b = {};
+    b.mass = 3e23f;
+    b.radius = 1e6f;
+    b.pos = { 1e8f, 0.0f };
+    b.vel = { -5e4f, 0.0f };
+    sim::addBody(&world->bodies, b);
+}
+
+static double relative(double value, double reference, double scale)
+{
+    return std::fabs(value - reference) / scale;
+}
+
+namespace bench
+{
+    int collisions(int argc, char** argv)
+    {
+        const double day = 86400.0;
+        bool ok = true;
+
+        printf("head-on impact at 100 km/s, one step of a day\n");
+        printf("  %-10s %8s %14s %14s %14s\n", "response", "bodies", "mass err", "momentum err", "energy err");
+        for (SimCollisionResponse response : { Sim_Collision_Merge, Sim_Collision_Bounce, Sim_Collision_Fragment })
+        {
+            SimWorld world;
+            setupImpact(&world);
+            double timeStep = day / world.bodies.units.time;
+            CollisionTotals before = getTotals(world.bodies);
+
+            driftAndCollide(&world, response, 1.0f, timeStep);
+            CollisionTotals after = getTotals(world.bodies);
+
+            double momentum = std::sqrt(before.px * before.px + before.py * before.py);
+            double massError = relative(after.mass, before.mass, before.mass);
+            double momentumError = std::sqrt((after.px - before.px) * (after.px - before.px) + (after.py - before.py) * (after.py - before.py)) / momentum;
+            double energyError = relative(after.kinetic, before.kinetic, before.kinetic);
+
+            // merging loses energy by design, an elastic bounce keeps it and sends the light body back
+            uint32_t expected = response == Sim_Collision_Merge ? 1 : (response == Sim_Collision_Bounce ? 2 : 1 + SIM_COLLISION_FRAGMENTS);
+            bool good = world.bodies.count == expected && massError < s_Tolerance && momentumError < s_Tolerance;
+            if (response == Sim_Collision_Bounce)
+                good = good && energyError < s_Tolerance && world.bodies.vx[1] > 0.0f && world.bodies.x[1] > world.bodies.x[0];
+
+            ok = ok && good;
+            printf("  %-10s %8u %14.3e %14.3e %14.3e %s\n", sim::getCollisionResponseName(response), world.bodies.count,
+                massError, momentumError, energyError, good ? "" : "FAIL");
+        }
+
+        {
+            // a test particle through a body at rest
+            SimWorld world;
+            setupImpact(&world);
+            world.bodies.vx[0] = world.bodies.vy[0] = 0.0f;
+            world.bodies.x[1] = 1e3f; // out of the way
+            sim::clearParticles(&world.particles);
+            sim::addParticle(&world.particles, world.bodies, { -3e8f, 0.0f }, { 1e5f, 0.0f });
+
+            driftAndCollide(&world, Sim_Collision_Merge, 1.0f, day / world.bodies.units.time);
+            bool good = world.particles.count == 0 && world.collisions.absorbed == 1;
+            ok = ok && good;
+            printf("  %-10s %8s particles left %u %s\n", "particle", "", world.particles.count, good ? "" : "FAIL");
+        }
+
+        // the grid is rebuilt every step, at the same density (the belt gets wider with the count) the cost per entry
+        // should stay about flat, a denser belt has more candidates per entry
+        printf("collision stage, belt from 2.2 AU with the density of 1000000 bodies up to 3.2 AU, one day\n");
+        printf("  %-10s %10s %10s %12s %12s %10s %8s\n", "kind", "count", "outer (AU)", "ms", "ns/entry", "cell (km)", "pairs");
+        for (uint32_t count : { 10000u, 100000u, 1000000u })
+        {
+            for (bool particles : { false, true })
+            {
+                double outer = std::sqrt(2.2 * 2.2 + (3.2 * 3.2 - 2.2 * 2.2) * count / 1e6);
+
+                SimWorld world;
+                sim::initSolarSystem(&world);
+                if (particles)
+                    sim::addParticleBelt(&world, count, 2.2f * AU, (float)(outer * AU));
+                else
+                    sim::addAsteroidBelt(&world, count, 2.2f * AU, (float)(outer * AU));
+
+                double timeStep = day / world.bodies.units.time;
+                SimCollisions& collisions = world.collisions;
+                sim::beginCollisions(&collisions, world.bodies, world.particles);
+                for (uint32_t i = 0; i < world.bodies.count; i++)
+                {
+                    world.bodies.x[i] += (float)(world.bodies.vx[i] * timeStep);
+                    world.bodies.y[i] += (float)(world.bodies.vy[i] * timeStep);
+                }
+                for (uint32_t i = 0; i < world.particles.count; i++)
+                {
+                    world.particles.x[i] += (float)(world.particles.vx[i] * timeStep);
+                    world.particles.y[i] += (float)(world.particles.vy[i] * timeStep);
+                }
+
+                sim::findCollisions(&collisions, world.bodies, world.particles); // warm up
+                const uint32_t repeats = 3;
+                double start = bench::now();
+                for (uint32_t r = 0; r < repeats; r++)
+                    sim::findCollisions(&collisions, world.bodies, world.particles);
+                double seconds = (bench::now() - start) / repeats;
+
+                uint32_t entries = world.bodies.count + world.particles.count;
+                printf("  %-10s %10u %10.3f %12.2f %12.1f %10.0f %8zu\n", particles ? "particles" : "bodies", count, outer, seconds * 1e3,
+                    seconds * 1e9 / entries, collisions.cellSize * world.bodies.units.length / 1e3, collisions.pairs.size());
+            }
+        }
+
+        if (!ok)
+        {
+            printf("a collision response is off by more than %.0e\n", s_Tolerance);
+            return 1;
+        }
+
+        return 0;
+    }
+}
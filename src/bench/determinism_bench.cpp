@@ -0,0 +1,178 @@
+#include "bench.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <vector>
+
+#include "core/simulation.h"
+#include "core/thread_pool.h"
+
+// runs every solver and integrator with 1 thread and with more and compares the checksum of the state after every step,
+// fails when a run that should be reproducible isn't, then the cost of the deterministic pair pass and of the checksum
+// usage: solarSystemBench determinism [max threads], the default is every hardware thread (at least 4)
+
+static const uint32_t s_Steps = 20;
+
+struct DeterminismCase
+{
+    const char* name;
+    SimSolver solver;
+    SimIntegrator integrator;
+    SimPrecision precision;
+    bool deterministic;
+    bool collisions;   // merging belt bodies, the pairs are found in parallel
+    bool expected;     // the same bits for every thread count
+};
+
+static void createWorld(SimWorld* world, bool collisions)
+{
+    sim::initSolarSystem(world);
+    sim::addAsteroidBelt(world, 3000, 2.2f * AU, 3.2f * AU);
+    sim::addParticleBelt(world, 20000, 2.2f * AU, 3.2f * AU, 3);
+
+    // huge radii so the belt merges within a few steps
+    if (collisions)
+    {
+        for (uint32_t i = 10; i < world->bodies.count; i++)
+            world->bodies.radius[i] = 1e9f / world->bodies.units.length;
+    }
+}
+
+static void runChecksums(const DeterminismCase& c, std::vector<uint64_t>* checksums, double* seconds)
+{
+    SimSettings settings;
+    sim::initSettings(&settings);
+    settings.solver = c.solver;
+    settings.integrator = c.integrator;
+    settings.precision = c.precision;
+    settings.deterministic = c.deterministic;
+    settings.collisions = c.collisions ? Sim_Collision_Merge : Sim_Collision_None;
+
+    SimWorld world;
+    createWorld(&world, c.collisions);
+
+    checksums->clear();
+    double start = bench::now();
+    for (uint32_t i = 0; i < s_Steps; i++)
+    {
+        sim::step(&world, settings);
+        checksums->push_back(sim::computeChecksum(world));
+    }
+    *seconds = (bench::now() - start) / s_Steps;
+}
+
+namespace bench
+{
+    int determinism(int argc, char** argv)
+    {
+        uint32_t hardware = sim::getHardwareThreadCount();
+        uint32_t maxThreads = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : std::max(hardware, 4u);
+        maxThreads = std::max(maxThreads, 2u);
+
+        // odd counts too, they split the rows differently from the powers of two
+        std::vector<uint32_t> threadCounts;
+        for (uint32_t threads : { 2u, 3u, maxThreads })
+        {
+            if (threads <= maxThreads && std::find(threadCounts.begin(), threadCounts.end(), threads) == threadCounts.end())
+                threadCounts.push_back(threads);
+        }
+
+        const DeterminismCase cases[] =
+        {
+            { "direct, leapfrog",                Sim_Solver_Direct,    Sim_Integrator_Leapfrog,      Sim_Precision_Float,  false, false, false },
+            { "direct, leapfrog, deterministic", Sim_Solver_Direct,    Sim_Integrator_Leapfrog,      Sim_Precision_Float,  true,  false, true },
+            { "direct, kahan, deterministic",    Sim_Solver_Direct,    Sim_Integrator_Yoshida4,      Sim_Precision_Kahan,  true,  false, true },
+            { "direct, merging, deterministic",  Sim_Solver_Direct,    Sim_Integrator_Euler,         Sim_Precision_Float,  true,  true,  true },
+            { "direct, double state",            Sim_Solver_Direct,    Sim_Integrator_Leapfrog,      Sim_Precision_Double, false, false, true },
+            { "barnes-hut, leapfrog",            Sim_Solver_BarnesHut, Sim_Integrator_Leapfrog,      Sim_Precision_Float,  false, false, true },
+            { "fmm, leapfrog",                   Sim_Solver_Fmm,       Sim_Integrator_Leapfrog,      Sim_Precision_Float,  false, false, true },
+            { "hermite",                         Sim_Solver_Direct,    Sim_Integrator_Hermite,       Sim_Precision_Float,  false, false, true },
+            { "dormand-prince",                  Sim_Solver_Direct,    Sim_Integrator_DormandPrince, Sim_Precision_Float,  false, false, true },
+        };
+
+        bool ok = true;
+        printf("checksum after every step of %u steps, solar system, 3000 belt bodies and 20000 test particles\n", s_Steps);
+        printf("  %-34s %10s", "case", "1 thread");
+        for (uint32_t threads : threadCounts)
+            printf(" %9u", threads);
+        printf("   (ms/step, first step that differs from 1 thread)\n");
+
+        for (const DeterminismCase& c : cases)
+        {
+            std::vector<uint64_t> reference, checksums;
+            double seconds;
+
+            sim::setThreadCount(1);
+            runChecksums(c, &reference, &seconds);
+            printf("  %-34s %10.2f", c.name, seconds * 1e3);
+
+            bool same = true;
+            for (uint32_t threads : threadCounts)
+            {
+                sim::setThreadCount(threads);
+                runChecksums(c, &checksums, &seconds);
+
+                uint32_t differs = 0;
+                for (uint32_t i = 0; i < s_Steps && differs == 0; i++)
+                {
+                    if (checksums[i] != reference[i])
+                        differs = i + 1;
+                }
+
+                same = same && differs == 0;
+                if (differs == 0)
+                    printf(" %9.2f", seconds * 1e3);
+                else
+                    printf(" %5.2f@%-3u", seconds * 1e3, differs);
+            }
+
+            bool good = same || !c.expected;
+            ok = ok && good;
+            printf("  %s\n", good ? (same ? "" : "(expected)") : "FAIL");
+        }
+
+        // the cost: the slots are fewer tasks than the rows, and a 64 bit hash of the whole state
+        printf("direct summation force pass, %u threads\n", maxThreads);
+        printf("  %8s %14s %16s %14s\n", "N", "ms", "deterministic", "checksum ms");
+        sim::setThreadCount(maxThreads);
+        for (uint32_t count : { 2000u, 8000u, 20000u })
+        {
+            SimWorld world;
+            sim::initSolarSystem(&world);
+            sim::addAsteroidBelt(&world, count - world.bodies.count, 2.2f * AU, 3.2f * AU);
+
+            SimSettings settings;
+            sim::initSettings(&settings);
+
+            double ms[2];
+            for (int deterministic = 0; deterministic < 2; deterministic++)
+            {
+                settings.deterministic = deterministic != 0;
+                sim::computeForces(&world, settings);
+
+                double start = bench::now();
+                for (int r = 0; r < 5; r++)
+                    sim::computeForces(&world, settings);
+                ms[deterministic] = (bench::now() - start) / 5 * 1e3;
+            }
+
+            double start = bench::now();
+            for (int r = 0; r < 100; r++)
+                sim::computeChecksum(world);
+            double checksumMs = (bench::now() - start) / 100 * 1e3;
+
+            printf("  %8u %14.3f %16.3f %14.4f\n", count, ms[0], ms[1], checksumMs);
+        }
+
+        sim::setThreadCount(0);
+
+        if (!ok)
+        {
+            printf("a run that should be reproducible gave different bits with more threads\n");
+            return 1;
+        }
+
+        return 0;
+    }
+}
@@ -0,0 +1,156 @@
+#include "bench.h"
+
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+#include "core/simulation.h"
+#include "core/gravity.h"
+
+// the potential energy summed in the force pass against a double precision sum of every pair (fails when they disagree),
+// the drift the diagnostics report for every integrator on the solar system and the cost of a step with them on
+
+static const double s_Tolerance = 1e-5; // relative, float forces and positions
+static const double s_Year = 365.25 * 86400.0;
+
+// -G sum m_i m_j / r in double
+static double referencePotential(const SimBodies& bodies)
+{
+    double sum = 0.0;
+    for (uint32_t i = 0; i < bodies.count; i++)
+    {
+        for (uint32_t j = i + 1; j < bodies.count; j++)
+        {
+            double dx = (double)bodies.x[j] - bodies.x[i];
+            double dy = (double)bodies.y[j] - bodies.y[i];
+            double r = std::sqrt(dx * dx + dy * dy);
+            if (r > 0.0)
+                sum += (double)bodies.mass[i] * bodies.mass[j] / r;
+        }
+    }
+
+    return -bodies.units.G * sum;
+}
+
+namespace bench
+{
+    int diagnostics(int argc, char** argv)
+    {
+        bool ok = true;
+
+        // si units too, m_i m_j overflows a float there
+        printf("potential energy of the force pass against a double sum of every pair, solar system and 4000 belt bodies\n");
+        printf("  %-14s %-10s %-14s %14s\n", "units", "kernel", "pass", "rel. error");
+        for (SimUnitSystem system : { Sim_Units_Astronomical, Sim_Units_Si })
+        {
+            SimWorld world;
+            sim::initSolarSystem(&world, system);
+            sim::addAsteroidBelt(&world, 4000, 2.2f * AU, 3.2f * AU);
+            const SimBodies& bodies = world.bodies;
+            double reference = referencePotential(bodies);
+
+            std::vector<float> ax(sim::paddedCount(bodies.count)), ay(sim::paddedCount(bodies.count));
+            for (int k = Sim_Kernel_Scalar; k < Sim_Kernel_Count; k++)
+            {
+                SimKernel kernel = (SimKernel)k;
+                if (!sim::isKernelAvailable(kernel)) continue;
+
+                for (int deterministic = 0; deterministic < 2; deterministic++)
+                {
+                    double potential;
+                    sim::computeAccelerationsPairwise(kernel, bodies, ax.data(), ay.data(), deterministic != 0, &potential);
+                    double error = std::fabs(potential - reference) / std::fabs(reference);
+                    bool good = error < s_Tolerance;
+                    ok = ok && good;
+                    printf("  %-14s %-10s %-14s %14.3e %s\n", sim::getUnitSystemName(system), sim::getKernelName(kernel),
+                        deterministic ? "deterministic" : "pairwise", error, good ? "" : "FAIL");
+                }
+            }
+
+            std::vector<double> x(bodies.count), y(bodies.count), dax(bodies.count), day(bodies.count);
+            for (uint32_t i = 0; i < bodies.count; i++)
+                x[i] = bodies.x[i], y[i] = bodies.y[i];
+
+            double potential;
+            sim::computeAccelerationsState<double, double>(bodies, x.data(), y.data(), dax.data(), day.data(), &potential);
+            double error = std::fabs(potential - reference) / std::fabs(reference);
+            bool good = error < 1e-12;
+            ok = ok && good;
+            printf("  %-14s %-10s %-14s %14.3e %s\n", sim::getUnitSystemName(system), "double", "state", error, good ? "" : "FAIL");
+        }
+
+        // what the diagnostics report after 100 years of steps of a day, the largest drift seen
+        printf("drift after 100 years of the solar system, steps of a day\n");
+        printf("  %-16s %-8s %14s %14s %14s %10s\n", "integrator", "state", "energy", "momentum", "angular", "fused");
+        for (SimIntegrator integrator : { Sim_Integrator_Euler, Sim_Integrator_Leapfrog, Sim_Integrator_Yoshida4, Sim_Integrator_Hermite, Sim_Integrator_DormandPrince })
+        {
+            for (SimPrecision precision : { Sim_Precision_Float, Sim_Precision_Double })
+            {
+                bool splitting = sim::getIntegrator(integrator).stages > 0;
+                if (!splitting && precision != Sim_Precision_Float) continue;
+
+                SimSettings settings;
+                sim::initSettings(&settings);
+                settings.integrator = integrator;
+                settings.precision = precision;
+                settings.diagnostics = true;
+
+                SimWorld world;
+                sim::initSolarSystem(&world);
+
+                double energy = 0.0, momentum = 0.0, angular = 0.0;
+                uint64_t steps = (uint64_t)(100 * s_Year / settings.timeStep);
+                for (uint64_t i = 0; i < steps; i++)
+                {
+                    sim::step(&world, settings);
+                    energy = std::max(energy, std::fabs(sim::getEnergyDrift(world.diagnostics)));
+                    momentum = std::max(momentum, std::fabs(sim::getMomentumDrift(world.diagnostics)));
+                    angular = std::max(angular, std::fabs(sim::getAngularDrift(world.diagnostics)));
+                }
+
+                printf("  %-16s %-8s %14.3e %14.3e %14.3e %10llu\n", sim::getIntegratorName(integrator), splitting ? sim::getPrecisionName(precision) : "double",
+                    energy, momentum, angular, (unsigned long long)world.diagnostics.fused);
+            }
+        }
+
+        // euler and forest-ruth end on a drift, their diagnostics compute the forces of the next step's first kick early
+        printf("cost of a step with and without diagnostics, direct summation\n");
+        printf("  %8s %-12s %12s %12s\n", "N", "integrator", "ms", "diagnostics");
+        for (uint32_t count : { 1000u, 10000u })
+        {
+            for (SimIntegrator integrator : { Sim_Integrator_Euler, Sim_Integrator_Leapfrog })
+            {
+                double ms[2];
+                for (int on = 0; on < 2; on++)
+                {
+                    SimSettings settings;
+                    sim::initSettings(&settings);
+                    settings.integrator = integrator;
+                    settings.diagnostics = on != 0;
+
+                    SimWorld world;
+                    sim::initSolarSystem(&world);
+                    sim::addAsteroidBelt(&world, count - world.bodies.count, 2.2f * AU, 3.2f * AU);
+                    sim::step(&world, settings);
+
+                    const int steps = 5;
+                    double start = bench::now();
+                    for (int i = 0; i < steps; i++)
+                        sim::step(&world, settings);
+                    ms[on] = (bench::now() - start) / steps * 1e3;
+                }
+
+                printf("  %8u %-12s %12.2f %12.2f\n", count, sim::getIntegratorName(integrator), ms[0], ms[1]);
+            }
+        }
+
+        if (!ok)
+        {
+            printf("the potential of the force pass is off by more than %.0e\n", s_Tolerance);
+            return 1;
+        }
+
+        return 0;
+    }
+}
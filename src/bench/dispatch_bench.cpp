@@ -0,0 +1,155 @@
+#include "bench.h"
+
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+#include "core/cpu.h"
+#include "core/gravity.h"
+#include "core/kepler.h"
+#include "core/simulation.h"
+
+// which kernels this build has and this cpu runs, the one picked at startup, then the kicks and drifts, the kepler
+// propagation and a whole step through every runnable kernel against the scalar one: they have to agree (fails otherwise)
+
+static const double s_Tolerance = 1e-4; // relative to the largest value
+
+static double maxRelativeDifference(const std::vector<float>& a, const std::vector<float>& b)
+{
+    double largest = 0.0, difference = 0.0;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        largest = std::max(largest, std::fabs((double)b[i]));
+        difference = std::max(difference, std::fabs((double)a[i] - b[i]));
+    }
+
+    return largest > 0.0 ? difference / largest : difference;
+}
+
+namespace bench
+{
+    int dispatch(int argc, char** argv)
+    {
+        const SimCpuFeatures& cpu = sim::getCpuFeatures();
+        printf("cpu: sse2 %d, sse4.2 %d, avx %d, avx2 %d, fma %d, avx512f %d\n", cpu.sse2, cpu.sse42, cpu.avx, cpu.avx2, cpu.fma, cpu.avx512f);
+
+        SimKernel startup = sim::getKernel();
+        printf("  %-10s %10s %10s\n", "kernel", "compiled", "runnable");
+        for (int k = 0; k < Sim_Kernel_Count; k++)
+        {
+            SimKernel kernel = (SimKernel)k;
+            printf("  %-10s %10s %10s %s\n", sim::getKernelName(kernel), sim::isKernelCompiled(kernel) ? "yes" : "no",
+                sim::isKernelAvailable(kernel) ? "yes" : "no", kernel == startup ? "<- selected" : "");
+        }
+
+        bool ok = true;
+
+        const uint32_t count = 1 << 20;
+        std::vector<float> x(count), v(count), reference;
+        for (uint32_t i = 0; i < count; i++)
+            v[i] = std::sin((float)i);
+
+        printf("y += x * s over %u floats (the kick and the drift of the float integrators)\n", count);
+        printf("  %-10s %12s %14s\n", "kernel", "ns/element", "rel. diff");
+        for (int k = Sim_Kernel_Scalar; k < Sim_Kernel_Count; k++)
+        {
+            SimKernel kernel = (SimKernel)k;
+            if (!sim::isKernelAvailable(kernel)) continue;
+
+            std::fill(x.begin(), x.end(), 1.0f);
+            const uint32_t passes = 100;
+            double start = bench::now();
+            for (uint32_t r = 0; r < passes; r++)
+                sim::addScaled(kernel, x.data(), v.data(), 1e-3f, 0, count);
+            double ns = (bench::now() - start) / ((double)passes * count) * 1e9;
+
+            if (kernel == Sim_Kernel_Scalar)
+                reference = x;
+
+            double error = maxRelativeDifference(x, reference);
+            bool good = error < s_Tolerance;
+            ok = ok && good;
+            printf("  %-10s %12.3f %14.3e %s\n", sim::getKernelName(kernel), ns, error, good ? "" : "FAIL");
+        }
+
+        // a year of the kuiper belt in one call, the solver runs in the double lanes of the kernel
+        {
+            SimWorld world;
+            sim::initSolarSystem(&world);
+            sim::addParticleBelt(&world, count, 30.0f * AU, 50.0f * AU);
+            SimKeplerCenter sun;
+            sim::getSunCenter(world.bodies, &sun);
+            const SimParticles& start = world.particles;
+
+            printf("kepler propagation of %u kuiper belt particles by a year\n", count);
+            printf("  %-10s %12s %14s\n", "kernel", "ns/particle", "rel. diff");
+            for (int k = Sim_Kernel_Scalar; k < Sim_Kernel_Count; k++)
+            {
+                SimKernel kernel = (SimKernel)k;
+                if (!sim::isKernelAvailable(kernel)) continue;
+
+                std::vector<float> px(start.x.begin(), start.x.begin() + count), py(start.y.begin(), start.y.begin() + count);
+                std::vector<float> pvx(start.vx.begin(), start.vx.begin() + count), pvy(start.vy.begin(), start.vy.begin() + count);
+                double begin = bench::now();
+                sim::propagateKepler(kernel, sun, world.bodies.units.G, 365.25, px.data(), py.data(), pvx.data(), pvy.data(), nullptr, count);
+                double ns = (bench::now() - begin) / count * 1e9;
+
+                px.insert(px.end(), py.begin(), py.end());
+                if (kernel == Sim_Kernel_Scalar)
+                    reference = px;
+
+                double error = maxRelativeDifference(px, reference);
+                bool good = error < s_Tolerance;
+                ok = ok && good;
+                printf("  %-10s %12.1f %14.3e %s\n", sim::getKernelName(kernel), ns, error, good ? "" : "FAIL");
+            }
+        }
+
+        SimSettings settings;
+        sim::initSettings(&settings);
+        settings.integrator = Sim_Integrator_Leapfrog;
+
+        const uint32_t belt = 4000, steps = 20;
+        std::vector<float> final[2];
+        printf("leapfrog step of the solar system and %u belt bodies, %u steps of a day\n", belt, steps);
+        printf("  %-10s %12s %14s\n", "kernel", "ms/step", "rel. diff");
+        for (int k = Sim_Kernel_Scalar; k < Sim_Kernel_Count; k++)
+        {
+            SimKernel kernel = (SimKernel)k;
+            if (!sim::isKernelAvailable(kernel)) continue;
+            sim::setKernel(kernel);
+
+            SimWorld world;
+            sim::initSolarSystem(&world);
+            sim::addAsteroidBelt(&world, belt, 2.2f * AU, 3.2f * AU);
+
+            double start = bench::now();
+            for (uint32_t i = 0; i < steps; i++)
+                sim::step(&world, settings);
+            double ms = (bench::now() - start) / steps * 1e3;
+
+            const SimBodies& bodies = world.bodies;
+            std::vector<float> positions(bodies.x.begin(), bodies.x.begin() + bodies.count);
+            positions.insert(positions.end(), bodies.y.begin(), bodies.y.begin() + bodies.count);
+            if (kernel == Sim_Kernel_Scalar)
+                final[0] = positions;
+            final[1] = positions;
+
+            double error = final[0].size() == final[1].size() ? maxRelativeDifference(final[1], final[0]) : 1.0;
+            bool good = error < s_Tolerance;
+            ok = ok && good;
+            printf("  %-10s %12.3f %14.3e %s\n", sim::getKernelName(kernel), ms, error, good ? "" : "FAIL");
+        }
+
+        sim::setKernel(startup);
+
+        if (!ok)
+        {
+            printf("a kernel disagrees with the scalar one by more than %.0e\n", s_Tolerance);
+            return 1;
+        }
+
+        return 0;
+    }
+}
@@ -0,0 +1,166 @@
+#include "bench.h"
+
+#include <cstdio>
+#include <cmath>
+
+#include "core/simulation.h"
+
+// a small body flying past an earth at 5 km/s with a perigee of a few earth radii, half an hour around perigee
+// in steps of a day: leapfrog with and without the regularized pair against a tight adaptive run, fails when
+// the regularized run is off, then the cost of a step of a belt with and without pairs, and a test particle
+// falling through the earth with and without softening
+
+static const double s_Tolerance = 1e-3; // relative to the distance of the flyby body from the earth at the end
+
+static const uint32_t s_Days = 50;
+
+// sun, an earth on a circular orbit and the flyby body 1e10 m behind it, aimed 3e7 m off its center
+static void setupFlyby(SimWorld* world)
+{
+    sim::initSolarSystem(world);
+    sim::clearBodies(&world->bodies, Sim_Units_Astronomical);
+
+    SimBody sun = {};
+    sun.mass = (float)SUN_MASS;
+    sun.sun = true;
+    sim::addBody(&world->bodies, sun);
+
+    SimBody earth = {};
+    earth.mass = 5.97e24f;
+    earth.radius = 6.371e6f;
+    earth.pos = { AU, 0.0f };
+    earth.vel = { 0.0f, 29780.0f };
+    sim::addBody(&world->bodies, earth);
+
+    SimBody flyby = {};
+    flyby.mass = 1e15f;
+    flyby.pos = { AU + 3e7f, -1e10f };
+    flyby.vel = { 0.0f, 29780.0f + 5000.0f };
+    sim::addBody(&world->bodies, flyby);
+}
+
+// position of the flyby body relative to the earth in meters
+static void relativePosition(const SimWorld& world, double* x, double* y)
+{
+    const SimBodies& bodies = world.bodies;
+    *x = ((double)bodies.x[2] - bodies.x[1]) * bodies.units.length;
+    *y = ((double)bodies.y[2] - bodies.y[1]) * bodies.units.length;
+}
+
+namespace bench
+{
+    int encounters(int argc, char** argv)
+    {
+        bool ok = true;
+
+        SimSettings reference;
+        sim::initSettings(&reference);
+        reference.integrator = Sim_Integrator_DormandPrince;
+        reference.tolerance = 1e-12f;
+
+        SimWorld referenceWorld;
+        setupFlyby(&referenceWorld);
+        for (uint32_t i = 0; i < s_Days; i++)
+            sim::step(&referenceWorld, reference);
+
+        double rx, ry;
+        relativePosition(referenceWorld, &rx, &ry);
+        double distance = std::sqrt(rx * rx + ry * ry);
+
+        printf("flyby of an earth at 5 km/s, perigee ~1.8e7 m, %u steps of a day, distance at the end %.3e m\n", s_Days, distance);
+        printf("  %-10s %-8s %10s %14s %10s %12s\n", "integrator", "state", "hill", "position err", "pair steps", "substeps");
+        for (SimPrecision precision : { Sim_Precision_Float, Sim_Precision_Double })
+        {
+            for (float hill : { 0.0f, 3.0f, SIM_ENCOUNTER_HILL })
+            {
+                SimSettings settings;
+                sim::initSettings(&settings);
+                settings.integrator = Sim_Integrator_Leapfrog;
+                settings.precision = precision;
+                settings.encounterHill = hill;
+
+                SimWorld world;
+                setupFlyby(&world);
+                for (uint32_t i = 0; i < s_Days; i++)
+                    sim::step(&world, settings);
+
+                double x, y;
+                relativePosition(world, &x, &y);
+                double error = std::sqrt((x - rx) * (x - rx) + (y - ry) * (y - ry)) / distance;
+
+                // float positions near 1 AU are good to ~10 km, the regularized double run has to match the reference,
+                // 3 hill radii (the usual choice for short steps) leave too much of the approach to steps of a day
+                bool good = !(hill == SIM_ENCOUNTER_HILL && precision == Sim_Precision_Double) || error < s_Tolerance;
+                ok = ok && good;
+                printf("  %-10s %-8s %10.1f %14.3e %10llu %12llu %s\n", sim::getIntegratorName(settings.integrator), sim::getPrecisionName(precision), hill,
+                    error, (unsigned long long)world.encounters.pairSteps, (unsigned long long)world.encounters.substeps, good ? "" : "FAIL");
+            }
+        }
+
+        // a pair only adds O(N) work per step, the other bodies keep the step and the force pass,
+        // the belt bodies within a few hill radii of each other are pairs of their own
+        const uint32_t beltCount = 8000;
+        const uint32_t steps = 10;
+        printf("step of the flyby with a belt of %u bodies, direct summation\n", beltCount);
+        printf("  %-10s %10s %10s %10s\n", "hill", "ms/step", "pairs", "substeps");
+        for (float hill : { 0.0f, SIM_ENCOUNTER_HILL })
+        {
+            SimSettings settings;
+            sim::initSettings(&settings);
+            settings.integrator = Sim_Integrator_Leapfrog;
+            settings.encounterHill = hill;
+
+            SimWorld world;
+            setupFlyby(&world);
+            sim::addAsteroidBelt(&world, beltCount, 2.2f * AU, 3.2f * AU);
+
+            // a day before perigee
+            settings.timeStep = 86400.0f * 22;
+            sim::step(&world, settings);
+            settings.timeStep = 86400.0f;
+
+            double start = bench::now();
+            for (uint32_t i = 0; i < steps; i++)
+                sim::step(&world, settings);
+            double seconds = (bench::now() - start) / steps;
+
+            printf("  %-10.1f %10.2f %10zu %10llu\n", hill, seconds * 1e3, world.encounters.pairs.size(), (unsigned long long)world.encounters.substeps);
+        }
+
+        // a particle falling through the center of the earth from 2e8 m at 8 km/s and out to the other side,
+        // its speed there against the speed it started with, softening has to be about the distance of a step
+        printf("test particle through the center of an earth, steps of 10 minutes\n");
+        printf("  %-14s %16s\n", "softening (m)", "speed change");
+        for (float softening : { 0.0f, 6.371e6f, 2e7f })
+        {
+            SimSettings settings;
+            sim::initSettings(&settings);
+            settings.integrator = Sim_Integrator_Leapfrog;
+            settings.timeStep = 600.0f;
+            settings.softening = softening;
+
+            SimWorld world;
+            setupFlyby(&world);
+            sim::removeBody(&world.bodies, 2);
+            sim::addParticle(&world.particles, world.bodies, { AU, -2e8f }, { 0.0f, 29780.0f + 8000.0f });
+
+            const SimUnits& units = world.bodies.units;
+            double speed = units.length / units.time;
+            for (uint32_t i = 0; i < 80; i++)
+                sim::step(&world, settings);
+
+            double vx = ((double)world.particles.vx[0] - world.bodies.vx[1]) * speed;
+            double vy = ((double)world.particles.vy[0] - world.bodies.vy[1]) * speed;
+            double change = std::sqrt(vx * vx + vy * vy) / 8000.0 - 1.0;
+            printf("  %-14.3e %16.3e\n", softening, change);
+        }
+
+        if (!ok)
+        {
+            printf("the regularized flyby is off by more than %.0e\n", s_Tolerance);
+            return 1;
+        }
+
+        return 0;
+    }
+}
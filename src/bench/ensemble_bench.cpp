@@ -0,0 +1,166 @@
+#include "bench.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+#include "core/ensemble.h"
+#include "core/gravity.h"
+#include "core/simulation.h"
+#include "core/thread_pool.h"
+
+// ensembles of the solar system: the unperturbed member against a float world stepped the same way (fails when
+// they drift apart), the outcomes of strongly perturbed members, and member-years per second for every kernel
+// and thread count against one world per member
+// usage: solarSystemBench ensemble [members], the default is 4096
+
+static const double s_Tolerance = 1e-2; // relative to the distance of a body from the sun, float rounding moves the phase of mercury most
+static const double s_Year = 365.25 * 86400.0;
+
+namespace bench
+{
+    int ensemble(int argc, char** argv)
+    {
+        uint32_t members = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : 4096;
+        members = std::max(members, 64u);
+        bool ok = true;
+
+        SimWorld world;
+        sim::initSolarSystem(&world);
+
+        // member 0 is the world, only the order of the sums differs (mercury ends ~1e-3 apart, as far as a double world is)
+        const uint32_t years = 10;
+        printf("member 0 against a world, %u years of the solar system in steps of a day\n", years);
+        printf("  %-12s %16s\n", "integrator", "max rel. error");
+        for (SimIntegrator integrator : { Sim_Integrator_Leapfrog, Sim_Integrator_Yoshida4 })
+        {
+            SimSettings settings;
+            sim::initSettings(&settings);
+            settings.integrator = integrator;
+
+            SimWorld reference;
+            sim::initSolarSystem(&reference);
+            SimEnsemble ensemble;
+            sim::initEnsemble(&ensemble, reference.bodies, 64, 0.0);
+
+            uint32_t steps = (uint32_t)(years * s_Year / settings.timeStep);
+            for (uint32_t i = 0; i < steps; i++)
+                sim::step(&reference, settings);
+            sim::stepEnsemble(&ensemble, integrator, settings.timeStep, steps);
+
+            double error = 0.0;
+            for (uint32_t i = 0; i < reference.bodies.count; i++)
+            {
+                SimBody body = sim::getBody(reference.bodies, i);
+                SimBody member = sim::getEnsembleBody(ensemble, 0, i);
+                if (body.sun) continue;
+
+                double dx = (double)member.pos.x - body.pos.x, dy = (double)member.pos.y - body.pos.y;
+                error = std::max(error, std::sqrt(dx * dx + dy * dy) / body.distance);
+            }
+
+            bool good = error < s_Tolerance;
+            ok = ok && good;
+            printf("  %-12s %16.3e %s\n", sim::getIntegratorName(integrator), error, good ? "" : "FAIL");
+        }
+
+        // positions and velocities moved by up to 20%, enough to throw some members apart within a century
+        {
+            const uint32_t count = 1024;
+            const uint32_t steps = (uint32_t)(100 * s_Year / 86400.0);
+            SimEnsemble ensemble;
+            sim::initEnsemble(&ensemble, world.bodies, count, 0.2);
+            sim::stepEnsemble(&ensemble, Sim_Integrator_Leapfrog, 86400.0f, steps);
+
+            uint32_t ejected = 0, collided = 0;
+            std::vector<float> eccentricity;
+            std::vector<uint32_t> bodies(ensemble.bodyCount, 0);
+            for (uint32_t m = 0; m < count; m++)
+            {
+                SimEnsembleOutcome outcome = sim::getEnsembleOutcome(ensemble, m);
+                ejected += outcome.ejected;
+                collided += outcome.collided;
+                eccentricity.push_back(outcome.maxEccentricity);
+                bodies[outcome.body]++;
+            }
+
+            std::sort(eccentricity.begin(), eccentricity.end());
+            printf("%u members perturbed by 20%%, 100 years in steps of a day\n", count);
+            printf("  ejected (%.0f AU) %u, collided %u\n", SIM_ENSEMBLE_EJECT_RADIUS / AU, ejected, collided);
+            printf("  max eccentricity: median %.3f, 90%% %.3f, max %.3f\n", eccentricity[count / 2], eccentricity[count * 9 / 10], eccentricity[count - 1]);
+            printf("  most eccentric body:");
+            for (uint32_t i = 0; i < ensemble.bodyCount; i++)
+            {
+                if (bodies[i] > 0)
+                    printf(" %u: %u", i, bodies[i]);
+            }
+            printf("\n");
+        }
+
+        // throughput, 10 years per member, the worlds run a tenth of the members for a year
+        uint32_t hardware = sim::getHardwareThreadCount();
+        std::vector<uint32_t> threadCounts = { 1 };
+        if (hardware > 1)
+            threadCounts.push_back(hardware);
+
+        printf("member-years per second, %u members, leapfrog in steps of a day\n", members);
+        printf("  %-10s %8s %16s\n", "kernel", "threads", "member-years/s");
+        SimKernel selected = sim::getKernel();
+        for (int k = Sim_Kernel_Scalar; k < Sim_Kernel_Count; k++)
+        {
+            SimKernel kernel = (SimKernel)k;
+            if (!sim::isKernelAvailable(kernel)) continue;
+            sim::setKernel(kernel);
+
+            for (uint32_t threads : threadCounts)
+            {
+                sim::setThreadCount(threads);
+
+                SimEnsemble ensemble;
+                sim::initEnsemble(&ensemble, world.bodies, members, 1e-3);
+                double start = bench::now();
+                sim::stepEnsemble(&ensemble, Sim_Integrator_Leapfrog, 86400.0f, (uint32_t)(10 * s_Year / 86400.0));
+                double seconds = bench::now() - start;
+
+                printf("  %-10s %8u %16.0f\n", sim::getKernelName(kernel), threads, members * ensemble.time / s_Year / seconds);
+            }
+        }
+
+        // a world of ten bodies per member, its force pass and step have the cost of a world of thousands
+        sim::setKernel(selected);
+        sim::setThreadCount(1);
+        {
+            SimSettings settings;
+            sim::initSettings(&settings);
+            settings.integrator = Sim_Integrator_Leapfrog;
+
+            uint32_t count = std::max(members / 10, 1u);
+            std::vector<SimWorld> worlds(count);
+            for (SimWorld& w : worlds)
+                sim::initSolarSystem(&w);
+
+            uint32_t steps = (uint32_t)(s_Year / settings.timeStep);
+            double start = bench::now();
+            for (SimWorld& w : worlds)
+            {
+                for (uint32_t i = 0; i < steps; i++)
+                    sim::step(&w, settings);
+            }
+            double seconds = bench::now() - start;
+
+            printf("  %-10s %8u %16.0f   (one world per member)\n", sim::getKernelName(selected), 1u, count / seconds);
+        }
+
+        sim::setThreadCount(0);
+
+        if (!ok)
+        {
+            printf("the unperturbed member is off the world by more than %.0e\n", s_Tolerance);
+            return 1;
+        }
+
+        return 0;
+    }
+}
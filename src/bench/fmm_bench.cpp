@@ -0,0 +1,116 @@
+#include "bench.h"
+
+#include <cstdio>
+#include <cmath>
+#include <vector>
+
+#include "core/simulation.h"
+#include "core/gravity.h"
+#include "core/barnes_hut.h"
+#include "core/fmm.h"
+
+// accuracy of the fast multipole solver for each expansion order, and its cost against barnes-hut and direct summation
+
+static const uint32_t s_ErrorSamples = 1000;
+
+static void createWorld(SimWorld* world, uint32_t count)
+{
+    sim::initSolarSystem(world);
+    if (count > world->bodies.count)
+        sim::addAsteroidBelt(world, count - world->bodies.count, 2.2f * AU, 3.2f * AU);
+}
+
+// equal masses spread uniformly over a disk 10 AU across: every body is pulled by the whole disk, so the error of
+// the far field isn't hidden under the exact pull of a sun that dwarfs it (the solar system sits at float rounding)
+static void createDisk(SimWorld* world, uint32_t count)
+{
+    sim::clearBodies(&world->bodies, Sim_Units_Astronomical);
+    uint32_t seed = 1;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        double r = 5.0 * AU * std::sqrt((seed >> 8) * (1.0 / 16777216.0));
+        seed = seed * 1664525u + 1013904223u;
+        double angle = (seed >> 8) * (1.0 / 16777216.0) * 2.0 * 3.14159265358979;
+
+        SimBody body = {};
+        body.mass = (float)(SUN_MASS / count);
+        body.pos = { (float)(r * std::cos(angle)), (float)(r * std::sin(angle)) };
+        sim::addBody(&world->bodies, body);
+    }
+
+    world->forcesCurrent = false;
+}
+
+namespace bench
+{
+    int fmm(int argc, char** argv)
+    {
+        const uint32_t orders[] = { 2, 4, 6, 8, 10, 12 };
+        const float thetas[] = { 0.5f, 0.7f };
+        const uint32_t counts[] = { 4000, 16000, 64000, 256000, 1000000 };
+        const uint32_t accuracyCount = 20000;
+        const uint32_t maxDirectCount = 64000;
+
+        // accuracy vs order, self-gravitating disk of equal masses
+        {
+            SimWorld world;
+            createDisk(&world, accuracyCount);
+            SimBodies& bodies = world.bodies;
+            std::vector<float> ax(sim::paddedCount(bodies.count)), ay(sim::paddedCount(bodies.count));
+
+            printf("fast multipole accuracy, disk of N = %u equal masses, relative acceleration error on %u bodies\n", bodies.count, s_ErrorSamples);
+            printf("%8s %8s %12s %12s %12s\n", "theta", "order", "rms error", "max error", "ms");
+
+            for (float theta : thetas)
+            {
+                for (uint32_t order : orders)
+                {
+                    double start = now();
+                    sim::computeAccelerationsFmm(&world.fmm, &world.tree, bodies, order, theta, ax.data(), ay.data());
+                    double ms = (now() - start) * 1e3;
+
+                    SimForceError error = sim::measureForceError(bodies, ax.data(), ay.data(), s_ErrorSamples);
+                    printf("%8.2f %8u %12.3e %12.3e %12.2f\n", theta, order, error.rms, error.max, ms);
+                }
+            }
+        }
+
+        // time vs N, theta 0.5 and order 8
+        printf("\ntime per force pass vs N (theta 0.5, fmm order 8, direct is the pairwise %s kernel)\n", sim::getKernelName(sim::getKernel()));
+        printf("%8s %14s %14s %14s %12s\n", "N", "direct ms", "bh ms", "fmm ms", "fmm rms err");
+
+        for (uint32_t count : counts)
+        {
+            SimWorld world;
+            createWorld(&world, count);
+            SimBodies& bodies = world.bodies;
+            std::vector<float> ax(sim::paddedCount(bodies.count)), ay(sim::paddedCount(bodies.count));
+
+            double directMs = -1.0;
+            if (count <= maxDirectCount)
+            {
+                double start = now();
+                sim::computeAccelerationsPairwise(sim::getKernel(), bodies, ax.data(), ay.data());
+                directMs = (now() - start) * 1e3;
+            }
+
+            double start = now();
+            sim::computeAccelerationsBarnesHut(&world.tree, bodies, 0.5f, false, ax.data(), ay.data());
+            double bhMs = (now() - start) * 1e3;
+
+            start = now();
+            sim::computeAccelerationsFmm(&world.fmm, &world.tree, bodies, 8, 0.5f, ax.data(), ay.data());
+            double fmmMs = (now() - start) * 1e3;
+
+            SimForceError error = sim::measureForceError(bodies, ax.data(), ay.data(), 100);
+
+            if (directMs >= 0.0)
+                printf("%8u %14.2f %14.2f %14.2f %12.3e\n", count, directMs, bhMs, fmmMs, error.rms);
+            else
+                printf("%8u %14s %14.2f %14.2f %12.3e\n", count, "-", bhMs, fmmMs, error.rms);
+        }
+
+        return 0;
+    }
+}
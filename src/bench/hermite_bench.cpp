@@ -0,0 +1,68 @@
+#include "bench.h"
+
+#include <cstdio>
+#include <cmath>
+
+#include "core/simulation.h"
+
+// force evaluations per simulated year and energy error of the hermite block steps,
+// against hermite with one shared step and the semi-implicit euler integrator
+
+static const double s_Year = 365.25 * 86400.0;
+
+struct HermiteCase
+{
+    const char* name;
+    SimIntegrator integrator;
+    float timeStep;
+    bool blockSteps;
+};
+
+static void runCase(const HermiteCase& c, uint32_t beltCount, double years)
+{
+    SimSettings settings;
+    sim::initSettings(&settings);
+    settings.integrator = c.integrator;
+    settings.timeStep = c.timeStep;
+    settings.blockSteps = c.blockSteps;
+
+    SimWorld world;
+    sim::initSolarSystem(&world);
+    sim::addAsteroidBelt(&world, beltCount, 2.2f * AU, 3.2f * AU);
+
+    double startEnergy = sim::computeEnergy(world.bodies);
+    uint64_t steps = (uint64_t)(years * s_Year / c.timeStep);
+
+    double start = bench::now();
+    for (uint64_t i = 0; i < steps; i++)
+        sim::step(&world, settings);
+    double seconds = bench::now() - start;
+
+    double energyError = std::fabs((sim::computeEnergy(world.bodies) - startEnergy) / startEnergy);
+    double perYear = world.evaluations / (world.time / s_Year);
+    printf("  %-28s %10.0f %16.3e %12.2f\n", c.name, perYear, energyError, seconds);
+}
+
+namespace bench
+{
+    int hermite(int argc, char** argv)
+    {
+        const uint32_t beltCount = 2000;
+        const double years = 5.0;
+        const float day = 86400.0f;
+
+        const HermiteCase cases[] = {
+            { "euler, 1 day",                Sim_Integrator_Euler,   day,         false },
+            { "hermite shared, max 64 days", Sim_Integrator_Hermite, 64.0f * day, false },
+            { "hermite block, max 64 days",  Sim_Integrator_Hermite, 64.0f * day, true },
+        };
+
+        printf("solar system and %u asteroids for %.0f years (hermite eta %.2f)\n", beltCount, years, SIM_HERMITE_ETA);
+        printf("  %-28s %10s %16s %12s\n", "integrator", "evals/yr", "rel. energy err", "seconds");
+
+        for (const HermiteCase& c : cases)
+            runCase(c, beltCount, years);
+
+        return 0;
+    }
+}
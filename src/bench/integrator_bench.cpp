@@ -0,0 +1,107 @@
+#include "bench.h"
+
+#include <cstdio>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+#include "core/simulation.h"
+
+// energy drift of the symplectic integrators on the solar system over a range of time steps,
+// and the largest step (cheapest run) of each integrator that stays within an energy budget,
+// in double precision with the energy of the double state (conservation diagnostics): float positions put a floor
+// of about 1e-6 under the error that hides the order of the integrators
+
+static const double s_Year = 365.25 * 86400.0;
+static const double s_Day = 86400.0;
+static const double s_EnergyBudget = 1e-7;
+
+struct IntegratorRun
+{
+    double energyError; // largest relative energy error over the run
+    double evaluationsPerYear;
+    double yearsPerSecond;
+};
+
+static IntegratorRun runIntegrator(SimIntegrator integrator, double timeStep, double years)
+{
+    SimSettings settings;
+    sim::initSettings(&settings);
+    settings.integrator = integrator;
+    settings.timeStep = (float)timeStep;
+    settings.precision = Sim_Precision_Double;
+    settings.diagnostics = true;
+
+    SimWorld world;
+    sim::initSolarSystem(&world);
+
+    uint64_t steps = (uint64_t)(years * s_Year / timeStep);
+    uint64_t sampleEvery = std::max<uint64_t>(1, (uint64_t)(s_Year / timeStep) / 4);
+
+    IntegratorRun run{};
+    double seconds = 0.0;
+    for (uint64_t i = 0; i < steps; i++)
+    {
+        double start = bench::now();
+        sim::step(&world, settings);
+        seconds += bench::now() - start;
+
+        if ((i + 1) % sampleEvery == 0 || i + 1 == steps)
+        {
+            run.energyError = std::max(run.energyError, std::fabs(sim::getEnergyDrift(world.diagnostics)));
+        }
+    }
+
+    run.evaluationsPerYear = world.evaluations / (world.time / s_Year);
+    run.yearsPerSecond = world.time / s_Year / seconds;
+    return run;
+}
+
+namespace bench
+{
+    int integrators(int argc, char** argv)
+    {
+        const double years = argc > 1 ? atof(argv[1]) : 100.0;
+        const double steps[] = { 0.5, 1.0, 2.0, 4.0, 8.0 }; // days
+
+        const SimIntegrator integrators[] = {
+            Sim_Integrator_Euler,
+            Sim_Integrator_Leapfrog,
+            Sim_Integrator_ForestRuth,
+            Sim_Integrator_Yoshida4,
+            Sim_Integrator_Yoshida6,
+        };
+
+        printf("solar system for %.0f years in double precision, largest relative energy error\n", years);
+        printf("  %-12s %5s %8s %16s %12s\n", "integrator", "order", "dt days", "rel. energy err", "years/s");
+
+        struct Best { double timeStep; IntegratorRun run; };
+        Best best[Sim_Integrator_Count] = {};
+
+        for (SimIntegrator integrator : integrators)
+        {
+            const SimIntegratorDesc& desc = sim::getIntegrator(integrator);
+            for (double dt : steps)
+            {
+                IntegratorRun run = runIntegrator(integrator, dt * s_Day, years);
+                printf("  %-12s %5u %8.1f %16.3e %12.0f\n", desc.name, desc.order, dt, run.energyError, run.yearsPerSecond);
+
+                if (run.energyError <= s_EnergyBudget && dt > best[integrator].timeStep)
+                    best[integrator] = { dt, run };
+            }
+        }
+
+        printf("\nlargest step within a relative energy error of %.0e\n", s_EnergyBudget);
+        printf("  %-12s %8s %12s %12s\n", "integrator", "dt days", "evals/yr", "years/s");
+        for (SimIntegrator integrator : integrators)
+        {
+            const Best& b = best[integrator];
+            if (b.timeStep == 0.0)
+                printf("  %-12s %8s\n", sim::getIntegratorName(integrator), "none");
+            else
+                printf("  %-12s %8.1f %12.0f %12.0f\n", sim::getIntegratorName(integrator), b.timeStep, b.run.evaluationsPerYear, b.run.yearsPerSecond);
+        }
+
+        return 0;
+    }
+}
@@ -0,0 +1,135 @@
+#include "bench.h"
+
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+
+#include "core/simulation.h"
+#include "core/kepler.h"
+
+// the analytic propagator against closed form positions of an eccentric comet (perihelion after half a period,
+// the start again after whole periods) and the conserved energy and angular momentum of a hyperbolic flyby,
+// fails when they are off, then the cost per particle for short and very long time steps
+
+static const double s_Tolerance = 1e-5; // relative, the state is stored in float
+
+struct KeplerOrbit
+{
+    float x, y, vx, vy;
+};
+
+static KeplerOrbit propagate(KeplerOrbit orbit, double G, double timeStep, uint32_t calls)
+{
+    SimKeplerCenter sun = { 0.0, 0.0, 0.0, 0.0, 1.0 };
+    for (uint32_t i = 0; i < calls; i++)
+        sim::propagateKepler(sim::getKernel(), sun, G, timeStep / calls, &orbit.x, &orbit.y, &orbit.vx, &orbit.vy, nullptr, 1);
+
+    return orbit;
+}
+
+static double energy(const KeplerOrbit& o, double G)
+{
+    return 0.5 * ((double)o.vx * o.vx + (double)o.vy * o.vy) - G / std::sqrt((double)o.x * o.x + (double)o.y * o.y);
+}
+
+static double angularMomentum(const KeplerOrbit& o)
+{
+    return (double)o.x * o.vy - (double)o.y * o.vx;
+}
+
+namespace bench
+{
+    int kepler(int argc, char** argv)
+    {
+        // astronomical units, the sun is 1
+        const double G = sim::getUnits(Sim_Units_Astronomical).G;
+        const double pi = 3.14159265358979;
+        bool ok = true;
+
+        // comet from aphelion, perihelion 0.5 AU, eccentricity 0.95
+        const double perihelion = 0.5;
+        const double eccentricity = 0.95;
+        const double a = perihelion / (1.0 - eccentricity);
+        const double aphelion = a * (1.0 + eccentricity);
+        const double period = 2.0 * pi * std::sqrt(a * a * a / G);
+        const double vAphelion = std::sqrt(G * (1.0 - eccentricity) / aphelion);
+        const double vPerihelion = std::sqrt(G * (1.0 + eccentricity) / perihelion);
+        const KeplerOrbit comet = { (float)-aphelion, 0.0f, 0.0f, (float)-vAphelion };
+
+        struct Case { const char* name; double timeStep; uint32_t calls; double x, y, vx, vy; double scale; };
+        const Case cases[] = {
+            { "half period, 1 call",        0.5 * period, 1, perihelion, 0.0, 0.0, vPerihelion, perihelion },
+            { "half period, 1000 calls",    0.5 * period, 1000, perihelion, 0.0, 0.0, vPerihelion, perihelion },
+            { "-3 periods, 1 call",         -3.0 * period, 1, -aphelion, 0.0, 0.0, -vAphelion, aphelion },
+        };
+
+        printf("comet, perihelion %.1f AU, eccentricity %.2f, period %.1f years\n", perihelion, eccentricity, period / 365.25);
+        printf("  %-26s %16s %16s\n", "case", "rel. pos err", "rel. vel err");
+        for (const Case& c : cases)
+        {
+            KeplerOrbit o = propagate(comet, G, c.timeStep, c.calls);
+            double positionError = std::sqrt((o.x - c.x) * (o.x - c.x) + (o.y - c.y) * (o.y - c.y)) / c.scale;
+            double speed = std::sqrt(c.vx * c.vx + c.vy * c.vy);
+            double velocityError = std::sqrt((o.vx - c.vx) * (o.vx - c.vx) + (o.vy - c.vy) * (o.vy - c.vy)) / speed;
+
+            // the many call run adds up float rounding of every call
+            double tolerance = s_Tolerance * std::sqrt((double)c.calls);
+            bool good = positionError < tolerance && velocityError < tolerance;
+            ok = ok && good;
+            printf("  %-26s %16.3e %16.3e %s\n", c.name, positionError, velocityError, good ? "" : "FAIL");
+        }
+
+        // many periods in one call against half a period, with the period of the float state, the period of the
+        // exact orbit drifts away from it by the rounding of the start state every orbit
+        double floatA = -G / (2.0 * energy(comet, G));
+        double floatPeriod = 2.0 * pi * std::sqrt(floatA * floatA * floatA / G);
+        KeplerOrbit half = propagate(comet, G, 0.5 * floatPeriod, 1);
+        KeplerOrbit many = propagate(comet, G, 1000.5 * floatPeriod, 1);
+        double manyError = std::sqrt((double)(many.x - half.x) * (many.x - half.x) + (double)(many.y - half.y) * (many.y - half.y)) / perihelion;
+        bool manyGood = manyError < s_Tolerance;
+        ok = ok && manyGood;
+        printf("  %-26s %16.3e %16s %s\n", "1000.5 periods, 1 call", manyError, "-", manyGood ? "" : "FAIL");
+
+        // hyperbolic flyby, eccentricity 1.5 with perihelion 1 AU, forwards and backwards from perihelion
+        const double vFlyby = std::sqrt(G * (1.0 + 1.5) / 1.0);
+        const KeplerOrbit flyby = { 1.0f, 0.0f, 0.0f, (float)vFlyby };
+        printf("hyperbolic flyby, eccentricity 1.5\n");
+        printf("  %-26s %16s %16s\n", "case", "rel. energy err", "rel. ang. mom err");
+        for (double days : { 100.0, -100.0, 10000.0 })
+        {
+            KeplerOrbit o = propagate(flyby, G, days, 1);
+            double energyError = std::fabs((energy(o, G) - energy(flyby, G)) / energy(flyby, G));
+            double momentumError = std::fabs((angularMomentum(o) - angularMomentum(flyby)) / angularMomentum(flyby));
+
+            bool good = energyError < s_Tolerance && momentumError < s_Tolerance;
+            ok = ok && good;
+            printf("  %+10.0f days %15s %16.3e %16.3e %s\n", days, "", energyError, momentumError, good ? "" : "FAIL");
+        }
+
+        // with the selected kernel, longer steps cost a few more quarterings of the stumpff argument up to a period
+        SimWorld world;
+        sim::initSolarSystem(&world);
+        sim::addParticleBelt(&world, 1000000, 30.0f * AU, 50.0f * AU);
+        SimKeplerCenter sun;
+        sim::getSunCenter(world.bodies, &sun);
+
+        printf("1000000 kuiper belt particles\n");
+        printf("  %-14s %12s %12s\n", "time step", "ns/particle", "iterations");
+        for (double days : { 1.0, 365.25, 36525.0, 3652500.0 })
+        {
+            SimParticles& p = world.particles;
+            double start = bench::now();
+            uint32_t iterations = sim::propagateKepler(sim::getKernel(), sun, world.bodies.units.G, days, p.x.data(), p.y.data(), p.vx.data(), p.vy.data(), nullptr, p.count);
+            double seconds = bench::now() - start;
+            printf("  %9.0f days %12.1f %12u\n", days, seconds * 1e9 / p.count, iterations);
+        }
+
+        if (!ok)
+        {
+            printf("the kepler propagation is off by more than %.0e\n", s_Tolerance);
+            return 1;
+        }
+
+        return 0;
+    }
+}
@@ -0,0 +1,118 @@
+#include "bench.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+#include "core/simulation.h"
+#include "core/gravity.h"
+
+// compares every available gravity kernel, per body and pairwise (newton's third law), against the reference (trigonometry) kernel
+// fails when a kernel is off by more than the tolerance, so it doubles as the kernel check
+
+static const double s_Tolerance = 1e-4;
+
+static float randomFloat(uint32_t* seed)
+{
+    *seed = *seed * 1664525u + 1013904223u;
+    return (*seed >> 8) * (1.0f / 16777216.0f);
+}
+
+static void createRandomBodies(SimBodies* bodies, uint32_t count)
+{
+    uint32_t seed = 4242;
+    sim::clearBodies(bodies);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        SimBody body{};
+        body.mass = 1e20f + randomFloat(&seed) * 1e27f;
+        body.pos = { (randomFloat(&seed) - 0.5f) * 80.0f * (float)AU, (randomFloat(&seed) - 0.5f) * 80.0f * (float)AU };
+        sim::addBody(bodies, body);
+    }
+}
+
+// largest error relative to the magnitude of the reference acceleration
+static double maxRelativeError(const std::vector<float>& ax, const std::vector<float>& ay, const std::vector<float>& refx, const std::vector<float>& refy)
+{
+    double maxError = 0.0;
+    for (size_t i = 0; i < ax.size(); i++)
+    {
+        double dx = (double)ax[i] - refx[i];
+        double dy = (double)ay[i] - refy[i];
+        double ref = std::sqrt((double)refx[i] * refx[i] + (double)refy[i] * refy[i]);
+        if (ref > 0.0)
+            maxError = std::max(maxError, std::sqrt(dx * dx + dy * dy) / ref);
+    }
+
+    return maxError;
+}
+
+static bool runCase(const char* name, const SimBodies& bodies)
+{
+    uint32_t count = bodies.count;
+    std::vector<float> refx(count), refy(count);
+    sim::computeAccelerations(Sim_Kernel_Reference, bodies, refx.data(), refy.data());
+
+    printf("%s (N = %u)\n", name, count);
+    printf("  %-10s %-9s %12s %14s %10s\n", "kernel", "pass", "ns/body^2", "max rel. err", "");
+
+    bool passed = true;
+    for (int k = 0; k < Sim_Kernel_Count; k++)
+    {
+        SimKernel kernel = (SimKernel)k;
+        if (!sim::isKernelAvailable(kernel)) continue;
+
+        for (int pairwise = 0; pairwise < 2; pairwise++)
+        {
+            std::vector<float> ax(sim::paddedCount(count)), ay(sim::paddedCount(count));
+            uint64_t repeat = std::max<uint64_t>(1, 20000000 / ((uint64_t)count * count));
+            if (kernel == Sim_Kernel_Reference) repeat = std::max<uint64_t>(1, repeat / 10);
+
+            double start = bench::now();
+            for (uint64_t r = 0; r < repeat; r++)
+            {
+                if (pairwise)
+                    sim::computeAccelerationsPairwise(kernel, bodies, ax.data(), ay.data());
+                else
+                    sim::computeAccelerations(kernel, bodies, ax.data(), ay.data());
+            }
+            double ns = (bench::now() - start) * 1e9 / ((double)repeat * count * count);
+
+            ax.resize(count);
+            ay.resize(count);
+            double error = maxRelativeError(ax, ay, refx, refy);
+            bool ok = error <= s_Tolerance;
+            passed = passed && ok;
+
+            printf("  %-10s %-9s %12.3f %14.3e %10s\n", sim::getKernelName(kernel), pairwise ? "pairwise" : "per body", ns, error, ok ? "ok" : "FAILED");
+        }
+    }
+
+    return passed;
+}
+
+namespace bench
+{
+    int kernels(int argc, char** argv)
+    {
+        printf("gravity kernels, tolerance %.0e relative to the reference kernel\n", s_Tolerance);
+
+        SimWorld world;
+        sim::initSolarSystem(&world);
+        bool passed = runCase("solar system", world.bodies);
+
+        const uint32_t counts[] = { 100, 1000, 4000 };
+        for (uint32_t count : counts)
+        {
+            SimBodies bodies;
+            createRandomBodies(&bodies, count);
+            passed = runCase("random bodies", bodies) && passed;
+        }
+
+        printf(passed ? "all kernels agree with the reference\n" : "kernel check FAILED\n");
+        return passed ? 0 : 1;
+    }
+}
@@ -0,0 +1,241 @@
+#include "bench.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <vector>
+
+#include "core/simulation.h"
+#include "core/gravity.h"
+
+// the old per body record: physics data next to the gl handles and the trail batch
+struct LegacyBatchGroup
+{
+    void* vertexBuffer;
+    void* indexBuffer;
+    void* vertexArray;
+    std::vector<float> vertices;
+    std::vector<uint32_t> indices;
+};
+
+struct LegacyPlanet
+{
+    float mass;
+    float distance;
+    float radius;
+    SimVec2 pos;
+    SimVec2 vel;
+    float color[3];
+    bool sun;
+
+    void* vertexBuffer;
+    void* vertexArray;
+    LegacyBatchGroup trailBatch;
+};
+
+struct LayoutResult
+{
+    double forceNs;        // per pair
+    double integrateNs;    // per body
+    BenchPerfResult forceMisses;
+    BenchPerfResult integrateMisses;
+};
+
+static const uint64_t s_PairBudget = 20000000;
+static const uint64_t s_BodyBudget = 50000000;
+
+static float randomFloat(uint32_t* seed)
+{
+    *seed = *seed * 1664525u + 1013904223u;
+    return (*seed >> 8) * (1.0f / 16777216.0f);
+}
+
+static void createBodies(uint32_t count, std::vector<LegacyPlanet>* legacy, SimBodies* bodies)
+{
+    uint32_t seed = 12345;
+
+    legacy->assign(count, LegacyPlanet{});
+    sim::clearBodies(bodies);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        SimBody body{};
+        body.mass = 1e20f + randomFloat(&seed) * 1e24f;
+        body.pos = { (randomFloat(&seed) - 0.5f) * 60.0f * (float)AU, (randomFloat(&seed) - 0.5f) * 60.0f * (float)AU };
+        body.vel = { (randomFloat(&seed) - 0.5f) * 1e4f, (randomFloat(&seed) - 0.5f) * 1e4f };
+
+        LegacyPlanet& planet = (*legacy)[i];
+        planet.mass = body.mass;
+        planet.pos = body.pos;
+        planet.vel = body.vel;
+
+        sim::addBody(bodies, body);
+    }
+}
+
+static LayoutResult runLegacy(std::vector<LegacyPlanet>& planets, BenchPerfCounters* counters, float* sink)
+{
+    uint32_t count = (uint32_t)planets.size();
+    uint32_t targets = (uint32_t)std::min<uint64_t>(count, std::max<uint64_t>(1, s_PairBudget / count));
+    uint64_t repeat = std::max<uint64_t>(1, s_PairBudget / ((uint64_t)targets * count));
+    std::vector<SimVec2> forces(count, { 0.0f, 0.0f });
+    LayoutResult result{};
+
+    bench::startPerfCounters(counters);
+    double start = bench::now();
+    for (uint64_t r = 0; r < repeat; r++)
+    {
+        for (uint32_t i = 0; i < targets; i++)
+        {
+            SimVec2 sum = { 0.0f, 0.0f };
+            for (uint32_t j = 0; j < count; j++)
+            {
+                if (i == j) continue;
+                SimVec2 f = sim::getBodyAttraction(planets[i].pos.x, planets[i].pos.y, planets[i].mass, planets[j].pos.x, planets[j].pos.y, planets[j].mass);
+                sum.x += f.x;
+                sum.y += f.y;
+            }
+            forces[i] = sum;
+        }
+    }
+    result.forceNs = (bench::now() - start) * 1e9 / ((double)repeat * targets * count);
+    result.forceMisses = bench::stopPerfCounters(counters);
+    result.forceMisses.l1Misses /= repeat;
+    result.forceMisses.llcMisses /= repeat;
+
+    repeat = std::max<uint64_t>(1, s_BodyBudget / count);
+    bench::startPerfCounters(counters);
+    start = bench::now();
+    for (uint64_t r = 0; r < repeat; r++)
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            LegacyPlanet& planet = planets[i];
+            planet.vel.x += forces[i].x / planet.mass * 1e-3f;
+            planet.vel.y += forces[i].y / planet.mass * 1e-3f;
+            planet.pos.x += planet.vel.x * 1e-3f;
+            planet.pos.y += planet.vel.y * 1e-3f;
+        }
+    }
+    result.integrateNs = (bench::now() - start) * 1e9 / ((double)repeat * count);
+    result.integrateMisses = bench::stopPerfCounters(counters);
+    result.integrateMisses.l1Misses /= repeat;
+    result.integrateMisses.llcMisses /= repeat;
+
+    *sink += planets[0].pos.x + forces[0].x;
+    return result;
+}
+
+static LayoutResult runSoa(SimBodies& bodies, BenchPerfCounters* counters, float* sink)
+{
+    uint32_t count = bodies.count;
+    uint32_t targets = (uint32_t)std::min<uint64_t>(count, std::max<uint64_t>(1, s_PairBudget / count));
+    uint64_t repeat = std::max<uint64_t>(1, s_PairBudget / ((uint64_t)targets * count));
+    std::vector<float> fx(count, 0.0f), fy(count, 0.0f);
+    float* x = bodies.x.data();
+    float* y = bodies.y.data();
+    float* vx = bodies.vx.data();
+    float* vy = bodies.vy.data();
+    const float* mass = bodies.mass.data();
+    LayoutResult result{};
+
+    bench::startPerfCounters(counters);
+    double start = bench::now();
+    for (uint64_t r = 0; r < repeat; r++)
+    {
+        for (uint32_t i = 0; i < targets; i++)
+        {
+            SimVec2 sum = { 0.0f, 0.0f };
+            for (uint32_t j = 0; j < count; j++)
+            {
+                if (i == j) continue;
+                SimVec2 f = sim::getBodyAttraction(x[i], y[i], mass[i], x[j], y[j], mass[j]);
+                sum.x += f.x;
+                sum.y += f.y;
+            }
+            fx[i] = sum.x;
+            fy[i] = sum.y;
+        }
+    }
+    result.forceNs = (bench::now() - start) * 1e9 / ((double)repeat * targets * count);
+    result.forceMisses = bench::stopPerfCounters(counters);
+    result.forceMisses.l1Misses /= repeat;
+    result.forceMisses.llcMisses /= repeat;
+
+    repeat = std::max<uint64_t>(1, s_BodyBudget / count);
+    bench::startPerfCounters(counters);
+    start = bench::now();
+    for (uint64_t r = 0; r < repeat; r++)
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            vx[i] += fx[i] / mass[i] * 1e-3f;
+            vy[i] += fy[i] / mass[i] * 1e-3f;
+            x[i] += vx[i] * 1e-3f;
+            y[i] += vy[i] * 1e-3f;
+        }
+    }
+    result.integrateNs = (bench::now() - start) * 1e9 / ((double)repeat * count);
+    result.integrateMisses = bench::stopPerfCounters(counters);
+    result.integrateMisses.l1Misses /= repeat;
+    result.integrateMisses.llcMisses /= repeat;
+
+    *sink += x[0] + fx[0];
+    return result;
+}
+
+static void printResult(uint32_t count, const char* name, const LayoutResult& result, bool perf, uint64_t pairs)
+{
+    printf("%8u  %-7s %10.2f %12.2f", count, name, result.forceNs, result.integrateNs);
+    if (perf)
+    {
+        printf(" %14.4f %14.4f %14.4f %14.4f",
+            (double)result.forceMisses.l1Misses / pairs, (double)result.forceMisses.llcMisses / pairs,
+            (double)result.integrateMisses.l1Misses / count, (double)result.integrateMisses.llcMisses / count);
+    }
+    printf("\n");
+}
+
+namespace bench
+{
+    int layout(int argc, char** argv)
+    {
+        const uint32_t counts[] = { 10, 1000, 100000 };
+
+        BenchPerfCounters counters;
+        initPerfCounters(&counters);
+
+        printf("body layout: legacy planet records (%zu bytes per body) vs soa arrays (%zu bytes per body)\n",
+            sizeof(LegacyPlanet), 5 * sizeof(float));
+        printf("force pass in ns per pair, integrate pass in ns per body");
+        printf(counters.available ? ", cache misses per pair / per body\n" : " (cache miss counters unavailable)\n");
+        printf("%8s  %-7s %10s %12s", "N", "layout", "force", "integrate");
+        if (counters.available)
+            printf(" %14s %14s %14s %14s", "force l1", "force llc", "integr. l1", "integr. llc");
+        printf("\n");
+
+        float sink = 0.0f;
+        for (uint32_t count : counts)
+        {
+            std::vector<LegacyPlanet> legacy;
+            SimBodies bodies;
+            createBodies(count, &legacy, &bodies);
+
+            uint32_t targets = (uint32_t)std::min<uint64_t>(count, std::max<uint64_t>(1, s_PairBudget / count));
+            uint64_t pairs = (uint64_t)targets * count;
+
+            LayoutResult legacyResult = runLegacy(legacy, &counters, &sink);
+            LayoutResult soaResult = runSoa(bodies, &counters, &sink);
+
+            printResult(count, "legacy", legacyResult, counters.available, pairs);
+            printResult(count, "soa", soaResult, counters.available, pairs);
+            printf("%8s  speedup %9.2fx %11.2fx\n", "", legacyResult.forceNs / soaResult.forceNs, legacyResult.integrateNs / soaResult.integrateNs);
+        }
+
+        uninitPerfCounters(&counters);
+
+        // keeps the compiler from removing the loops
+        if (sink == 1.0f) printf(" ");
+        return 0;
+    }
+}
@@ -0,0 +1,112 @@
+#include "bench.h"
+
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+
+#include "core/simulation.h"
+
+// massless test particles against the same bodies carried as (almost) massless bodies,
+// the orbits must agree, fails otherwise, then the cost per step of large kuiper belts
+
+static const double s_Tolerance = 1e-4; // relative to the distance from the sun, after a year
+
+// the particles of the world as 1 kg bodies
+static void particlesToBodies(SimWorld* world)
+{
+    SimBodies& bodies = world->bodies;
+    const SimParticles& particles = world->particles;
+    double speed = bodies.units.length / bodies.units.time;
+
+    for (uint32_t i = 0; i < particles.count; i++)
+    {
+        SimBody body{};
+        body.mass = 1.0f;
+        body.pos = sim::getParticlePosition(particles, bodies, i);
+        body.vel = { (float)(particles.vx[i] * speed), (float)(particles.vy[i] * speed) };
+        sim::addBody(&bodies, body);
+    }
+
+    sim::clearParticles(&world->particles);
+}
+
+static double stepTime(SimWorld* world, const SimSettings& settings, uint32_t steps)
+{
+    sim::step(world, settings); // warm up, first force pass
+    double start = bench::now();
+    for (uint32_t i = 0; i < steps; i++)
+        sim::step(world, settings);
+
+    return (bench::now() - start) / steps;
+}
+
+namespace bench
+{
+    int particles(int argc, char** argv)
+    {
+        SimSettings settings;
+        sim::initSettings(&settings);
+        settings.integrator = Sim_Integrator_Leapfrog; // kick-drift-kick like the particles
+
+        // agreement, a year of an asteroid belt of particles against the same belt of 1 kg bodies
+        const uint32_t agreementCount = 500;
+        SimWorld particleWorld;
+        sim::initSolarSystem(&particleWorld);
+        sim::addParticleBelt(&particleWorld, agreementCount, 2.2f * AU, 3.2f * AU);
+
+        SimWorld bodyWorld = particleWorld;
+        particlesToBodies(&bodyWorld);
+
+        for (uint32_t i = 0; i < 365; i++)
+        {
+            sim::step(&particleWorld, settings);
+            sim::step(&bodyWorld, settings);
+        }
+
+        SimVec2 sun = sim::getBody(bodyWorld.bodies, 0).pos;
+        uint32_t planets = particleWorld.bodies.count;
+        double maxDifference = 0.0;
+        for (uint32_t i = 0; i < agreementCount; i++)
+        {
+            SimVec2 p = sim::getParticlePosition(particleWorld.particles, particleWorld.bodies, i);
+            SimVec2 b = sim::getBody(bodyWorld.bodies, planets + i).pos;
+            double r = std::sqrt(((double)b.x - sun.x) * ((double)b.x - sun.x) + ((double)b.y - sun.y) * ((double)b.y - sun.y));
+            double d = std::sqrt(((double)p.x - b.x) * ((double)p.x - b.x) + ((double)p.y - b.y) * ((double)p.y - b.y));
+            maxDifference = std::max(maxDifference, d / r);
+        }
+
+        printf("%u asteroid belt particles against 1 kg bodies after a year (leapfrog, 1 day): max rel. pos diff %.3e\n", agreementCount, maxDifference);
+
+        // cost per step, the particle pass is bodies x particles
+        printf("  %10s %16s %16s\n", "particles", "ms/step", "as bodies ms/step");
+        const uint32_t counts[] = { 10000, 100000, 1000000 };
+        for (uint32_t count : counts)
+        {
+            SimWorld world;
+            sim::initSolarSystem(&world);
+            sim::addParticleBelt(&world, count, 30.0f * AU, 50.0f * AU);
+            uint32_t steps = std::max(2000000u / count, 4u);
+            double particleTime = stepTime(&world, settings, steps);
+
+            // O(N^2) with them as bodies, only the smallest belt
+            if (count <= 10000)
+            {
+                particlesToBodies(&world);
+                double bodyTime = stepTime(&world, settings, 4);
+                printf("  %10u %16.3f %16.3f\n", count, particleTime * 1000.0, bodyTime * 1000.0);
+            }
+            else
+            {
+                printf("  %10u %16.3f %16s\n", count, particleTime * 1000.0, "-");
+            }
+        }
+
+        if (maxDifference > s_Tolerance)
+        {
+            printf("particles and bodies disagree by more than %.0e\n", s_Tolerance);
+            return 1;
+        }
+
+        return 0;
+    }
+}
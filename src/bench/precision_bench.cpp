@@ -0,0 +1,128 @@
+#include "bench.h"
+
+#include <cstdio>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+#include "core/simulation.h"
+
+// speed against long term orbit error of the float, kahan and double states of the splitting integrators
+// on the solar system, against a 6th order double precision run with half the step
+
+static const double s_Year = 365.25 * 86400.0;
+static const double s_Day = 86400.0;
+
+struct PrecisionRun
+{
+    double seconds;
+    double energyError; // largest relative energy error, sampled every year
+    double x[16], y[16]; // final positions of the planets
+    uint32_t count;
+};
+
+static PrecisionRun runPrecision(SimPrecision precision, SimIntegrator integrator, double timeStep, double years)
+{
+    SimSettings settings;
+    sim::initSettings(&settings);
+    settings.integrator = integrator;
+    settings.precision = precision;
+    settings.timeStep = (float)timeStep;
+
+    SimWorld world;
+    sim::initSolarSystem(&world);
+
+    double startEnergy = sim::computeEnergy(world.bodies);
+    uint64_t steps = (uint64_t)std::llround(years * s_Year / timeStep);
+    uint64_t stepsPerYear = (uint64_t)std::llround(s_Year / timeStep);
+
+    PrecisionRun run{};
+    for (uint64_t i = 0; i < steps; i++)
+    {
+        double start = bench::now();
+        sim::step(&world, settings);
+        run.seconds += bench::now() - start;
+
+        if ((i + 1) % stepsPerYear == 0)
+            run.energyError = std::max(run.energyError, std::fabs((sim::computeEnergy(world.bodies) - startEnergy) / startEnergy));
+    }
+
+    // positions in the state's own precision
+    run.count = std::min(world.bodies.count, 16u);
+    for (uint32_t i = 0; i < run.count; i++)
+    {
+        run.x[i] = world.bodies.x[i];
+        run.y[i] = world.bodies.y[i];
+        if (precision == Sim_Precision_Kahan)
+        {
+            run.x[i] = (double)world.kahanState.x[i].value - world.kahanState.x[i].error;
+            run.y[i] = (double)world.kahanState.y[i].value - world.kahanState.y[i].error;
+        }
+        else if (precision == Sim_Precision_Double)
+        {
+            run.x[i] = world.doubleState.x[i];
+            run.y[i] = world.doubleState.y[i];
+        }
+
+        run.x[i] *= world.bodies.units.length;
+        run.y[i] *= world.bodies.units.length;
+    }
+
+    return run;
+}
+
+// milliseconds per step of the solar system and an asteroid belt, where the force pass dominates
+static double stepTime(SimPrecision precision, SimIntegrator integrator, uint32_t beltCount)
+{
+    SimSettings settings;
+    sim::initSettings(&settings);
+    settings.integrator = integrator;
+    settings.precision = precision;
+
+    SimWorld world;
+    sim::initSolarSystem(&world);
+    sim::addAsteroidBelt(&world, beltCount, 2.2f * AU, 3.2f * AU);
+
+    const uint32_t steps = 5;
+    sim::step(&world, settings);
+
+    double start = bench::now();
+    for (uint32_t i = 0; i < steps; i++)
+        sim::step(&world, settings);
+
+    return (bench::now() - start) * 1000.0 / steps;
+}
+
+static double positionError(const PrecisionRun& run, const PrecisionRun& reference, uint32_t body)
+{
+    double dx = run.x[body] - reference.x[body];
+    double dy = run.y[body] - reference.y[body];
+    return std::sqrt(dx * dx + dy * dy);
+}
+
+namespace bench
+{
+    int precision(int argc, char** argv)
+    {
+        const double years = argc > 1 ? atof(argv[1]) : 1000.0;
+        const double timeStep = s_Day;
+        const SimIntegrator integrator = Sim_Integrator_Yoshida4;
+        const uint32_t earth = 3, pluto = 9;
+
+        PrecisionRun reference = runPrecision(Sim_Precision_Double, Sim_Integrator_Yoshida6, 0.5 * timeStep, years);
+
+        const uint32_t beltCount = 4000;
+
+        printf("solar system for %.0f years, %s with a 1 day step, error against yoshida6 in double with half the step\n", years, sim::getIntegratorName(integrator));
+        printf("  %-10s %10s %16s %16s %16s %16s\n", "precision", "seconds", "rel. energy err", "earth err km", "pluto err km", "ms/step N=4010");
+
+        for (int p = 0; p < Sim_Precision_Count; p++)
+        {
+            PrecisionRun run = runPrecision((SimPrecision)p, integrator, timeStep, years);
+            printf("  %-10s %10.2f %16.3e %16.1f %16.1f %16.2f\n", sim::getPrecisionName((SimPrecision)p), run.seconds, run.energyError,
+                positionError(run, reference, earth) / 1000.0, positionError(run, reference, pluto) / 1000.0, stepTime((SimPrecision)p, integrator, beltCount));
+        }
+
+        return 0;
+    }
+}
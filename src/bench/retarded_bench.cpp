@@ -0,0 +1,237 @@
+#include "bench.h"
+
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+#include "core/gravity.h"
+#include "core/history.h"
+#include "core/simulation.h"
+
+// the finite speed of gravity: lookups in the position history of bodies in straight lines against the exact
+// positions, the retarded forces with a very fast gravity against the instantaneous ones, and the planets losing
+// the sun one after the other when it is deleted, each when the news arrives (all fail otherwise),
+// then the cost of the retarded force pass of every kernel against the instantaneous pair pass
+
+static const double s_Tolerance = 1e-4;    // relative to the largest acceleration
+
+static double maxRelativeDifference(const float* ax, const float* ay, const float* bx, const float* by, uint32_t count)
+{
+    double largest = 0.0, difference = 0.0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        largest = std::max(largest, std::hypot((double)bx[i], (double)by[i]));
+        difference = std::max(difference, std::hypot((double)ax[i] - bx[i], (double)ay[i] - by[i]));
+    }
+
+    return difference / largest;
+}
+
+// bodies in straight lines (no sun, so their past is straight too) moved and recorded past the length of the ring
+static bool checkLookups()
+{
+    SimBodies bodies;
+    sim::clearBodies(&bodies, Sim_Units_Astronomical);
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        SimBody body{};
+        body.mass = 1e20f;
+        body.pos = { (float)((i % 10) * AU), (float)((i / 10) * AU) };
+        body.vel = { 1000.0f + 37.0f * i, -500.0f + 11.0f * i };
+        sim::addBody(&bodies, body);
+    }
+
+    // 10 AU in 8 days, the light time across the system is 12 samples
+    double interval = 1.0, speed = 1.25 * AU / DAY;
+    SimHistory history;
+    sim::syncHistory(&history, bodies, 0.0, interval, speed);
+
+    uint32_t steps = 3 * history.samples + 1;
+    for (uint32_t s = 1; s <= steps; s++)
+    {
+        for (uint32_t i = 0; i < bodies.count; i++)
+        {
+            bodies.x[i] += bodies.vx[i] * (float)interval;
+            bodies.y[i] += bodies.vy[i] * (float)interval;
+        }
+        sim::recordHistory(&history, bodies, s * interval, speed);
+    }
+
+    // a stage half a step past the newest sample, the bodies are there now
+    double offset = 0.5;
+    double largest = 0.0;
+    for (uint32_t i = 0; i < bodies.count; i++)
+    {
+        float x = bodies.x[i] + bodies.vx[i] * (float)offset;
+        float y = bodies.y[i] + bodies.vy[i] * (float)offset;
+        for (double age = 0.0; age < (history.samples - 1) * interval; age += 0.37)
+        {
+            SimVec2 p = sim::getRetardedPosition(history, i, x, y, offset, age);
+            double error = std::hypot(p.x - (x - bodies.vx[i] * age), p.y - (y - bodies.vy[i] * age));
+            largest = std::max(largest, error);
+        }
+    }
+
+    // a float position around 10 AU is good to about 1e-6 AU, a slot off would be 1e-3
+    bool ok = largest < 1e-4;
+    printf("lookups of %u bodies in straight lines, %u samples, %u steps recorded: largest error %.3e AU %s\n",
+        bodies.count, history.samples, steps, largest, ok ? "" : "FAIL");
+    return ok;
+}
+
+// gravity a million times faster than light against the instantaneous pair pass, at a stage in the middle of a step
+static bool checkFastGravity()
+{
+    SimWorld world;
+    sim::initSolarSystem(&world);
+    sim::addAsteroidBelt(&world, 2000, 2.2f * AU, 3.2f * AU);
+    const SimBodies& bodies = world.bodies;
+    uint32_t padded = sim::paddedCount(bodies.count);
+
+    double speed = 1e6 * LIGHT_SPEED;
+    sim::syncHistory(&world.history, bodies, 0.0, 1.0, speed);
+
+    std::vector<float> refx(padded), refy(padded), ax(padded), ay(padded);
+    sim::computeAccelerationsPairwise(Sim_Kernel_Scalar, bodies, refx.data(), refy.data());
+
+    bool ok = true;
+    printf("retarded forces with gravity 1e6 times faster than light against instantaneous, %u bodies\n", bodies.count);
+    printf("  %-10s %14s\n", "kernel", "rel. diff");
+    for (int k = Sim_Kernel_Scalar; k < Sim_Kernel_Count; k++)
+    {
+        SimKernel kernel = (SimKernel)k;
+        if (!sim::isKernelAvailable(kernel)) continue;
+
+        sim::computeAccelerationsRetarded(kernel, world.history, bodies, speed, 0.5, ax.data(), ay.data());
+        double error = maxRelativeDifference(ax.data(), ay.data(), refx.data(), refy.data(), bodies.count);
+        bool good = error < s_Tolerance;
+        ok = ok && good;
+        printf("  %-10s %14.3e %s\n", sim::getKernelName(kernel), error, good ? "" : "FAIL");
+    }
+
+    return ok;
+}
+
+// the sun is deleted after 10 steps, every planet keeps its acceleration towards where the sun was until the light
+// time from there has passed, gravity at 1% of the speed of light so that is a day for the earth and weeks for pluto
+static bool checkDeletedSun()
+{
+    const char* names[] = { "mercury", "venus", "earth", "mars", "jupiter", "saturn", "uranus", "neptune", "pluto" };
+
+    SimSettings settings;
+    sim::initSettings(&settings);
+    settings.integrator = Sim_Integrator_Leapfrog;
+    settings.timeStep = 6.0f * 3600.0f;
+    settings.gravitySpeed = (float)(0.01 * LIGHT_SPEED);
+
+    SimWorld world;
+    sim::initSolarSystem(&world);
+    for (uint32_t i = 0; i < 10; i++)
+        sim::step(&world, settings);
+
+    SimBodies& bodies = world.bodies;
+    const uint32_t planets = 9;
+    double removed = world.time;
+    float sunX = bodies.x[0], sunY = bodies.y[0];
+    double before[planets], delay[planets], heard[planets];
+    for (uint32_t p = 0; p < planets; p++)
+    {
+        before[p] = std::hypot(world.ax[p + 1], world.ay[p + 1]);
+        delay[p] = std::hypot(bodies.x[p + 1] - sunX, bodies.y[p + 1] - sunY) * bodies.units.length / settings.gravitySpeed;
+        heard[p] = -1.0;
+    }
+
+    // like the delete the sun button
+    sim::removeBody(&bodies, 0);
+    sim::resetIntegrator(&world);
+
+    bool ghost = false;
+    while (world.time - removed < 40.0 * DAY)
+    {
+        sim::step(&world, settings);
+        ghost = ghost || world.history.ghosts > 0;
+        for (uint32_t p = 0; p < planets; p++)
+        {
+            if (heard[p] < 0.0 && std::hypot(world.ax[p], world.ay[p]) < 0.5 * before[p])
+                heard[p] = world.time - removed;
+        }
+    }
+
+    // the forces at the end of a step see the sun gone once the light time is within the step
+    bool ok = ghost && world.history.ghosts == 0;
+    printf("deleted sun, gravity at 1%% of the speed of light, steps of %.0f hours\n", settings.timeStep / 3600.0);
+    printf("  %-10s %14s %14s\n", "planet", "light time d", "pull lost d");
+    for (uint32_t p = 0; p < planets; p++)
+    {
+        bool good = heard[p] >= delay[p] - 1e-3 * DAY && heard[p] <= delay[p] + settings.timeStep + 1e-3 * DAY;
+        ok = ok && good;
+        printf("  %-10s %14.2f %14.2f %s\n", names[p], delay[p] / DAY, heard[p] / DAY, good ? "" : "FAIL");
+    }
+
+    return ok;
+}
+
+static double timePasses(SimKernel kernel, const SimWorld& world, double speed, std::vector<float>* ax, std::vector<float>* ay)
+{
+    uint32_t passes = 0;
+    double start = bench::now(), seconds = 0.0;
+    do
+    {
+        if (speed > 0.0)
+            sim::computeAccelerationsRetarded(kernel, world.history, world.bodies, speed, 0.0, ax->data(), ay->data());
+        else
+            sim::computeAccelerationsPairwise(kernel, world.bodies, ax->data(), ay->data());
+        passes++;
+        seconds = bench::now() - start;
+    } while (seconds < 0.2 && passes < 100);
+
+    return seconds / passes;
+}
+
+namespace bench
+{
+    int retarded(int argc, char** argv)
+    {
+        bool ok = checkLookups();
+        ok = checkFastGravity() && ok;
+        ok = checkDeletedSun() && ok;
+
+        SimKernel best = sim::getKernel();
+        printf("force pass, instantaneous pairs against retarded (gravity at c and at 1%% of c, history of steps of a day)\n");
+        printf("  %6s %-10s %12s %12s %12s %10s %12s\n", "N", "kernel", "pairs ms", "c ms", "0.01 c ms", "samples", "history MB");
+        for (uint32_t count : { 1000u, 4000u })
+        {
+            SimWorld world;
+            sim::initSolarSystem(&world);
+            sim::addAsteroidBelt(&world, count - world.bodies.count, 2.2f * AU, 3.2f * AU);
+            uint32_t padded = sim::paddedCount(world.bodies.count);
+            std::vector<float> ax(padded), ay(padded);
+
+            for (SimKernel kernel : { Sim_Kernel_Scalar, best })
+            {
+                if (kernel == best && best == Sim_Kernel_Scalar && count > 1000) continue;
+
+                double pairs = timePasses(kernel, world, 0.0, &ax, &ay);
+                sim::clearHistory(&world.history);
+                sim::syncHistory(&world.history, world.bodies, 0.0, 1.0, LIGHT_SPEED);
+                double light = timePasses(kernel, world, LIGHT_SPEED, &ax, &ay);
+                sim::clearHistory(&world.history);
+                sim::syncHistory(&world.history, world.bodies, 0.0, 1.0, 0.01 * LIGHT_SPEED);
+                double slow = timePasses(kernel, world, 0.01 * LIGHT_SPEED, &ax, &ay);
+
+                printf("  %6u %-10s %12.3f %12.3f %12.3f %10u %12.2f\n", count, sim::getKernelName(kernel), pairs * 1e3, light * 1e3, slow * 1e3,
+                    world.history.samples, sim::getHistoryBytes(world.history) / 1048576.0);
+                if (kernel == best) break;
+            }
+        }
+
+        if (!ok)
+        {
+            printf("the retarded positions or forces are off\n");
+            return 1;
+        }
+
+        return 0;
+    }
+}
@@ -0,0 +1,116 @@
+#include "bench.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+#include "core/simulation.h"
+#include "core/gravity.h"
+#include "core/barnes_hut.h"
+#include "core/fmm.h"
+#include "core/thread_pool.h"
+
+// speedup of the force passes and of a whole step with the number of worker threads
+// usage: solarSystemBench scaling [max threads], the default is every hardware thread
+
+static const uint32_t s_Repeat = 3;
+
+static void createWorld(SimWorld* world, uint32_t count)
+{
+    sim::initSolarSystem(world);
+    if (count > world->bodies.count)
+        sim::addAsteroidBelt(world, count - world->bodies.count, 2.2f * AU, 3.2f * AU);
+}
+
+// largest difference to the single threaded result, relative to the magnitude of the acceleration
+static double maxDifference(const SimWorld& world, const std::vector<float>& refx, const std::vector<float>& refy)
+{
+    double maxError = 0.0;
+    for (uint32_t i = 0; i < world.bodies.count; i++)
+    {
+        double dx = (double)world.ax[i] - refx[i];
+        double dy = (double)world.ay[i] - refy[i];
+        double ref = std::sqrt((double)refx[i] * refx[i] + (double)refy[i] * refy[i]);
+        if (ref > 0.0)
+            maxError = std::max(maxError, std::sqrt(dx * dx + dy * dy) / ref);
+    }
+
+    return maxError;
+}
+
+static void runCase(const char* name, uint32_t count, SimSolver solver, bool fullStep, const std::vector<uint32_t>& threadCounts)
+{
+    SimSettings settings;
+    sim::initSettings(&settings);
+    settings.solver = solver;
+
+    SimWorld world;
+    createWorld(&world, count);
+
+    printf("%s, N = %u\n", name, world.bodies.count);
+    printf("  %8s %12s %10s %12s %14s\n", "threads", "ms", "speedup", "efficiency", "max rel. diff");
+
+    std::vector<float> refx, refy;
+    double singleMs = 0.0;
+
+    for (uint32_t threads : threadCounts)
+    {
+        sim::setThreadCount(threads);
+
+        // best of a few runs, a step moves the bodies so every run starts from the same state
+        double best = 0.0;
+        for (uint32_t r = 0; r < s_Repeat; r++)
+        {
+            SimWorld run = world;
+            double start = bench::now();
+            if (fullStep)
+                sim::step(&run, settings);
+            else
+                sim::computeForces(&run, settings);
+            double ms = (bench::now() - start) * 1e3;
+            best = r == 0 ? ms : std::min(best, ms);
+
+            if (r == 0)
+                world.ax = run.ax, world.ay = run.ay;
+        }
+
+        if (threads == threadCounts[0])
+        {
+            singleMs = best;
+            refx.assign(world.ax.begin(), world.ax.begin() + world.bodies.count);
+            refy.assign(world.ay.begin(), world.ay.begin() + world.bodies.count);
+        }
+
+        double speedup = singleMs / best;
+        printf("  %8u %12.2f %9.2fx %11.0f%% %14.3e\n", threads, best, speedup, 100.0 * speedup / threads, maxDifference(world, refx, refy));
+    }
+}
+
+namespace bench
+{
+    int scaling(int argc, char** argv)
+    {
+        uint32_t hardware = sim::getHardwareThreadCount();
+        uint32_t maxThreads = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : hardware;
+        maxThreads = std::max(maxThreads, 1u);
+
+        std::vector<uint32_t> threadCounts;
+        for (uint32_t threads = 1; threads < maxThreads; threads *= 2)
+            threadCounts.push_back(threads);
+        threadCounts.push_back(maxThreads);
+
+        printf("thread scaling, %u hardware threads\n", hardware);
+        if (maxThreads > hardware)
+            printf("more threads than hardware threads, the speedups only check that the results agree\n");
+
+        runCase("direct (pairwise)", 20000, Sim_Solver_Direct, false, threadCounts);
+        runCase("barnes-hut", 200000, Sim_Solver_BarnesHut, false, threadCounts);
+        runCase("fmm", 200000, Sim_Solver_Fmm, false, threadCounts);
+        runCase("step (fmm forces, tree and update)", 200000, Sim_Solver_Fmm, true, threadCounts);
+
+        sim::setThreadCount(0);
+        return 0;
+    }
+}
@@ -0,0 +1,106 @@
+#include "bench.h"
+
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+#include "core/gravity.h"
+#include "core/simulation.h"
+
+// the pair pass of small systems through the kernel compiled for their body count against the tiled pass,
+// the accelerations of both have to agree (fails otherwise), then a whole step of the solar system both ways
+
+static const double s_Tolerance = 1e-5; // relative to the largest acceleration
+
+// the solar system, then belt bodies up to count (or its first count bodies)
+static void createWorld(SimWorld* world, uint32_t count)
+{
+    sim::initSolarSystem(world);
+    if (count > world->bodies.count)
+        sim::addAsteroidBelt(world, count - world->bodies.count, 2.2f * AU, 3.2f * AU);
+    while (world->bodies.count > count)
+        sim::removeBody(&world->bodies, world->bodies.count - 1);
+}
+
+namespace bench
+{
+    int small(int argc, char** argv)
+    {
+        bool ok = true;
+        SimKernel kernel = sim::getKernel();
+
+        printf("pair pass, %s kernel, specialized for the body count against tiled\n", sim::getKernelName(kernel));
+        printf("  %6s %14s %14s %10s %14s\n", "N", "tiled ns", "specialized ns", "speedup", "rel. diff");
+        for (uint32_t count : { 2u, 5u, 10u, 16u, 24u, 32u })
+        {
+            SimWorld world;
+            createWorld(&world, count);
+            const SimBodies& bodies = world.bodies;
+
+            uint32_t padded = sim::paddedCount(count);
+            std::vector<float> ax[2], ay[2];
+            double ns[2];
+            for (int small = 0; small < 2; small++)
+            {
+                sim::setSmallKernels(small != 0);
+                ax[small].assign(padded, 0.0f);
+                ay[small].assign(padded, 0.0f);
+
+                const uint32_t passes = 200000;
+                double start = bench::now();
+                for (uint32_t r = 0; r < passes; r++)
+                    sim::computeAccelerationsPairwise(kernel, bodies, ax[small].data(), ay[small].data());
+                ns[small] = (bench::now() - start) / passes * 1e9;
+            }
+
+            double largest = 0.0, difference = 0.0;
+            for (uint32_t i = 0; i < count; i++)
+            {
+                largest = std::max(largest, std::hypot((double)ax[0][i], (double)ay[0][i]));
+                difference = std::max(difference, std::hypot((double)ax[1][i] - ax[0][i], (double)ay[1][i] - ay[0][i]));
+            }
+
+            double error = difference / largest;
+            bool good = error < s_Tolerance;
+            ok = ok && good;
+            printf("  %6u %14.1f %14.1f %10.2f %14.3e %s\n", count, ns[0], ns[1], ns[0] / ns[1], error, good ? "" : "FAIL");
+        }
+
+        printf("step of the solar system (10 bodies), steps of a day\n");
+        printf("  %-12s %14s %14s %10s\n", "integrator", "tiled us", "specialized us", "speedup");
+        for (SimIntegrator integrator : { Sim_Integrator_Leapfrog, Sim_Integrator_Yoshida6 })
+        {
+            SimSettings settings;
+            sim::initSettings(&settings);
+            settings.integrator = integrator;
+
+            double us[2];
+            for (int small = 0; small < 2; small++)
+            {
+                sim::setSmallKernels(small != 0);
+
+                SimWorld world;
+                sim::initSolarSystem(&world);
+
+                const uint32_t steps = 100000;
+                double start = bench::now();
+                for (uint32_t i = 0; i < steps; i++)
+                    sim::step(&world, settings);
+                us[small] = (bench::now() - start) / steps * 1e6;
+            }
+
+            printf("  %-12s %14.3f %14.3f %10.2f\n", sim::getIntegratorName(integrator), us[0], us[1], us[0] / us[1]);
+        }
+
+        sim::setSmallKernels(true);
+
+        if (!ok)
+        {
+            printf("the specialized kernels disagree with the tiled pass by more than %.0e\n", s_Tolerance);
+            return 1;
+        }
+
+        return 0;
+    }
+}
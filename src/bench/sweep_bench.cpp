@@ -0,0 +1,86 @@
+#include "bench.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <vector>
+
+#include "core/sweep.h"
+#include "core/thread_pool.h"
+
+// a grid over the time step and the mass of jupiter run with 1 thread and with more: every point has to end on the
+// same checksum however many points run beside it (fails otherwise), and the points per second of each
+// usage: solarSystemBench sweep [max threads], the default is every hardware thread (at least 4)
+
+static const double s_Year = 365.25 * 86400.0;
+
+static double runPoints(const SimSweep& sweep, const SimSettings& settings, double duration, uint32_t belt, std::vector<uint64_t>* checksums)
+{
+    auto setup = [&](SimWorld* world)
+    {
+        sim::initSolarSystem(world);
+        if (belt > 0)
+            sim::addAsteroidBelt(world, belt, 2.2f * AU, 3.2f * AU);
+    };
+
+    checksums->assign(sim::buildSweepPoints(sweep).size(), 0);
+    double start = bench::now();
+    sim::runSweep(sweep, settings, duration, setup, {}, [&](const SimSweepResult& result)
+    {
+        (*checksums)[result.index] = result.checksum;
+    });
+
+    return bench::now() - start;
+}
+
+namespace bench
+{
+    int sweep(int argc, char** argv)
+    {
+        uint32_t hardware = sim::getHardwareThreadCount();
+        uint32_t maxThreads = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : std::max(hardware, 4u);
+        maxThreads = std::max(maxThreads, 2u);
+
+        SimSweep sweep;
+        sweep.mode = Sim_Sweep_Grid;
+        sweep.parameters.push_back({ Sim_Sweep_TimeStep, 0, 3600.0, 86400.0, 4, true });
+        sweep.parameters.push_back({ Sim_Sweep_Mass, 5, 1.0, 1000.0, 8, true });
+
+        SimSettings settings;
+        sim::initSettings(&settings);
+        settings.integrator = Sim_Integrator_Leapfrog;
+
+        bool ok = true;
+        printf("grid of 32 points (4 time steps x 8 masses of jupiter), leapfrog\n");
+        printf("  %-28s %8s %12s %10s\n", "world", "threads", "points/s", "checksums");
+        for (uint32_t belt : { 0u, 500u })
+        {
+            double duration = (belt > 0 ? 1.0 : 10.0) * s_Year;
+            std::vector<uint64_t> reference, checksums;
+
+            sim::setThreadCount(1);
+            double seconds = runPoints(sweep, settings, duration, belt, &reference);
+            printf("  %-28s %8u %12.2f\n", belt > 0 ? "500 belt bodies, 1 year" : "planets, 10 years", 1u, reference.size() / seconds);
+
+            for (uint32_t threads : { 2u, maxThreads })
+            {
+                sim::setThreadCount(threads);
+                seconds = runPoints(sweep, settings, duration, belt, &checksums);
+
+                bool same = checksums == reference;
+                ok = ok && same;
+                printf("  %-28s %8u %12.2f %10s\n", "", threads, checksums.size() / seconds, same ? "same" : "FAIL");
+            }
+        }
+
+        sim::setThreadCount(0);
+
+        if (!ok)
+        {
+            printf("a point ended differently with other points running beside it\n");
+            return 1;
+        }
+
+        return 0;
+    }
+}
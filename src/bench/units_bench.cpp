@@ -0,0 +1,111 @@
+#include "bench.h"
+
+#include <cstdio>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "core/simulation.h"
+
+// the same runs in si and in astronomical units must agree, fails otherwise
+// the solar system and an asteroid belt for a year with every solver and a few integrators,
+// the final positions are compared in si units relative to the distance from the sun
+
+static const double s_Tolerance = 1e-4; // float rounding differs between the two, the orbits only drift apart slowly
+
+struct UnitsCase
+{
+    const char* name;
+    SimSolver solver;
+    SimIntegrator integrator;
+    double timeStep;
+};
+
+struct UnitsRun
+{
+    std::vector<SimBody> bodies; // si
+    double energyError;
+    double seconds;
+};
+
+static UnitsRun runUnits(const UnitsCase& c, SimUnitSystem system, uint32_t beltCount, double duration)
+{
+    SimSettings settings;
+    sim::initSettings(&settings);
+    settings.solver = c.solver;
+    settings.integrator = c.integrator;
+    settings.timeStep = (float)c.timeStep;
+
+    SimWorld world;
+    sim::initSolarSystem(&world, system);
+    sim::addAsteroidBelt(&world, beltCount, 2.2f * AU, 3.2f * AU);
+
+    double startEnergy = sim::computeEnergy(world.bodies);
+    uint64_t steps = (uint64_t)std::llround(duration / c.timeStep);
+
+    UnitsRun run;
+    double start = bench::now();
+    for (uint64_t i = 0; i < steps; i++)
+        sim::step(&world, settings);
+    run.seconds = bench::now() - start;
+
+    run.energyError = std::fabs((sim::computeEnergy(world.bodies) - startEnergy) / startEnergy);
+    for (uint32_t i = 0; i < world.bodies.count; i++)
+        run.bodies.push_back(sim::getBody(world.bodies, i));
+
+    return run;
+}
+
+namespace bench
+{
+    int units(int argc, char** argv)
+    {
+        const uint32_t beltCount = 500;
+        const double day = DAY;
+        const double duration = 365.0 * day;
+
+        const UnitsCase cases[] = {
+            { "direct, euler",      Sim_Solver_Direct,    Sim_Integrator_Euler,         day },
+            { "direct, yoshida4",   Sim_Solver_Direct,    Sim_Integrator_Yoshida4,      day },
+            { "barnes-hut, leapfrog", Sim_Solver_BarnesHut, Sim_Integrator_Leapfrog,    day },
+            { "fmm, leapfrog",      Sim_Solver_Fmm,       Sim_Integrator_Leapfrog,      day },
+            { "hermite",            Sim_Solver_Direct,    Sim_Integrator_Hermite,       16.0 * day },
+            { "dormand-prince",     Sim_Solver_Direct,    Sim_Integrator_DormandPrince, 16.0 * day },
+        };
+
+        SimUnits astronomical = sim::getUnits(Sim_Units_Astronomical);
+        printf("solar system and %u asteroids for a year in si and in astronomical units (G = %.6e AU^3 / (Msun day^2))\n", beltCount, astronomical.G);
+        printf("  %-22s %18s %16s %16s %10s %10s\n", "run", "max rel. pos diff", "energy err si", "energy err au", "si s", "au s");
+
+        bool agree = true;
+        for (const UnitsCase& c : cases)
+        {
+            UnitsRun si = runUnits(c, Sim_Units_Si, beltCount, duration);
+            UnitsRun au = runUnits(c, Sim_Units_Astronomical, beltCount, duration);
+
+            // relative to the distance from the sun (body 0), the sun itself against 1 AU
+            double maxDifference = 0.0;
+            for (size_t i = 0; i < si.bodies.size(); i++)
+            {
+                double dx = (double)si.bodies[i].pos.x - au.bodies[i].pos.x;
+                double dy = (double)si.bodies[i].pos.y - au.bodies[i].pos.y;
+                double rx = (double)si.bodies[i].pos.x - si.bodies[0].pos.x;
+                double ry = (double)si.bodies[i].pos.y - si.bodies[0].pos.y;
+                double r = std::max(std::sqrt(rx * rx + ry * ry), AU);
+                maxDifference = std::max(maxDifference, std::sqrt(dx * dx + dy * dy) / r);
+            }
+
+            bool ok = maxDifference < s_Tolerance;
+            agree = agree && ok;
+            printf("  %-22s %18.3e %16.3e %16.3e %10.2f %10.2f %s\n", c.name, maxDifference, si.energyError, au.energyError, si.seconds, au.seconds, ok ? "" : "DISAGREE");
+        }
+
+        if (!agree)
+        {
+            printf("si and astronomical runs disagree by more than %.0e\n", s_Tolerance);
+            return 1;
+        }
+
+        return 0;
+    }
+}
@@ -0,0 +1,93 @@
+#include "barnes_hut.h"
+#include "simulation.h"
+#include "thread_pool.h"
+
+#include <cmath>
+
+namespace sim
+{
+    SimVec2 accelerationBarnesHut(const SimQuadtree& tree, const SimBodies& bodies, double px, double py, double theta, bool quadrupole, double G)
+    {
+        double ax = 0.0, ay = 0.0;
+        double theta2 = theta * theta;
+
+        uint32_t stack[SIM_QUADTREE_MAX_DEPTH * 4 + 4];
+        uint32_t stackSize = 0;
+        if (!tree.nodes.empty())
+            stack[stackSize++] = 0;
+
+        while (stackSize > 0)
+        {
+            const SimQuadNode& node = tree.nodes[stack[--stackSize]];
+
+            if (isLeaf(node))
+            {
+                for (uint32_t k = node.begin; k < node.end; k++)
+                {
+                    uint32_t j = tree.order[k];
+                    double dx = bodies.x[j] - px;
+                    double dy = bodies.y[j] - py;
+                    double r2 = dx * dx + dy * dy;
+                    if (r2 == 0.0) continue;
+
+                    double s = bodies.mass[j] / (r2 * std::sqrt(r2));
+                    ax += s * dx;
+                    ay += s * dy;
+                }
+                continue;
+            }
+
+            double dx = node.comx - px;
+            double dy = node.comy - py;
+            double r2 = dx * dx + dy * dy;
+            double size = 2.0 * node.halfSize;
+
+            // open the cell when it looks too big or the body is inside of it
+            bool inside = std::fabs(px - node.cx) <= node.halfSize && std::fabs(py - node.cy) <= node.halfSize;
+            if (inside || size * size >= theta2 * r2)
+            {
+                for (uint32_t c = node.firstChild; c < node.firstChild + node.childCount; c++)
+                    stack[stackSize++] = c;
+                continue;
+            }
+
+            double invr2 = 1.0 / r2;
+            double invr = std::sqrt(invr2);
+            double invr3 = invr * invr2;
+
+            ax += node.mass * invr3 * dx;
+            ay += node.mass * invr3 * dy;
+
+            if (quadrupole)
+            {
+                // a = Q r / r^5 - 5/2 (r^T Q r) r / r^7 with r pointing from the center of mass to the body
+                double rx = -dx, ry = -dy;
+                double qrx = node.qxx * rx + node.qxy * ry;
+                double qry = node.qxy * rx + node.qyy * ry;
+                double rqr = rx * qrx + ry * qry;
+                double invr5 = invr3 * invr2;
+
+                ax += qrx * invr5 - 2.5 * rqr * rx * invr5 * invr2;
+                ay += qry * invr5 - 2.5 * rqr * ry * invr5 * invr2;
+            }
+        }
+
+        return { (float)(G * ax), (float)(G * ay) };
+    }
+
+    void computeAccelerationsBarnesHut(SimQuadtree* tree, const SimBodies& bodies, float theta, bool quadrupole, float* ax, float* ay)
+    {
+        buildQuadtree(tree, bodies);
+
+        // bodies in dense regions open more cells, small chunks let the idle workers steal them
+        parallelFor(0, bodies.count, 64, [&](uint32_t begin, uint32_t end, uint32_t worker)
+        {
+            for (uint32_t i = begin; i < end; i++)
+            {
+                SimVec2 a = accelerationBarnesHut(*tree, bodies, bodies.x[i], bodies.y[i], theta, quadrupole, bodies.units.G);
+                ax[i] = a.x;
+                ay[i] = a.y;
+            }
+        });
+    }
+}
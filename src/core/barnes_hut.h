@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "bodies.h"
+#include "quadtree.h"
+
+// barnes-hut gravity, cells that look smaller than theta radians from a body are replaced
+// by their monopole (and optionally quadrupole) moment
+
+namespace sim
+{
+    SimVec2 accelerationBarnesHut(const SimQuadtree& tree, const SimBodies& bodies, double px, double py, double theta, bool quadrupole, double G);
+
+    // builds the tree and computes the acceleration of every body
+    void computeAccelerationsBarnesHut(SimQuadtree* tree, const SimBodies& bodies, float theta, bool quadrupole, float* ax, float* ay);
+}
@@ -0,0 +1,123 @@
+#include "bodies.h"
+
+#include <cmath>
+#include <algorithm>
+
+namespace sim
+{
+    static void resizeHot(SimBodies* bodies, uint32_t count)
+    {
+        uint32_t padded = paddedCount(count);
+
+        bodies->x.resize(padded, 0.0f);
+        bodies->y.resize(padded, 0.0f);
+        bodies->vx.resize(padded, 0.0f);
+        bodies->vy.resize(padded, 0.0f);
+        bodies->mass.resize(padded, 0.0f);
+    }
+
+    uint32_t paddedCount(uint32_t count)
+    {
+        return (count + SIM_PADDING - 1) & ~(uint32_t)(SIM_PADDING - 1);
+    }
+
+    void clearBodies(SimBodies* bodies, SimUnitSystem system)
+    {
+        *bodies = SimBodies{};
+        bodies->units = getUnits(system);
+    }
+
+    uint32_t addBody(SimBodies* bodies, const SimBody& body)
+    {
+        uint32_t index = bodies->count;
+        resizeHot(bodies, index + 1);
+
+        const SimUnits& units = bodies->units;
+        double speed = units.time / units.length;
+        bodies->x[index] = (float)(body.pos.x / units.length);
+        bodies->y[index] = (float)(body.pos.y / units.length);
+        bodies->vx[index] = (float)(body.vel.x * speed);
+        bodies->vy[index] = (float)(body.vel.y * speed);
+        bodies->mass[index] = (float)(body.mass / units.mass);
+
+        bodies->distance.push_back((float)(body.distance / units.length));
+        double radius = body.radius > 0.0f ? body.radius : std::cbrt(3.0 * body.mass / (4.0 * 3.14159265358979 * SIM_DEFAULT_DENSITY));
+        bodies->radius.push_back((float)(radius / units.length));
+        bodies->id.push_back(bodies->nextId);
+        bodies->sun.push_back(body.sun);
+
+        bodies->count++;
+        return bodies->nextId++;
+    }
+
+    void removeBody(SimBodies* bodies, uint32_t index)
+    {
+        if (index >= bodies->count) return;
+
+        SimArray<float>* hot[] = { &bodies->x, &bodies->y, &bodies->vx, &bodies->vy, &bodies->mass };
+        for (SimArray<float>* array : hot)
+        {
+            // keep the order of the bodies, the padding at the end must stay zero
+            array->erase(array->begin() + index);
+            array->push_back(0.0f);
+        }
+
+        bodies->distance.erase(bodies->distance.begin() + index);
+        bodies->radius.erase(bodies->radius.begin() + index);
+        bodies->id.erase(bodies->id.begin() + index);
+        bodies->sun.erase(bodies->sun.begin() + index);
+
+        bodies->count--;
+        resizeHot(bodies, bodies->count);
+    }
+
+    void removeBodies(SimBodies* bodies, const uint8_t* remove)
+    {
+        uint32_t count = 0;
+        for (uint32_t i = 0; i < bodies->count; i++)
+        {
+            if (remove[i]) continue;
+
+            bodies->x[count] = bodies->x[i];
+            bodies->y[count] = bodies->y[i];
+            bodies->vx[count] = bodies->vx[i];
+            bodies->vy[count] = bodies->vy[i];
+            bodies->mass[count] = bodies->mass[i];
+            bodies->distance[count] = bodies->distance[i];
+            bodies->radius[count] = bodies->radius[i];
+            bodies->id[count] = bodies->id[i];
+            bodies->sun[count] = bodies->sun[i];
+            count++;
+        }
+
+        // zero the slots that became padding before shrinking
+        for (SimArray<float>* array : { &bodies->x, &bodies->y, &bodies->vx, &bodies->vy, &bodies->mass })
+            std::fill(array->begin() + count, array->end(), 0.0f);
+
+        bodies->distance.resize(count);
+        bodies->radius.resize(count);
+        bodies->id.resize(count);
+        bodies->sun.resize(count);
+        bodies->count = count;
+        resizeHot(bodies, count);
+    }
+
+    SimBody getBody(const SimBodies& bodies, uint32_t index)
+    {
+        const SimUnits& units = bodies.units;
+        float length = (float)units.length;
+        float speed = (float)(units.length / units.time);
+        return { (float)(bodies.mass[index] * units.mass), bodies.distance[index] * length, { bodies.x[index] * length, bodies.y[index] * length },
+            { bodies.vx[index] * speed, bodies.vy[index] * speed }, bodies.sun[index] != 0, bodies.radius[index] * length };
+    }
+
+    int32_t findSun(const SimBodies& bodies)
+    {
+        for (uint32_t i = 0; i < bodies.count; i++)
+        {
+            if (bodies.sun[i]) return (int32_t)i;
+        }
+
+        return -1;
+    }
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include "units.h"
+
+// structure of arrays body storage for the physics hot loops
+
+#define SIM_ALIGNMENT 64 /* byte alignment of the physics arrays (one cache line) */
+#define SIM_PADDING 16   /* physics arrays are padded with zero mass bodies to a multiple of this */
+#define SIM_DEFAULT_DENSITY 2000.0 /* kg/m^3, gives the radius of bodies added without one */
+
+template <typename T>
+struct SimAlignedAllocator
+{
+    typedef T value_type;
+
+    SimAlignedAllocator() = default;
+    template <typename U> SimAlignedAllocator(const SimAlignedAllocator<U>&) {}
+
+    T* allocate(size_t n)
+    {
+        size_t size = (n * sizeof(T) + SIM_ALIGNMENT - 1) & ~(size_t)(SIM_ALIGNMENT - 1);
+#ifdef _MSC_VER
+        void* ptr = _aligned_malloc(size, SIM_ALIGNMENT);
+#else
+        void* ptr = std::aligned_alloc(SIM_ALIGNMENT, size);
+#endif
+        if (!ptr) throw std::bad_alloc();
+        return static_cast<T*>(ptr);
+    }
+
+    void deallocate(T* ptr, size_t)
+    {
+#ifdef _MSC_VER
+        _aligned_free(ptr);
+#else
+        std::free(ptr);
+#endif
+    }
+
+    template <typename U> bool operator==(const SimAlignedAllocator<U>&) const { return true; }
+    template <typename U> bool operator!=(const SimAlignedAllocator<U>&) const { return false; }
+};
+
+template <typename T>
+using SimArray = std::vector<T, SimAlignedAllocator<T>>;
+
+struct SimVec2
+{
+    float x, y;
+};
+
+// single body in si units, used to add bodies to the store and to read them back
+struct SimBody
+{
+    float mass;          // mass of body
+    float distance;      // distance from sun
+    SimVec2 pos;         // x, y pos of body
+    SimVec2 vel;         // x, y velocity of body
+    bool sun;
+    float radius;        // physical radius for collisions, 0 derives it from the mass and SIM_DEFAULT_DENSITY
+};
+
+// in the units of the bodies, see units.h
+struct SimBodies
+{
+    // hot data, the size of these arrays is paddedCount(count) and the padding is all zero
+    SimArray<float> x, y;
+    SimArray<float> vx, vy;
+    SimArray<float> mass;
+
+    // cold data, size is count
+    std::vector<float> distance;    // distance from sun
+    std::vector<float> radius;      // physical radius, collisions only
+    std::vector<uint32_t> id;       // stable id of the body, used to look up data kept outside the core (rendering)
+    std::vector<uint8_t> sun;
+
+    uint32_t count = 0;
+    uint32_t nextId = 0;
+    SimUnits units = { 1.0, 1.0, 1.0, G_CONSTANT };
+};
+
+namespace sim
+{
+    uint32_t paddedCount(uint32_t count);
+
+    // removes every body, the bodies added next are stored in the given units
+    void clearBodies(SimBodies* bodies, SimUnitSystem system = Sim_Units_Si);
+    uint32_t addBody(SimBodies* bodies, const SimBody& body); // si units, returns the id of the body
+    void removeBody(SimBodies* bodies, uint32_t index);
+    void removeBodies(SimBodies* bodies, const uint8_t* remove); // every body with remove[i] != 0, one pass, keeps the order
+    SimBody getBody(const SimBodies& bodies, uint32_t index); // si units
+    int32_t findSun(const SimBodies& bodies); // -1 if there is no sun
+}
@@ -0,0 +1,83 @@
+#include "clock.h"
+#include "simulation.h"
+
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+
+namespace sim
+{
+    static double now()
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    uint32_t advanceClock(SimClock* clock, SimWorld* world, const SimSettings& settings, double frameSeconds)
+    {
+        const SimBodies& bodies = world->bodies;
+        double timeStep = settings.timeStep;
+        frameSeconds = std::min(frameSeconds, SIM_CLOCK_MAX_FRAME);
+
+        // no step to take, accumulating would spin in the loop below and fmod by 0 leaves pending at nan
+        if (!(timeStep > 0.0))
+        {
+            clock->substeps = 0;
+            clock->behind = false;
+            return 0;
+        }
+
+        clock->pending += frameSeconds * clock->speed;
+        clock->substeps = 0;
+        clock->behind = false;
+
+        double start = now();
+        while (clock->pending >= timeStep)
+        {
+            if (now() - start > clock->budget)
+            {
+                // keep the frame rate, the simulation falls behind the requested speed instead
+                clock->pending = std::fmod(clock->pending, timeStep);
+                clock->behind = true;
+                break;
+            }
+
+            clock->previousX.assign(bodies.x.begin(), bodies.x.begin() + bodies.count);
+            clock->previousY.assign(bodies.y.begin(), bodies.y.begin() + bodies.count);
+
+            step(world, settings);
+            clock->pending -= timeStep;
+            clock->substeps++;
+        }
+
+        clock->alpha = (float)std::min(clock->pending / timeStep, 1.0);
+
+        clock->windowWall += frameSeconds;
+        clock->windowSimulated += clock->substeps * timeStep;
+        if (clock->windowWall >= 1.0)
+        {
+            clock->throughput = clock->windowSimulated / clock->windowWall;
+            clock->windowWall = 0.0;
+            clock->windowSimulated = 0.0;
+        }
+
+        return clock->substeps;
+    }
+
+    void resetClock(SimClock* clock)
+    {
+        clock->pending = 0.0;
+        clock->alpha = 1.0f;
+        clock->previousX.clear();
+        clock->previousY.clear();
+    }
+
+    SimVec2 getInterpolatedPosition(const SimClock& clock, const SimBodies& bodies, uint32_t i)
+    {
+        // no previous state for these bodies (first frame, bodies removed since)
+        if (clock.previousX.size() != bodies.count)
+            return { bodies.x[i], bodies.y[i] };
+
+        float t = clock.alpha;
+        return { clock.previousX[i] + (bodies.x[i] - clock.previousX[i]) * t, clock.previousY[i] + (bodies.y[i] - clock.previousY[i]) * t };
+    }
+}
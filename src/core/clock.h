@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "bodies.h"
+
+// fixed time step accumulator, decouples the simulated time from the frame rate
+// every frame owes speed * frame time of simulated time, paid in steps of settings.timeStep
+// as long as the physics stays within its cpu time budget, the remainder (less than a step)
+// carries over and the renderer interpolates between the last two states by it
+
+#define SIM_CLOCK_SPEED (60.0 * DAY) /* default simulated seconds per wall second, a day a frame at 60 fps */
+#define SIM_CLOCK_BUDGET 0.012       /* default wall seconds of physics per frame */
+#define SIM_CLOCK_MAX_FRAME 0.25     /* longer frames (window drags, breakpoints) only count this much */
+
+struct SimWorld;
+struct SimSettings;
+
+struct SimClock
+{
+    double speed = SIM_CLOCK_SPEED;   // simulated seconds per wall second
+    double budget = SIM_CLOCK_BUDGET; // wall seconds of physics per frame
+    double pending = 0.0;             // simulated seconds owed, less than a step unless the budget ran out
+
+    // positions before the last step and how far (0 to 1) the frame is from them to the current ones
+    std::vector<float> previousX, previousY;
+    float alpha = 1.0f;
+
+    // last frame
+    uint32_t substeps = 0;
+    bool behind = false; // the budget ran out and the owed time was dropped, the simulation runs slower than speed
+
+    // simulated seconds per wall second over about the last second
+    double throughput = 0.0;
+    double windowWall = 0.0;
+    double windowSimulated = 0.0;
+};
+
+namespace sim
+{
+    // takes as many steps as the frame owes within the budget, returns the number of steps (none when the time step is 0 or less)
+    uint32_t advanceClock(SimClock* clock, SimWorld* world, const SimSettings& settings, double frameSeconds);
+
+    // drops the owed time and the previous state (restart, bodies removed)
+    void resetClock(SimClock* clock);
+
+    // position of body i between the last two states, in the units of the bodies
+    SimVec2 getInterpolatedPosition(const SimClock& clock, const SimBodies& bodies, uint32_t i);
+}
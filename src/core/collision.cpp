@@ -0,0 +1,427 @@
+#include "collision.h"
+#include "simulation.h"
+#include "thread_pool.h"
+
+#include <cmath>
+#include <algorithm>
+
+namespace sim
+{
+    const char* getCollisionResponseName(SimCollisionResponse response)
+    {
+        switch (response)
+        {
+        case Sim_Collision_None:     { return "none"; }
+        case Sim_Collision_Merge:    { return "merge"; }
+        case Sim_Collision_Bounce:   { return "bounce"; }
+        case Sim_Collision_Fragment: { return "fragment"; }
+        default: break;
+        }
+
+        return "unknown";
+    }
+
+    void beginCollisions(SimCollisions* collisions, const SimBodies& bodies, const SimParticles& particles)
+    {
+        collisions->previousX.assign(bodies.x.begin(), bodies.x.begin() + bodies.count);
+        collisions->previousY.assign(bodies.y.begin(), bodies.y.begin() + bodies.count);
+        collisions->previousParticleX.assign(particles.x.begin(), particles.x.begin() + particles.count);
+        collisions->previousParticleY.assign(particles.y.begin(), particles.y.begin() + particles.count);
+    }
+
+    // entries are the bodies followed by the particles
+    static inline SimCollisionSlot getSlot(const SimCollisions& c, const SimBodies& bodies, const SimParticles& particles, uint32_t e)
+    {
+        if (e < bodies.count)
+            return { e, 0, 0, c.previousX[e], c.previousY[e], bodies.x[e], bodies.y[e], bodies.radius[e] };
+
+        uint32_t p = e - bodies.count;
+        return { e, 0, 0, c.previousParticleX[p], c.previousParticleY[p], particles.x[p], particles.y[p], 0.0f };
+    }
+
+    // same arithmetic as the cell bounds of the entries
+    static inline int32_t firstCellX(const SimCollisionSlot& s, float invCell)
+    {
+        return (int32_t)std::floor((std::min(s.x0, s.x1) - s.r) * invCell);
+    }
+
+    static inline int32_t firstCellY(const SimCollisionSlot& s, float invCell)
+    {
+        return (int32_t)std::floor((std::min(s.y0, s.y1) - s.r) * invCell);
+    }
+
+    static inline bool overlaps(const SimCollisionSlot& a, const SimCollisionSlot& b)
+    {
+        return std::max(b.x0, b.x1) + b.r >= std::min(a.x0, a.x1) - a.r && std::min(b.x0, b.x1) - b.r <= std::max(a.x0, a.x1) + a.r
+            && std::max(b.y0, b.y1) + b.r >= std::min(a.y0, a.y1) - a.r && std::min(b.y0, b.y1) - b.r <= std::max(a.y0, a.y1) + a.r;
+    }
+
+    // first time in [0, 1] the spheres touch with both moving in a straight line over the step
+    static bool sweptContact(const SimCollisionSlot& a, const SimCollisionSlot& b, float* time)
+    {
+        double dx = (double)b.x0 - a.x0, dy = (double)b.y0 - a.y0;
+        double ux = ((double)b.x1 - a.x1) - dx, uy = ((double)b.y1 - a.y1) - dy;
+        double r = (double)a.r + b.r;
+
+        double c = dx * dx + dy * dy - r * r;
+        if (c <= 0.0)
+        {
+            *time = 0.0f;
+            return true;
+        }
+
+        double qa = ux * ux + uy * uy;
+        double qb = 2.0 * (dx * ux + dy * uy);
+        double discriminant = qb * qb - 4.0 * qa * c;
+        if (qa == 0.0 || qb >= 0.0 || discriminant < 0.0)
+            return false;
+
+        double t = (-qb - std::sqrt(discriminant)) / (2.0 * qa);
+        if (t > 1.0)
+            return false;
+
+        *time = (float)t;
+        return true;
+    }
+
+    static inline uint32_t hashCell(int32_t x, int32_t y, uint32_t mask)
+    {
+        return (((uint32_t)x * 73856093u) ^ ((uint32_t)y * 19349663u)) & mask;
+    }
+
+    void findCollisions(SimCollisions* c, const SimBodies& bodies, const SimParticles& particles)
+    {
+        uint32_t nb = bodies.count;
+        uint32_t n = nb + particles.count;
+        c->pairs.clear();
+        if (n < 2 || c->previousX.size() != nb || c->previousParticleX.size() != particles.count) return;
+
+        // swept bounds, the cell size is a high percentile of their size so most entries span a cell or two
+        c->extent.resize(n);
+        float largestCoordinate = 0.0f;
+        for (uint32_t e = 0; e < n; e++)
+        {
+            SimCollisionSlot s = getSlot(*c, bodies, particles, e);
+            float width = std::fabs(s.x1 - s.x0) + 2.0f * s.r;
+            float height = std::fabs(s.y1 - s.y0) + 2.0f * s.r;
+            c->extent[e] = std::max(width, height);
+            largestCoordinate = std::max(largestCoordinate, std::max(std::max(std::fabs(s.x0), std::fabs(s.x1)), std::max(std::fabs(s.y0), std::fabs(s.y1))) + s.r);
+        }
+
+        std::vector<float> sorted = c->extent;
+        uint32_t k = std::min((uint32_t)(n * SIM_COLLISION_CELL_PERCENTILE), n - 1);
+        std::nth_element(sorted.begin(), sorted.begin() + k, sorted.end());
+        // cell coordinates must fit in an int32
+        c->cellSize = std::max(sorted[k], largestCoordinate / (float)(1 << 30));
+        if (c->cellSize <= 0.0f) c->cellSize = 1.0f;
+        float invCell = 1.0f / c->cellSize;
+
+        c->cellMinX.resize(n);
+        c->cellMinY.resize(n);
+        c->cellMaxX.resize(n);
+        c->cellMaxY.resize(n);
+        c->large.clear();
+        std::vector<uint8_t> isLarge(n, 0);
+
+        uint64_t insertions = 0;
+        for (uint32_t e = 0; e < n; e++)
+        {
+            SimCollisionSlot s = getSlot(*c, bodies, particles, e);
+            c->cellMinX[e] = firstCellX(s, invCell);
+            c->cellMinY[e] = firstCellY(s, invCell);
+            c->cellMaxX[e] = (int32_t)std::floor((std::max(s.x0, s.x1) + s.r) * invCell);
+            c->cellMaxY[e] = (int32_t)std::floor((std::max(s.y0, s.y1) + s.r) * invCell);
+
+            uint64_t cells = (uint64_t)(c->cellMaxX[e] - c->cellMinX[e] + 1) * (uint64_t)(c->cellMaxY[e] - c->cellMinY[e] + 1);
+            if (cells > SIM_COLLISION_MAX_CELLS)
+            {
+                c->large.push_back(e);
+                isLarge[e] = 1;
+            }
+            else
+                insertions += cells;
+        }
+
+        // counting sort of the cell insertions by bucket
+        uint32_t buckets = 1024;
+        while (buckets < 2 * insertions) buckets *= 2;
+        uint32_t mask = buckets - 1;
+
+        c->bucketStart.assign(buckets + 1, 0);
+        for (uint32_t e = 0; e < n; e++)
+        {
+            if (isLarge[e]) continue;
+            for (int32_t y = c->cellMinY[e]; y <= c->cellMaxY[e]; y++)
+                for (int32_t x = c->cellMinX[e]; x <= c->cellMaxX[e]; x++)
+                    c->bucketStart[hashCell(x, y, mask) + 1]++;
+        }
+
+        for (uint32_t b = 0; b < buckets; b++)
+            c->bucketStart[b + 1] += c->bucketStart[b];
+
+        // the bounds go with the entries, a bucket is tested without looking anything up
+        c->slots.resize(insertions);
+        std::vector<uint32_t> fill(c->bucketStart.begin(), c->bucketStart.end() - 1);
+        for (uint32_t e = 0; e < n; e++)
+        {
+            if (isLarge[e]) continue;
+            SimCollisionSlot s = getSlot(*c, bodies, particles, e);
+            for (int32_t y = c->cellMinY[e]; y <= c->cellMaxY[e]; y++)
+            {
+                for (int32_t x = c->cellMinX[e]; x <= c->cellMaxX[e]; x++)
+                {
+                    s.cellX = x;
+                    s.cellY = y;
+                    c->slots[fill[hashCell(x, y, mask)]++] = s;
+                }
+            }
+        }
+
+        uint32_t threads = getThreadCount();
+        c->workerPairs.resize(threads);
+        for (auto& pairs : c->workerPairs)
+            pairs.clear();
+
+        // candidates share a cell, a pair spanning several common cells is only tested in the first of them
+        parallelFor(0, buckets, 256, [&](uint32_t begin, uint32_t end, uint32_t worker)
+        {
+            std::vector<SimCollisionPair>& pairs = c->workerPairs[worker];
+            for (uint32_t b = begin; b < end; b++)
+            {
+                for (uint32_t p = c->bucketStart[b]; p < c->bucketStart[b + 1]; p++)
+                {
+                    const SimCollisionSlot& sa = c->slots[p];
+                    for (uint32_t q = p + 1; q < c->bucketStart[b + 1]; q++)
+                    {
+                        const SimCollisionSlot& sb = c->slots[q];
+                        uint32_t ea = sa.entry, eb = sb.entry;
+                        if (ea >= nb && eb >= nb) continue; // particles don't collide with each other
+                        if (sa.cellX != sb.cellX || sa.cellY != sb.cellY) continue; // hash collision
+                        if (!overlaps(sa, sb)) continue;
+
+                        // the overlap of the bounds starts in the first common cell
+                        if (sa.cellX != std::max(firstCellX(sa, invCell), firstCellX(sb, invCell)) || sa.cellY != std::max(firstCellY(sa, invCell), firstCellY(sb, invCell))) continue;
+
+                        float time;
+                        if (sweptContact(sa, sb, &time))
+                            pairs.push_back({ std::min(ea, eb), std::max(ea, eb), time });
+                    }
+                }
+            }
+        });
+
+        // the large entries against everything, bounds first
+        parallelFor(0, (uint32_t)c->large.size(), 1, [&](uint32_t begin, uint32_t end, uint32_t worker)
+        {
+            std::vector<SimCollisionPair>& pairs = c->workerPairs[worker];
+            for (uint32_t l = begin; l < end; l++)
+            {
+                uint32_t ea = c->large[l];
+                SimCollisionSlot a = getSlot(*c, bodies, particles, ea);
+                for (uint32_t eb = 0; eb < n; eb++)
+                {
+                    if (eb == ea || (isLarge[eb] && eb < ea)) continue;
+                    if (ea >= nb && eb >= nb) continue;
+                    if (c->cellMaxX[eb] < c->cellMinX[ea] || c->cellMinX[eb] > c->cellMaxX[ea] || c->cellMaxY[eb] < c->cellMinY[ea] || c->cellMinY[eb] > c->cellMaxY[ea]) continue;
+
+                    SimCollisionSlot b = getSlot(*c, bodies, particles, eb);
+                    float time;
+                    if (overlaps(a, b) && sweptContact(a, b, &time))
+                        pairs.push_back({ std::min(ea, eb), std::max(ea, eb), time });
+                }
+            }
+        });
+
+        for (const auto& pairs : c->workerPairs)
+            c->pairs.insert(c->pairs.end(), pairs.begin(), pairs.end());
+
+        // earliest first, the order of the workers doesn't matter
+        std::sort(c->pairs.begin(), c->pairs.end(), [](const SimCollisionPair& a, const SimCollisionPair& b)
+        {
+            if (a.time != b.time) return a.time < b.time;
+            if (a.a != b.a) return a.a < b.a;
+            return a.b < b.b;
+        });
+    }
+
+    // b into a, mass, momentum and volume conserved, a stays at the center of mass
+    static void merge(SimBodies* bodies, uint32_t a, uint32_t b)
+    {
+        float ma = bodies->mass[a], mb = bodies->mass[b];
+        float m = ma + mb;
+        if (m <= 0.0f) return;
+
+        bodies->x[a] = (ma * bodies->x[a] + mb * bodies->x[b]) / m;
+        bodies->y[a] = (ma * bodies->y[a] + mb * bodies->y[b]) / m;
+        bodies->vx[a] = (ma * bodies->vx[a] + mb * bodies->vx[b]) / m;
+        bodies->vy[a] = (ma * bodies->vy[a] + mb * bodies->vy[b]) / m;
+        bodies->mass[a] = m;
+        bodies->radius[a] = std::cbrt(bodies->radius[a] * bodies->radius[a] * bodies->radius[a] + bodies->radius[b] * bodies->radius[b] * bodies->radius[b]);
+        bodies->sun[a] = bodies->sun[a] || bodies->sun[b];
+    }
+
+    // rewinds both to the time of contact, so bodies that passed through each other during the step bounce off
+    // the side they came from, then moves them on with the new velocities for the rest of the step
+    static void bounce(const SimCollisions& c, SimBodies* bodies, uint32_t a, uint32_t b, float time, float restitution, double timeStep)
+    {
+        double ma = bodies->mass[a], mb = bodies->mass[b];
+        if (ma <= 0.0 || mb <= 0.0) return;
+
+        double ax = c.previousX[a] + time * ((double)bodies->x[a] - c.previousX[a]);
+        double ay = c.previousY[a] + time * ((double)bodies->y[a] - c.previousY[a]);
+        double bx = c.previousX[b] + time * ((double)bodies->x[b] - c.previousX[b]);
+        double by = c.previousY[b] + time * ((double)bodies->y[b] - c.previousY[b]);
+
+        double nx = bx - ax, ny = by - ay;
+        double distance = std::sqrt(nx * nx + ny * ny);
+        if (distance == 0.0) return;
+        nx /= distance;
+        ny /= distance;
+
+        // only while they approach, otherwise they are separating already
+        double vax = bodies->vx[a], vay = bodies->vy[a], vbx = bodies->vx[b], vby = bodies->vy[b];
+        double vn = (vbx - vax) * nx + (vby - vay) * ny;
+        if (vn < 0.0)
+        {
+            double j = -(1.0 + restitution) * vn / (1.0 / ma + 1.0 / mb);
+            vax -= j / ma * nx;
+            vay -= j / ma * ny;
+            vbx += j / mb * nx;
+            vby += j / mb * ny;
+        }
+
+        // bodies that started the step overlapping are pushed apart to touching, around the center of mass
+        double overlap = (double)bodies->radius[a] + bodies->radius[b] - distance;
+        if (overlap > 0.0)
+        {
+            ax -= overlap * mb / (ma + mb) * nx;
+            ay -= overlap * mb / (ma + mb) * ny;
+            bx += overlap * ma / (ma + mb) * nx;
+            by += overlap * ma / (ma + mb) * ny;
+        }
+
+        double rest = (1.0 - time) * timeStep;
+        bodies->x[a] = (float)(ax + vax * rest);
+        bodies->y[a] = (float)(ay + vay * rest);
+        bodies->x[b] = (float)(bx + vbx * rest);
+        bodies->y[b] = (float)(by + vby * rest);
+        bodies->vx[a] = (float)vax;
+        bodies->vy[a] = (float)vay;
+        bodies->vx[b] = (float)vbx;
+        bodies->vy[b] = (float)vby;
+    }
+
+    // merges b into a and throws a fraction of b's mass back out as fragments, symmetric so the momentum is unchanged
+    static bool fragment(SimBodies* bodies, uint32_t a, uint32_t b)
+    {
+        double ma = bodies->mass[a], mb = bodies->mass[b];
+        double dvx = (double)bodies->vx[b] - bodies->vx[a];
+        double dvy = (double)bodies->vy[b] - bodies->vy[a];
+        double speed = std::sqrt(dvx * dvx + dvy * dvy);
+        double escape = std::sqrt(2.0 * bodies->units.G * (ma + mb) / ((double)bodies->radius[a] + bodies->radius[b]));
+        if (speed <= escape || ma + mb <= 0.0)
+        {
+            merge(bodies, a, b);
+            return false;
+        }
+
+        double nx = std::atan2(dvy, dvx);
+        merge(bodies, a, b);
+
+        double ejecta = SIM_COLLISION_EJECTA * std::min(ma, mb);
+        double fragmentMass = ejecta / SIM_COLLISION_FRAGMENTS;
+        double fragmentRadius = std::cbrt(bodies->radius[a] * bodies->radius[a] * bodies->radius[a] * fragmentMass / (ma + mb));
+        bodies->mass[a] = (float)(ma + mb - ejecta);
+        bodies->radius[a] = (float)std::cbrt(bodies->radius[a] * bodies->radius[a] * bodies->radius[a] * (ma + mb - ejecta) / (ma + mb));
+
+        // just outside the remnant at its escape speed there
+        double distance = bodies->radius[a] + 2.0 * fragmentRadius;
+        double ejectSpeed = std::sqrt(2.0 * bodies->units.G * (ma + mb) / distance);
+
+        const SimUnits& units = bodies->units;
+        for (uint32_t f = 0; f < SIM_COLLISION_FRAGMENTS; f++)
+        {
+            double angle = nx + f * (2.0 * 3.14159265358979 / SIM_COLLISION_FRAGMENTS);
+            double cx = std::cos(angle), cy = std::sin(angle);
+
+            // si units for addBody
+            SimBody body{};
+            body.mass = (float)(fragmentMass * units.mass);
+            body.radius = (float)(fragmentRadius * units.length);
+            body.pos = { (float)((bodies->x[a] + distance * cx) * units.length), (float)((bodies->y[a] + distance * cy) * units.length) };
+            body.vel = { (float)((bodies->vx[a] + ejectSpeed * cx) * units.length / units.time), (float)((bodies->vy[a] + ejectSpeed * cy) * units.length / units.time) };
+            addBody(bodies, body);
+        }
+
+        return true;
+    }
+
+    uint32_t resolveCollisions(SimCollisions* c, SimWorld* world, SimCollisionResponse response, float restitution, double timeStep)
+    {
+        SimBodies* bodies = &world->bodies;
+        SimParticles* particles = &world->particles;
+        uint32_t nb = bodies->count;
+        uint32_t np = particles->count;
+        if (c->pairs.empty() || response == Sim_Collision_None) return 0;
+
+        std::vector<uint8_t> removeBodyFlags(nb, 0);
+        std::vector<uint8_t> removeParticleFlags(np, 0);
+        uint32_t resolved = 0;
+        bool bodiesChanged = false;
+
+        for (const SimCollisionPair& pair : c->pairs)
+        {
+            uint32_t a = pair.a, b = pair.b;
+
+            // a particle hits a body, a < b so the body is a
+            if (b >= nb)
+            {
+                if (removeBodyFlags[a] || removeParticleFlags[b - nb]) continue;
+                removeParticleFlags[b - nb] = 1;
+                c->absorbed++;
+                resolved++;
+                continue;
+            }
+
+            if (removeBodyFlags[a] || removeBodyFlags[b]) continue;
+
+            // the heavier body survives
+            if (bodies->mass[b] > bodies->mass[a])
+                std::swap(a, b);
+
+            switch (response)
+            {
+            case Sim_Collision_Merge:
+                merge(bodies, a, b);
+                removeBodyFlags[b] = 1;
+                c->merges++;
+                break;
+            case Sim_Collision_Bounce:
+                bounce(*c, bodies, a, b, pair.time, restitution, timeStep);
+                c->bounces++;
+                break;
+            case Sim_Collision_Fragment:
+                if (fragment(bodies, a, b))
+                    c->fragmentations++;
+                else
+                    c->merges++;
+                removeBodyFlags[b] = 1;
+                break;
+            default: break;
+            }
+
+            bodiesChanged = true;
+            resolved++;
+        }
+
+        // fragments were added at the end
+        removeBodyFlags.resize(bodies->count, 0);
+        removeBodies(bodies, removeBodyFlags.data());
+        removeParticles(particles, removeParticleFlags.data());
+
+        if (bodiesChanged)
+            resetIntegrator(world);
+
+        return resolved;
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "bodies.h"
+
+// collision stage, run after the bodies moved, with a uniform spatial hash grid rebuilt every step
+// every body (and test particle) is inserted with the bounds of the sphere swept from its position at the
+// start of the step to the one at the end, candidates in the same cell get a swept sphere test
+// (relative motion linear over the step), so fast bodies can't tunnel through each other in one step
+// the cell size follows the size of the swept bounds, entries spanning too many cells are tested against everything
+
+#define SIM_COLLISION_MAX_CELLS 64      /* entries spanning more cells go to the large list */
+#define SIM_COLLISION_CELL_PERCENTILE 0.9 /* cells are as big as this fraction of the swept bounds */
+#define SIM_COLLISION_FRAGMENTS 4       /* fragments of a shattering impact */
+#define SIM_COLLISION_EJECTA 0.2        /* fraction of the smaller body's mass ejected as fragments */
+#define SIM_COLLISION_RESTITUTION 0.5f  /* default normal restitution of bounces */
+
+struct SimWorld;
+struct SimSettings;
+struct SimParticles;
+
+enum SimCollisionResponse
+{
+    Sim_Collision_None,      // bodies pass through each other
+    Sim_Collision_Merge,     // perfectly inelastic, mass and momentum conserved
+    Sim_Collision_Bounce,    // impulse along the contact normal with settings.restitution
+    Sim_Collision_Fragment,  // impacts faster than the mutual escape speed shatter the smaller body, slower ones merge
+    Sim_Collision_Count,
+};
+
+// an entry in one cell of the grid with its positions at the start and the end of the step
+struct SimCollisionSlot
+{
+    uint32_t entry;
+    int32_t cellX, cellY;
+    float x0, y0, x1, y1, r;
+};
+
+// entries are the bodies followed by the particles, time is the first contact as a fraction of the step
+struct SimCollisionPair
+{
+    uint32_t a, b;
+    float time;
+};
+
+struct SimCollisions
+{
+    // positions at the start of the step
+    SimArray<float> previousX, previousY;
+    SimArray<float> previousParticleX, previousParticleY;
+
+    // grid of the last pass, per entry size of the swept bounds and cell bounds, then the entries sorted by hash bucket
+    float cellSize = 0.0f;
+    std::vector<float> extent;
+    std::vector<int32_t> cellMinX, cellMinY, cellMaxX, cellMaxY;
+    std::vector<uint32_t> bucketStart;
+    std::vector<SimCollisionSlot> slots; // slots[bucketStart[b], bucketStart[b + 1]) are in bucket b
+    std::vector<uint32_t> large;         // entries spanning too many cells, not in the grid
+
+    std::vector<std::vector<SimCollisionPair>> workerPairs;
+    std::vector<SimCollisionPair> pairs; // contacts of the last pass, by time
+
+    // totals since the world was set up
+    uint64_t merges = 0;
+    uint64_t bounces = 0;
+    uint64_t fragmentations = 0;
+    uint64_t absorbed = 0; // particles that hit a body
+};
+
+namespace sim
+{
+    const char* getCollisionResponseName(SimCollisionResponse response);
+
+    // saves the positions at the start of the step
+    void beginCollisions(SimCollisions* collisions, const SimBodies& bodies, const SimParticles& particles);
+
+    // every pair that touched during the step, sorted by the time of contact
+    void findCollisions(SimCollisions* collisions, const SimBodies& bodies, const SimParticles& particles);
+
+    // applies the response to the pairs found, particles are absorbed by any body they hit,
+    // timeStep is the step that was taken (in the units of the bodies), returns the number of collisions resolved
+    uint32_t resolveCollisions(SimCollisions* collisions, SimWorld* world, SimCollisionResponse response, float restitution, double timeStep);
+}
@@ -0,0 +1,79 @@
+#include "cpu.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define SIM_CPUID 1
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#define SIM_CPUID 1
+#else
+#define SIM_CPUID 0
+#endif
+
+#if SIM_CPUID
+static void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t registers[4])
+{
+#if defined(_MSC_VER)
+    __cpuidex((int*)registers, (int)leaf, (int)subleaf);
+#else
+    __cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+}
+
+// xcr0, the register state the os saves on a context switch
+static uint64_t xgetbv()
+{
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    uint32_t eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((uint64_t)edx << 32) | eax;
+#endif
+}
+#endif
+
+static SimCpuFeatures detectCpuFeatures()
+{
+    SimCpuFeatures features = {};
+
+#if SIM_CPUID
+    uint32_t r[4];
+    cpuid(0, 0, r);
+    uint32_t maxLeaf = r[0];
+    if (maxLeaf < 1)
+        return features;
+
+    cpuid(1, 0, r);
+    features.sse2 = (r[3] >> 26) & 1;
+    features.sse42 = (r[2] >> 20) & 1;
+    features.fma = (r[2] >> 12) & 1;
+    bool osxsave = (r[2] >> 27) & 1;
+    bool avx = (r[2] >> 28) & 1;
+
+    // xmm and ymm state (bits 1, 2), then opmask, zmm 0-15 upper halves and zmm 16-31 (bits 5, 6, 7)
+    uint64_t xcr0 = osxsave ? xgetbv() : 0;
+    bool osAvx = (xcr0 & 0x06) == 0x06;
+    bool osAvx512 = osAvx && (xcr0 & 0xe0) == 0xe0;
+    features.avx = avx && osAvx;
+    features.fma = features.fma && features.avx;
+
+    if (maxLeaf >= 7)
+    {
+        cpuid(7, 0, r);
+        features.avx2 = features.avx && ((r[1] >> 5) & 1);
+        features.avx512f = osAvx512 && ((r[1] >> 16) & 1);
+    }
+#endif
+
+    return features;
+}
+
+namespace sim
+{
+    const SimCpuFeatures& getCpuFeatures()
+    {
+        static const SimCpuFeatures features = detectCpuFeatures();
+        return features;
+    }
+}
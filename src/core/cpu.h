@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+
+// instruction sets of the cpu the program runs on (cpuid), read once, the vector kernels are only selected
+// when the cpu and the operating system (saved vector registers) support them, so one binary built with every
+// kernel (SIM_SIMD=AVX512) runs on any x86-64 machine with the widest kernel it has
+
+struct SimCpuFeatures
+{
+    bool sse2;
+    bool sse42;
+    bool avx;      // with the ymm registers saved by the os
+    bool avx2;
+    bool fma;
+    bool avx512f;  // with the zmm and mask registers saved by the os
+};
+
+namespace sim
+{
+    const SimCpuFeatures& getCpuFeatures();
+}
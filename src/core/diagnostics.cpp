@@ -0,0 +1,113 @@
+#include "diagnostics.h"
+#include "precision.h"
+
+#include <cmath>
+
+namespace sim
+{
+    void resetDiagnostics(SimDiagnostics* diagnostics)
+    {
+        diagnostics->started = false;
+        diagnostics->head = 0;
+        diagnostics->size = 0;
+    }
+
+    template <typename P>
+    SimConservation measureConservation(const SimBodies& bodies, const P* x, const P* y, const P* vx, const P* vy, double potential)
+    {
+        SimConservation c = { 0.0, potential, 0.0, 0.0, 0.0, 0.0, 0.0 };
+        uint32_t count = bodies.count;
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            double m = bodies.mass[i];
+            double px = exact(x[i]), py = exact(y[i]);
+            double pvx = exact(vx[i]), pvy = exact(vy[i]);
+            double v2 = pvx * pvx + pvy * pvy;
+
+            c.kinetic += 0.5 * m * v2;
+            c.px += m * pvx;
+            c.py += m * pvy;
+            c.angular += m * (px * pvy - py * pvx);
+            c.scale += m * std::sqrt(v2);
+        }
+
+        // the tree solvers and the integrators with their own force loops don't sum the potential
+        if (std::isnan(c.potential) && count <= SIM_DIAGNOSTICS_MAX_DIRECT)
+        {
+            double sum = 0.0;
+            for (uint32_t i = 0; i < count; i++)
+            {
+                double row = 0.0;
+                for (uint32_t j = i + 1; j < count; j++)
+                {
+                    double dx = exact(x[j]) - exact(x[i]);
+                    double dy = exact(y[j]) - exact(y[i]);
+                    double r = std::sqrt(dx * dx + dy * dy);
+                    if (r > 0.0)
+                        row += bodies.mass[j] / r;
+                }
+
+                sum += bodies.mass[i] * row;
+            }
+
+            c.potential = -bodies.units.G * sum;
+        }
+
+        c.energy = c.kinetic + c.potential;
+        return c;
+    }
+
+    template SimConservation measureConservation<float>(const SimBodies&, const float*, const float*, const float*, const float*, double);
+    template SimConservation measureConservation<SimKahan>(const SimBodies&, const SimKahan*, const SimKahan*, const SimKahan*, const SimKahan*, double);
+    template SimConservation measureConservation<double>(const SimBodies&, const double*, const double*, const double*, const double*, double);
+
+    static double relative(double value, double reference)
+    {
+        return reference != 0.0 ? (value - reference) / std::fabs(reference) : 0.0;
+    }
+
+    double getEnergyDrift(const SimDiagnostics& d)
+    {
+        return relative(d.last.energy, d.initial.energy);
+    }
+
+    double getMomentumDrift(const SimDiagnostics& d)
+    {
+        double dx = d.last.px - d.initial.px;
+        double dy = d.last.py - d.initial.py;
+        return d.initial.scale > 0.0 ? std::sqrt(dx * dx + dy * dy) / d.initial.scale : 0.0;
+    }
+
+    double getAngularDrift(const SimDiagnostics& d)
+    {
+        return relative(d.last.angular, d.initial.angular);
+    }
+
+    void recordConservation(SimDiagnostics* d, const SimConservation& sample, uint32_t count, bool fused)
+    {
+        if (!d->started || d->count != count)
+        {
+            resetDiagnostics(d);
+            d->started = true;
+            d->count = count;
+            d->initial = sample;
+        }
+
+        d->last = sample;
+        if (fused)
+            d->fused++;
+        else if (!std::isnan(sample.potential))
+            d->direct++;
+
+        uint32_t slot = (d->head + d->size) % SIM_DIAGNOSTICS_HISTORY;
+        d->energyDrift[slot] = (float)getEnergyDrift(*d);
+        d->momentumDrift[slot] = (float)getMomentumDrift(*d);
+        d->angularDrift[slot] = (float)getAngularDrift(*d);
+
+        if (d->size < SIM_DIAGNOSTICS_HISTORY)
+            d->size++;
+        else
+            d->head = (d->head + 1) % SIM_DIAGNOSTICS_HISTORY;
+    }
+}
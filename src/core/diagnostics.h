@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "bodies.h"
+
+// conservation diagnostics: total energy, linear momentum and angular momentum of the bodies after every step and their
+// drift since the first sample, the test particles are massless and left out
+// the potential energy comes out of the direct summation force pass (m_j / r next to m_j / r^3, one multiply add
+// per pair), the kinetic energy and the momenta are one O(N) sweep over the state of the integrator
+
+#define SIM_DIAGNOSTICS_HISTORY 512      /* steps kept for the plots */
+#define SIM_DIAGNOSTICS_MAX_DIRECT 2048  /* bodies up to which the potential is summed on its own when the force pass has none */
+
+// in the units of the bodies, the potential (and the energy) is nan when it wasn't available
+struct SimConservation
+{
+    double kinetic, potential, energy;
+    double px, py;   // linear momentum
+    double angular;  // angular momentum about the origin
+    double scale;    // sum of m |v|, the momentum drift is relative to it as the total is about zero
+};
+
+struct SimDiagnostics
+{
+    uint32_t count = 0;    // bodies of the first sample, a change of the bodies (merges, edits) starts again
+    bool started = false;
+    SimConservation initial{};
+    SimConservation last{};
+
+    // relative drift of the last SIM_DIAGNOSTICS_HISTORY steps, oldest at head once the ring is full
+    float energyDrift[SIM_DIAGNOSTICS_HISTORY];
+    float momentumDrift[SIM_DIAGNOSTICS_HISTORY];
+    float angularDrift[SIM_DIAGNOSTICS_HISTORY];
+    uint32_t head = 0, size = 0;
+
+    // samples with the potential from the force pass and summed on their own (the others have no energy)
+    uint64_t fused = 0, direct = 0;
+};
+
+namespace sim
+{
+    // the next sample is the new reference
+    void resetDiagnostics(SimDiagnostics* diagnostics);
+
+    // kinetic energy and momenta of a state (the bodies or a precision state of the integrator), potential is the
+    // energy from the force pass at these positions or nan, then it is summed here for up to SIM_DIAGNOSTICS_MAX_DIRECT bodies
+    template <typename P>
+    SimConservation measureConservation(const SimBodies& bodies, const P* x, const P* y, const P* vx, const P* vy, double potential);
+
+    // appends the drift of sample against the first one, fused tells where the potential came from
+    void recordConservation(SimDiagnostics* diagnostics, const SimConservation& sample, uint32_t count, bool fused);
+
+    // drift of the last sample, energy relative to the first energy, momentum relative to the first scale
+    double getEnergyDrift(const SimDiagnostics& diagnostics);
+    double getMomentumDrift(const SimDiagnostics& diagnostics);
+    double getAngularDrift(const SimDiagnostics& diagnostics);
+}
@@ -0,0 +1,270 @@
+#include "dormand_prince.h"
+#include "simulation.h"
+#include "thread_pool.h"
+
+#include <cmath>
+#include <algorithm>
+
+namespace sim
+{
+    // butcher tableau, the last row is also the 5th order solution (first same as last)
+    static const double s_A[7][6] =
+    {
+        { 0.0 },
+        { 1.0 / 5.0 },
+        { 3.0 / 40.0, 9.0 / 40.0 },
+        { 44.0 / 45.0, -56.0 / 15.0, 32.0 / 9.0 },
+        { 19372.0 / 6561.0, -25360.0 / 2187.0, 64448.0 / 6561.0, -212.0 / 729.0 },
+        { 9017.0 / 3168.0, -355.0 / 33.0, 46732.0 / 5247.0, 49.0 / 176.0, -5103.0 / 18656.0 },
+        { 35.0 / 384.0, 0.0, 500.0 / 1113.0, 125.0 / 192.0, -2187.0 / 6784.0, 11.0 / 84.0 },
+    };
+
+    // difference of the 5th and the embedded 4th order weights
+    static const double s_E[7] = { 71.0 / 57600.0, 0.0, -71.0 / 16695.0, 71.0 / 1920.0, -17253.0 / 339200.0, 22.0 / 525.0, -1.0 / 40.0 };
+
+    // acceleration on every body at the positions px, py, direct summation
+    static void evaluate(const SimBodies& bodies, const double* px, const double* py, double* ax, double* ay)
+    {
+        uint32_t count = bodies.count;
+        parallelFor(0, count, 16, [&](uint32_t begin, uint32_t end, uint32_t worker)
+        {
+            for (uint32_t i = begin; i < end; i++)
+            {
+                double sumx = 0.0, sumy = 0.0;
+                for (uint32_t j = 0; j < count; j++)
+                {
+                    double dx = px[j] - px[i];
+                    double dy = py[j] - py[i];
+                    double r2 = dx * dx + dy * dy;
+                    if (r2 == 0.0) continue;
+
+                    double invr2 = 1.0 / r2;
+                    double s = bodies.mass[j] * invr2 * std::sqrt(invr2);
+                    sumx += s * dx;
+                    sumy += s * dy;
+                }
+
+                ax[i] = bodies.units.G * sumx;
+                ay[i] = bodies.units.G * sumy;
+            }
+        });
+    }
+
+    // mean distance from the origin and mean speed, the error of a body is measured against its own
+    // distance and speed plus these, so bodies near the origin or at rest don't force tiny steps
+    static void meanScales(const SimDormandPrince* dp, double* meanR, double* meanV)
+    {
+        double r = 0.0, v = 0.0;
+        for (uint32_t i = 0; i < dp->count; i++)
+        {
+            r += std::sqrt(dp->x[i] * dp->x[i] + dp->y[i] * dp->y[i]);
+            v += std::sqrt(dp->vx[i] * dp->vx[i] + dp->vy[i] * dp->vy[i]);
+        }
+
+        *meanR = r / dp->count;
+        *meanV = v / dp->count;
+    }
+
+    static void start(SimDormandPrince* dp, const SimBodies& bodies, double timeStep, double tolerance)
+    {
+        uint32_t count = bodies.count;
+        dp->count = count;
+
+        for (std::vector<double>* v : { &dp->x, &dp->y, &dp->vx, &dp->vy, &dp->sx, &dp->sy, &dp->nx, &dp->ny, &dp->nvx, &dp->nvy })
+            v->assign(count, 0.0);
+        for (uint32_t s = 0; s < 7; s++)
+        {
+            dp->kvx[s].assign(count, 0.0);
+            dp->kvy[s].assign(count, 0.0);
+            dp->kax[s].assign(count, 0.0);
+            dp->kay[s].assign(count, 0.0);
+        }
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            dp->x[i] = bodies.x[i];
+            dp->y[i] = bodies.y[i];
+            dp->vx[i] = dp->kvx[0][i] = bodies.vx[i];
+            dp->vy[i] = dp->kvy[0][i] = bodies.vy[i];
+        }
+
+        evaluate(bodies, dp->x.data(), dp->y.data(), dp->kax[0].data(), dp->kay[0].data());
+
+        // first step, a fraction of the time a body needs to move by its error scale
+        double meanR, meanV;
+        meanScales(dp, &meanR, &meanV);
+
+        double step = timeStep;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            double r = std::sqrt(dp->x[i] * dp->x[i] + dp->y[i] * dp->y[i]) + meanR;
+            double v = std::sqrt(dp->vx[i] * dp->vx[i] + dp->vy[i] * dp->vy[i]);
+            double a = std::sqrt(dp->kax[0][i] * dp->kax[0][i] + dp->kay[0][i] * dp->kay[0][i]);
+            if (v > 0.0) step = std::min(step, r / v);
+            if (a > 0.0) step = std::min(step, (v + meanV) / a);
+        }
+
+        dp->step = std::min(timeStep, 0.1 * std::pow(tolerance, 0.2) * step);
+        dp->accepted = 0;
+        dp->rejected = 0;
+    }
+
+    // one trial step of size h, returns the error relative to the tolerance (accept when <= 1)
+    static double trialStep(SimDormandPrince* dp, const SimBodies& bodies, double h, double tolerance, double meanR, double meanV)
+    {
+        uint32_t count = dp->count;
+
+        for (uint32_t s = 1; s < 7; s++)
+        {
+            parallelFor(0, count, 1024, [&](uint32_t begin, uint32_t end, uint32_t worker)
+            {
+                for (uint32_t i = begin; i < end; i++)
+                {
+                    double x = 0.0, y = 0.0, vx = 0.0, vy = 0.0;
+                    for (uint32_t j = 0; j < s; j++)
+                    {
+                        x += s_A[s][j] * dp->kvx[j][i];
+                        y += s_A[s][j] * dp->kvy[j][i];
+                        vx += s_A[s][j] * dp->kax[j][i];
+                        vy += s_A[s][j] * dp->kay[j][i];
+                    }
+
+                    dp->sx[i] = dp->x[i] + h * x;
+                    dp->sy[i] = dp->y[i] + h * y;
+                    dp->kvx[s][i] = dp->vx[i] + h * vx;
+                    dp->kvy[s][i] = dp->vy[i] + h * vy;
+                }
+            });
+
+            evaluate(bodies, dp->sx.data(), dp->sy.data(), dp->kax[s].data(), dp->kay[s].data());
+        }
+
+        // the last stage is the 5th order solution, the error is its difference to the embedded 4th order one
+        std::vector<double> workerError(getThreadCount(), 0.0);
+        parallelFor(0, count, 1024, [&](uint32_t begin, uint32_t end, uint32_t worker)
+        {
+            double error = workerError[worker];
+            for (uint32_t i = begin; i < end; i++)
+            {
+                double ex = 0.0, ey = 0.0, evx = 0.0, evy = 0.0;
+                for (uint32_t j = 0; j < 7; j++)
+                {
+                    ex += s_E[j] * dp->kvx[j][i];
+                    ey += s_E[j] * dp->kvy[j][i];
+                    evx += s_E[j] * dp->kax[j][i];
+                    evy += s_E[j] * dp->kay[j][i];
+                }
+
+                dp->nx[i] = dp->sx[i];
+                dp->ny[i] = dp->sy[i];
+                dp->nvx[i] = dp->kvx[6][i];
+                dp->nvy[i] = dp->kvy[6][i];
+
+                double r = std::max(std::sqrt(dp->x[i] * dp->x[i] + dp->y[i] * dp->y[i]), std::sqrt(dp->nx[i] * dp->nx[i] + dp->ny[i] * dp->ny[i]));
+                double v = std::max(std::sqrt(dp->vx[i] * dp->vx[i] + dp->vy[i] * dp->vy[i]), std::sqrt(dp->nvx[i] * dp->nvx[i] + dp->nvy[i] * dp->nvy[i]));
+                double positionError = h * std::sqrt(ex * ex + ey * ey) / (tolerance * (r + meanR));
+                double velocityError = h * std::sqrt(evx * evx + evy * evy) / (tolerance * (v + meanV));
+                error = std::max(error, std::max(positionError, velocityError));
+            }
+            workerError[worker] = error;
+        });
+
+        return *std::max_element(workerError.begin(), workerError.end());
+    }
+
+    // the double state is only kept while the bodies still hold its rounded copy,
+    // bodies moved by another integrator or edited in between start over from the floats
+    static bool inSync(const SimDormandPrince* dp, const SimBodies& bodies)
+    {
+        if (dp->count != bodies.count || dp->x.size() != bodies.count)
+            return false;
+
+        for (uint32_t i = 0; i < bodies.count; i++)
+        {
+            if ((float)dp->x[i] != bodies.x[i] || (float)dp->y[i] != bodies.y[i] || (float)dp->vx[i] != bodies.vx[i] || (float)dp->vy[i] != bodies.vy[i])
+                return false;
+        }
+
+        return true;
+    }
+
+    void resetDormandPrince(SimDormandPrince* dp)
+    {
+        dp->count = 0;
+        dp->step = 0.0;
+    }
+
+    uint64_t stepDormandPrince(SimDormandPrince* dp, SimBodies* bodies, double timeStep, double tolerance)
+    {
+        uint32_t count = bodies->count;
+        uint64_t evaluations = 0;
+        if (count == 0) return 0;
+
+        if (!inSync(dp, *bodies))
+        {
+            start(dp, *bodies, timeStep, tolerance);
+            evaluations += count;
+        }
+
+        double meanR, meanV;
+        meanScales(dp, &meanR, &meanV);
+        double minStep = SIM_DORMAND_PRINCE_MIN_STEP / bodies->units.time;
+
+        dp->steps = 0;
+        dp->minStep = timeStep;
+        dp->maxError = 0.0;
+
+        double now = 0.0;
+        bool rejected = false;
+        while (now < timeStep)
+        {
+            // land exactly on the end of the outer step, a shortened last step doesn't change the step size
+            double h = dp->step;
+            bool last = h >= timeStep - now;
+            if (last) h = timeStep - now;
+
+            double error = trialStep(dp, *bodies, h, tolerance, meanR, meanV);
+            evaluations += 6ull * count;
+
+            double factor = error > 0.0 ? 0.9 * std::pow(error, -0.2) : 5.0;
+            if (error > 1.0 && h > minStep)
+            {
+                dp->rejected++;
+                rejected = true;
+                dp->step = std::max(h * std::max(factor, 0.2), minStep);
+                continue;
+            }
+
+            std::swap(dp->x, dp->nx);
+            std::swap(dp->y, dp->ny);
+            std::swap(dp->vx, dp->nvx);
+            std::swap(dp->vy, dp->nvy);
+            std::swap(dp->kvx[0], dp->kvx[6]);
+            std::swap(dp->kvy[0], dp->kvy[6]);
+            std::swap(dp->kax[0], dp->kax[6]);
+            std::swap(dp->kay[0], dp->kay[6]);
+
+            dp->accepted++;
+            dp->steps++;
+            dp->minStep = std::min(dp->minStep, h);
+            dp->maxError = std::max(dp->maxError, error);
+
+            // no growth right after a rejection, it would only be rejected again
+            if (!last || h == dp->step)
+                dp->step = h * std::min(factor, rejected ? 1.0 : 5.0);
+            rejected = false;
+
+            now = last ? timeStep : now + h;
+        }
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            bodies->x[i] = (float)dp->x[i];
+            bodies->y[i] = (float)dp->y[i];
+            bodies->vx[i] = (float)dp->vx[i];
+            bodies->vy[i] = (float)dp->vy[i];
+        }
+
+        return evaluations;
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "bodies.h"
+
+// adaptive dormand-prince 5(4) runge-kutta with embedded error control
+// the step size follows a user tolerance on the local error instead of a fixed time step,
+// it shrinks at perihelion and close encounters and grows again on quiet stretches of the orbits
+// the outer time step is only the interval the integrator lands on, the state is kept in double
+// between outer steps as long as nothing else moves the bodies
+
+#define SIM_DORMAND_PRINCE_TOLERANCE 1e-9f /* default relative error per step */
+#define SIM_DORMAND_PRINCE_MIN_STEP 1e-3   /* smallest step (s), below it a step is accepted anyway */
+
+struct SimDormandPrince
+{
+    uint32_t count = 0; // bodies the state was set up for, the state is set up again when the bodies change
+    double step = 0.0;  // next step size, carried over between outer steps
+
+    // per body state and per stage velocity and acceleration, stage 0 is the acceleration at the current state
+    std::vector<double> x, y, vx, vy;
+    std::vector<double> sx, sy;            // stage positions
+    std::vector<double> kvx[7], kvy[7];    // stage velocities
+    std::vector<double> kax[7], kay[7];    // stage accelerations
+    std::vector<double> nx, ny, nvx, nvy;  // 5th order solution of the trial step
+
+    // statistics, accepted and rejected count since the last reset, the others of the last outer step
+    uint64_t accepted = 0;
+    uint64_t rejected = 0;
+    uint32_t steps = 0;
+    double minStep = 0.0;
+    double maxError = 0.0;
+};
+
+namespace sim
+{
+    // the next step sets the state up again from the bodies (after editing masses or velocities)
+    void resetDormandPrince(SimDormandPrince* dp);
+
+    // advances every body by timeStep (in the units of the bodies, like the step sizes above)
+    // with as many adaptive steps as the tolerance needs
+    // returns the number of single body force evaluations
+    uint64_t stepDormandPrince(SimDormandPrince* dp, SimBodies* bodies, double timeStep, double tolerance);
+}
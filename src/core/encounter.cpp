@@ -0,0 +1,401 @@
+#include "encounter.h"
+#include "precision.h"
+#include "thread_pool.h"
+
+#include <cmath>
+#include <complex>
+#include <numeric>
+#include <algorithm>
+
+typedef std::complex<double> Complex;
+
+namespace sim
+{
+    void findEncounters(SimEncounters* e, const SimBodies& bodies, float hill)
+    {
+        e->pairs.clear();
+        int32_t sun = findSun(bodies);
+        e->sun = sun;
+        uint32_t count = bodies.count;
+        if (hill <= 0.0f || sun < 0 || count < 3) return;
+
+        const float* x = bodies.x.data();
+        const float* y = bodies.y.data();
+        const float* mass = bodies.mass.data();
+
+        // hill radius d (m / 3 M)^(1/3) around the sun, the sun itself has no encounters
+        e->reach.resize(count);
+        double sunMass = mass[sun];
+        parallelFor(0, count, 4096, [&](uint32_t begin, uint32_t end, uint32_t worker)
+        {
+            for (uint32_t i = begin; i < end; i++)
+            {
+                double dx = (double)x[i] - x[sun];
+                double dy = (double)y[i] - y[sun];
+                e->reach[i] = i == (uint32_t)sun ? 0.0f : (float)(hill * std::sqrt(dx * dx + dy * dy) * std::cbrt(mass[i] / (3.0 * sunMass)));
+            }
+        });
+
+        e->order.resize(count);
+        std::iota(e->order.begin(), e->order.end(), 0u);
+        e->order.erase(e->order.begin() + sun);
+        std::sort(e->order.begin(), e->order.end(), [&](uint32_t a, uint32_t b) { return x[a] - e->reach[a] < x[b] - e->reach[b]; });
+
+        // sweep along x, the active bodies are the ones whose interval reaches the current left edge
+        e->active.clear();
+        e->candidates.clear();
+        for (uint32_t i : e->order)
+        {
+            float left = x[i] - e->reach[i];
+            size_t kept = 0;
+            for (uint32_t a : e->active)
+            {
+                if (x[a] + e->reach[a] >= left)
+                    e->active[kept++] = a;
+            }
+            e->active.resize(kept);
+
+            for (uint32_t a : e->active)
+            {
+                double dx = (double)x[a] - x[i];
+                double dy = (double)y[a] - y[i];
+                double limit = (double)e->reach[a] + e->reach[i];
+                double r2 = dx * dx + dy * dy;
+                if (r2 < limit * limit)
+                    e->candidates.push_back({ std::min(a, i), std::max(a, i), (float)(std::sqrt(r2) / limit) });
+            }
+
+            e->active.push_back(i);
+        }
+
+        // closest first, a body that is already in a pair stays with its closer partner
+        std::sort(e->candidates.begin(), e->candidates.end(), [](const SimEncounterCandidate& a, const SimEncounterCandidate& b)
+        {
+            if (a.distance != b.distance) return a.distance < b.distance;
+            return a.i != b.i ? a.i < b.i : a.j < b.j;
+        });
+
+        e->paired.assign(count, 0);
+        for (const SimEncounterCandidate& c : e->candidates)
+        {
+            if (e->pairs.size() == SIM_ENCOUNTER_MAX_PAIRS) break;
+            if (e->paired[c.i] || e->paired[c.j]) continue;
+
+            e->paired[c.i] = e->paired[c.j] = 1;
+            SimEncounterPair pair = {};
+            pair.i = c.i;
+            pair.j = c.j;
+            pair.mi = mass[c.i];
+            pair.mj = mass[c.j];
+            e->pairs.push_back(pair);
+        }
+    }
+
+    // state of the regularized two-body problem, u and its derivative u' in the fictitious time s, the energy h and the time t
+    struct LeviCivita
+    {
+        Complex u, du;
+        double h, t;
+    };
+
+    static inline LeviCivita madd(const LeviCivita& a, const LeviCivita& d, double ds)
+    {
+        return { a.u + ds * d.u, a.du + ds * d.du, a.h + ds * d.h, a.t + ds * d.t };
+    }
+
+    // 2u'' - h u = r conj(u) P, h' = 2 re(conj(u u') P), t' = r with z = u^2, r = |u|^2 and the perturbation P,
+    // the difference of the sun's pull on the two bodies plus the tidal field of the rest T z
+    static inline LeviCivita derivative(const LeviCivita& s, const SimEncounterPair& pair)
+    {
+        double r = std::norm(s.u);
+        Complex z = s.u * s.u;
+
+        // the linear tidal field of the sun is off by z / d, a few percent at a few hill radii
+        double fi = pair.mi / (pair.mi + pair.mj);
+        double t = s.t;
+        Complex d(pair.sx + (pair.svx + 0.5 * pair.sax * t) * t, pair.sy + (pair.svy + 0.5 * pair.say * t) * t);
+        Complex di = d - (1.0 - fi) * z;
+        Complex dj = d + fi * z;
+        double ri = std::abs(di), rj = std::abs(dj);
+        Complex perturbation = pair.sunMu * (di / (ri * ri * ri) - dj / (rj * rj * rj));
+        perturbation += Complex(pair.txx * z.real() + pair.txy * z.imag(), pair.txy * z.real() + pair.tyy * z.imag());
+
+        return { s.du, 0.5 * s.h * s.u + 0.5 * r * std::conj(s.u) * perturbation, 2.0 * std::real(std::conj(s.u * s.du) * perturbation), r };
+    }
+
+    // relative orbit of the pair over timeStep, classic runge-kutta in s, the last steps aim at t = timeStep
+    static uint32_t propagateLeviCivita(const SimEncounterPair& pair, double G, double timeStep, Complex* z, Complex* w)
+    {
+        double mu = G * (pair.mi + pair.mj);
+        double r0 = std::abs(*z);
+        if (r0 == 0.0 || mu <= 0.0)
+        {
+            *z += *w * timeStep;
+            return 0;
+        }
+
+        // u' = conj(u) w / 2 so that w = 2 u u' / r
+        LeviCivita s;
+        s.u = std::sqrt(*z);
+        s.du = 0.5 * std::conj(s.u) * *w;
+        s.h = 0.5 * std::norm(*w) - mu / r0;
+        s.t = 0.0;
+
+        // the oscillator frequency is sqrt(-h / 2) for bound orbits, mu / r0 keeps the step finite for parabolic ones
+        double ds = SIM_ENCOUNTER_ETA / std::sqrt(0.5 * std::fabs(s.h) + mu / r0);
+
+        uint32_t substeps = 0;
+        for (; substeps < SIM_ENCOUNTER_MAX_SUBSTEPS; substeps++)
+        {
+            double remaining = timeStep - s.t;
+            if (std::fabs(remaining) <= 1e-13 * timeStep) break;
+
+            // the step that ends the interval if r stayed the same, it converges like a newton iteration
+            double r = std::norm(s.u);
+            double step = r > 0.0 ? remaining / r : ds;
+            step = std::max(-ds, std::min(ds, step));
+
+            LeviCivita k1 = derivative(s, pair);
+            LeviCivita k2 = derivative(madd(s, k1, 0.5 * step), pair);
+            LeviCivita k3 = derivative(madd(s, k2, 0.5 * step), pair);
+            LeviCivita k4 = derivative(madd(s, k3, step), pair);
+
+            s.u += step / 6.0 * (k1.u + 2.0 * k2.u + 2.0 * k3.u + k4.u);
+            s.du += step / 6.0 * (k1.du + 2.0 * k2.du + 2.0 * k3.du + k4.du);
+            s.h += step / 6.0 * (k1.h + 2.0 * k2.h + 2.0 * k3.h + k4.h);
+            s.t += step / 6.0 * (k1.t + 2.0 * k2.t + 2.0 * k3.t + k4.t);
+        }
+
+        double r = std::norm(s.u);
+        *z = s.u * s.u;
+        if (r > 0.0)
+            *w = 2.0 * s.u * s.du / r;
+
+        return substeps;
+    }
+
+    // G m (x_k - (px, py)) / |x_k - (px, py)|^3 summed over every body but skip1 and skip2
+    template <typename P>
+    static Complex accelerationWithout(const SimBodies& bodies, const P* x, const P* y, double px, double py, uint32_t skip1, uint32_t skip2)
+    {
+        double ax = 0.0, ay = 0.0;
+        for (uint32_t k = 0; k < bodies.count; k++)
+        {
+            if (k == skip1 || k == skip2) continue;
+
+            double dx = value(x[k]) - px;
+            double dy = value(y[k]) - py;
+            double r2 = dx * dx + dy * dy;
+            if (r2 == 0.0) continue;
+
+            double s = bodies.mass[k] / (r2 * std::sqrt(r2));
+            ax += s * dx;
+            ay += s * dy;
+        }
+
+        return Complex(ax * bodies.units.G, ay * bodies.units.G);
+    }
+
+    template <typename P, typename V>
+    void beginEncounters(SimEncounters* e, const SimBodies& bodies, const P* x, const P* y, P* vx, P* vy)
+    {
+        double G = bodies.units.G;
+        parallelFor(0, (uint32_t)e->pairs.size(), 1, [&](uint32_t begin, uint32_t end, uint32_t worker)
+        {
+            for (uint32_t p = begin; p < end; p++)
+            {
+                SimEncounterPair& pair = e->pairs[p];
+                uint32_t i = pair.i, j = pair.j;
+                double m = pair.mi + pair.mj;
+                double fi = m > 0.0 ? pair.mi / m : 0.5;
+
+                pair.zx = value(x[j]) - value(x[i]);
+                pair.zy = value(y[j]) - value(y[i]);
+                pair.wx = value(vx[j]) - value(vx[i]);
+                pair.wy = value(vy[j]) - value(vy[i]);
+
+                double cx = fi * value(x[i]) + (1.0 - fi) * value(x[j]);
+                double cy = fi * value(y[i]) + (1.0 - fi) * value(y[j]);
+                double cvx = fi * value(vx[i]) + (1.0 - fi) * value(vx[j]);
+                double cvy = fi * value(vy[i]) + (1.0 - fi) * value(vy[j]);
+
+                // the center around the sun, on a parabola over the step
+                uint32_t sun = (uint32_t)e->sun;
+                pair.sunMu = G * bodies.mass[sun];
+                pair.sx = cx - value(x[sun]);
+                pair.sy = cy - value(y[sun]);
+                pair.svx = cvx - value(vx[sun]);
+                pair.svy = cvy - value(vy[sun]);
+                double s2 = pair.sx * pair.sx + pair.sy * pair.sy;
+                double sa = -G * (bodies.mass[sun] + m) / (s2 * std::sqrt(s2));
+                pair.sax = sa * pair.sx;
+                pair.say = sa * pair.sy;
+
+                // gradient of the field of the other bodies at the center, G m (3 d d^T - |d|^2 I) / |d|^5
+                double txx = 0.0, txy = 0.0, tyy = 0.0;
+                for (uint32_t k = 0; k < bodies.count; k++)
+                {
+                    if (k == i || k == j || k == sun) continue;
+
+                    double dx = value(x[k]) - cx;
+                    double dy = value(y[k]) - cy;
+                    double r2 = dx * dx + dy * dy;
+                    if (r2 == 0.0) continue;
+
+                    double s = bodies.mass[k] / (r2 * r2 * std::sqrt(r2));
+                    txx += s * (3.0 * dx * dx - r2);
+                    txy += s * (3.0 * dx * dy);
+                    tyy += s * (3.0 * dy * dy - r2);
+                }
+                pair.txx = txx * G;
+                pair.txy = txy * G;
+                pair.tyy = tyy * G;
+
+                // both drift with the center, the relative motion is the regularized orbit's
+                assign(&vx[i], cvx);
+                assign(&vy[i], cvy);
+                assign(&vx[j], cvx);
+                assign(&vy[j], cvy);
+            }
+        });
+    }
+
+    template <typename P, typename V>
+    void removePairForces(const SimEncounters& e, const SimBodies& bodies, const P* x, const P* y, V* ax, V* ay)
+    {
+        parallelFor(0, (uint32_t)e.pairs.size(), 1, [&](uint32_t begin, uint32_t end, uint32_t worker)
+        {
+            for (uint32_t p = begin; p < end; p++)
+            {
+                const SimEncounterPair& pair = e.pairs[p];
+                for (uint32_t b : { pair.i, pair.j })
+                {
+                    Complex a = accelerationWithout(bodies, x, y, value(x[b]), value(y[b]), pair.i, pair.j);
+                    ax[b] = (V)a.real();
+                    ay[b] = (V)a.imag();
+                }
+            }
+        });
+    }
+
+    // where the two bodies of a pair were after the integrator's step and where they are put
+    struct EncounterMove
+    {
+        double x0[2], y0[2];
+        double x1[2], y1[2];
+    };
+
+    template <typename P, typename V>
+    void endEncounters(SimEncounters* e, const SimBodies& bodies, double timeStep, P* x, P* y, P* vx, P* vy, V* ax, V* ay, bool forcesCurrent)
+    {
+        uint32_t pairCount = (uint32_t)e->pairs.size();
+        if (pairCount == 0) return;
+
+        double G = bodies.units.G;
+        std::vector<EncounterMove> moves(pairCount);
+
+        parallelFor(0, pairCount, 1, [&](uint32_t begin, uint32_t end, uint32_t worker)
+        {
+            for (uint32_t p = begin; p < end; p++)
+            {
+                SimEncounterPair& pair = e->pairs[p];
+                uint32_t i = pair.i, j = pair.j;
+                double m = pair.mi + pair.mj;
+                double fi = m > 0.0 ? pair.mi / m : 0.5;
+
+                Complex z(pair.zx, pair.zy), w(pair.wx, pair.wy);
+                pair.substeps = propagateLeviCivita(pair, G, timeStep, &z, &w);
+
+                // the step moved the center with the forces of the other bodies on both
+                EncounterMove& move = moves[p];
+                move.x0[0] = value(x[i]);
+                move.y0[0] = value(y[i]);
+                move.x0[1] = value(x[j]);
+                move.y0[1] = value(y[j]);
+                double cx = fi * move.x0[0] + (1.0 - fi) * move.x0[1];
+                double cy = fi * move.y0[0] + (1.0 - fi) * move.y0[1];
+                double cvx = fi * value(vx[i]) + (1.0 - fi) * value(vx[j]);
+                double cvy = fi * value(vy[i]) + (1.0 - fi) * value(vy[j]);
+
+                move.x1[0] = cx - (1.0 - fi) * z.real();
+                move.y1[0] = cy - (1.0 - fi) * z.imag();
+                move.x1[1] = cx + fi * z.real();
+                move.y1[1] = cy + fi * z.imag();
+
+                assign(&x[i], move.x1[0]);
+                assign(&y[i], move.y1[0]);
+                assign(&x[j], move.x1[1]);
+                assign(&y[j], move.y1[1]);
+                assign(&vx[i], cvx - (1.0 - fi) * w.real());
+                assign(&vy[i], cvy - (1.0 - fi) * w.imag());
+                assign(&vx[j], cvx + fi * w.real());
+                assign(&vy[j], cvy + fi * w.imag());
+            }
+        });
+
+        for (const SimEncounterPair& pair : e->pairs)
+            e->substeps += pair.substeps;
+        e->pairSteps += pairCount;
+
+        if (!forcesCurrent) return;
+
+        // the accelerations of the last drift are reused by the next kick: every other body feels
+        // the paired bodies where they are now, the paired bodies feel everything again
+        parallelFor(0, bodies.count, 1024, [&](uint32_t begin, uint32_t end, uint32_t worker)
+        {
+            for (uint32_t k = begin; k < end; k++)
+            {
+                if (e->paired[k]) continue;
+
+                double px = value(x[k]), py = value(y[k]);
+                double dax = 0.0, day = 0.0;
+                for (uint32_t p = 0; p < pairCount; p++)
+                {
+                    const SimEncounterPair& pair = e->pairs[p];
+                    const EncounterMove& move = moves[p];
+                    for (uint32_t b = 0; b < 2; b++)
+                    {
+                        double m = b == 0 ? pair.mi : pair.mj;
+                        double dx1 = move.x1[b] - px, dy1 = move.y1[b] - py;
+                        double dx0 = move.x0[b] - px, dy0 = move.y0[b] - py;
+                        double r1 = dx1 * dx1 + dy1 * dy1;
+                        double r0 = dx0 * dx0 + dy0 * dy0;
+                        double s1 = r1 > 0.0 ? m / (r1 * std::sqrt(r1)) : 0.0;
+                        double s0 = r0 > 0.0 ? m / (r0 * std::sqrt(r0)) : 0.0;
+                        dax += s1 * dx1 - s0 * dx0;
+                        day += s1 * dy1 - s0 * dy0;
+                    }
+                }
+
+                ax[k] += (V)(dax * G);
+                ay[k] += (V)(day * G);
+            }
+        });
+
+        parallelFor(0, pairCount, 1, [&](uint32_t begin, uint32_t end, uint32_t worker)
+        {
+            for (uint32_t p = begin; p < end; p++)
+            {
+                const SimEncounterPair& pair = e->pairs[p];
+                for (uint32_t b : { pair.i, pair.j })
+                {
+                    Complex a = accelerationWithout(bodies, x, y, value(x[b]), value(y[b]), b, b);
+                    ax[b] = (V)a.real();
+                    ay[b] = (V)a.imag();
+                }
+            }
+        });
+    }
+
+    template void beginEncounters<float, float>(SimEncounters*, const SimBodies&, const float*, const float*, float*, float*);
+    template void beginEncounters<SimKahan, float>(SimEncounters*, const SimBodies&, const SimKahan*, const SimKahan*, SimKahan*, SimKahan*);
+    template void beginEncounters<double, double>(SimEncounters*, const SimBodies&, const double*, const double*, double*, double*);
+
+    template void removePairForces<float, float>(const SimEncounters&, const SimBodies&, const float*, const float*, float*, float*);
+    template void removePairForces<SimKahan, float>(const SimEncounters&, const SimBodies&, const SimKahan*, const SimKahan*, float*, float*);
+    template void removePairForces<double, double>(const SimEncounters&, const SimBodies&, const double*, const double*, double*, double*);
+
+    template void endEncounters<float, float>(SimEncounters*, const SimBodies&, double, float*, float*, float*, float*, float*, float*, bool);
+    template void endEncounters<SimKahan, float>(SimEncounters*, const SimBodies&, double, SimKahan*, SimKahan*, SimKahan*, SimKahan*, float*, float*, bool);
+    template void endEncounters<double, double>(SimEncounters*, const SimBodies&, double, double*, double*, double*, double*, double*, double*, bool);
+}
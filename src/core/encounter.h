@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "bodies.h"
+
+// close encounters of two bodies in the splitting integrators, regularized with levi-civita coordinates
+// two bodies closer than settings.encounterHill times the sum of their hill radii are a pair for the step:
+// in the integrator's step the pair moves as its center of mass (both are kicked by the other bodies only
+// and drift with the velocity of the center), and the relative orbit is integrated on its own in the
+// coordinates z = u^2 with the fictitious time ds = dt / r, where the two-body problem is a harmonic
+// oscillator without the 1/r^2 singularity, perturbed by the sun (exactly, along a parabola of the center
+// over the step) and the tidal field of the other bodies at the center
+// a pair costs O(N) per step on top of the step, every other body keeps the large step
+
+#define SIM_ENCOUNTER_HILL 10.0f         /* encounter distance in hill radii, wider than the usual 3 as the steps here are days long */
+#define SIM_ENCOUNTER_MAX_PAIRS 256      /* closest pairs regularized in one step */
+#define SIM_ENCOUNTER_ETA 0.05           /* regularized step, fraction of the oscillator period / 2 pi */
+#define SIM_ENCOUNTER_MAX_SUBSTEPS 100000 /* regularized steps of one pair in one step */
+
+// a pair of the current step, i < j, relative values are body j minus body i
+struct SimEncounterPair
+{
+    uint32_t i, j;
+    double mi, mj;
+    double zx, zy, wx, wy;  // relative position and velocity at the start of the step
+    double sx, sy, svx, svy, sax, say; // center of mass relative to the sun at the start of the step, its velocity and acceleration
+    double sunMu;           // G times the mass of the sun
+    double txx, txy, tyy;   // tidal tensor of the bodies other than the sun at the center of mass
+    uint32_t substeps;      // regularized steps of the last step
+};
+
+// two bodies closer than their encounter distance, distance is in units of it
+struct SimEncounterCandidate
+{
+    uint32_t i, j;
+    float distance;
+};
+
+struct SimEncounters
+{
+    // detection of the last step, the bodies sorted by the left edge of their encounter interval
+    std::vector<float> reach;          // encounter radius of every body, 0 for the sun
+    std::vector<uint32_t> order;
+    std::vector<uint32_t> active;
+    std::vector<uint8_t> paired;
+    std::vector<SimEncounterCandidate> candidates;
+
+    std::vector<SimEncounterPair> pairs; // pairs of the current step, a body is in one at most
+    int32_t sun = -1;
+
+    // totals since the world was set up
+    uint64_t pairSteps = 0;  // steps of single pairs
+    uint64_t substeps = 0;   // regularized steps of all pairs
+};
+
+namespace sim
+{
+    // pairs closer than hill times the sum of their hill radii around the sun, closest first, none without a sun or with hill 0
+    // a sort and sweep along x, O(N log N)
+    void findEncounters(SimEncounters* encounters, const SimBodies& bodies, float hill);
+
+    // the functions below run on the state of a splitting integrator (the bodies themselves or a precision state)
+    // and are instantiated for the float, kahan and double states
+
+    // saves the relative orbit and the tidal field of every pair and gives both bodies the velocity of their center
+    template <typename P, typename V>
+    void beginEncounters(SimEncounters* encounters, const SimBodies& bodies, const P* x, const P* y, P* vx, P* vy);
+
+    // replaces the accelerations of the paired bodies with the ones from every other body
+    template <typename P, typename V>
+    void removePairForces(const SimEncounters& encounters, const SimBodies& bodies, const P* x, const P* y, V* ax, V* ay);
+
+    // moves the relative orbit of every pair by timeStep and places both bodies around where the step left their center,
+    // forcesCurrent accelerations are updated for the new places (O(N) per pair) so they can still be reused
+    template <typename P, typename V>
+    void endEncounters(SimEncounters* encounters, const SimBodies& bodies, double timeStep, P* x, P* y, P* vx, P* vy, V* ax, V* ay, bool forcesCurrent);
+}
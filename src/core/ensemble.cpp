@@ -0,0 +1,212 @@
+#include "ensemble.h"
+#include "gravity.h"
+#include "gravity_kernels.h"
+#include "thread_pool.h"
+
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+// SIM_SIMD_LEVEL is set by cmake (SIM_SIMD option): 0 scalar only, 1 sse2, 2 avx2, 3 avx512
+#ifndef SIM_SIMD_LEVEL
+#define SIM_SIMD_LEVEL 0
+#endif
+
+namespace sim
+{
+    // uniform in [-1, 1)
+    static double perturb(uint32_t* seed)
+    {
+        *seed = *seed * 1664525u + 1013904223u;
+        return (*seed >> 8) * (2.0 / 16777216.0) - 1.0;
+    }
+
+    void initEnsemble(SimEnsemble* ensemble, const SimBodies& bodies, uint32_t members, double perturbation, uint32_t seed)
+    {
+        uint32_t n = std::min(bodies.count, (uint32_t)SIM_ENSEMBLE_MAX_BODIES);
+        uint32_t stride = (members + SIM_ENSEMBLE_BLOCK - 1) / SIM_ENSEMBLE_BLOCK * SIM_ENSEMBLE_BLOCK;
+
+        ensemble->bodyCount = n;
+        ensemble->members = members;
+        ensemble->stride = stride;
+        ensemble->sun = findSun(bodies);
+        if (ensemble->sun >= (int32_t)n)
+            ensemble->sun = -1;
+        ensemble->units = bodies.units;
+        ensemble->time = 0.0;
+        ensemble->steps = 0;
+
+        ensemble->mass.assign(bodies.mass.begin(), bodies.mass.begin() + n);
+        ensemble->radius.assign(bodies.radius.begin(), bodies.radius.begin() + n);
+        ensemble->contact2.assign(n * n, 0.0f);
+        for (uint32_t i = 0; i < n; i++)
+        {
+            for (uint32_t j = 0; j < n; j++)
+            {
+                // bodies without a radius never touch
+                double contact = (double)bodies.radius[i] + bodies.radius[j];
+                ensemble->contact2[i * n + j] = contact > 0.0 ? (float)(1.0 / (contact * contact)) : std::numeric_limits<float>::infinity();
+            }
+        }
+
+        for (SimArray<float>* a : { &ensemble->x, &ensemble->y, &ensemble->vx, &ensemble->vy, &ensemble->ax, &ensemble->ay, &ensemble->maxEccentricity2 })
+            a->assign((size_t)n * stride, 0.0f);
+        ensemble->maxDistance2.assign(stride, 0.0f);
+        ensemble->minSeparation2.assign(stride, std::numeric_limits<float>::infinity());
+
+        double xs = 0.0, ys = 0.0, vxs = 0.0, vys = 0.0;
+        if (ensemble->sun >= 0)
+        {
+            xs = bodies.x[ensemble->sun];
+            ys = bodies.y[ensemble->sun];
+            vxs = bodies.vx[ensemble->sun];
+            vys = bodies.vy[ensemble->sun];
+        }
+
+        for (uint32_t i = 0; i < n; i++)
+        {
+            // relative to the sun in double, the perturbation of a far body would round away next to its position
+            double rx = bodies.x[i] - xs, ry = bodies.y[i] - ys;
+            double ux = bodies.vx[i] - vxs, uy = bodies.vy[i] - vys;
+            double r = std::sqrt(rx * rx + ry * ry);
+            double u = std::sqrt(ux * ux + uy * uy);
+
+            for (uint32_t m = 0; m < stride; m++)
+            {
+                size_t k = (size_t)i * stride + m;
+                double dx = 0.0, dy = 0.0, dvx = 0.0, dvy = 0.0;
+
+                // member 0 and the padding are the bodies as they are
+                if (m > 0 && m < members && (int32_t)i != ensemble->sun)
+                {
+                    dx = perturbation * r * perturb(&seed);
+                    dy = perturbation * r * perturb(&seed);
+                    dvx = perturbation * u * perturb(&seed);
+                    dvy = perturbation * u * perturb(&seed);
+                }
+
+                ensemble->x[k] = (float)(xs + rx + dx);
+                ensemble->y[k] = (float)(ys + ry + dy);
+                ensemble->vx[k] = (float)(vxs + ux + dvx);
+                ensemble->vy[k] = (float)(vys + uy + dvy);
+            }
+        }
+    }
+
+    void stepEnsemble(SimEnsemble* ensemble, SimIntegrator integrator, float timeStep, uint32_t steps)
+    {
+        if (ensemble->members == 0 || steps == 0)
+            return;
+
+        const SimIntegratorDesc* desc = &getIntegrator(integrator);
+        if (desc->stages == 0)
+            desc = &getIntegrator(Sim_Integrator_Leapfrog);
+
+        const SimUnits& units = ensemble->units;
+        double dt = timeStep / units.time;
+        uint32_t n = ensemble->bodyCount;
+
+        std::vector<float> invMu(n, 0.0f);
+        for (uint32_t i = 0; i < n && ensemble->sun >= 0; i++)
+        {
+            if ((int32_t)i != ensemble->sun)
+                invMu[i] = (float)(1.0 / (units.G * ((double)ensemble->mass[ensemble->sun] + ensemble->mass[i])));
+        }
+
+        SimEnsembleKernelArgs args;
+        args.x = ensemble->x.data();
+        args.y = ensemble->y.data();
+        args.vx = ensemble->vx.data();
+        args.vy = ensemble->vy.data();
+        args.ax = ensemble->ax.data();
+        args.ay = ensemble->ay.data();
+        args.mass = ensemble->mass.data();
+        args.contact2 = ensemble->contact2.data();
+        args.invMu = invMu.data();
+        args.maxDistance2 = ensemble->maxDistance2.data();
+        args.minSeparation2 = ensemble->minSeparation2.data();
+        args.maxEccentricity2 = ensemble->maxEccentricity2.data();
+        args.bodyCount = n;
+        args.stride = ensemble->stride;
+        args.steps = steps;
+        args.sun = ensemble->sun;
+        args.stages = desc->stages;
+        for (uint32_t k = 0; k < desc->stages; k++)
+            args.drift[k] = (float)(desc->drift[k] * dt);
+        for (uint32_t k = 0; k <= desc->stages; k++)
+            args.kick[k] = (float)(desc->kick[k] * dt * units.G);
+
+        SimKernel kernel = getKernel();
+        parallelFor(0, ensemble->stride / SIM_ENSEMBLE_BLOCK, 1, [&](uint32_t begin, uint32_t end, uint32_t worker)
+        {
+            uint32_t m0 = begin * SIM_ENSEMBLE_BLOCK, m1 = end * SIM_ENSEMBLE_BLOCK;
+            switch (kernel)
+            {
+#if SIM_SIMD_LEVEL >= 1
+            case Sim_Kernel_Sse2:   { sse2::ensemble(args, m0, m1); return; }
+#endif
+#if SIM_SIMD_LEVEL >= 2
+            case Sim_Kernel_Avx2:   { avx2::ensemble(args, m0, m1); return; }
+#endif
+#if SIM_SIMD_LEVEL >= 3
+            case Sim_Kernel_Avx512: { avx512::ensemble(args, m0, m1); return; }
+#endif
+            default: break;
+            }
+
+            ensembleKernel<SimdScalar>(args, m0, m1);
+        });
+
+        ensemble->time += (double)timeStep * steps;
+        ensemble->steps += steps;
+    }
+
+    SimEnsembleOutcome getEnsembleOutcome(const SimEnsemble& ensemble, uint32_t member, double ejectRadius)
+    {
+        SimEnsembleOutcome outcome = {};
+        uint32_t stride = ensemble.stride;
+
+        // a member that blew up has no finite positions left to take a distance from
+        bool finite = true;
+        for (uint32_t i = 0; i < ensemble.bodyCount; i++)
+        {
+            finite = finite && std::isfinite(ensemble.x[i * stride + member]) && std::isfinite(ensemble.y[i * stride + member]);
+
+            float e2 = ensemble.maxEccentricity2[i * stride + member];
+            if (e2 > outcome.maxEccentricity * outcome.maxEccentricity)
+            {
+                outcome.maxEccentricity = std::sqrt(e2);
+                outcome.body = i;
+            }
+        }
+
+        outcome.maxDistance = std::sqrt((double)ensemble.maxDistance2[member]) * ensemble.units.length;
+        outcome.minSeparation = std::sqrt(ensemble.minSeparation2[member]);
+        outcome.ejected = !finite || outcome.maxDistance > ejectRadius;
+        outcome.collided = outcome.minSeparation < 1.0f;
+        return outcome;
+    }
+
+    SimBody getEnsembleBody(const SimEnsemble& ensemble, uint32_t member, uint32_t body)
+    {
+        const SimUnits& units = ensemble.units;
+        float length = (float)units.length;
+        float speed = (float)(units.length / units.time);
+        size_t k = (size_t)body * ensemble.stride + member;
+
+        SimBody result = {};
+        result.mass = (float)(ensemble.mass[body] * units.mass);
+        result.pos = { ensemble.x[k] * length, ensemble.y[k] * length };
+        result.vel = { ensemble.vx[k] * speed, ensemble.vy[k] * speed };
+        result.sun = (int32_t)body == ensemble.sun;
+        result.radius = ensemble.radius[body] * length;
+
+        if (ensemble.sun >= 0)
+        {
+            size_t s = (size_t)ensemble.sun * ensemble.stride + member;
+            result.distance = std::hypot(ensemble.x[k] - ensemble.x[s], ensemble.y[k] - ensemble.y[s]) * length;
+        }
+
+        return result;
+    }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "bodies.h"
+#include "integrator.h"
+
+// ensembles of small systems (the ten bodies of the solar system) run thousands of times from perturbed initial conditions
+// a single run of ten bodies has nothing to split between threads or vector lanes, so here a lane is a member:
+// every array is [body * stride + member], a vector of members goes through all its steps with its state in l1
+// and blocks of members are spread over the worker threads
+// the members move with a splitting integrator in float, every step records the largest distance of a body from the
+// sun, the closest approach of every pair relative to the sum of their radii and the largest eccentricity of every body
+
+#define SIM_ENSEMBLE_BLOCK 64            /* members of one task, a multiple of the widest vector */
+#define SIM_ENSEMBLE_MAX_BODIES 32       /* bodies of one member */
+#define SIM_ENSEMBLE_EJECT_RADIUS (100.0 * AU) /* default distance from the sun (m) a member counts as ejected at */
+
+struct SimEnsemble
+{
+    uint32_t bodyCount = 0;   // bodies of every member
+    uint32_t members = 0;
+    uint32_t stride = 0;      // members rounded up to SIM_ENSEMBLE_BLOCK, the padding lanes are copies of member 0
+    int32_t sun = -1;         // eccentricities and distances are relative to it, -1 without one
+    SimUnits units;
+
+    // [body * stride + member] in the units of the bodies
+    SimArray<float> x, y, vx, vy, ax, ay;
+
+    // the same for every member
+    std::vector<float> mass;      // [body]
+    std::vector<float> radius;    // [body]
+    std::vector<float> contact2;  // [i * bodyCount + j], 1 / (r_i + r_j)^2
+
+    // outcomes since initEnsemble
+    SimArray<float> maxDistance2;     // [member], largest squared distance of any body from the sun
+    SimArray<float> minSeparation2;   // [member], smallest squared pair distance over squared sum of radii, below 1 is a collision
+    SimArray<float> maxEccentricity2; // [body * stride + member]
+
+    double time = 0.0;  // seconds
+    uint64_t steps = 0;
+};
+
+// pointers into an ensemble for the kernels (gravity_kernels.h), the drift coefficients include dt and the kicks dt and G
+struct SimEnsembleKernelArgs
+{
+    float* x;
+    float* y;
+    float* vx;
+    float* vy;
+    float* ax;
+    float* ay;
+    const float* mass;       // [body]
+    const float* contact2;
+    const float* invMu;      // [body], 1 / (G (m_sun + m_body)) for the eccentricities, 0 for the sun
+    float* maxDistance2;
+    float* minSeparation2;
+    float* maxEccentricity2;
+    uint32_t bodyCount, stride, steps;
+    int32_t sun;
+    uint32_t stages;
+    float drift[SIM_SPLITTING_MAX_STAGES];
+    float kick[SIM_SPLITTING_MAX_STAGES + 1];
+};
+
+struct SimEnsembleOutcome
+{
+    bool ejected;           // a body went further than the eject radius from the sun
+    bool collided;          // two bodies came closer than the sum of their radii
+    float maxEccentricity;  // largest eccentricity of any body around the sun
+    uint32_t body;          // body with that eccentricity
+    double maxDistance;     // meters
+    float minSeparation;    // closest approach of any pair in sums of their radii
+};
+
+namespace sim
+{
+    // members copies of the bodies, member 0 is exact and the others get every position and velocity relative to the sun
+    // moved by up to perturbation times its magnitude (uniform in a square), at most SIM_ENSEMBLE_MAX_BODIES bodies
+    void initEnsemble(SimEnsemble* ensemble, const SimBodies& bodies, uint32_t members, double perturbation, uint32_t seed = 1);
+
+    // every member steps times timeStep seconds with a splitting integrator (the others fall back to leapfrog, the
+    // headless runner refuses them)
+    // using the vector width of the selected kernel
+    void stepEnsemble(SimEnsemble* ensemble, SimIntegrator integrator, float timeStep, uint32_t steps);
+
+    SimEnsembleOutcome getEnsembleOutcome(const SimEnsemble& ensemble, uint32_t member, double ejectRadius = SIM_ENSEMBLE_EJECT_RADIUS);
+
+    // body of a member in si units
+    SimBody getEnsembleBody(const SimEnsemble& ensemble, uint32_t member, uint32_t body);
+}
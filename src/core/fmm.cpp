@@ -0,0 +1,506 @@
+#include "fmm.h"
+#include "simulation.h"
+#include "thread_pool.h"
+
+#include <cmath>
+#include <algorithm>
+
+// the gravity of the plane is still 3d (1/r potential), which is not the real part of an analytic function,
+// so the expansions are cartesian taylor series of 1/r with multi indices k = (kx, ky) instead of complex series
+//
+//   phi(x) = sum_k M_k D_k(x - c),   M_k = sum_j m_j (y_j - c)^k / k!,   D_k(r) = d^k/dc^k 1/|x - c|
+//   phi(x) = sum_n L_n (x - c)^n / n!   (local expansion)
+//
+// with the factorials in the coefficients every translation is a plain sum of products (no binomials),
+// the D_k come from the recurrence of Duan & Krasny, which stays in the plane when the z components are 0
+
+struct FmmFactorials
+{
+    double factorial[SIM_FMM_MAX_ORDER + 1];
+    double inverse[SIM_FMM_MAX_ORDER + 1];
+};
+
+struct FmmPass
+{
+    const SimQuadtree* tree;
+    SimFmm* fmm;
+    const FmmFactorials* factorials;
+    uint32_t order;
+    double theta;
+    double ox, oy, scale; // scaled position = (position - o) * scale
+};
+
+namespace sim
+{
+    static inline uint32_t coefficientIndex(uint32_t a, uint32_t b)
+    {
+        uint32_t n = a + b;
+        return n * (n + 1) / 2 + b;
+    }
+
+    static inline uint32_t coefficientCount(uint32_t order)
+    {
+        return (order + 1) * (order + 2) / 2;
+    }
+
+    static FmmFactorials makeFactorials()
+    {
+        FmmFactorials table{};
+        table.factorial[0] = 1.0;
+        for (uint32_t n = 1; n <= SIM_FMM_MAX_ORDER; n++)
+            table.factorial[n] = table.factorial[n - 1] * n;
+
+        for (uint32_t n = 0; n <= SIM_FMM_MAX_ORDER; n++)
+            table.inverse[n] = 1.0 / table.factorial[n];
+
+        return table;
+    }
+
+    static const FmmFactorials& getFactorials()
+    {
+        static const FmmFactorials table = makeFactorials();
+        return table;
+    }
+
+    // D[k] for |k| <= order with r = x - c, the recurrence runs on the taylor coefficients b_k = D_k / k!
+    static void derivatives(const FmmFactorials& factorials, double rx, double ry, uint32_t order, double* b)
+    {
+        double invr2 = 1.0 / (rx * rx + ry * ry);
+        b[0] = std::sqrt(invr2);
+
+        for (uint32_t n = 1; n <= order; n++)
+        {
+            double c1 = 2.0 - 1.0 / n;
+            double c2 = 1.0 - 1.0 / n;
+
+            for (uint32_t ky = 0; ky <= n; ky++)
+            {
+                uint32_t kx = n - ky;
+                double v = 0.0;
+                if (kx >= 1) v += c1 * rx * b[coefficientIndex(kx - 1, ky)];
+                if (ky >= 1) v += c1 * ry * b[coefficientIndex(kx, ky - 1)];
+                if (kx >= 2) v -= c2 * b[coefficientIndex(kx - 2, ky)];
+                if (ky >= 2) v -= c2 * b[coefficientIndex(kx, ky - 2)];
+                b[coefficientIndex(kx, ky)] = v * invr2;
+            }
+        }
+
+        for (uint32_t n = 1; n <= order; n++)
+        {
+            for (uint32_t ky = 0; ky <= n; ky++)
+                b[coefficientIndex(n - ky, ky)] *= factorials.factorial[n - ky] * factorials.factorial[ky];
+        }
+    }
+
+    // p[i] = v^i / i!
+    static void scaledPowers(const FmmFactorials& factorials, double v, uint32_t order, double* p)
+    {
+        double power = 1.0;
+        for (uint32_t i = 0; i <= order; i++)
+        {
+            p[i] = power * factorials.inverse[i];
+            power *= v;
+        }
+    }
+
+    static inline double scaledComX(const FmmPass& pass, const SimQuadNode& node) { return (node.comx - pass.ox) * pass.scale; }
+    static inline double scaledComY(const FmmPass& pass, const SimQuadNode& node) { return (node.comy - pass.oy) * pass.scale; }
+
+    // multipole of a leaf from its bodies (P2M), of the other nodes from their children (M2M)
+    static void computeMultipole(FmmPass& pass, uint32_t nodeIndex)
+    {
+        const SimQuadtree& tree = *pass.tree;
+        SimFmm& fmm = *pass.fmm;
+        const FmmFactorials& factorials = *pass.factorials;
+        uint32_t order = pass.order;
+        double px[SIM_FMM_MAX_ORDER + 1], py[SIM_FMM_MAX_ORDER + 1];
+
+        const SimQuadNode& node = tree.nodes[nodeIndex];
+        double* m = &fmm.multipoles[(size_t)nodeIndex * fmm.coefficients];
+        double cx = scaledComX(pass, node);
+        double cy = scaledComY(pass, node);
+
+        std::fill(m, m + fmm.coefficients, 0.0);
+
+        if (isLeaf(node))
+        {
+            for (uint32_t k = node.begin; k < node.end; k++)
+            {
+                scaledPowers(factorials, fmm.x[k] - cx, order, px);
+                scaledPowers(factorials, fmm.y[k] - cy, order, py);
+
+                for (uint32_t n = 0; n <= order; n++)
+                {
+                    for (uint32_t ky = 0; ky <= n; ky++)
+                        m[coefficientIndex(n - ky, ky)] += fmm.mass[k] * px[n - ky] * py[ky];
+                }
+            }
+            return;
+        }
+
+        for (uint32_t c = node.firstChild; c < node.firstChild + node.childCount; c++)
+        {
+            const SimQuadNode& child = tree.nodes[c];
+            const double* mc = &fmm.multipoles[(size_t)c * fmm.coefficients];
+            scaledPowers(factorials, scaledComX(pass, child) - cx, order, px);
+            scaledPowers(factorials, scaledComY(pass, child) - cy, order, py);
+
+            // M_k += sum_{j <= k} Mc_j s^(k - j) / (k - j)!
+            for (uint32_t n = 0; n <= order; n++)
+            {
+                for (uint32_t ky = 0; ky <= n; ky++)
+                {
+                    uint32_t kx = n - ky;
+                    double sum = 0.0;
+                    for (uint32_t jx = 0; jx <= kx; jx++)
+                    {
+                        for (uint32_t jy = 0; jy <= ky; jy++)
+                            sum += mc[coefficientIndex(jx, jy)] * px[kx - jx] * py[ky - jy];
+                    }
+                    m[coefficientIndex(kx, ky)] += sum;
+                }
+            }
+        }
+    }
+
+    // local expansion of target from the multipole of source (M2L)
+    static void localFromMultipole(FmmPass& pass, uint32_t target, uint32_t source)
+    {
+        const SimQuadtree& tree = *pass.tree;
+        SimFmm& fmm = *pass.fmm;
+        uint32_t order = pass.order;
+
+        const double* m = &fmm.multipoles[(size_t)source * fmm.coefficients];
+        double* l = &fmm.locals[(size_t)target * fmm.coefficients];
+
+        double rx = (tree.nodes[target].comx - tree.nodes[source].comx) * pass.scale;
+        double ry = (tree.nodes[target].comy - tree.nodes[source].comy) * pass.scale;
+
+        double d[(SIM_FMM_MAX_ORDER + 1) * (SIM_FMM_MAX_ORDER + 2) / 2];
+        derivatives(*pass.factorials, rx, ry, order, d);
+
+        // L_n += (-1)^|n| sum_k D_(k + n)(r) M_k, the coefficients of one degree are contiguous in ky
+        // so all L_n of degree n are summed at once, the inner loop has no dependency between iterations
+        double sum[SIM_FMM_MAX_ORDER + 1];
+        for (uint32_t n = 0; n <= order; n++)
+        {
+            std::fill(sum, sum + n + 1, 0.0);
+
+            for (uint32_t k = 0; k + n <= order; k++)
+            {
+                const double* dk = d + coefficientIndex(k + n, 0);
+                const double* mk = m + coefficientIndex(k, 0);
+                for (uint32_t ky = 0; ky <= k; ky++)
+                {
+                    for (uint32_t ny = 0; ny <= n; ny++)
+                        sum[ny] += mk[ky] * dk[ky + ny];
+                }
+            }
+
+            double* ln = l + coefficientIndex(n, 0);
+            for (uint32_t ny = 0; ny <= n; ny++)
+                ln[ny] += (n & 1) ? -sum[ny] : sum[ny];
+        }
+    }
+
+    // direct sum of the bodies of the source leaf on the bodies of the target leaf (P2P)
+    static void bodiesFromBodies(FmmPass& pass, const SimQuadNode& target, const SimQuadNode& source)
+    {
+        SimFmm& fmm = *pass.fmm;
+
+        for (uint32_t i = target.begin; i < target.end; i++)
+        {
+            double axi = 0.0, ayi = 0.0;
+            for (uint32_t j = source.begin; j < source.end; j++)
+            {
+                double dx = fmm.x[j] - fmm.x[i];
+                double dy = fmm.y[j] - fmm.y[i];
+                double r2 = dx * dx + dy * dy;
+
+                // branch free so the loop vectorizes, the body itself (r2 = 0) adds nothing
+                double s = r2 > 0.0 ? fmm.mass[j] / (r2 * std::sqrt(r2)) : 0.0;
+                axi += s * dx;
+                ayi += s * dy;
+            }
+
+            fmm.ax[i] += axi;
+            fmm.ay[i] += ayi;
+        }
+    }
+
+    // the traversal only collects the interacting pairs, they are evaluated per target node afterwards
+    static void interact(FmmPass& pass, uint32_t a, uint32_t b)
+    {
+        const SimQuadtree& tree = *pass.tree;
+        SimFmm& fmm = *pass.fmm;
+        const SimQuadNode& nodeA = tree.nodes[a];
+        const SimQuadNode& nodeB = tree.nodes[b];
+
+        double dx = nodeA.comx - nodeB.comx;
+        double dy = nodeA.comy - nodeB.comy;
+        double reach = nodeA.radius + nodeB.radius;
+
+        if (reach * reach < pass.theta * pass.theta * (dx * dx + dy * dy))
+        {
+            fmm.farPairs.push_back(a);
+            fmm.farPairs.push_back(b);
+            return;
+        }
+
+        bool leafA = isLeaf(nodeA);
+        bool leafB = isLeaf(nodeB);
+        if (leafA && leafB)
+        {
+            fmm.nearPairs.push_back(a);
+            fmm.nearPairs.push_back(b);
+            return;
+        }
+
+        // split the bigger cell
+        if (leafB || (!leafA && nodeA.radius >= nodeB.radius))
+        {
+            for (uint32_t c = nodeA.firstChild; c < nodeA.firstChild + nodeA.childCount; c++)
+                interact(pass, c, b);
+        }
+        else
+        {
+            for (uint32_t c = nodeB.firstChild; c < nodeB.firstChild + nodeB.childCount; c++)
+                interact(pass, a, c);
+        }
+    }
+
+    static void interactSelf(FmmPass& pass, uint32_t a)
+    {
+        const SimQuadNode& node = pass.tree->nodes[a];
+        if (isLeaf(node))
+        {
+            pass.fmm->nearPairs.push_back(a);
+            pass.fmm->nearPairs.push_back(a);
+            return;
+        }
+
+        for (uint32_t c = node.firstChild; c < node.firstChild + node.childCount; c++)
+        {
+            interactSelf(pass, c);
+            for (uint32_t d = c + 1; d < node.firstChild + node.childCount; d++)
+                interact(pass, c, d);
+        }
+    }
+
+    // every pair (a, b) acts in both directions, sorts the sources by target node
+    static void buildInteractionList(const std::vector<uint32_t>& pairs, uint32_t nodeCount, std::vector<uint32_t>* start, std::vector<uint32_t>* sources)
+    {
+        start->assign(nodeCount + 1, 0);
+        for (size_t p = 0; p < pairs.size(); p += 2)
+        {
+            (*start)[pairs[p] + 1]++;
+            if (pairs[p] != pairs[p + 1])
+                (*start)[pairs[p + 1] + 1]++;
+        }
+
+        for (uint32_t n = 0; n < nodeCount; n++)
+            (*start)[n + 1] += (*start)[n];
+
+        std::vector<uint32_t> cursor(start->begin(), start->end() - 1);
+        sources->resize(start->back());
+        for (size_t p = 0; p < pairs.size(); p += 2)
+        {
+            (*sources)[cursor[pairs[p]]++] = pairs[p + 1];
+            if (pairs[p] != pairs[p + 1])
+                (*sources)[cursor[pairs[p + 1]]++] = pairs[p];
+        }
+    }
+
+    // locals of the children from their parent (L2L), the locals of the leaves are evaluated at their bodies (L2P)
+    static void evaluateLocal(FmmPass& pass, uint32_t nodeIndex)
+    {
+        const SimQuadtree& tree = *pass.tree;
+        SimFmm& fmm = *pass.fmm;
+        const FmmFactorials& factorials = *pass.factorials;
+        uint32_t order = pass.order;
+        double px[SIM_FMM_MAX_ORDER + 1], py[SIM_FMM_MAX_ORDER + 1];
+
+        const SimQuadNode& node = tree.nodes[nodeIndex];
+        const double* l = &fmm.locals[(size_t)nodeIndex * fmm.coefficients];
+        double cx = scaledComX(pass, node);
+        double cy = scaledComY(pass, node);
+
+        if (isLeaf(node))
+        {
+            // grad phi = sum_n L_n (t^(n - ex) / (n - ex)!, t^(n - ey) / (n - ey)!)
+            for (uint32_t k = node.begin; k < node.end; k++)
+            {
+                scaledPowers(factorials, fmm.x[k] - cx, order, px);
+                scaledPowers(factorials, fmm.y[k] - cy, order, py);
+
+                double gx = 0.0, gy = 0.0;
+                for (uint32_t n = 1; n <= order; n++)
+                {
+                    for (uint32_t ny = 0; ny <= n; ny++)
+                    {
+                        uint32_t nx = n - ny;
+                        double ln = l[coefficientIndex(nx, ny)];
+                        if (nx > 0) gx += ln * px[nx - 1] * py[ny];
+                        if (ny > 0) gy += ln * px[nx] * py[ny - 1];
+                    }
+                }
+
+                fmm.ax[k] += gx;
+                fmm.ay[k] += gy;
+            }
+            return;
+        }
+
+        for (uint32_t c = node.firstChild; c < node.firstChild + node.childCount; c++)
+        {
+            double* lc = &fmm.locals[(size_t)c * fmm.coefficients];
+            scaledPowers(factorials, scaledComX(pass, tree.nodes[c]) - cx, order, px);
+            scaledPowers(factorials, scaledComY(pass, tree.nodes[c]) - cy, order, py);
+
+            // Lc_j += sum_{n >= j} L_n s^(n - j) / (n - j)!
+            for (uint32_t j = 0; j <= order; j++)
+            {
+                for (uint32_t jy = 0; jy <= j; jy++)
+                {
+                    uint32_t jx = j - jy;
+                    double sum = 0.0;
+                    for (uint32_t n = j; n <= order; n++)
+                    {
+                        for (uint32_t ny = jy; ny <= n - jx; ny++)
+                        {
+                            uint32_t nx = n - ny;
+                            sum += l[coefficientIndex(nx, ny)] * px[nx - jx] * py[ny - jy];
+                        }
+                    }
+                    lc[coefficientIndex(jx, jy)] += sum;
+                }
+            }
+        }
+    }
+
+    static void sortByLevel(const SimQuadtree& tree, SimFmm* fmm)
+    {
+        uint32_t nodeCount = (uint32_t)tree.nodes.size();
+        fmm->depth.assign(nodeCount, 0);
+
+        uint32_t levels = 1;
+        for (uint32_t n = 0; n < nodeCount; n++)
+        {
+            const SimQuadNode& node = tree.nodes[n];
+            for (uint32_t c = node.firstChild; c < node.firstChild + node.childCount; c++)
+            {
+                fmm->depth[c] = fmm->depth[n] + 1;
+                levels = std::max(levels, fmm->depth[c] + 1);
+            }
+        }
+
+        fmm->levelStart.assign(levels + 1, 0);
+        for (uint32_t n = 0; n < nodeCount; n++)
+            fmm->levelStart[fmm->depth[n] + 1]++;
+        for (uint32_t level = 0; level < levels; level++)
+            fmm->levelStart[level + 1] += fmm->levelStart[level];
+
+        std::vector<uint32_t> cursor(fmm->levelStart.begin(), fmm->levelStart.end() - 1);
+        fmm->levelNodes.resize(nodeCount);
+        for (uint32_t n = 0; n < nodeCount; n++)
+            fmm->levelNodes[cursor[fmm->depth[n]]++] = n;
+    }
+
+    void computeAccelerationsFmm(SimFmm* fmm, SimQuadtree* tree, const SimBodies& bodies, uint32_t order, float theta, float* ax, float* ay)
+    {
+        uint32_t count = bodies.count;
+        if (count == 0) return;
+
+        order = std::max(1u, std::min(order, (uint32_t)SIM_FMM_MAX_ORDER));
+        buildQuadtree(tree, bodies, SIM_FMM_LEAF_SIZE);
+
+        const SimQuadNode& root = tree->nodes[0];
+
+        FmmPass pass;
+        pass.tree = tree;
+        pass.fmm = fmm;
+        pass.factorials = &getFactorials();
+        pass.order = order;
+        pass.theta = theta;
+        pass.ox = root.cx;
+        pass.oy = root.cy;
+        pass.scale = 1.0 / root.halfSize;
+
+        // work in units of the root cell so the high order terms stay in range
+        uint32_t nodeCount = (uint32_t)tree->nodes.size();
+        fmm->order = order;
+        fmm->coefficients = coefficientCount(order);
+        fmm->multipoles.resize((size_t)nodeCount * fmm->coefficients);
+        fmm->locals.assign((size_t)nodeCount * fmm->coefficients, 0.0);
+        fmm->x.resize(count);
+        fmm->y.resize(count);
+        fmm->mass.resize(count);
+        fmm->ax.assign(count, 0.0);
+        fmm->ay.assign(count, 0.0);
+
+        parallelFor(0, count, 4096, [&](uint32_t begin, uint32_t end, uint32_t worker)
+        {
+            for (uint32_t k = begin; k < end; k++)
+            {
+                uint32_t i = tree->order[k];
+                fmm->x[k] = (bodies.x[i] - pass.ox) * pass.scale;
+                fmm->y[k] = (bodies.y[i] - pass.oy) * pass.scale;
+                fmm->mass[k] = bodies.mass[i];
+            }
+        });
+
+        sortByLevel(*tree, fmm);
+        uint32_t levels = (uint32_t)fmm->levelStart.size() - 1;
+
+        // upward pass, deepest level first
+        for (uint32_t level = levels; level-- > 0;)
+        {
+            parallelFor(fmm->levelStart[level], fmm->levelStart[level + 1], 16, [&](uint32_t begin, uint32_t end, uint32_t worker)
+            {
+                for (uint32_t k = begin; k < end; k++)
+                    computeMultipole(pass, fmm->levelNodes[k]);
+            });
+        }
+
+        fmm->farPairs.clear();
+        fmm->nearPairs.clear();
+        interactSelf(pass, 0);
+        buildInteractionList(fmm->farPairs, nodeCount, &fmm->farStart, &fmm->farSources);
+        buildInteractionList(fmm->nearPairs, nodeCount, &fmm->nearStart, &fmm->nearSources);
+
+        // every target only writes its own local and bodies, near leaves cost more than far cells so the chunks are small
+        parallelFor(0, nodeCount, 8, [&](uint32_t begin, uint32_t end, uint32_t worker)
+        {
+            for (uint32_t n = begin; n < end; n++)
+            {
+                for (uint32_t s = fmm->farStart[n]; s < fmm->farStart[n + 1]; s++)
+                    localFromMultipole(pass, n, fmm->farSources[s]);
+
+                for (uint32_t s = fmm->nearStart[n]; s < fmm->nearStart[n + 1]; s++)
+                    bodiesFromBodies(pass, tree->nodes[n], tree->nodes[fmm->nearSources[s]]);
+            }
+        });
+
+        // downward pass, root first
+        for (uint32_t level = 0; level < levels; level++)
+        {
+            parallelFor(fmm->levelStart[level], fmm->levelStart[level + 1], 16, [&](uint32_t begin, uint32_t end, uint32_t worker)
+            {
+                for (uint32_t k = begin; k < end; k++)
+                    evaluateLocal(pass, fmm->levelNodes[k]);
+            });
+        }
+
+        // 1/|x - y| = scale / |x' - y'| so the gradient picks up scale^2
+        double factor = bodies.units.G * pass.scale * pass.scale;
+        parallelFor(0, count, 4096, [&](uint32_t begin, uint32_t end, uint32_t worker)
+        {
+            for (uint32_t k = begin; k < end; k++)
+            {
+                uint32_t i = tree->order[k];
+                ax[i] = (float)(factor * fmm->ax[k]);
+                ay[i] = (float)(factor * fmm->ay[k]);
+            }
+        });
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "bodies.h"
+#include "quadtree.h"
+
+// fast multipole gravity, cartesian taylor expansions of 1/r up to a configurable order
+// with a dual tree traversal over the quadtree, O(N) for a fixed order and opening angle
+
+#define SIM_FMM_MAX_ORDER 16 /* highest supported expansion order */
+#define SIM_FMM_LEAF_SIZE 32 /* max bodies in a leaf, leaves interact directly */
+
+struct SimFmm
+{
+    uint32_t order;                 // order of the last pass
+    uint32_t coefficients;          // coefficients per expansion, (order + 1) (order + 2) / 2
+    std::vector<double> multipoles; // per node, about the node's center of mass
+    std::vector<double> locals;     // per node, about the node's center of mass
+
+    // bodies in tree order, scaled to the root cell
+    std::vector<double> x, y, mass, ax, ay;
+
+    // nodes sorted by depth, the nodes of one level are independent in the upward and downward passes
+    std::vector<uint32_t> levelNodes, levelStart, depth;
+
+    // interacting node pairs of the traversal, and per target node the sources it interacts with
+    // (farSources[farStart[n], farStart[n + 1]) through expansions, nearSources directly)
+    std::vector<uint32_t> farPairs, nearPairs;
+    std::vector<uint32_t> farStart, farSources, nearStart, nearSources;
+};
+
+namespace sim
+{
+    // builds the tree and computes the acceleration of every body
+    // cells interact through their expansions when (radius a + radius b) < theta * distance
+    void computeAccelerationsFmm(SimFmm* fmm, SimQuadtree* tree, const SimBodies& bodies, uint32_t order, float theta, float* ax, float* ay);
+}
@@ -0,0 +1,604 @@
+#include "gravity.h"
+#include "gravity_kernels.h"
+#include "cpu.h"
+#include "simulation.h"
+#include "thread_pool.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// SIM_SIMD_LEVEL is set by cmake (SIM_SIMD option): 0 scalar only, 1 sse2, 2 avx2, 3 avx512
+#ifndef SIM_SIMD_LEVEL
+#define SIM_SIMD_LEVEL 0
+#endif
+
+static SimKernel s_Kernel = sim::getStartupKernel();
+static bool s_SmallKernels = true;
+
+// per worker (or per slot in the deterministic mode) accumulators of the pairwise pass, a tile also writes to the rows of other tiles
+// one set per calling thread so worlds can step side by side (sweep.h), the passes bind the caller's set before their tasks
+static thread_local std::vector<SimArray<float>> s_WorkerAx, s_WorkerAy;
+static thread_local std::vector<double> s_WorkerPotential;
+
+// per body sums of m_j / r of the float state pass, added up in body order
+static thread_local std::vector<double> s_BodyPotential;
+
+// the double state pass, its positions and masses padded like the bodies and one accumulator per reduction slot
+static thread_local SimArray<double> s_StateX, s_StateY, s_StateMass;
+static thread_local std::vector<SimArray<double>> s_SlotAx, s_SlotAy;
+static thread_local std::vector<double> s_SlotPotential;
+
+namespace sim
+{
+    const char* getKernelName(SimKernel kernel)
+    {
+        switch (kernel)
+        {
+        case Sim_Kernel_Reference: { return "reference"; }
+        case Sim_Kernel_Scalar:    { return "scalar"; }
+        case Sim_Kernel_Sse2:      { return "sse2"; }
+        case Sim_Kernel_Avx2:      { return "avx2"; }
+        case Sim_Kernel_Avx512:    { return "avx512"; }
+        default: break;
+        }
+
+        return "unknown";
+    }
+
+    bool isKernelCompiled(SimKernel kernel)
+    {
+        switch (kernel)
+        {
+        case Sim_Kernel_Reference: { return true; }
+        case Sim_Kernel_Scalar:    { return true; }
+        case Sim_Kernel_Sse2:      { return SIM_SIMD_LEVEL >= 1; }
+        case Sim_Kernel_Avx2:      { return SIM_SIMD_LEVEL >= 2; }
+        case Sim_Kernel_Avx512:    { return SIM_SIMD_LEVEL >= 3; }
+        default: break;
+        }
+
+        return false;
+    }
+
+    bool isKernelAvailable(SimKernel kernel)
+    {
+        if (!isKernelCompiled(kernel))
+            return false;
+
+        // the flags the kernels are compiled with (cmake SIM_FLAGS_*)
+        const SimCpuFeatures& cpu = getCpuFeatures();
+        switch (kernel)
+        {
+        case Sim_Kernel_Sse2:   { return cpu.sse2; }
+        case Sim_Kernel_Avx2:   { return cpu.avx2 && cpu.fma; }
+        case Sim_Kernel_Avx512: { return cpu.avx512f && cpu.avx2 && cpu.fma; }
+        default: break;
+        }
+
+        return true;
+    }
+
+    bool findKernel(const char* name, SimKernel* kernel)
+    {
+        for (int k = 0; k < Sim_Kernel_Count; k++)
+        {
+            if (strcmp(name, getKernelName((SimKernel)k)) == 0)
+            {
+                *kernel = (SimKernel)k;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    SimKernel getBestKernel()
+    {
+        for (int kernel = Sim_Kernel_Count - 1; kernel > Sim_Kernel_Scalar; kernel--)
+        {
+            if (isKernelAvailable((SimKernel)kernel))
+                return (SimKernel)kernel;
+        }
+
+        return Sim_Kernel_Scalar;
+    }
+
+    SimKernel getStartupKernel()
+    {
+        SimKernel best = getBestKernel();
+        const char* name = getenv("SIM_KERNEL");
+        if (!name || !*name)
+            return best;
+
+        SimKernel kernel;
+        if (!findKernel(name, &kernel) || !isKernelAvailable(kernel))
+        {
+            fprintf(stderr, "SIM_KERNEL=%s is not a kernel this build and cpu can run, using %s\n", name, getKernelName(best));
+            return best;
+        }
+
+        return kernel;
+    }
+
+    bool setKernel(SimKernel kernel)
+    {
+        if (!isKernelAvailable(kernel))
+            return false;
+
+        s_Kernel = kernel;
+        return true;
+    }
+
+    SimKernel getKernel()
+    {
+        return s_Kernel;
+    }
+
+    void setSmallKernels(bool enabled)
+    {
+        s_SmallKernels = enabled;
+    }
+
+    bool getSmallKernels()
+    {
+        return s_SmallKernels;
+    }
+
+    SimVec2 getBodyAttraction(float x1, float y1, float m1, float x2, float y2, float m2, double G)
+    {
+        float distx = x1 - x2;
+        float disty = y1 - y2;
+
+        // get the gravitational force using the grav. force formula
+        float distance = std::sqrt(std::pow(distx, 2) + std::pow(disty, 2));
+        float force = G * m1 * m2 / std::pow(distance, 2);
+
+        // apply the force for the x and y forces
+        float theta = std::atan2(disty, distx);
+        float fx = force * std::cos(theta);
+        float fy = force * std::sin(theta);
+
+        return { -fx, -fy };
+    }
+
+    static SimVec2 accelerationOnReference(const SimBodies& bodies, float px, float py)
+    {
+        SimVec2 sumOfForces = { 0.0f, 0.0f };
+
+        // force on a unit mass
+        for (uint32_t j = 0; j < bodies.count; j++)
+        {
+            if (bodies.x[j] == px && bodies.y[j] == py) continue;
+
+            SimVec2 f = getBodyAttraction(px, py, 1.0f, bodies.x[j], bodies.y[j], bodies.mass[j], bodies.units.G);
+            sumOfForces.x += f.x;
+            sumOfForces.y += f.y;
+        }
+
+        return sumOfForces;
+    }
+
+    SimVec2 accelerationOn(SimKernel kernel, const SimBodies& bodies, float px, float py)
+    {
+        const float* x = bodies.x.data();
+        const float* y = bodies.y.data();
+        const float* mass = bodies.mass.data();
+        uint32_t padded = paddedCount(bodies.count);
+
+        switch (kernel)
+        {
+#if SIM_SIMD_LEVEL >= 1
+        case Sim_Kernel_Sse2:   { return sse2::accelerationOn(x, y, mass, padded, px, py, bodies.units.G); }
+#endif
+#if SIM_SIMD_LEVEL >= 2
+        case Sim_Kernel_Avx2:   { return avx2::accelerationOn(x, y, mass, padded, px, py, bodies.units.G); }
+#endif
+#if SIM_SIMD_LEVEL >= 3
+        case Sim_Kernel_Avx512: { return avx512::accelerationOn(x, y, mass, padded, px, py, bodies.units.G); }
+#endif
+        case Sim_Kernel_Reference: { return accelerationOnReference(bodies, px, py); }
+        default: break;
+        }
+
+        return accelerationOnKernel<SimdScalar>(x, y, mass, padded, px, py, bodies.units.G);
+    }
+
+    void computeAccelerations(SimKernel kernel, const SimBodies& bodies, float* ax, float* ay)
+    {
+        parallelFor(0, bodies.count, 16, [&](uint32_t begin, uint32_t end, uint32_t worker)
+        {
+            for (uint32_t i = begin; i < end; i++)
+            {
+                SimVec2 a = accelerationOn(kernel, bodies, bodies.x[i], bodies.y[i]);
+                ax[i] = a.x;
+                ay[i] = a.y;
+            }
+        });
+    }
+
+    void computeAccelerationsPairwise(SimKernel kernel, const SimBodies& bodies, float* ax, float* ay, bool deterministic, double* potential)
+    {
+        const float* x = bodies.x.data();
+        const float* y = bodies.y.data();
+        const float* mass = bodies.mass.data();
+        uint32_t count = bodies.count;
+        uint32_t padded = paddedCount(count);
+
+        if (kernel == Sim_Kernel_Reference)
+        {
+            computeAccelerations(kernel, bodies, ax, ay);
+            if (potential)
+                *potential = std::nan("");
+            return;
+        }
+
+        if (s_SmallKernels && count <= SIM_SMALL_BODIES)
+        {
+            float G = (float)bodies.units.G;
+            double sum;
+            switch (kernel)
+            {
+#if SIM_SIMD_LEVEL >= 1
+            case Sim_Kernel_Sse2:   { sum = sse2::smallPairs(count, x, y, mass, ax, ay, G); break; }
+#endif
+#if SIM_SIMD_LEVEL >= 2
+            case Sim_Kernel_Avx2:   { sum = avx2::smallPairs(count, x, y, mass, ax, ay, G); break; }
+#endif
+#if SIM_SIMD_LEVEL >= 3
+            case Sim_Kernel_Avx512: { sum = avx512::smallPairs(count, x, y, mass, ax, ay, G); break; }
+#endif
+            default: { sum = smallPairDispatch<SimdScalar>(count, x, y, mass, ax, ay, G); break; }
+            }
+
+            for (uint32_t i = count; i < padded; i++)
+            {
+                ax[i] = 0.0f;
+                ay[i] = 0.0f;
+            }
+
+            if (potential)
+                *potential = -bodies.units.G * sum;
+            return;
+        }
+
+        // a row of tiles (i0, j0 >= i0) is one task, the rows get shorter towards the end so they are stolen in halves
+        uint32_t tileRows = (count + SIM_TILE_SIZE - 1) / SIM_TILE_SIZE;
+        uint32_t slots = tileRows < SIM_REDUCTION_SLOTS ? tileRows : SIM_REDUCTION_SLOTS;
+        uint32_t accumulators = deterministic ? slots : getThreadCount();
+        std::vector<SimArray<float>>& workerAx = s_WorkerAx;
+        std::vector<SimArray<float>>& workerAy = s_WorkerAy;
+        std::vector<double>& workerPotential = s_WorkerPotential;
+        workerAx.resize(accumulators);
+        workerAy.resize(accumulators);
+        workerPotential.assign(accumulators, 0.0);
+        for (uint32_t w = 0; w < accumulators; w++)
+        {
+            workerAx[w].assign(padded, 0.0f);
+            workerAy[w].assign(padded, 0.0f);
+        }
+
+        auto sumRow = [&](uint32_t row, uint32_t accumulator)
+        {
+            float* wax = workerAx[accumulator].data();
+            float* way = workerAy[accumulator].data();
+            double rowPotential = 0.0;
+
+            uint32_t i0 = row * SIM_TILE_SIZE;
+            uint32_t i1 = i0 + SIM_TILE_SIZE < count ? i0 + SIM_TILE_SIZE : count;
+
+            for (uint32_t j0 = i0; j0 < padded; j0 += SIM_TILE_SIZE)
+            {
+                uint32_t j1 = j0 + SIM_TILE_SIZE < padded ? j0 + SIM_TILE_SIZE : padded;
+
+                switch (kernel)
+                {
+#if SIM_SIMD_LEVEL >= 1
+                case Sim_Kernel_Sse2:   { rowPotential += sse2::pairTile(x, y, mass, wax, way, i0, i1, j0, j1); break; }
+#endif
+#if SIM_SIMD_LEVEL >= 2
+                case Sim_Kernel_Avx2:   { rowPotential += avx2::pairTile(x, y, mass, wax, way, i0, i1, j0, j1); break; }
+#endif
+#if SIM_SIMD_LEVEL >= 3
+                case Sim_Kernel_Avx512: { rowPotential += avx512::pairTile(x, y, mass, wax, way, i0, i1, j0, j1); break; }
+#endif
+                default: { rowPotential += pairTileKernel<SimdScalar>(x, y, mass, wax, way, i0, i1, j0, j1); break; }
+                }
+            }
+
+            workerPotential[accumulator] += rowPotential;
+        };
+
+        if (deterministic)
+        {
+            // row r goes to slot r % slots, the slots hold a mix of long and short rows
+            parallelFor(0, slots, 1, [&](uint32_t begin, uint32_t end, uint32_t worker)
+            {
+                for (uint32_t slot = begin; slot < end; slot++)
+                {
+                    for (uint32_t row = slot; row < tileRows; row += slots)
+                        sumRow(row, slot);
+                }
+            });
+        }
+        else
+        {
+            parallelFor(0, tileRows, 1, [&](uint32_t begin, uint32_t end, uint32_t worker)
+            {
+                for (uint32_t row = begin; row < end; row++)
+                    sumRow(row, worker);
+            });
+        }
+
+        // the tiles sum m / r^3 terms, G is applied once at the end
+        float G = (float)bodies.units.G;
+        parallelFor(0, padded, 4096, [&](uint32_t begin, uint32_t end, uint32_t worker)
+        {
+            for (uint32_t i = begin; i < end; i++)
+            {
+                float sx = 0.0f, sy = 0.0f;
+                for (uint32_t w = 0; w < accumulators; w++)
+                {
+                    sx += workerAx[w][i];
+                    sy += workerAy[w][i];
+                }
+
+                ax[i] = i < count ? sx * G : 0.0f;
+                ay[i] = i < count ? sy * G : 0.0f;
+            }
+        });
+
+        if (potential)
+        {
+            double sum = 0.0;
+            for (uint32_t w = 0; w < accumulators; w++)
+                sum += workerPotential[w];
+            *potential = -bodies.units.G * sum;
+        }
+    }
+
+    void computeParticleAccelerations(SimKernel kernel, const SimBodies& bodies, const float* px, const float* py, uint32_t paddedParticles, float* ax, float* ay, float softening)
+    {
+        const float* x = bodies.x.data();
+        const float* y = bodies.y.data();
+        const float* mass = bodies.mass.data();
+        uint32_t count = bodies.count;
+        float G = (float)bodies.units.G;
+        float softening2 = softening * softening;
+
+        // tasks are runs of SIM_PADDING particles so every range starts on a vector boundary
+        parallelFor(0, paddedParticles / SIM_PADDING, 64, [&](uint32_t begin, uint32_t end, uint32_t worker)
+        {
+            uint32_t i0 = begin * SIM_PADDING;
+            uint32_t i1 = end * SIM_PADDING;
+
+            switch (kernel)
+            {
+#if SIM_SIMD_LEVEL >= 1
+            case Sim_Kernel_Sse2:   { sse2::particles(x, y, mass, count, px, py, ax, ay, i0, i1, G, softening2); break; }
+#endif
+#if SIM_SIMD_LEVEL >= 2
+            case Sim_Kernel_Avx2:   { avx2::particles(x, y, mass, count, px, py, ax, ay, i0, i1, G, softening2); break; }
+#endif
+#if SIM_SIMD_LEVEL >= 3
+            case Sim_Kernel_Avx512: { avx512::particles(x, y, mass, count, px, py, ax, ay, i0, i1, G, softening2); break; }
+#endif
+            default: { particleKernel<SimdScalar>(x, y, mass, count, px, py, ax, ay, i0, i1, G, softening2); break; }
+            }
+        });
+    }
+
+    void addScaled(SimKernel kernel, float* y, const float* x, float s, uint32_t begin, uint32_t end)
+    {
+        switch (kernel)
+        {
+#if SIM_SIMD_LEVEL >= 1
+        case Sim_Kernel_Sse2:   { sse2::addScaled(y, x, s, begin, end); return; }
+#endif
+#if SIM_SIMD_LEVEL >= 2
+        case Sim_Kernel_Avx2:   { avx2::addScaled(y, x, s, begin, end); return; }
+#endif
+#if SIM_SIMD_LEVEL >= 3
+        case Sim_Kernel_Avx512: { avx512::addScaled(y, x, s, begin, end); return; }
+#endif
+        default: break;
+        }
+
+        addScaledKernel<SimdScalar>(y, x, s, begin, end);
+    }
+
+    template <typename P, typename V>
+    void computeAccelerationsState(const SimBodies& bodies, const P* x, const P* y, V* ax, V* ay, double* potential)
+    {
+        uint32_t count = bodies.count;
+        std::vector<double>& bodyPotential = s_BodyPotential;
+        bodyPotential.resize(count);
+        parallelFor(0, count, 64, [&](uint32_t begin, uint32_t end, uint32_t worker)
+        {
+            for (uint32_t i = begin; i < end; i++)
+            {
+                V sx = 0, sy = 0, pot = 0;
+                for (uint32_t j = 0; j < count; j++)
+                {
+                    V dx = x[j] - x[i];
+                    V dy = y[j] - y[i];
+                    V r2 = dx * dx + dy * dy;
+                    if (r2 == 0) continue;
+
+                    // r^3 overflows a float beyond some 10^13 m, 1 / r cubed doesn't
+                    V invr = (V)1 / std::sqrt(r2);
+                    V s = (V)bodies.mass[j] * invr * invr * invr;
+                    sx += s * dx;
+                    sy += s * dy;
+                    pot += (V)bodies.mass[j] * invr;
+                }
+
+                ax[i] = sx * (V)bodies.units.G;
+                ay[i] = sy * (V)bodies.units.G;
+                bodyPotential[i] = (double)bodies.mass[i] * pot;
+            }
+        });
+
+        // every pair was visited from both ends
+        if (potential)
+        {
+            double sum = 0.0;
+            for (uint32_t i = 0; i < count; i++)
+                sum += bodyPotential[i];
+            *potential = -0.5 * bodies.units.G * sum;
+        }
+    }
+
+    // the double state gets the tiled pass of computeAccelerationsPairwise in the double lanes of the selected kernel,
+    // always summed into the fixed reduction slots so the state steps to the same bits with any thread count
+    template <>
+    void computeAccelerationsState<double, double>(const SimBodies& bodies, const double* x, const double* y, double* ax, double* ay, double* potential)
+    {
+        SimKernel kernel = getKernel();
+        uint32_t count = bodies.count;
+        uint32_t padded = paddedCount(count);
+        if (count == 0)
+        {
+            if (potential)
+                *potential = 0.0;
+            return;
+        }
+
+        SimArray<double>& px = s_StateX;
+        SimArray<double>& py = s_StateY;
+        SimArray<double>& mass = s_StateMass;
+        px.assign(padded, 0.0);
+        py.assign(padded, 0.0);
+        mass.assign(padded, 0.0);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            px[i] = x[i];
+            py[i] = y[i];
+            mass[i] = bodies.mass[i];
+        }
+
+        uint32_t tileRows = (count + SIM_TILE_SIZE - 1) / SIM_TILE_SIZE;
+        uint32_t slots = tileRows < SIM_REDUCTION_SLOTS ? tileRows : SIM_REDUCTION_SLOTS;
+        std::vector<SimArray<double>>& slotAx = s_SlotAx;
+        std::vector<SimArray<double>>& slotAy = s_SlotAy;
+        std::vector<double>& slotPotential = s_SlotPotential;
+        slotAx.resize(slots);
+        slotAy.resize(slots);
+        slotPotential.assign(slots, 0.0);
+        for (uint32_t w = 0; w < slots; w++)
+        {
+            slotAx[w].assign(padded, 0.0);
+            slotAy[w].assign(padded, 0.0);
+        }
+
+        // row r goes to slot r % slots like the deterministic pairwise pass
+        parallelFor(0, slots, 1, [&](uint32_t begin, uint32_t end, uint32_t worker)
+        {
+            for (uint32_t slot = begin; slot < end; slot++)
+            {
+                double* sax = slotAx[slot].data();
+                double* say = slotAy[slot].data();
+                for (uint32_t row = slot; row < tileRows; row += slots)
+                {
+                    uint32_t i0 = row * SIM_TILE_SIZE;
+                    uint32_t i1 = i0 + SIM_TILE_SIZE < count ? i0 + SIM_TILE_SIZE : count;
+
+                    for (uint32_t j0 = i0; j0 < padded; j0 += SIM_TILE_SIZE)
+                    {
+                        uint32_t j1 = j0 + SIM_TILE_SIZE < padded ? j0 + SIM_TILE_SIZE : padded;
+                        const double* mx = px.data();
+                        const double* my = py.data();
+                        const double* mm = mass.data();
+
+                        switch (kernel)
+                        {
+#if SIM_SIMD_LEVEL >= 1
+                        case Sim_Kernel_Sse2:   { slotPotential[slot] += sse2::pairTileDouble(mx, my, mm, sax, say, i0, i1, j0, j1); break; }
+#endif
+#if SIM_SIMD_LEVEL >= 2
+                        case Sim_Kernel_Avx2:   { slotPotential[slot] += avx2::pairTileDouble(mx, my, mm, sax, say, i0, i1, j0, j1); break; }
+#endif
+#if SIM_SIMD_LEVEL >= 3
+                        case Sim_Kernel_Avx512: { slotPotential[slot] += avx512::pairTileDouble(mx, my, mm, sax, say, i0, i1, j0, j1); break; }
+#endif
+                        default: { slotPotential[slot] += pairTileDoubleKernel<SimdScalarDouble>(mx, my, mm, sax, say, i0, i1, j0, j1); break; }
+                        }
+                    }
+                }
+            }
+        });
+
+        // the tiles sum m / r^3 terms, G is applied once at the end
+        double G = bodies.units.G;
+        parallelFor(0, count, 4096, [&](uint32_t begin, uint32_t end, uint32_t worker)
+        {
+            for (uint32_t i = begin; i < end; i++)
+            {
+                double sx = 0.0, sy = 0.0;
+                for (uint32_t w = 0; w < slots; w++)
+                {
+                    sx += slotAx[w][i];
+                    sy += slotAy[w][i];
+                }
+
+                ax[i] = sx * G;
+                ay[i] = sy * G;
+            }
+        });
+
+        // every pair was visited once
+        if (potential)
+        {
+            double sum = 0.0;
+            for (uint32_t w = 0; w < slots; w++)
+                sum += slotPotential[w];
+            *potential = -G * sum;
+        }
+    }
+
+    template void computeAccelerationsState<float, float>(const SimBodies&, const float*, const float*, float*, float*, double*);
+
+    SimForceError measureForceError(const SimBodies& bodies, const float* ax, const float* ay, uint32_t samples)
+    {
+        SimForceError error = { 0.0, 0.0, 0 };
+        if (bodies.count == 0 || samples == 0) return error;
+
+        uint32_t stride = bodies.count > samples ? bodies.count / samples : 1;
+        double sum = 0.0;
+
+        for (uint32_t i = 0; i < bodies.count; i += stride)
+        {
+            double refx = 0.0, refy = 0.0;
+            for (uint32_t j = 0; j < bodies.count; j++)
+            {
+                double dx = (double)bodies.x[j] - bodies.x[i];
+                double dy = (double)bodies.y[j] - bodies.y[i];
+                double r2 = dx * dx + dy * dy;
+                if (r2 == 0.0) continue;
+
+                double s = bodies.mass[j] / (r2 * std::sqrt(r2));
+                refx += s * dx;
+                refy += s * dy;
+            }
+
+            refx *= bodies.units.G;
+            refy *= bodies.units.G;
+
+            double ref = std::sqrt(refx * refx + refy * refy);
+            if (ref == 0.0) continue;
+
+            double ex = ax[i] - refx;
+            double ey = ay[i] - refy;
+            double e = std::sqrt(ex * ex + ey * ey) / ref;
+
+            sum += e * e;
+            error.max = e > error.max ? e : error.max;
+            error.samples++;
+        }
+
+        error.rms = error.samples > 0 ? std::sqrt(sum / error.samples) : 0.0;
+        return error;
+    }
+}
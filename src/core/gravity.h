@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "bodies.h"
+#include "precision.h"
+
+#define SIM_TILE_SIZE 256 /* bodies per tile of the pair pass, two tiles of x, y, mass, ax, ay stay in l1 */
+#define SIM_REDUCTION_SLOTS 32 /* accumulators of the deterministic pair pass, fixed so the sums don't depend on the thread count */
+#define SIM_SMALL_BODIES 32 /* body counts up to which the pair pass runs a kernel compiled for that exact count */
+
+// gravity kernels, the reference kernel is the original per pair force with trigonometry,
+// the other kernels compute a = G * m * r / |r|^3 with a reciprocal square root and no trigonometry
+
+struct SimForceError
+{
+    double rms;              // relative to the magnitude of the exact acceleration
+    double max;
+    uint32_t samples;
+};
+
+enum SimKernel
+{
+    Sim_Kernel_Reference,
+    Sim_Kernel_Scalar,
+    Sim_Kernel_Sse2,
+    Sim_Kernel_Avx2,
+    Sim_Kernel_Avx512,
+    Sim_Kernel_Count,
+};
+
+namespace sim
+{
+    const char* getKernelName(SimKernel kernel);
+    bool findKernel(const char* name, SimKernel* kernel); // by getKernelName()
+    bool isKernelCompiled(SimKernel kernel);  // compiled in for this build (SIM_SIMD)
+    bool isKernelAvailable(SimKernel kernel); // compiled in and supported by this cpu (cpu.h)
+    SimKernel getBestKernel();                // widest available
+
+    // the kernel selected once at startup: getBestKernel(), or the one named by the SIM_KERNEL environment
+    // variable (reference, scalar, sse2, avx2, avx512) when it is available, to force a path for tests and benchmarks
+    SimKernel getStartupKernel();
+
+    // kernel used by the simulation step, defaults to getStartupKernel(), false (and no change) when not available
+    bool setKernel(SimKernel kernel);
+    SimKernel getKernel();
+
+    // up to SIM_SMALL_BODIES bodies the pair pass runs on one thread with a kernel specialized for the body count
+    // (on by default), off runs the tiled pass for every count
+    void setSmallKernels(bool enabled);
+    bool getSmallKernels();
+
+    // force on body 1 from body 2, the original scalar implementation
+    SimVec2 getBodyAttraction(float x1, float y1, float m1, float x2, float y2, float m2, double G = G_CONSTANT);
+
+    // acceleration at (px, py) from all bodies, bodies exactly at (px, py) are skipped
+    SimVec2 accelerationOn(SimKernel kernel, const SimBodies& bodies, float px, float py);
+    void computeAccelerations(SimKernel kernel, const SimBodies& bodies, float* ax, float* ay);
+
+    // visits every unordered pair once and applies equal and opposite accelerations,
+    // in tiles of SIM_TILE_SIZE bodies, ax and ay must hold paddedCount(bodies.count) floats
+    // the rows of tiles are summed into one accumulator per worker, so the rounding depends on the thread count
+    // and on which worker stole which row, deterministic sums the rows into SIM_REDUCTION_SLOTS accumulators
+    // in a fixed order instead (row r always into slot r % slots) and gives the same bits for any thread count
+    // potential (when not null) gets the potential energy -G sum m_i m_j / r, summed next to the forces
+    // small systems (see setSmallKernels) go through one kernel for their count and are the same for any thread count
+    void computeAccelerationsPairwise(SimKernel kernel, const SimBodies& bodies, float* ax, float* ay, bool deterministic = false, double* potential = nullptr);
+
+    // accelerations of massless test particles from the bodies, O(bodies x particles), the particles feel the bodies
+    // but the bodies don't feel them, paddedParticles is a multiple of SIM_PADDING and the arrays are aligned like the bodies
+    // softening (in the units of the bodies) is the plummer softening length, a / (r^2 + softening^2)^(3/2) keeps a particle
+    // passing through a body from being flung out
+    void computeParticleAccelerations(SimKernel kernel, const SimBodies& bodies, const float* px, const float* py, uint32_t paddedParticles, float* ax, float* ay, float softening = 0.0f);
+
+    // y[i] += x[i] * s for i in [begin, end) with the vectors of kernel, the kicks and drifts of the float state
+    void addScaled(SimKernel kernel, float* y, const float* x, float s, uint32_t begin, uint32_t end);
+
+    // direct summation on the positions of a precision state (instead of the bodies) in its own scalar type,
+    // instantiated for the float and double states, potential like computeAccelerationsPairwise, the double state
+    // visits every pair once in the tiles and the double lanes of the selected kernel, the same bits for any thread count
+    template <typename P, typename V>
+    void computeAccelerationsState(const SimBodies& bodies, const P* x, const P* y, V* ax, V* ay, double* potential = nullptr);
+    template <>
+    void computeAccelerationsState<double, double>(const SimBodies& bodies, const double* x, const double* y, double* ax, double* ay, double* potential);
+
+    // error of the accelerations of an approximate solver against direct summation in double precision,
+    // on an evenly spaced subset of the bodies
+    SimForceError measureForceError(const SimBodies& bodies, const float* ax, const float* ay, uint32_t samples);
+}
@@ -0,0 +1,56 @@
+#include "gravity_kernels.h"
+
+// compiled with the AVX2 compiler flags, only called when the kernel is selected
+
+#ifdef SIM_SIMD_AVX2
+namespace sim
+{
+    namespace avx2
+    {
+        SimVec2 accelerationOn(const float* x, const float* y, const float* mass, uint32_t paddedCount, float px, float py, float G)
+        {
+            return accelerationOnKernel<SimdAvx2>(x, y, mass, paddedCount, px, py, G);
+        }
+
+        double pairTile(const float* x, const float* y, const float* mass, float* ax, float* ay, uint32_t i0, uint32_t i1, uint32_t j0, uint32_t j1)
+        {
+            return pairTileKernel<SimdAvx2>(x, y, mass, ax, ay, i0, i1, j0, j1);
+        }
+
+        void particles(const float* x, const float* y, const float* mass, uint32_t count, const float* px, const float* py, float* ax, float* ay, uint32_t begin, uint32_t end, float G, float softening2)
+        {
+            particleKernel<SimdAvx2>(x, y, mass, count, px, py, ax, ay, begin, end, G, softening2);
+        }
+
+        void ensemble(const SimEnsembleKernelArgs& args, uint32_t begin, uint32_t end)
+        {
+            ensembleKernel<SimdAvx2>(args, begin, end);
+        }
+
+        double smallPairs(uint32_t count, const float* x, const float* y, const float* mass, float* ax, float* ay, float G)
+        {
+            return smallPairDispatch<SimdAvx2>(count, x, y, mass, ax, ay, G);
+        }
+
+        void addScaled(float* y, const float* x, float s, uint32_t begin, uint32_t end)
+        {
+            addScaledKernel<SimdAvx2>(y, x, s, begin, end);
+        }
+
+        void retarded(const SimRetardedKernelArgs& args, uint32_t begin, uint32_t end)
+        {
+            retardedKernel<SimdAvx2>(args, begin, end);
+        }
+
+        uint32_t kepler(SimKeplerBatch* batch)
+        {
+            return keplerKernel<SimdAvx2Double>(batch);
+        }
+
+        double pairTileDouble(const double* x, const double* y, const double* mass, double* ax, double* ay, uint32_t i0, uint32_t i1, uint32_t j0, uint32_t j1)
+        {
+            return pairTileDoubleKernel<SimdAvx2Double>(x, y, mass, ax, ay, i0, i1, j0, j1);
+        }
+    }
+}
+#endif
@@ -0,0 +1,736 @@
+#pragma once
+
+#include "bodies.h"
+#include "ensemble.h"
+#include "gravity.h"
+#include "history.h"
+#include "kepler.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <array>
+#include <utility>
+
+// kernel templates shared by the per instruction set translation units (gravity_*.cpp)
+
+namespace sim
+{
+    // sums m * r / |r|^3 over all (padded) bodies, one vector of sources per iteration
+    template <typename V>
+    inline SimVec2 accelerationOnKernel(const float* x, const float* y, const float* mass, uint32_t paddedCount, float px, float py, float G)
+    {
+        typedef typename V::Reg Reg;
+
+        Reg pxv = V::set1(px);
+        Reg pyv = V::set1(py);
+        Reg axv = V::zero();
+        Reg ayv = V::zero();
+
+        for (uint32_t j = 0; j < paddedCount; j += V::width)
+        {
+            Reg dx = V::sub(V::load(x + j), pxv);
+            Reg dy = V::sub(V::load(y + j), pyv);
+            Reg r2 = V::fmadd(dx, dx, V::mul(dy, dy));
+            Reg invr = V::rsqrtNonZero(r2);
+
+            // m / r^3, multiplied in this order so nothing over or underflows in si units
+            Reg s = V::mul(V::mul(V::mul(V::load(mass + j), invr), invr), invr);
+
+            axv = V::fmadd(s, dx, axv);
+            ayv = V::fmadd(s, dy, ayv);
+        }
+
+        return { G * V::sum(axv), G * V::sum(ayv) };
+    }
+
+    // body i against bodies [j0, j1), j0 and j1 are multiples of V::width
+    // adds m_j * r / |r|^3 to body i and the equal and opposite m_i * r / |r|^3 to every body j,
+    // returns the sum of m_j / r for the potential energy (one more multiply add on the 1 / r that is there anyway)
+    template <typename V>
+    inline float pairRowKernel(const float* x, const float* y, const float* mass, float* ax, float* ay, uint32_t i, uint32_t j0, uint32_t j1)
+    {
+        typedef typename V::Reg Reg;
+
+        Reg xi = V::set1(x[i]);
+        Reg yi = V::set1(y[i]);
+        Reg mi = V::set1(mass[i]);
+        Reg axi = V::zero();
+        Reg ayi = V::zero();
+        Reg poti = V::zero();
+
+        for (uint32_t j = j0; j < j1; j += V::width)
+        {
+            Reg dx = V::sub(V::loadu(x + j), xi);
+            Reg dy = V::sub(V::loadu(y + j), yi);
+            Reg r2 = V::fmadd(dx, dx, V::mul(dy, dy));
+            Reg invr = V::rsqrtNonZero(r2);
+            Reg invr2 = V::mul(invr, invr);
+
+            // 1 / r^3 alone is denormal past ~40 AU in si units, so the masses go in first
+            Reg mj = V::loadu(mass + j);
+            Reg sj = V::mul(V::mul(mj, invr), invr2);
+            axi = V::fmadd(sj, dx, axi);
+            ayi = V::fmadd(sj, dy, ayi);
+            poti = V::fmadd(mj, invr, poti);
+
+            Reg si = V::mul(V::mul(mi, invr), invr2);
+            V::storeu(ax + j, V::fnmadd(si, dx, V::loadu(ax + j)));
+            V::storeu(ay + j, V::fnmadd(si, dy, V::loadu(ay + j)));
+        }
+
+        ax[i] += V::sum(axi);
+        ay[i] += V::sum(ayi);
+        return V::sum(poti);
+    }
+
+    // every unordered pair between the tiles [i0, i1) and [j0, j1) once, the tiles are the same
+    // (diagonal tile) or j0 >= i1, tile bounds are multiples of V::width except i1 which may be the body count
+    // returns the sum of m_i m_j / r over the pairs, in double as m_i m_j overflows a float in si units
+    template <typename V>
+    inline double pairTileKernel(const float* x, const float* y, const float* mass, float* ax, float* ay, uint32_t i0, uint32_t i1, uint32_t j0, uint32_t j1)
+    {
+        double potential = 0.0;
+        for (uint32_t i = i0; i < i1; i++)
+        {
+            uint32_t start = j0;
+            float row = 0.0f;
+
+            if (j0 == i0)
+            {
+                // diagonal tile, only j > i, go one by one until j is aligned to the vector width
+                start = (i + V::width) & ~(V::width - 1);
+                start = start < j1 ? start : j1;
+                if (i + 1 < start)
+                    row = pairRowKernel<SimdScalar>(x, y, mass, ax, ay, i, i + 1, start);
+            }
+
+            row += pairRowKernel<V>(x, y, mass, ax, ay, i, start, j1);
+            potential += (double)mass[i] * row;
+        }
+
+        return potential;
+    }
+
+    // pairRowKernel on the double state (gravity.h computeAccelerationsState), the masses in double too
+    template <typename D>
+    inline double pairRowDoubleKernel(const double* x, const double* y, const double* mass, double* ax, double* ay, uint32_t i, uint32_t j0, uint32_t j1)
+    {
+        typedef typename D::Reg Reg;
+
+        Reg xi = D::set1(x[i]);
+        Reg yi = D::set1(y[i]);
+        Reg mi = D::set1(mass[i]);
+        Reg axi = D::zero();
+        Reg ayi = D::zero();
+        Reg poti = D::zero();
+
+        for (uint32_t j = j0; j < j1; j += D::width)
+        {
+            Reg dx = D::sub(D::loadu(x + j), xi);
+            Reg dy = D::sub(D::loadu(y + j), yi);
+            Reg r2 = D::fmadd(dx, dx, D::mul(dy, dy));
+            Reg invr = D::rsqrtNonZero(r2);
+            Reg invr2 = D::mul(invr, invr);
+
+            Reg mj = D::loadu(mass + j);
+            Reg sj = D::mul(D::mul(mj, invr), invr2);
+            axi = D::fmadd(sj, dx, axi);
+            ayi = D::fmadd(sj, dy, ayi);
+            poti = D::fmadd(mj, invr, poti);
+
+            Reg si = D::mul(D::mul(mi, invr), invr2);
+            D::storeu(ax + j, D::fnmadd(si, dx, D::loadu(ax + j)));
+            D::storeu(ay + j, D::fnmadd(si, dy, D::loadu(ay + j)));
+        }
+
+        ax[i] += D::sum(axi);
+        ay[i] += D::sum(ayi);
+        return D::sum(poti);
+    }
+
+    // pairTileKernel on the double state
+    template <typename D>
+    inline double pairTileDoubleKernel(const double* x, const double* y, const double* mass, double* ax, double* ay, uint32_t i0, uint32_t i1, uint32_t j0, uint32_t j1)
+    {
+        double potential = 0.0;
+        for (uint32_t i = i0; i < i1; i++)
+        {
+            uint32_t start = j0;
+            double row = 0.0;
+
+            if (j0 == i0)
+            {
+                start = (i + D::width) & ~(D::width - 1);
+                start = start < j1 ? start : j1;
+                if (i + 1 < start)
+                    row = pairRowDoubleKernel<SimdScalarDouble>(x, y, mass, ax, ay, i, i + 1, start);
+            }
+
+            row += pairRowDoubleKernel<D>(x, y, mass, ax, ay, i, start, j1);
+            potential += mass[i] * row;
+        }
+
+        return potential;
+    }
+
+    // every pair of exactly N bodies, the bodies are the lanes (N rounded up to the vector width, the padding has no
+    // mass) and the N sources are broadcast one at a time, both directions of a pair are summed so there is nothing
+    // to scatter, a body on itself has r = 0 and adds nothing, the bounds are constants so both loops unroll and the
+    // sums of a vector stay in registers, no tiles, accumulators or tasks, the same order for any thread count
+    // writes G * sum m_j r / |r|^3 to ax and ay [0, N rounded up) and returns the sum of m_i m_j / r over the pairs
+    template <typename V, uint32_t N>
+    inline double smallPairKernel(const float* x, const float* y, const float* mass, float* ax, float* ay, float G)
+    {
+        typedef typename V::Reg Reg;
+
+        const uint32_t padded = (N + V::width - 1) / V::width * V::width;
+        alignas(64) float rows[padded > 0 ? padded : 1];
+
+        Reg g = V::set1(G);
+        for (uint32_t i = 0; i < padded; i += V::width)
+        {
+            Reg xi = V::load(x + i);
+            Reg yi = V::load(y + i);
+            Reg axi = V::zero();
+            Reg ayi = V::zero();
+            Reg poti = V::zero();
+
+            for (uint32_t j = 0; j < N; j++)
+            {
+                Reg dx = V::sub(V::set1(x[j]), xi);
+                Reg dy = V::sub(V::set1(y[j]), yi);
+                Reg invr = V::rsqrtNonZero(V::fmadd(dx, dx, V::mul(dy, dy)));
+                Reg mj = V::set1(mass[j]);
+                Reg sj = V::mul(V::mul(mj, invr), V::mul(invr, invr));
+                axi = V::fmadd(sj, dx, axi);
+                ayi = V::fmadd(sj, dy, ayi);
+                poti = V::fmadd(mj, invr, poti);
+            }
+
+            V::storeu(ax + i, V::mul(g, axi));
+            V::storeu(ay + i, V::mul(g, ayi));
+            V::store(rows + i, poti);
+        }
+
+        // every pair was summed from both ends
+        double potential = 0.0;
+        for (uint32_t i = 0; i < N; i++)
+            potential += (double)mass[i] * rows[i];
+
+        return 0.5 * potential;
+    }
+
+    typedef double (*SimSmallPairFunction)(const float* x, const float* y, const float* mass, float* ax, float* ay, float G);
+
+    template <typename V, uint32_t... N>
+    inline std::array<SimSmallPairFunction, sizeof...(N)> makeSmallPairKernels(std::integer_sequence<uint32_t, N...>)
+    {
+        return { { &smallPairKernel<V, N>... } };
+    }
+
+    // smallPairKernel<V, count>, count up to SIM_SMALL_BODIES
+    template <typename V>
+    inline double smallPairDispatch(uint32_t count, const float* x, const float* y, const float* mass, float* ax, float* ay, float G)
+    {
+        static const std::array<SimSmallPairFunction, SIM_SMALL_BODIES + 1> kernels =
+            makeSmallPairKernels<V>(std::make_integer_sequence<uint32_t, SIM_SMALL_BODIES + 1>());
+        return kernels[count](x, y, mass, ax, ay, G);
+    }
+
+    // accelerations of the test particles [begin, end) from the massive bodies, the particles are the lanes
+    // and the (few) bodies are broadcast one at a time, begin and end are multiples of V::width
+    // softening2 is the square of the plummer softening length, 0 adds exactly nothing
+    template <typename V>
+    inline void particleKernel(const float* x, const float* y, const float* mass, uint32_t count, const float* px, const float* py, float* ax, float* ay, uint32_t begin, uint32_t end, float G, float softening2)
+    {
+        typedef typename V::Reg Reg;
+
+        Reg g = V::set1(G);
+        Reg eps2 = V::set1(softening2);
+        for (uint32_t i = begin; i < end; i += V::width)
+        {
+            Reg pxv = V::load(px + i);
+            Reg pyv = V::load(py + i);
+            Reg axv = V::zero();
+            Reg ayv = V::zero();
+
+            for (uint32_t j = 0; j < count; j++)
+            {
+                Reg dx = V::sub(V::set1(x[j]), pxv);
+                Reg dy = V::sub(V::set1(y[j]), pyv);
+                Reg r2 = V::fmadd(dx, dx, V::fmadd(dy, dy, eps2));
+                Reg invr = V::rsqrtNonZero(r2);
+                Reg s = V::mul(V::mul(V::mul(V::set1(mass[j]), invr), invr), invr);
+
+                axv = V::fmadd(s, dx, axv);
+                ayv = V::fmadd(s, dy, ayv);
+            }
+
+            V::store(ax + i, V::mul(g, axv));
+            V::store(ay + i, V::mul(g, ayv));
+        }
+    }
+
+    // members [begin, end) of an ensemble, the members are the lanes and a vector of them runs every step before
+    // the next vector starts, so its bodies stay in l1, begin and end are multiples of V::width
+    // the accelerations leave out G (it is in the kick coefficients), every pair once with equal and opposite
+    // accelerations, the smallest r^2 / (r_i + r_j)^2 is taken at every force pass and the distances and
+    // eccentricities around the sun after every step
+    template <typename V>
+    inline void ensembleKernel(const SimEnsembleKernelArgs& args, uint32_t begin, uint32_t end)
+    {
+        typedef typename V::Reg Reg;
+
+        const uint32_t n = args.bodyCount;
+        const uint32_t stride = args.stride;
+
+        for (uint32_t m = begin; m < end; m += V::width)
+        {
+            float* x = args.x + m;
+            float* y = args.y + m;
+            float* vx = args.vx + m;
+            float* vy = args.vy + m;
+            float* ax = args.ax + m;
+            float* ay = args.ay + m;
+            float* eccentricity2 = args.maxEccentricity2 + m;
+            Reg minSeparation2 = V::load(args.minSeparation2 + m);
+            Reg maxDistance2 = V::load(args.maxDistance2 + m);
+
+            auto forces = [&]()
+            {
+                for (uint32_t i = 0; i < n; i++)
+                {
+                    V::store(ax + i * stride, V::zero());
+                    V::store(ay + i * stride, V::zero());
+                }
+
+                for (uint32_t i = 0; i < n; i++)
+                {
+                    Reg xi = V::load(x + i * stride);
+                    Reg yi = V::load(y + i * stride);
+                    Reg mi = V::set1(args.mass[i]);
+                    Reg axi = V::load(ax + i * stride);
+                    Reg ayi = V::load(ay + i * stride);
+
+                    for (uint32_t j = i + 1; j < n; j++)
+                    {
+                        Reg dx = V::sub(V::load(x + j * stride), xi);
+                        Reg dy = V::sub(V::load(y + j * stride), yi);
+                        Reg r2 = V::fmadd(dx, dx, V::mul(dy, dy));
+                        Reg invr = V::rsqrtNonZero(r2);
+                        Reg invr2 = V::mul(invr, invr);
+                        minSeparation2 = V::min(V::mul(r2, V::set1(args.contact2[i * n + j])), minSeparation2);
+
+                        Reg sj = V::mul(V::mul(V::set1(args.mass[j]), invr), invr2);
+                        axi = V::fmadd(sj, dx, axi);
+                        ayi = V::fmadd(sj, dy, ayi);
+
+                        Reg si = V::mul(V::mul(mi, invr), invr2);
+                        V::store(ax + j * stride, V::fnmadd(si, dx, V::load(ax + j * stride)));
+                        V::store(ay + j * stride, V::fnmadd(si, dy, V::load(ay + j * stride)));
+                    }
+
+                    V::store(ax + i * stride, axi);
+                    V::store(ay + i * stride, ayi);
+                }
+            };
+
+            bool current = false;
+            for (uint32_t step = 0; step < args.steps; step++)
+            {
+                for (uint32_t k = 0; k <= args.stages; k++)
+                {
+                    if (args.kick[k] != 0.0f)
+                    {
+                        if (!current)
+                            forces();
+                        current = true;
+
+                        Reg d = V::set1(args.kick[k]);
+                        for (uint32_t i = 0; i < n; i++)
+                        {
+                            V::store(vx + i * stride, V::fmadd(d, V::load(ax + i * stride), V::load(vx + i * stride)));
+                            V::store(vy + i * stride, V::fmadd(d, V::load(ay + i * stride), V::load(vy + i * stride)));
+                        }
+                    }
+
+                    if (k < args.stages)
+                    {
+                        Reg c = V::set1(args.drift[k]);
+                        for (uint32_t i = 0; i < n; i++)
+                        {
+                            V::store(x + i * stride, V::fmadd(c, V::load(vx + i * stride), V::load(x + i * stride)));
+                            V::store(y + i * stride, V::fmadd(c, V::load(vy + i * stride), V::load(y + i * stride)));
+                        }
+                        current = false;
+                    }
+                }
+
+                // e = (v^2 / mu - 1 / r) r - (r . v / mu) v relative to the sun, nothing to divide but the rsqrt
+                Reg xs = V::zero(), ys = V::zero(), vxs = V::zero(), vys = V::zero();
+                if (args.sun >= 0)
+                {
+                    xs = V::load(x + args.sun * stride);
+                    ys = V::load(y + args.sun * stride);
+                    vxs = V::load(vx + args.sun * stride);
+                    vys = V::load(vy + args.sun * stride);
+                }
+
+                for (uint32_t i = 0; i < n; i++)
+                {
+                    if ((int32_t)i == args.sun) continue;
+
+                    Reg dx = V::sub(V::load(x + i * stride), xs);
+                    Reg dy = V::sub(V::load(y + i * stride), ys);
+                    Reg r2 = V::fmadd(dx, dx, V::mul(dy, dy));
+                    maxDistance2 = V::max(r2, maxDistance2);
+                    if (args.sun < 0) continue;
+
+                    Reg dvx = V::sub(V::load(vx + i * stride), vxs);
+                    Reg dvy = V::sub(V::load(vy + i * stride), vys);
+                    Reg invMu = V::set1(args.invMu[i]);
+                    Reg v2 = V::fmadd(dvx, dvx, V::mul(dvy, dvy));
+                    Reg rv = V::fmadd(dx, dvx, V::mul(dy, dvy));
+                    Reg a = V::sub(V::mul(v2, invMu), V::rsqrtNonZero(r2));
+                    Reg b = V::mul(rv, invMu);
+                    Reg ex = V::fnmadd(b, dvx, V::mul(a, dx));
+                    Reg ey = V::fnmadd(b, dvy, V::mul(a, dy));
+                    Reg e2 = V::fmadd(ex, ex, V::mul(ey, ey));
+                    V::store(eccentricity2 + i * stride, V::max(e2, V::load(eccentricity2 + i * stride)));
+                }
+            }
+
+            V::store(args.minSeparation2 + m, minSeparation2);
+            V::store(args.maxDistance2 + m, maxDistance2);
+        }
+    }
+
+    // positions age ago of the rings at ringX/ringY + lane, lanes are ring numbers times the ring stride (as floats)
+    // and cx, cy the bodies now: a lerp between the two samples around the age, or between the newest sample and
+    // the bodies when the age is within the offset, no branches so every lane can be on another part of its ring
+    template <typename V>
+    inline void retardedPosition(const SimRetardedKernelArgs& args, const float* ringX, const float* ringY, typename V::Reg lane,
+        typename V::Reg cx, typename V::Reg cy, typename V::Reg age, typename V::Reg* px, typename V::Reg* py)
+    {
+        typedef typename V::Reg Reg;
+
+        float samples = (float)args.samples;
+        Reg u = V::mul(V::sub(age, V::set1(args.offset)), V::set1(args.invInterval));
+        u = V::min(V::max(u, V::zero()), V::set1(samples - 1.0f));
+        Reg k = V::min(V::truncate(u), V::set1(samples - 2.0f));
+        Reg f = V::sub(u, k);
+
+        // sample k back from the head in the upper copy of the ring, the next older one just below it
+        Reg index = V::sub(V::add(lane, V::set1((float)(args.head + args.samples))), k);
+        Reg older = V::sub(index, V::set1(1.0f));
+        Reg x0 = V::gather(ringX, index);
+        Reg y0 = V::gather(ringY, index);
+        Reg hx = V::fmadd(V::sub(V::gather(ringX, older), x0), f, x0);
+        Reg hy = V::fmadd(V::sub(V::gather(ringY, older), y0), f, y0);
+
+        // age / offset of the way from the bodies to the newest sample, all the way past the offset
+        Reg w = V::fnmadd(V::max(V::sub(V::set1(args.offset), age), V::zero()), V::set1(args.invOffset), V::set1(1.0f));
+        *px = V::fmadd(V::sub(hx, cx), w, cx);
+        *py = V::fmadd(V::sub(hy, cy), w, cy);
+    }
+
+    // bodies [begin, end) against every body (vectors of sources) and ghost (one at a time) where they were when
+    // the gravity now arriving left them, no newton's third law, body i only writes its own acceleration
+    // a block of targets goes through every vector of sources before the next, so the rings of the sources are
+    // read from l1 by the whole block instead of streaming the history from memory once per target
+    template <typename V>
+    inline void retardedKernel(const SimRetardedKernelArgs& args, uint32_t begin, uint32_t end)
+    {
+        typedef typename V::Reg Reg;
+
+        uint32_t stride = 2 * args.samples;
+        alignas(64) float lanes[V::width];
+        for (uint32_t l = 0; l < V::width; l++)
+            lanes[l] = (float)(l * stride);
+        Reg lane = V::load(lanes);
+        Reg invSpeed = V::set1(args.invSpeed);
+
+        alignas(64) float accX[SIM_RETARDED_BLOCK * V::width];
+        alignas(64) float accY[SIM_RETARDED_BLOCK * V::width];
+
+        for (uint32_t i0 = begin; i0 < end; i0 += SIM_RETARDED_BLOCK)
+        {
+            uint32_t i1 = std::min(i0 + SIM_RETARDED_BLOCK, end);
+            for (uint32_t i = i0; i < i1; i++)
+            {
+                V::store(accX + (i - i0) * V::width, V::zero());
+                V::store(accY + (i - i0) * V::width, V::zero());
+            }
+
+            for (uint32_t j = 0; j < args.padded; j += V::width)
+            {
+                Reg cx = V::load(args.x + j);
+                Reg cy = V::load(args.y + j);
+                Reg mj = V::load(args.mass + j);
+                const float* ringX = args.ringX + (size_t)j * stride;
+                const float* ringY = args.ringY + (size_t)j * stride;
+
+                for (uint32_t i = i0; i < i1; i++)
+                {
+                    Reg xi = V::set1(args.x[i]);
+                    Reg yi = V::set1(args.y[i]);
+                    Reg m = mj;
+                    if (i - j < V::width)
+                    {
+                        // no force on itself, whatever its past says
+                        alignas(64) float masses[V::width];
+                        V::store(masses, m);
+                        masses[i - j] = 0.0f;
+                        m = V::load(masses);
+                    }
+
+                    // light time of the distance now, then of the distance to where that put the source
+                    Reg dx = V::sub(cx, xi);
+                    Reg dy = V::sub(cy, yi);
+                    Reg r2 = V::fmadd(dx, dx, V::mul(dy, dy));
+                    Reg age = V::mul(V::mul(r2, V::rsqrtNonZero(r2)), invSpeed);
+                    Reg px, py;
+                    retardedPosition<V>(args, ringX, ringY, lane, cx, cy, age, &px, &py);
+
+                    dx = V::sub(px, xi);
+                    dy = V::sub(py, yi);
+                    r2 = V::fmadd(dx, dx, V::mul(dy, dy));
+                    age = V::mul(V::mul(r2, V::rsqrtNonZero(r2)), invSpeed);
+                    retardedPosition<V>(args, ringX, ringY, lane, cx, cy, age, &px, &py);
+
+                    dx = V::sub(px, xi);
+                    dy = V::sub(py, yi);
+                    r2 = V::fmadd(dx, dx, V::mul(dy, dy));
+                    Reg invr = V::rsqrtNonZero(r2);
+                    Reg s = V::mul(V::mul(V::mul(m, invr), invr), invr);
+                    float* axi = accX + (i - i0) * V::width;
+                    float* ayi = accY + (i - i0) * V::width;
+                    V::store(axi, V::fmadd(s, dx, V::load(axi)));
+                    V::store(ayi, V::fmadd(s, dy, V::load(ayi)));
+                }
+            }
+
+            for (uint32_t i = i0; i < i1; i++)
+            {
+                float ax = V::sum(V::load(accX + (i - i0) * V::width));
+                float ay = V::sum(V::load(accY + (i - i0) * V::width));
+
+                // a ghost has no now, its newest sample is where it was removed, it pulls until its removal is older than the light time
+                for (uint32_t g = 0; g < args.ghosts; g++)
+                {
+                    const float* ringX = args.ringX + (size_t)(args.padded + g) * stride;
+                    const float* ringY = args.ringY + (size_t)(args.padded + g) * stride;
+                    float cx = ringX[args.head + args.samples];
+                    float cy = ringY[args.head + args.samples];
+
+                    float dx = cx - args.x[i];
+                    float dy = cy - args.y[i];
+                    float age = std::sqrt(dx * dx + dy * dy) * args.invSpeed;
+                    float px, py;
+                    retardedPosition<SimdScalar>(args, ringX, ringY, 0.0f, cx, cy, age, &px, &py);
+
+                    dx = px - args.x[i];
+                    dy = py - args.y[i];
+                    age = std::sqrt(dx * dx + dy * dy) * args.invSpeed;
+                    if (age < args.ghostAge[g]) continue;
+                    retardedPosition<SimdScalar>(args, ringX, ringY, 0.0f, cx, cy, age, &px, &py);
+
+                    dx = px - args.x[i];
+                    dy = py - args.y[i];
+                    float invr = SimdScalar::rsqrtNonZero(dx * dx + dy * dy);
+                    float s = args.ghostMass[g] * invr * invr * invr;
+                    ax += s * dx;
+                    ay += s * dy;
+                }
+
+                args.ax[i] = args.G * ax;
+                args.ay[i] = args.G * ay;
+            }
+        }
+    }
+
+    // y += x * s over [begin, end), the kicks and drifts of the float integrators, unaligned for any begin
+    template <typename V>
+    inline void addScaledKernel(float* y, const float* x, float s, uint32_t begin, uint32_t end)
+    {
+        typedef typename V::Reg Reg;
+
+        Reg vs = V::set1(s);
+        uint32_t i = begin;
+        for (; i + V::width <= end; i += V::width)
+            V::storeu(y + i, V::add(V::loadu(y + i), V::mul(V::loadu(x + i), vs)));
+        for (; i < end; i++)
+            y[i] += x[i] * s;
+    }
+
+    // stumpff functions c(z) and s(z) of every lane without branches, elliptic and hyperbolic alike: the series at
+    // z / 4^k with |z / 4^k| <= 1, then back up k times with c(4z) = (1 - z s)^2 / 2 and s(4z) = (c + s - z c s) / 4,
+    // the loops run as often as the lane of the vector that needs the most
+    template <typename D>
+    inline void stumpffKernel(typename D::Reg z, typename D::Reg* c, typename D::Reg* s)
+    {
+        typedef typename D::Reg Reg;
+        typedef typename D::Mask Mask;
+
+        // 1 / (2n + 2)! and 1 / (2n + 3)!, 10 terms are good to 1e-15 at |z| = 1
+        static const double cTerms[10] = { 1.0 / 2.0, 1.0 / 24.0, 1.0 / 720.0, 1.0 / 40320.0, 1.0 / 3628800.0, 1.0 / 479001600.0,
+            1.0 / 87178291200.0, 1.0 / 20922789888000.0, 1.0 / 6402373705728000.0, 1.0 / 2432902008176640000.0 };
+        static const double sTerms[10] = { 1.0 / 6.0, 1.0 / 120.0, 1.0 / 5040.0, 1.0 / 362880.0, 1.0 / 39916800.0, 1.0 / 6227020800.0,
+            1.0 / 1307674368000.0, 1.0 / 355687428096000.0, 1.0 / 121645100408832000.0, 1.0 / 51090942171709440000.0 };
+
+        Reg one = D::set1(1.0);
+        Reg levels = D::set1(0.0);
+        uint32_t rounds = 0;
+        for (; rounds < 64; rounds++)
+        {
+            Mask large = D::greater(D::abs(z), one);
+            if (!D::any(large)) break;
+            z = D::select(large, D::mul(z, D::set1(0.25)), z);
+            levels = D::select(large, D::add(levels, one), levels);
+        }
+
+        Reg minusZ = D::sub(D::set1(0.0), z);
+        Reg cz = D::set1(cTerms[9]);
+        Reg sz = D::set1(sTerms[9]);
+        for (int n = 8; n >= 0; n--)
+        {
+            cz = D::fmadd(cz, minusZ, D::set1(cTerms[n]));
+            sz = D::fmadd(sz, minusZ, D::set1(sTerms[n]));
+        }
+
+        for (uint32_t r = rounds; r > 0; r--)
+        {
+            Mask up = D::greater(levels, D::set1(r - 0.5));
+            Reg t = D::sub(one, D::mul(z, sz));
+            Reg c4 = D::mul(D::set1(0.5), D::mul(t, t));
+            Reg s4 = D::mul(D::set1(0.25), D::sub(D::add(cz, sz), D::mul(z, D::mul(cz, sz))));
+            cz = D::select(up, c4, cz);
+            sz = D::select(up, s4, sz);
+            z = D::select(up, D::mul(z, D::set1(4.0)), z);
+        }
+
+        *c = cz;
+        *s = sz;
+    }
+
+    // the universal kepler equation of a whole batch (kepler.h), then the positions and velocities after the step from
+    // the lagrange coefficients, lanes at the center give garbage that kepler.cpp doesn't read, returns the iterations
+    template <typename D>
+    inline uint32_t keplerKernel(SimKeplerBatch* b)
+    {
+        typedef typename D::Reg Reg;
+        typedef typename D::Mask Mask;
+        static_assert(SIM_KEPLER_BATCH % D::width == 0, "a batch is whole vectors");
+
+        // f(chi) = sigma chi^2 c + (1 - alpha r0) chi^3 s + r0 chi - sqrt(mu) dt, sigma = r0 . v0 / sqrt(mu)
+        const double order = 5.0;
+        Reg zero = D::set1(0.0);
+        Reg one = D::set1(1.0);
+        uint32_t iterations = 0;
+        for (; iterations < SIM_KEPLER_MAX_ITERATIONS; iterations++)
+        {
+            bool converged = true;
+            for (uint32_t k = 0; k < SIM_KEPLER_BATCH; k += D::width)
+            {
+                Reg chi = D::load(b->chi + k);
+                Reg alpha = D::load(b->alpha + k);
+                Reg sigma = D::load(b->sigma + k);
+                Reg r0 = D::load(b->r0 + k);
+                Reg chi2 = D::mul(chi, chi);
+                Reg z = D::mul(alpha, chi2);
+                Reg c, s;
+                stumpffKernel<D>(z, &c, &s);
+
+                Reg beta = D::sub(one, D::mul(alpha, r0));
+                Reg zs = D::sub(one, D::mul(z, s));
+                Reg f = D::sub(D::fmadd(D::mul(sigma, chi2), c, D::fmadd(D::mul(beta, D::mul(chi2, chi)), s, D::mul(r0, chi))),
+                    D::mul(D::load(b->sqrtMu + k), D::load(b->dt + k)));
+                Reg df = D::fmadd(D::mul(sigma, chi), zs, D::fmadd(D::mul(beta, chi2), c, r0));
+                Reg ddf = D::fmadd(sigma, D::sub(one, D::mul(z, c)), D::mul(D::mul(beta, chi), zs));
+
+                // laguerre-conway step, the root takes the sign of df
+                Reg root = D::sqrt(D::abs(D::sub(D::mul(D::set1((order - 1.0) * (order - 1.0)), D::mul(df, df)),
+                    D::mul(D::set1(order * (order - 1.0)), D::mul(f, ddf)))));
+                Reg denominator = D::add(df, D::select(D::greater(zero, df), D::sub(zero, root), root));
+                Reg delta = D::select(D::greater(D::abs(denominator), zero), D::div(D::mul(D::set1(order), f), denominator), zero);
+
+                D::store(b->chi + k, D::sub(chi, delta));
+                Mask moving = D::greater(D::abs(delta), D::mul(D::set1(SIM_KEPLER_TOLERANCE), D::max(D::abs(chi), D::set1(1e-300))));
+                if (D::any(moving))
+                    converged = false;
+            }
+
+            if (converged)
+                break;
+        }
+
+        // lagrange coefficients
+        for (uint32_t k = 0; k < SIM_KEPLER_BATCH; k += D::width)
+        {
+            Reg chi = D::load(b->chi + k);
+            Reg r0 = D::load(b->r0 + k);
+            Reg sqrtMu = D::load(b->sqrtMu + k);
+            Reg rx0 = D::load(b->rx + k), ry0 = D::load(b->ry + k);
+            Reg vx0 = D::load(b->vx + k), vy0 = D::load(b->vy + k);
+            Reg chi2 = D::mul(chi, chi);
+            Reg z = D::mul(D::load(b->alpha + k), chi2);
+            Reg c, s;
+            stumpffKernel<D>(z, &c, &s);
+
+            Reg f = D::sub(one, D::mul(D::div(chi2, r0), c));
+            Reg g = D::sub(D::load(b->dt + k), D::mul(D::div(D::mul(chi2, chi), sqrtMu), s));
+            Reg rx = D::fmadd(f, rx0, D::mul(g, vx0));
+            Reg ry = D::fmadd(f, ry0, D::mul(g, vy0));
+            Reg r = D::sqrt(D::fmadd(rx, rx, D::mul(ry, ry)));
+
+            Reg df = D::mul(D::div(sqrtMu, D::mul(r, r0)), D::mul(D::sub(D::mul(z, s), one), chi));
+            Reg dg = D::sub(one, D::mul(D::div(chi2, r), c));
+
+            D::store(b->nx + k, rx);
+            D::store(b->ny + k, ry);
+            D::store(b->nvx + k, D::fmadd(df, rx0, D::mul(dg, vx0)));
+            D::store(b->nvy + k, D::fmadd(df, ry0, D::mul(dg, vy0)));
+        }
+
+        return iterations + 1;
+    }
+
+    namespace sse2
+    {
+        SimVec2 accelerationOn(const float* x, const float* y, const float* mass, uint32_t paddedCount, float px, float py, float G);
+        double pairTile(const float* x, const float* y, const float* mass, float* ax, float* ay, uint32_t i0, uint32_t i1, uint32_t j0, uint32_t j1);
+        void particles(const float* x, const float* y, const float* mass, uint32_t count, const float* px, const float* py, float* ax, float* ay, uint32_t begin, uint32_t end, float G, float softening2);
+        void ensemble(const SimEnsembleKernelArgs& args, uint32_t begin, uint32_t end);
+        double smallPairs(uint32_t count, const float* x, const float* y, const float* mass, float* ax, float* ay, float G);
+        void addScaled(float* y, const float* x, float s, uint32_t begin, uint32_t end);
+        void retarded(const SimRetardedKernelArgs& args, uint32_t begin, uint32_t end);
+        uint32_t kepler(SimKeplerBatch* batch);
+        double pairTileDouble(const double* x, const double* y, const double* mass, double* ax, double* ay, uint32_t i0, uint32_t i1, uint32_t j0, uint32_t j1);
+    }
+
+    namespace avx2
+    {
+        SimVec2 accelerationOn(const float* x, const float* y, const float* mass, uint32_t paddedCount, float px, float py, float G);
+        double pairTile(const float* x, const float* y, const float* mass, float* ax, float* ay, uint32_t i0, uint32_t i1, uint32_t j0, uint32_t j1);
+        void particles(const float* x, const float* y, const float* mass, uint32_t count, const float* px, const float* py, float* ax, float* ay, uint32_t begin, uint32_t end, float G, float softening2);
+        void ensemble(const SimEnsembleKernelArgs& args, uint32_t begin, uint32_t end);
+        double smallPairs(uint32_t count, const float* x, const float* y, const float* mass, float* ax, float* ay, float G);
+        void addScaled(float* y, const float* x, float s, uint32_t begin, uint32_t end);
+        void retarded(const SimRetardedKernelArgs& args, uint32_t begin, uint32_t end);
+        uint32_t kepler(SimKeplerBatch* batch);
+        double pairTileDouble(const double* x, const double* y, const double* mass, double* ax, double* ay, uint32_t i0, uint32_t i1, uint32_t j0, uint32_t j1);
+    }
+
+    namespace avx512
+    {
+        SimVec2 accelerationOn(const float* x, const float* y, const float* mass, uint32_t paddedCount, float px, float py, float G);
+        double pairTile(const float* x, const float* y, const float* mass, float* ax, float* ay, uint32_t i0, uint32_t i1, uint32_t j0, uint32_t j1);
+        void particles(const float* x, const float* y, const float* mass, uint32_t count, const float* px, const float* py, float* ax, float* ay, uint32_t begin, uint32_t end, float G, float softening2);
+        void ensemble(const SimEnsembleKernelArgs& args, uint32_t begin, uint32_t end);
+        double smallPairs(uint32_t count, const float* x, const float* y, const float* mass, float* ax, float* ay, float G);
+        void addScaled(float* y, const float* x, float s, uint32_t begin, uint32_t end);
+        void retarded(const SimRetardedKernelArgs& args, uint32_t begin, uint32_t end);
+        uint32_t kepler(SimKeplerBatch* batch);
+        double pairTileDouble(const double* x, const double* y, const double* mass, double* ax, double* ay, uint32_t i0, uint32_t i1, uint32_t j0, uint32_t j1);
+    }
+}
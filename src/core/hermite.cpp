@@ -0,0 +1,234 @@
+#include "hermite.h"
+#include "simulation.h"
+#include "thread_pool.h"
+
+#include <cmath>
+#include <algorithm>
+
+namespace sim
+{
+    // acceleration and jerk on body i from the predicted state of every body, direct summation
+    static void evaluate(SimHermite* h, const SimBodies& bodies, uint32_t i)
+    {
+        double ax = 0.0, ay = 0.0, jx = 0.0, jy = 0.0;
+        double xi = h->px[i], yi = h->py[i], vxi = h->pvx[i], vyi = h->pvy[i];
+
+        for (uint32_t j = 0; j < bodies.count; j++)
+        {
+            double dx = h->px[j] - xi;
+            double dy = h->py[j] - yi;
+            double dvx = h->pvx[j] - vxi;
+            double dvy = h->pvy[j] - vyi;
+            double r2 = dx * dx + dy * dy;
+            if (r2 == 0.0) continue;
+
+            double invr2 = 1.0 / r2;
+            double s = bodies.mass[j] * invr2 * std::sqrt(invr2);
+            double rv = 3.0 * (dx * dvx + dy * dvy) * invr2;
+
+            ax += s * dx;
+            ay += s * dy;
+            jx += s * (dvx - rv * dx);
+            jy += s * (dvy - rv * dy);
+        }
+
+        double G = bodies.units.G;
+        h->nax[i] = G * ax;
+        h->nay[i] = G * ay;
+        h->njx[i] = G * jx;
+        h->njy[i] = G * jy;
+    }
+
+    static void predict(SimHermite* h, uint32_t count, double time)
+    {
+        parallelFor(0, count, 4096, [&](uint32_t begin, uint32_t end, uint32_t worker)
+        {
+            for (uint32_t i = begin; i < end; i++)
+            {
+                double t = time - h->time[i];
+                double t2 = t * t * 0.5;
+                double t3 = t * t2 * (1.0 / 3.0);
+
+                h->px[i] = h->x[i] + h->vx[i] * t + h->ax[i] * t2 + h->jx[i] * t3;
+                h->py[i] = h->y[i] + h->vy[i] * t + h->ay[i] * t2 + h->jy[i] * t3;
+                h->pvx[i] = h->vx[i] + h->ax[i] * t + h->jx[i] * t2;
+                h->pvy[i] = h->vy[i] + h->ay[i] * t + h->jy[i] * t2;
+            }
+        });
+    }
+
+    // largest power of two fraction of the outer step that is not bigger than dt
+    static double quantizeStep(double dt, double timeStep)
+    {
+        double step = timeStep;
+        for (uint32_t level = 0; level < SIM_HERMITE_MAX_LEVEL && step > dt; level++)
+            step *= 0.5;
+
+        return step;
+    }
+
+    static void start(SimHermite* h, const SimBodies& bodies, double timeStep)
+    {
+        uint32_t count = bodies.count;
+        h->count = count;
+        h->timeStep = timeStep;
+
+        for (std::vector<double>* v : { &h->x, &h->y, &h->vx, &h->vy, &h->time, &h->dt, &h->ax, &h->ay, &h->jx, &h->jy, &h->px, &h->py, &h->pvx, &h->pvy, &h->nax, &h->nay, &h->njx, &h->njy })
+            v->assign(count, 0.0);
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            h->x[i] = bodies.x[i];
+            h->y[i] = bodies.y[i];
+            h->vx[i] = bodies.vx[i];
+            h->vy[i] = bodies.vy[i];
+        }
+
+        predict(h, count, 0.0);
+        parallelFor(0, count, 16, [&](uint32_t begin, uint32_t end, uint32_t worker)
+        {
+            for (uint32_t i = begin; i < end; i++)
+            {
+                evaluate(h, bodies, i);
+                h->ax[i] = h->nax[i];
+                h->ay[i] = h->nay[i];
+                h->jx[i] = h->njx[i];
+                h->jy[i] = h->njy[i];
+
+                double a = std::sqrt(h->ax[i] * h->ax[i] + h->ay[i] * h->ay[i]);
+                double j = std::sqrt(h->jx[i] * h->jx[i] + h->jy[i] * h->jy[i]);
+                h->dt[i] = quantizeStep(j > 0.0 ? SIM_HERMITE_ETA_START * a / j : timeStep, timeStep);
+            }
+        });
+    }
+
+    // the double state is only kept while the bodies still hold its rounded copy,
+    // bodies moved by another integrator or edited in between start over from the floats
+    static bool inSync(const SimHermite* h, const SimBodies& bodies)
+    {
+        if (h->count != bodies.count || h->x.size() != bodies.count)
+            return false;
+
+        for (uint32_t i = 0; i < bodies.count; i++)
+        {
+            if ((float)h->x[i] != bodies.x[i] || (float)h->y[i] != bodies.y[i] || (float)h->vx[i] != bodies.vx[i] || (float)h->vy[i] != bodies.vy[i])
+                return false;
+        }
+
+        return true;
+    }
+
+    void resetHermite(SimHermite* hermite)
+    {
+        hermite->count = 0;
+        hermite->timeStep = 0.0;
+    }
+
+    uint64_t stepHermite(SimHermite* h, SimBodies* bodies, double timeStep, double eta, bool blockSteps)
+    {
+        uint32_t count = bodies->count;
+        uint64_t evaluations = 0;
+        if (count == 0) return 0;
+
+        if (h->timeStep != timeStep || h->time.size() != count || !inSync(h, *bodies))
+        {
+            start(h, *bodies, timeStep);
+            evaluations += count;
+        }
+
+        if (!blockSteps)
+        {
+            double shared = *std::min_element(h->dt.begin(), h->dt.end());
+            std::fill(h->dt.begin(), h->dt.end(), shared);
+        }
+
+        std::fill(h->time.begin(), h->time.end(), 0.0);
+        h->blocks = 0;
+        h->minStep = timeStep;
+
+        // the block times are sums of power of two fractions of the step, so they compare exactly
+        double now = 0.0;
+        while (now < timeStep)
+        {
+            double next = timeStep;
+            for (uint32_t i = 0; i < count; i++)
+                next = std::min(next, h->time[i] + h->dt[i]);
+
+            h->active.clear();
+            for (uint32_t i = 0; i < count; i++)
+            {
+                if (h->time[i] + h->dt[i] == next)
+                    h->active.push_back(i);
+            }
+
+            predict(h, count, next);
+
+            parallelFor(0, (uint32_t)h->active.size(), 16, [&](uint32_t begin, uint32_t end, uint32_t worker)
+            {
+                for (uint32_t k = begin; k < end; k++)
+                    evaluate(h, *bodies, h->active[k]);
+            });
+
+            // corrector, then the next step from the derivatives at the end of the step
+            parallelFor(0, (uint32_t)h->active.size(), 256, [&](uint32_t begin, uint32_t end, uint32_t worker)
+            {
+                for (uint32_t k = begin; k < end; k++)
+                {
+                    uint32_t i = h->active[k];
+                    double dt = next - h->time[i];
+                    double dt2 = dt * dt, dt3 = dt2 * dt;
+
+                    // second and third derivative of the acceleration at the start of the step
+                    double a2x = (-6.0 * (h->ax[i] - h->nax[i]) - dt * (4.0 * h->jx[i] + 2.0 * h->njx[i])) / dt2;
+                    double a2y = (-6.0 * (h->ay[i] - h->nay[i]) - dt * (4.0 * h->jy[i] + 2.0 * h->njy[i])) / dt2;
+                    double a3x = (12.0 * (h->ax[i] - h->nax[i]) + 6.0 * dt * (h->jx[i] + h->njx[i])) / dt3;
+                    double a3y = (12.0 * (h->ay[i] - h->nay[i]) + 6.0 * dt * (h->jy[i] + h->njy[i])) / dt3;
+
+                    h->x[i] = h->px[i] + a2x * dt2 * dt2 / 24.0 + a3x * dt2 * dt3 / 120.0;
+                    h->y[i] = h->py[i] + a2y * dt2 * dt2 / 24.0 + a3y * dt2 * dt3 / 120.0;
+                    h->vx[i] = h->pvx[i] + a2x * dt3 / 6.0 + a3x * dt2 * dt2 / 24.0;
+                    h->vy[i] = h->pvy[i] + a2y * dt3 / 6.0 + a3y * dt2 * dt2 / 24.0;
+                    bodies->x[i] = (float)h->x[i];
+                    bodies->y[i] = (float)h->y[i];
+                    bodies->vx[i] = (float)h->vx[i];
+                    bodies->vy[i] = (float)h->vy[i];
+
+                    h->ax[i] = h->nax[i];
+                    h->ay[i] = h->nay[i];
+                    h->jx[i] = h->njx[i];
+                    h->jy[i] = h->njy[i];
+                    h->time[i] = next;
+
+                    // aarseth criterion with the derivatives at the end of the step
+                    a2x += a3x * dt;
+                    a2y += a3y * dt;
+                    double a = std::sqrt(h->ax[i] * h->ax[i] + h->ay[i] * h->ay[i]);
+                    double j = std::sqrt(h->jx[i] * h->jx[i] + h->jy[i] * h->jy[i]);
+                    double a2 = std::sqrt(a2x * a2x + a2y * a2y);
+                    double a3 = std::sqrt(a3x * a3x + a3y * a3y);
+                    double denominator = j * a3 + a2 * a2;
+                    double wanted = denominator > 0.0 ? std::sqrt(eta * (a * a2 + j * j) / denominator) : timeStep;
+
+                    // smaller steps right away, a bigger step only where it stays in sync with the blocks
+                    if (wanted < dt)
+                        h->dt[i] = quantizeStep(wanted, timeStep);
+                    else if (wanted >= 2.0 * dt && 2.0 * dt <= timeStep && std::fmod(next, 2.0 * dt) == 0.0)
+                        h->dt[i] = 2.0 * dt;
+                }
+            });
+
+            if (!blockSteps)
+            {
+                double shared = *std::min_element(h->dt.begin(), h->dt.end());
+                std::fill(h->dt.begin(), h->dt.end(), shared);
+            }
+
+            evaluations += h->active.size();
+            h->blocks++;
+            now = next;
+            h->minStep = std::min(h->minStep, *std::min_element(h->dt.begin(), h->dt.end()));
+        }
+
+        return evaluations;
+    }
+}
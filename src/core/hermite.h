@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "bodies.h"
+
+// 4th order hermite predictor-corrector with hierarchical (power of two) block timesteps
+// every body gets its own step timeStep / 2^k from its acceleration and jerk (aarseth criterion),
+// a block only evaluates the forces on the bodies whose step ends there, all bodies are in sync
+// again at the end of the (outer) step
+// the state is kept in double between outer steps as long as nothing else moves the bodies
+
+#define SIM_HERMITE_MAX_LEVEL 24     /* smallest block step is timeStep / 2^24 */
+#define SIM_HERMITE_ETA 0.02f        /* default accuracy parameter of the timestep criterion */
+#define SIM_HERMITE_ETA_START 0.01   /* first step, |a| / |j| times this */
+
+struct SimHermite
+{
+    uint32_t count = 0;     // bodies the state was set up for, the state is set up again when the bodies change
+    double timeStep = 0.0;  // outer step the block steps are fractions of
+
+    // per body, times are relative to the start of the outer step
+    std::vector<double> x, y, vx, vy;       // state at time, the bodies hold its rounded copy
+    std::vector<double> time, dt;
+    std::vector<double> ax, ay, jx, jy;     // acceleration and jerk at time
+    std::vector<double> px, py, pvx, pvy;   // predicted position and velocity at the current block time
+    std::vector<double> nax, nay, njx, njy; // acceleration and jerk at the block time, active bodies only
+    std::vector<uint32_t> active;
+
+    // statistics of the last outer step
+    uint32_t blocks = 0;
+    double minStep = 0.0;
+};
+
+namespace sim
+{
+    // the next step sets the state up again (after editing masses or velocities)
+    void resetHermite(SimHermite* hermite);
+
+    // advances every body by timeStep (in the units of the bodies, like the steps above), blockSteps false moves all bodies with the smallest step
+    // returns the number of single body force evaluations
+    uint64_t stepHermite(SimHermite* hermite, SimBodies* bodies, double timeStep, double eta, bool blockSteps);
+}
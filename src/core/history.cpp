@@ -0,0 +1,388 @@
+#include "history.h"
+#include "gravity_kernels.h"
+#include "kepler.h"
+#include "thread_pool.h"
+
+#include <cmath>
+#include <algorithm>
+#include <unordered_map>
+
+// SIM_SIMD_LEVEL is set by cmake (SIM_SIMD option): 0 scalar only, 1 sse2, 2 avx2, 3 avx512
+#ifndef SIM_SIMD_LEVEL
+#define SIM_SIMD_LEVEL 0
+#endif
+
+namespace sim
+{
+    static const uint32_t s_NoBody = UINT32_MAX; // id of the padding rings
+
+    void clearHistory(SimHistory* history)
+    {
+        *history = SimHistory{};
+    }
+
+    size_t getHistoryBytes(const SimHistory& history)
+    {
+        return (history.x.size() + history.y.size()) * sizeof(float);
+    }
+
+    static void writeSample(SimHistory* history, uint32_t ring, uint32_t slot, float x, float y)
+    {
+        size_t base = (size_t)ring * 2 * history->samples;
+        history->x[base + slot] = x;
+        history->x[base + slot + history->samples] = x;
+        history->y[base + slot] = y;
+        history->y[base + slot + history->samples] = y;
+    }
+
+    // the light time across the system (bodies and ghosts) in samples, plus the two samples around it
+    static uint32_t requiredSamples(const SimHistory& history, const SimBodies& bodies, double interval, double speed)
+    {
+        float minX = INFINITY, minY = INFINITY, maxX = -INFINITY, maxY = -INFINITY;
+        for (uint32_t i = 0; i < bodies.count; i++)
+        {
+            minX = std::min(minX, bodies.x[i]);
+            maxX = std::max(maxX, bodies.x[i]);
+            minY = std::min(minY, bodies.y[i]);
+            maxY = std::max(maxY, bodies.y[i]);
+        }
+
+        for (uint32_t g = 0; g < history.ghosts; g++)
+        {
+            size_t newest = (size_t)(history.padded + g) * 2 * history.samples + history.head;
+            minX = std::min(minX, history.x[newest]);
+            maxX = std::max(maxX, history.x[newest]);
+            minY = std::min(minY, history.y[newest]);
+            maxY = std::max(maxY, history.y[newest]);
+        }
+
+        double size = bodies.count + history.ghosts > 0 ? std::hypot((double)maxX - minX, (double)maxY - minY) : 0.0;
+        double needed = std::ceil(size / speed / interval) + 2.0;
+
+        uint32_t samples = SIM_HISTORY_MIN_SAMPLES;
+        while (samples < SIM_HISTORY_MAX_SAMPLES && samples < needed)
+            samples *= 2;
+        return samples;
+    }
+
+    // the past of bodies that have none yet: two-body orbits around the sun run backwards (straight lines without one),
+    // a sample k steps back for every slot
+    static void fillPast(SimHistory* history, const SimBodies& bodies, const std::vector<uint32_t>& indices)
+    {
+        uint32_t n = (uint32_t)indices.size();
+        if (n == 0) return;
+
+        std::vector<float> x0(n), y0(n), vx0(n), vy0(n), mass(n);
+        for (uint32_t k = 0; k < n; k++)
+        {
+            x0[k] = bodies.x[indices[k]];
+            y0[k] = bodies.y[indices[k]];
+            vx0[k] = bodies.vx[indices[k]];
+            vy0[k] = bodies.vy[indices[k]];
+            mass[k] = bodies.mass[indices[k]];
+        }
+
+        SimKeplerCenter center;
+        bool kepler = getSunCenter(bodies, &center);
+
+        std::vector<float> x(n), y(n), vx(n), vy(n);
+        for (uint32_t s = 0; s < history->samples; s++)
+        {
+            double age = s * history->interval;
+            x = x0;
+            y = y0;
+            vx = vx0;
+            vy = vy0;
+            if (s > 0 && kepler)
+            {
+                propagateKepler(getKernel(), center, bodies.units.G, -age, x.data(), y.data(), vx.data(), vy.data(), mass.data(), n);
+            }
+            else
+            {
+                for (uint32_t k = 0; k < n; k++)
+                {
+                    x[k] = (float)(x0[k] - vx0[k] * age);
+                    y[k] = (float)(y0[k] - vy0[k] * age);
+                }
+            }
+
+            uint32_t slot = (history->head - s) & (history->samples - 1);
+            for (uint32_t k = 0; k < n; k++)
+                writeSample(history, indices[k], slot, x[k], y[k]);
+        }
+    }
+
+    // rings in the order of the bodies again: kept rings move to their body, new bodies get a past and the rings of
+    // bodies that are gone become ghosts removed at time
+    static void matchBodies(SimHistory* history, const SimBodies& bodies, double time)
+    {
+        uint32_t count = bodies.count;
+        bool same = history->count == count;
+        for (uint32_t i = 0; same && i < count; i++)
+            same = history->id[i] == bodies.id[i];
+        if (same) return;
+
+        std::unordered_map<uint32_t, uint32_t> rings;
+        for (uint32_t r = 0; r < history->count; r++)
+            rings[history->id[r]] = r;
+
+        uint32_t stride = 2 * history->samples;
+        uint32_t padded = paddedCount(count);
+        std::vector<uint8_t> kept(history->count, 0);
+        std::vector<uint32_t> added;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            auto found = rings.find(bodies.id[i]);
+            if (found == rings.end())
+                added.push_back(i);
+            else
+                kept[found->second] = 1;
+        }
+
+        uint32_t ghosts = history->ghosts;
+        for (uint32_t r = 0; r < history->count; r++)
+            ghosts += kept[r] ? 0 : 1;
+
+        SimArray<float> x((size_t)(padded + ghosts) * stride, 0.0f), y((size_t)(padded + ghosts) * stride, 0.0f);
+        std::vector<uint32_t> id(padded + ghosts, s_NoBody);
+        std::vector<float> mass(padded + ghosts, 0.0f);
+        std::vector<double> removed;
+
+        auto copyRing = [&](uint32_t from, uint32_t to)
+        {
+            std::copy(history->x.begin() + (size_t)from * stride, history->x.begin() + (size_t)(from + 1) * stride, x.begin() + (size_t)to * stride);
+            std::copy(history->y.begin() + (size_t)from * stride, history->y.begin() + (size_t)(from + 1) * stride, y.begin() + (size_t)to * stride);
+            id[to] = history->id[from];
+            mass[to] = history->mass[from];
+        };
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            auto found = rings.find(bodies.id[i]);
+            if (found != rings.end())
+                copyRing(found->second, i);
+            id[i] = bodies.id[i];
+            mass[i] = bodies.mass[i];
+        }
+
+        uint32_t ghost = padded;
+        for (uint32_t r = 0; r < history->count; r++)
+        {
+            if (kept[r]) continue;
+            copyRing(r, ghost++);
+            removed.push_back(time);
+        }
+
+        for (uint32_t g = 0; g < history->ghosts; g++)
+        {
+            copyRing(history->padded + g, ghost++);
+            removed.push_back(history->removed[g]);
+        }
+
+        history->x.swap(x);
+        history->y.swap(y);
+        history->id.swap(id);
+        history->mass.swap(mass);
+        history->removed.swap(removed);
+        history->count = count;
+        history->padded = padded;
+        history->ghosts = ghosts;
+
+        fillPast(history, bodies, added);
+    }
+
+    // every ring at a new size and sample interval, each new sample a lookup in the old rings (the oldest for
+    // ages past their end), the head is the same newest sample
+    static void resample(SimHistory* history, uint32_t samples, double interval)
+    {
+        SimHistory old = std::move(*history);
+        uint32_t rings = old.padded + old.ghosts;
+
+        *history = SimHistory{};
+        history->count = old.count;
+        history->padded = old.padded;
+        history->ghosts = old.ghosts;
+        history->samples = samples;
+        history->head = 0;
+        history->interval = interval;
+        history->time = old.time;
+        history->x.assign((size_t)rings * 2 * samples, 0.0f);
+        history->y.assign((size_t)rings * 2 * samples, 0.0f);
+        history->id = std::move(old.id);
+        history->mass = std::move(old.mass);
+        history->removed = std::move(old.removed);
+
+        for (uint32_t r = 0; r < rings; r++)
+        {
+            if (r >= old.count && r < old.padded) continue;
+
+            for (uint32_t s = 0; s < samples; s++)
+            {
+                // offset 0 never reads the positions now
+                SimVec2 p = getRetardedPosition(old, r, 0.0f, 0.0f, 0.0, s * interval);
+                writeSample(history, r, (0 - s) & (samples - 1), p.x, p.y);
+            }
+        }
+    }
+
+    void syncHistory(SimHistory* history, const SimBodies& bodies, double time, double interval, double speed)
+    {
+        double c = speed * bodies.units.time / bodies.units.length;
+        if (c <= 0.0 || interval <= 0.0) return;
+
+        // nothing yet, or a history of another run (the ids start over after clearBodies)
+        if (history->samples == 0 || std::fabs(history->time - time) > 1e-6 * interval)
+        {
+            clearHistory(history);
+            history->samples = requiredSamples(*history, bodies, interval, c);
+            history->interval = interval;
+            history->time = time;
+        }
+
+        matchBodies(history, bodies, time);
+
+        uint32_t samples = std::max(history->samples, requiredSamples(*history, bodies, interval, c));
+        if (samples != history->samples || interval != history->interval)
+            resample(history, samples, interval);
+    }
+
+    void recordHistory(SimHistory* history, const SimBodies& bodies, double time, double speed)
+    {
+        double c = speed * bodies.units.time / bodies.units.length;
+        if (history->samples == 0 || c <= 0.0) return;
+
+        // collisions of the step merged or added bodies, the past of new ones ends at the new head
+        uint32_t previous = history->head;
+        history->head = (history->head + 1) & (history->samples - 1);
+        history->time = time;
+        matchBodies(history, bodies, time);
+
+        uint32_t stride = 2 * history->samples;
+        for (uint32_t i = 0; i < bodies.count; i++)
+        {
+            writeSample(history, i, history->head, bodies.x[i], bodies.y[i]);
+            history->mass[i] = bodies.mass[i];
+        }
+
+        // a ghost stays where it was removed, drop it once the news passed the furthest body
+        for (uint32_t g = 0; g < history->ghosts; )
+        {
+            uint32_t ring = history->padded + g;
+            float gx = history->x[(size_t)ring * stride + previous];
+            float gy = history->y[(size_t)ring * stride + previous];
+            writeSample(history, ring, history->head, gx, gy);
+
+            double reach = (time - history->removed[g]) * c;
+            bool heard = true;
+            for (uint32_t i = 0; heard && i < bodies.count; i++)
+            {
+                double dx = (double)bodies.x[i] - gx, dy = (double)bodies.y[i] - gy;
+                heard = dx * dx + dy * dy < reach * reach;
+            }
+
+            if (!heard)
+            {
+                g++;
+                continue;
+            }
+
+            // the last ghost takes its place
+            uint32_t last = history->padded + history->ghosts - 1;
+            std::copy(history->x.begin() + (size_t)last * stride, history->x.begin() + (size_t)(last + 1) * stride, history->x.begin() + (size_t)ring * stride);
+            std::copy(history->y.begin() + (size_t)last * stride, history->y.begin() + (size_t)(last + 1) * stride, history->y.begin() + (size_t)ring * stride);
+            history->id[ring] = history->id[last];
+            history->mass[ring] = history->mass[last];
+            history->removed[g] = history->removed.back();
+
+            history->ghosts--;
+            history->x.resize((size_t)(last) * stride);
+            history->y.resize((size_t)(last) * stride);
+            history->id.pop_back();
+            history->mass.pop_back();
+            history->removed.pop_back();
+        }
+    }
+
+    static SimRetardedKernelArgs makeArgs(const SimHistory& history, double offset)
+    {
+        SimRetardedKernelArgs args = {};
+        args.ringX = history.x.data();
+        args.ringY = history.y.data();
+        args.padded = history.padded;
+        args.ghosts = history.ghosts;
+        args.samples = history.samples;
+        args.head = history.head;
+        args.offset = (float)offset;
+        args.invOffset = offset > 0.0 ? (float)(1.0 / offset) : 0.0f;
+        args.invInterval = (float)(1.0 / history.interval);
+        return args;
+    }
+
+    SimVec2 getRetardedPosition(const SimHistory& history, uint32_t ring, float x, float y, double offset, double age)
+    {
+        const float* ringX = history.x.data() + (size_t)ring * 2 * history.samples;
+        const float* ringY = history.y.data() + (size_t)ring * 2 * history.samples;
+        if (ring >= history.padded)
+        {
+            x = ringX[history.head + history.samples];
+            y = ringY[history.head + history.samples];
+        }
+
+        SimVec2 p;
+        retardedPosition<SimdScalar>(makeArgs(history, offset), ringX, ringY, 0.0f, x, y, (float)age, &p.x, &p.y);
+        return p;
+    }
+
+    void computeAccelerationsRetarded(SimKernel kernel, const SimHistory& history, const SimBodies& bodies, double speed, double elapsed, float* ax, float* ay)
+    {
+        uint32_t count = bodies.count;
+        uint32_t padded = paddedCount(count);
+
+        // rings of other bodies (or none), gravity is instantaneous until the next syncHistory
+        double c = speed * bodies.units.time / bodies.units.length;
+        if (history.samples == 0 || history.count != count || c <= 0.0)
+        {
+            computeAccelerationsPairwise(kernel, bodies, ax, ay);
+            return;
+        }
+
+        // a ghost is gone for ages below the time since its removal
+        std::vector<float> ghostAge(history.ghosts);
+        for (uint32_t g = 0; g < history.ghosts; g++)
+            ghostAge[g] = (float)(history.time + elapsed - history.removed[g]);
+
+        SimRetardedKernelArgs args = makeArgs(history, elapsed);
+        args.x = bodies.x.data();
+        args.y = bodies.y.data();
+        args.mass = bodies.mass.data();
+        args.ghostMass = history.mass.data() + history.padded;
+        args.ghostAge = ghostAge.data();
+        args.ax = ax;
+        args.ay = ay;
+        args.invSpeed = (float)(1.0 / c);
+        args.G = (float)bodies.units.G;
+
+        parallelFor(0, count, SIM_RETARDED_BLOCK, [&](uint32_t begin, uint32_t end, uint32_t worker)
+        {
+            switch (kernel)
+            {
+#if SIM_SIMD_LEVEL >= 1
+            case Sim_Kernel_Sse2:   { sse2::retarded(args, begin, end); break; }
+#endif
+#if SIM_SIMD_LEVEL >= 2
+            case Sim_Kernel_Avx2:   { avx2::retarded(args, begin, end); break; }
+#endif
+#if SIM_SIMD_LEVEL >= 3
+            case Sim_Kernel_Avx512: { avx512::retarded(args, begin, end); break; }
+#endif
+            default: { retardedKernel<SimdScalar>(args, begin, end); break; }
+            }
+        });
+
+        for (uint32_t i = count; i < padded; i++)
+        {
+            ax[i] = 0.0f;
+            ay[i] = 0.0f;
+        }
+    }
+}
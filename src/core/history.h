@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "bodies.h"
+#include "gravity.h"
+
+// finite speed of gravity: body i feels body j where j was at the retarded time t - r / c, r being the distance
+// between i now and j then (the past light cone of i, one fixed point iteration from the distance now)
+// the past comes from a ring of positions per body, one sample per time step, so a lookup is an index and a lerp
+// between two samples, and the positions between the newest sample and the stage of the step being evaluated are a
+// lerp from the newest sample to the bodies themselves
+// removed bodies stay in the history as ghosts that keep pulling from where they were until the news of their removal
+// reached every body, bodies that are added (or fragments of a collision) get a past of two-body orbits around the sun
+// only positions have a past: mass changes are felt everywhere at once, and the test particles feel the bodies where they are
+
+#define SIM_HISTORY_MIN_SAMPLES 4      /* ring size when the light time across the system is a step or two */
+#define SIM_HISTORY_MAX_SAMPLES 1024   /* most samples per body, older positions are clamped to the oldest */
+#define SIM_RETARDED_BLOCK 64          /* bodies that go through every vector of sources together (their rings stay in l1) */
+
+struct SimHistory
+{
+    uint32_t count = 0;      // bodies the rings belong to, in the order of the bodies
+    uint32_t padded = 0;     // paddedCount(count), the rings of the padding are zero like the bodies
+    uint32_t ghosts = 0;     // rings after the padded ones, of removed bodies
+    uint32_t samples = 0;    // ring size, a power of two, 0 when the history is off
+    uint32_t head = 0;       // slot of the newest sample
+    double interval = 0.0;   // time between samples, the time step (units of the bodies)
+    double time = 0.0;       // time of the newest sample
+
+    // [ring * 2 * samples + slot], every sample is stored at slot and slot + samples so two neighbouring samples
+    // are always next to each other whatever the head
+    SimArray<float> x, y;
+
+    std::vector<uint32_t> id;       // id of the body of every ring (padded + ghosts)
+    std::vector<float> mass;        // mass of the body at the last sample, the mass a ghost pulls with
+    std::vector<double> removed;    // [ghost], time the body was removed
+};
+
+// pointers into the history and the bodies for the kernels (gravity_kernels.h), times in the units of the bodies
+struct SimRetardedKernelArgs
+{
+    const float* x;          // bodies now (padded)
+    const float* y;
+    const float* mass;
+    const float* ringX;      // SimHistory::x, y
+    const float* ringY;
+    const float* ghostMass;  // [ghost]
+    const float* ghostAge;   // [ghost], age below which the ghost is already gone (time since its removal)
+    float* ax;
+    float* ay;
+    uint32_t padded, ghosts;
+    uint32_t samples, head;
+    float invSpeed;          // 1 / c
+    float offset;            // time from the newest sample to the positions of the bodies, may be negative
+    float invOffset;         // 1 / offset when the offset is positive, else 0
+    float invInterval;
+    float G;
+};
+
+namespace sim
+{
+    // drops every ring, the next syncHistory starts over from the bodies
+    void clearHistory(SimHistory* history);
+
+    // before a step at time with steps of interval (units of the bodies) and gravity at speed (m/s):
+    // matches the rings to the bodies by id (new bodies get a past, removed ones turn into ghosts), resamples the
+    // rings when the time step changed and grows them until they reach back the light time across the system
+    void syncHistory(SimHistory* history, const SimBodies& bodies, double time, double interval, double speed);
+
+    // after the step: the bodies (after collisions) become the newest sample at time, ghosts whose removal every body
+    // has heard of are dropped
+    void recordHistory(SimHistory* history, const SimBodies& bodies, double time, double speed);
+
+    // where the body of ring (padded + ghost for ghosts) was age before the newest sample plus offset, positions
+    // (x, y) are the body now, for ghosts they are ignored
+    SimVec2 getRetardedPosition(const SimHistory& history, uint32_t ring, float x, float y, double offset, double age);
+
+    // accelerations of the bodies from the bodies and ghosts where they were at the retarded time, speed in m/s,
+    // elapsed is the time since the newest sample the positions of the bodies are at (a stage of a step),
+    // O(N^2) without newton's third law (the delays of a pair aren't symmetric), the same bits for any thread count
+    void computeAccelerationsRetarded(SimKernel kernel, const SimHistory& history, const SimBodies& bodies, double speed, double elapsed, float* ax, float* ay);
+
+    // bytes of the rings
+    size_t getHistoryBytes(const SimHistory& history);
+}
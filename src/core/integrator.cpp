@@ -0,0 +1,347 @@
+#include "integrator.h"
+#include "simulation.h"
+#include "gravity.h"
+#include "thread_pool.h"
+#include "kepler.h"
+#include "encounter.h"
+#include "diagnostics.h"
+
+#include <cmath>
+#include <type_traits>
+
+namespace sim
+{
+    template <typename P, typename V>
+    static void kick(uint32_t count, P* vx, P* vy, const V* ax, const V* ay, V dt)
+    {
+        if constexpr (std::is_same<P, float>::value && std::is_same<V, float>::value)
+        {
+            SimKernel kernel = getKernel();
+            parallelFor(0, count, 4096, [&](uint32_t begin, uint32_t end, uint32_t worker)
+            {
+                addScaled(kernel, vx, ax, dt, begin, end);
+                addScaled(kernel, vy, ay, dt, begin, end);
+            });
+            return;
+        }
+
+        parallelFor(0, count, 4096, [&](uint32_t begin, uint32_t end, uint32_t worker)
+        {
+            for (uint32_t i = begin; i < end; i++)
+            {
+                addTo(&vx[i], ax[i] * dt);
+                addTo(&vy[i], ay[i] * dt);
+            }
+        });
+    }
+
+    template <typename P, typename V>
+    static void drift(uint32_t count, P* x, P* y, const P* vx, const P* vy, V dt)
+    {
+        if constexpr (std::is_same<P, float>::value && std::is_same<V, float>::value)
+        {
+            SimKernel kernel = getKernel();
+            parallelFor(0, count, 4096, [&](uint32_t begin, uint32_t end, uint32_t worker)
+            {
+                addScaled(kernel, x, vx, dt, begin, end);
+                addScaled(kernel, y, vy, dt, begin, end);
+            });
+            return;
+        }
+
+        parallelFor(0, count, 4096, [&](uint32_t begin, uint32_t end, uint32_t worker)
+        {
+            for (uint32_t i = begin; i < end; i++)
+            {
+                addTo(&x[i], value(vx[i]) * dt);
+                addTo(&y[i], value(vy[i]) * dt);
+            }
+        });
+    }
+
+    // forces(elapsed, &ax, &ay) points ax and ay at the accelerations of the current positions, computing them
+    // when *forcesCurrent is false, the drifts clear it, elapsed is the time the drifts moved them since the start of the step
+    template <typename P, typename V, typename Forces>
+    static void splitting(const SimIntegratorDesc& desc, double dt, uint32_t count, P* x, P* y, P* vx, P* vy, bool* forcesCurrent, const Forces& forces)
+    {
+        double elapsed = 0.0;
+        for (uint32_t s = 0; s <= desc.stages; s++)
+        {
+            if (desc.kick[s] != 0.0)
+            {
+                const V* ax;
+                const V* ay;
+                forces(elapsed, &ax, &ay);
+                kick<P, V>(count, vx, vy, ax, ay, (V)(desc.kick[s] * dt));
+            }
+
+            if (s < desc.stages)
+            {
+                drift<P, V>(count, x, y, vx, vy, (V)(desc.drift[s] * dt));
+                elapsed += desc.drift[s] * dt;
+                *forcesCurrent = false;
+            }
+        }
+    }
+
+    // loads the state from the bodies unless they still hold its rounded copy
+    template <typename P, typename V>
+    static void syncState(SimState<P, V>* state, const SimBodies& bodies)
+    {
+        uint32_t count = bodies.count;
+        bool inSync = state->count == count && state->x.size() == count;
+        for (uint32_t i = 0; inSync && i < count; i++)
+        {
+            inSync = rounded(state->x[i]) == bodies.x[i] && rounded(state->y[i]) == bodies.y[i] &&
+                rounded(state->vx[i]) == bodies.vx[i] && rounded(state->vy[i]) == bodies.vy[i];
+        }
+
+        if (inSync) return;
+
+        state->count = count;
+        state->forcesCurrent = false;
+        for (SimArray<P>* v : { &state->x, &state->y, &state->vx, &state->vy })
+            v->resize(count);
+        for (SimArray<V>* v : { &state->ax, &state->ay })
+            v->resize(count);
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            load(&state->x[i], bodies.x[i]);
+            load(&state->y[i], bodies.y[i]);
+            load(&state->vx[i], bodies.vx[i]);
+            load(&state->vy[i], bodies.vy[i]);
+        }
+    }
+
+    template <typename P, typename V>
+    static void storeState(const SimState<P, V>& state, SimBodies* bodies, bool velocities)
+    {
+        parallelFor(0, state.count, 4096, [&](uint32_t begin, uint32_t end, uint32_t worker)
+        {
+            for (uint32_t i = begin; i < end; i++)
+            {
+                bodies->x[i] = rounded(state.x[i]);
+                bodies->y[i] = rounded(state.y[i]);
+                if (!velocities) continue;
+
+                bodies->vx[i] = rounded(state.vx[i]);
+                bodies->vy[i] = rounded(state.vy[i]);
+            }
+        });
+    }
+
+    // after the step, potential is the energy of the force pass at the final positions or nan
+    template <typename P>
+    static void sampleDiagnostics(SimWorld* world, const P* x, const P* y, const P* vx, const P* vy, double potential)
+    {
+        SimConservation sample = measureConservation(world->bodies, x, y, vx, vy, potential);
+        recordConservation(&world->diagnostics, sample, world->bodies.count, !std::isnan(potential));
+    }
+
+    template <typename P, typename V>
+    static void stepState(SimWorld* world, SimState<P, V>* state, const SimSettings& settings, const SimIntegratorDesc& desc, double timeStep, bool stateForces)
+    {
+        SimBodies& bodies = world->bodies;
+        syncState(state, bodies);
+
+        SimEncounters& encounters = world->encounters;
+        bool pairs = !encounters.pairs.empty();
+        if (pairs)
+            beginEncounters<P, V>(&encounters, bodies, state->x.data(), state->y.data(), state->vx.data(), state->vy.data());
+
+        uint32_t count = state->count;
+        auto computeStateForces = [&](double elapsed)
+        {
+            if (state->forcesCurrent) return;
+
+            if (stateForces && settings.solver == Sim_Solver_Direct && settings.gravitySpeed <= 0.0f)
+            {
+                computeAccelerationsState(bodies, state->x.data(), state->y.data(), state->ax.data(), state->ay.data(), &state->potential);
+            }
+            else
+            {
+                // the solvers and their vector kernels work on the rounded positions
+                storeState(*state, &bodies, false);
+                computeForces(world, settings, elapsed);
+                for (uint32_t i = 0; i < count; i++)
+                {
+                    state->ax[i] = world->ax[i];
+                    state->ay[i] = world->ay[i];
+                }
+                state->potential = world->potential;
+            }
+
+            world->evaluations += count;
+            state->forcesCurrent = true;
+        };
+
+        splitting<P, V>(desc, timeStep, count, state->x.data(), state->y.data(), state->vx.data(), state->vy.data(), &state->forcesCurrent,
+            [&](double elapsed, const V** ax, const V** ay)
+            {
+                computeStateForces(elapsed);
+
+                if (pairs)
+                    removePairForces<P, V>(encounters, bodies, state->x.data(), state->y.data(), state->ax.data(), state->ay.data());
+
+                *ax = state->ax.data();
+                *ay = state->ay.data();
+            });
+
+        // the pairs move the forces of the last kick but not its potential
+        bool stalePotential = pairs && state->forcesCurrent;
+        if (pairs)
+            endEncounters<P, V>(&encounters, bodies, timeStep, state->x.data(), state->y.data(), state->vx.data(), state->vy.data(),
+                state->ax.data(), state->ay.data(), state->forcesCurrent);
+
+        // a splitting that ends on a drift (euler, forest-ruth) gets the forces of the next step's first kick now
+        if (settings.diagnostics)
+        {
+            computeStateForces(timeStep);
+            sampleDiagnostics(world, state->x.data(), state->y.data(), state->vx.data(), state->vy.data(), stalePotential ? std::nan("") : state->potential);
+        }
+
+        storeState(*state, &bodies, true);
+
+        world->forcesCurrent = false;
+    }
+
+    static void stepSplitting(SimWorld* world, const SimSettings& settings, const SimIntegratorDesc& desc, double timeStep)
+    {
+        // close pairs of the step, their relative orbits are regularized around the splitting
+        // (not with the finite speed of gravity, the pair forces they take out are instantaneous)
+        findEncounters(&world->encounters, world->bodies, settings.gravitySpeed > 0.0f ? 0.0f : settings.encounterHill);
+
+        switch (settings.precision)
+        {
+        case Sim_Precision_Kahan:
+        {
+            // float forces from the rounded positions are as good as the state's own float forces,
+            // the compensation is in the small updates that plain floats round away
+            stepState(world, &world->kahanState, settings, desc, timeStep, false);
+            break;
+        }
+        case Sim_Precision_Double:
+        {
+            stepState(world, &world->doubleState, settings, desc, timeStep, true);
+            break;
+        }
+        default:
+        {
+            // the bodies are the state, forces from the selected solver and its vector kernels
+            SimBodies& bodies = world->bodies;
+            SimEncounters& encounters = world->encounters;
+            bool pairs = !encounters.pairs.empty();
+            if (pairs)
+                beginEncounters<float, float>(&encounters, bodies, bodies.x.data(), bodies.y.data(), bodies.vx.data(), bodies.vy.data());
+
+            auto computeBodyForces = [&](double elapsed)
+            {
+                if (!world->forcesCurrent || world->ax.size() != paddedCount(bodies.count))
+                {
+                    computeForces(world, settings, elapsed);
+                    world->evaluations += bodies.count;
+                    world->forcesCurrent = true;
+                }
+            };
+
+            splitting<float, float>(desc, timeStep, bodies.count, bodies.x.data(), bodies.y.data(), bodies.vx.data(), bodies.vy.data(), &world->forcesCurrent,
+                [&](double elapsed, const float** ax, const float** ay)
+                {
+                    computeBodyForces(elapsed);
+
+                    if (pairs)
+                        removePairForces<float, float>(encounters, bodies, bodies.x.data(), bodies.y.data(), world->ax.data(), world->ay.data());
+
+                    *ax = world->ax.data();
+                    *ay = world->ay.data();
+                });
+
+            bool stalePotential = pairs && world->forcesCurrent;
+            if (pairs)
+                endEncounters<float, float>(&encounters, bodies, timeStep, bodies.x.data(), bodies.y.data(), bodies.vx.data(), bodies.vy.data(),
+                    world->ax.data(), world->ay.data(), world->forcesCurrent);
+
+            if (settings.diagnostics)
+            {
+                computeBodyForces(timeStep);
+                sampleDiagnostics(world, bodies.x.data(), bodies.y.data(), bodies.vx.data(), bodies.vy.data(), stalePotential ? std::nan("") : world->potential);
+            }
+            break;
+        }
+        }
+    }
+
+    static void stepHermiteWorld(SimWorld* world, const SimSettings& settings, const SimIntegratorDesc& desc, double timeStep)
+    {
+        world->evaluations += stepHermite(&world->hermite, &world->bodies, timeStep, settings.hermiteEta, settings.blockSteps);
+        world->forcesCurrent = false;
+
+        // the double state the bodies were rounded from
+        const SimHermite& hermite = world->hermite;
+        if (settings.diagnostics && hermite.count == world->bodies.count)
+            sampleDiagnostics(world, hermite.x.data(), hermite.y.data(), hermite.vx.data(), hermite.vy.data(), std::nan(""));
+    }
+
+    static void stepDormandPrinceWorld(SimWorld* world, const SimSettings& settings, const SimIntegratorDesc& desc, double timeStep)
+    {
+        world->evaluations += stepDormandPrince(&world->dormandPrince, &world->bodies, timeStep, settings.tolerance);
+        world->forcesCurrent = false;
+
+        // the double state the bodies were rounded from
+        const SimDormandPrince& dp = world->dormandPrince;
+        if (settings.diagnostics && dp.count == world->bodies.count)
+            sampleDiagnostics(world, dp.x.data(), dp.y.data(), dp.vx.data(), dp.vy.data(), std::nan(""));
+    }
+
+    static void stepKeplerWorld(SimWorld* world, const SimSettings& settings, const SimIntegratorDesc& desc, double timeStep)
+    {
+        SimBodies& bodies = world->bodies;
+        SimKeplerCenter center;
+
+        // without a sun everything moves in a straight line
+        if (!getSunCenter(bodies, &center))
+            center = { 0.0, 0.0, 0.0, 0.0, 0.0 };
+
+        propagateKepler(getKernel(), center, bodies.units.G, timeStep, bodies.x.data(), bodies.y.data(), bodies.vx.data(), bodies.vy.data(), bodies.mass.data(), bodies.count);
+        world->forcesCurrent = false;
+
+        if (settings.diagnostics)
+            sampleDiagnostics(world, bodies.x.data(), bodies.y.data(), bodies.vx.data(), bodies.vy.data(), std::nan(""));
+    }
+
+    // triple jump: 1 / (2 - 2^(1/3)), 1 - 2 / (2 - 2^(1/3)), yoshida 6 solution A: w3, w2, w1, w0
+    static const SimIntegratorDesc s_Integrators[Sim_Integrator_Count] =
+    {
+        { "euler", 1, true, stepSplitting, 1, { 1.0 }, { 1.0, 0.0 } },
+        { "leapfrog", 2, true, stepSplitting, 1, { 1.0 }, { 0.5, 0.5 } },
+        { "yoshida4", 4, true, stepSplitting, 3,
+            { 1.3512071919596578, -1.7024143839193155, 1.3512071919596578 },
+            { 0.6756035959798289, -0.17560359597982889, -0.17560359597982889, 0.6756035959798289 } },
+        { "yoshida6", 6, true, stepSplitting, 7,
+            { 0.78451361047756, 0.235573213359357, -1.17767998417887, 1.3151863206839063, -1.17767998417887, 0.235573213359357, 0.78451361047756 },
+            { 0.39225680523878, 0.5100434119184585, -0.47105338540975655, 0.0687531682525181, 0.0687531682525181, -0.47105338540975655, 0.5100434119184585, 0.39225680523878 } },
+        { "forest-ruth", 4, true, stepSplitting, 4,
+            { 0.6756035959798289, -0.17560359597982889, -0.17560359597982889, 0.6756035959798289 },
+            { 0.0, 1.3512071919596578, -1.7024143839193155, 1.3512071919596578, 0.0 } },
+        { "hermite", 4, false, stepHermiteWorld, 0, {}, {} },
+        { "dormand-prince", 5, false, stepDormandPrinceWorld, 0, {}, {} },
+        { "kepler", 0, true, stepKeplerWorld, 0, {}, {} },
+    };
+
+    const SimIntegratorDesc& getIntegrator(SimIntegrator integrator)
+    {
+        if (integrator < 0 || integrator >= Sim_Integrator_Count)
+            integrator = Sim_Integrator_Euler;
+
+        return s_Integrators[integrator];
+    }
+
+    const char* getIntegratorName(SimIntegrator integrator)
+    {
+        if (integrator < 0 || integrator >= Sim_Integrator_Count)
+            return "unknown";
+
+        return s_Integrators[integrator].name;
+    }
+}
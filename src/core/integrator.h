@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+
+// integrator table, selected at runtime with SimSettings::integrator
+// the symplectic integrators are splittings into drifts (x += v c dt) and kicks (v += a d dt), run as
+// kick d[0], drift c[0], kick d[1], ..., drift c[n - 1], kick d[n], zero kicks are skipped and the forces
+// of the last kick are reused by the first kick of the next step when the bodies did not move in between
+
+#define SIM_SPLITTING_MAX_STAGES 7 /* most drifts of a splitting (yoshida 6) */
+
+struct SimWorld;
+struct SimSettings;
+struct SimIntegratorDesc;
+
+enum SimIntegrator
+{
+    Sim_Integrator_Euler,      // semi-implicit euler, 1st order, one force pass per step
+    Sim_Integrator_Leapfrog,   // kick-drift-kick leapfrog, 2nd order, one force pass per step
+    Sim_Integrator_Yoshida4,   // yoshida triple jump of leapfrogs, 4th order, three force passes per step
+    Sim_Integrator_Yoshida6,   // yoshida solution A, 6th order, seven force passes per step
+    Sim_Integrator_ForestRuth, // forest-ruth drift-kick-drift, 4th order, three force passes per step
+    Sim_Integrator_Hermite,    // 4th order hermite with block steps, direct summation, not symplectic
+    Sim_Integrator_DormandPrince, // adaptive runge-kutta 5(4) with error control, direct summation, not symplectic
+    Sim_Integrator_Kepler,     // analytic two-body orbits around the sun, the bodies don't perturb each other, any time step
+    Sim_Integrator_Count,
+};
+
+// timeStep is settings.timeStep in the time unit of the bodies
+typedef void (*SimStepFunction)(SimWorld* world, const SimSettings& settings, const SimIntegratorDesc& desc, double timeStep);
+
+struct SimIntegratorDesc
+{
+    const char* name;
+    uint32_t order;                             // 0 for the analytic kepler orbits
+    bool symplectic;
+    SimStepFunction step;
+    uint32_t stages;                            // drifts of a splitting
+    double drift[SIM_SPLITTING_MAX_STAGES];     // fractions of the time step
+    double kick[SIM_SPLITTING_MAX_STAGES + 1];
+};
+
+namespace sim
+{
+    const SimIntegratorDesc& getIntegrator(SimIntegrator integrator);
+    const char* getIntegratorName(SimIntegrator integrator);
+}
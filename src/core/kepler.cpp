@@ -0,0 +1,147 @@
+#include "kepler.h"
+#include "gravity_kernels.h"
+#include "thread_pool.h"
+
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+
+// SIM_SIMD_LEVEL is set by cmake (SIM_SIMD option): 0 scalar only, 1 sse2, 2 avx2, 3 avx512
+#ifndef SIM_SIMD_LEVEL
+#define SIM_SIMD_LEVEL 0
+#endif
+
+static_assert(SIM_KEPLER_BATCH % 8 == 0, "a kepler batch is whole avx-512 double vectors");
+
+namespace sim
+{
+    bool getSunCenter(const SimBodies& bodies, SimKeplerCenter* center)
+    {
+        int32_t sun = findSun(bodies);
+        if (sun < 0) return false;
+
+        *center = { bodies.x[sun], bodies.y[sun], bodies.vx[sun], bodies.vy[sun], bodies.mass[sun] };
+        return true;
+    }
+
+    static uint32_t solveBatch(SimKernel kernel, SimKeplerBatch* batch)
+    {
+        switch (kernel)
+        {
+#if SIM_SIMD_LEVEL >= 1
+        case Sim_Kernel_Sse2:   { return sse2::kepler(batch); }
+#endif
+#if SIM_SIMD_LEVEL >= 2
+        case Sim_Kernel_Avx2:   { return avx2::kepler(batch); }
+#endif
+#if SIM_SIMD_LEVEL >= 3
+        case Sim_Kernel_Avx512: { return avx512::kepler(batch); }
+#endif
+        default: { return keplerKernel<SimdScalarDouble>(batch); }
+        }
+    }
+
+    uint32_t propagateKepler(SimKernel kernel, const SimKeplerCenter& center, double G, double timeStep, float* x, float* y, float* vx, float* vy, const float* mass, uint32_t count)
+    {
+        const double twoPi = 6.28318530717958647692;
+
+        // the center after the step
+        double cx = center.x + center.vx * timeStep;
+        double cy = center.y + center.vy * timeStep;
+
+        std::atomic<uint32_t> maxIterations{ 0 };
+        uint32_t batches = (count + SIM_KEPLER_BATCH - 1) / SIM_KEPLER_BATCH;
+
+        parallelFor(0, batches, 1, [&](uint32_t begin, uint32_t end, uint32_t worker)
+        {
+            SimKeplerBatch b;
+            for (uint32_t batch = begin; batch < end; batch++)
+            {
+                uint32_t first = batch * SIM_KEPLER_BATCH;
+                uint32_t n = std::min(count - first, (uint32_t)SIM_KEPLER_BATCH);
+
+                for (uint32_t k = 0; k < n; k++)
+                {
+                    uint32_t i = first + k;
+                    double mu = G * (center.mass + (mass ? mass[i] : 0.0));
+                    double rx = x[i] - center.x, ry = y[i] - center.y;
+                    double ux = vx[i] - center.vx, uy = vy[i] - center.vy;
+                    double r0 = std::sqrt(rx * rx + ry * ry);
+
+                    b.rx[k] = rx;
+                    b.ry[k] = ry;
+                    b.vx[k] = ux;
+                    b.vy[k] = uy;
+                    b.r0[k] = r0;
+                    b.sqrtMu[k] = std::sqrt(mu);
+                    b.dt[k] = timeStep;
+
+                    // at the center (the center body itself), nothing to solve
+                    if (r0 == 0.0 || mu <= 0.0)
+                    {
+                        b.sigma[k] = 0.0;
+                        b.alpha[k] = 0.0;
+                        b.r0[k] = 1.0;
+                        b.sqrtMu[k] = 1.0;
+                        b.dt[k] = 0.0;
+                        b.chi[k] = 0.0;
+                        continue;
+                    }
+
+                    double alpha = 2.0 / r0 - (ux * ux + uy * uy) / mu;
+                    b.sigma[k] = (rx * ux + ry * uy) / b.sqrtMu[k];
+                    b.alpha[k] = alpha;
+
+                    // whole periods of bound orbits change nothing
+                    if (alpha > 0.0)
+                    {
+                        double period = twoPi / (b.sqrtMu[k] * alpha * std::sqrt(alpha));
+                        b.dt[k] = timeStep - period * std::trunc(timeStep / period);
+                        b.chi[k] = b.sqrtMu[k] * alpha * b.dt[k];
+                    }
+                    else
+                    {
+                        b.chi[k] = b.sqrtMu[k] * timeStep / r0;
+
+                        // hyperbolic start from the asymptotic solution (vallado), the guess above grows too fast
+                        double sign = timeStep >= 0.0 ? 1.0 : -1.0;
+                        double argument = alpha < 0.0 ? -2.0 * mu * alpha * timeStep /
+                            (b.sigma[k] * b.sqrtMu[k] + sign * std::sqrt(mu / -alpha) * (1.0 - r0 * alpha)) : 0.0;
+                        if (argument > 0.0)
+                            b.chi[k] = sign * std::sqrt(-1.0 / alpha) * std::log(argument);
+                    }
+                }
+
+                // lanes past the bodies sit at the center
+                for (uint32_t k = n; k < SIM_KEPLER_BATCH; k++)
+                {
+                    b.rx[k] = b.ry[k] = b.vx[k] = b.vy[k] = 0.0;
+                    b.r0[k] = b.sqrtMu[k] = 1.0;
+                    b.sigma[k] = b.alpha[k] = b.dt[k] = b.chi[k] = 0.0;
+                }
+
+                uint32_t iterations = solveBatch(kernel, &b);
+                uint32_t previous = maxIterations.load(std::memory_order_relaxed);
+                while (iterations > previous && !maxIterations.compare_exchange_weak(previous, iterations)) {}
+
+                for (uint32_t k = 0; k < n; k++)
+                {
+                    uint32_t i = first + k;
+                    if (b.dt[k] == 0.0 && b.chi[k] == 0.0)
+                    {
+                        x[i] = (float)(cx + b.rx[k]);
+                        y[i] = (float)(cy + b.ry[k]);
+                        continue;
+                    }
+
+                    x[i] = (float)(cx + b.nx[k]);
+                    y[i] = (float)(cy + b.ny[k]);
+                    vx[i] = (float)(center.vx + b.nvx[k]);
+                    vy[i] = (float)(center.vy + b.nvy[k]);
+                }
+            }
+        });
+
+        return maxIterations.load();
+    }
+}
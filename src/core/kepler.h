@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "bodies.h"
+#include "gravity.h"
+
+// analytic two-body propagation with universal variables, valid for elliptic, parabolic and hyperbolic orbits
+// the bodies are advanced in batches, every iteration of the kepler equation solver runs over the whole batch
+// (laguerre-conway, converges from any start) in the double lanes of the selected kernel, branch free, elliptic
+// orbits are reduced to less than a period first so the cost doesn't depend on the time step
+
+#define SIM_KEPLER_BATCH 64            /* bodies solved together, a multiple of the widest double vector */
+#define SIM_KEPLER_MAX_ITERATIONS 32   /* the batch stops earlier once every body converged */
+#define SIM_KEPLER_TOLERANCE 1e-12     /* relative change of the universal anomaly that counts as converged */
+
+// a batch in the layout of the vector kernels (gravity_kernels.h), relative to the center, lanes past the bodies of a
+// short batch sit at the center with nothing to solve
+struct SimKeplerBatch
+{
+    alignas(64) double rx[SIM_KEPLER_BATCH], ry[SIM_KEPLER_BATCH], vx[SIM_KEPLER_BATCH], vy[SIM_KEPLER_BATCH];
+    alignas(64) double r0[SIM_KEPLER_BATCH], sigma[SIM_KEPLER_BATCH], alpha[SIM_KEPLER_BATCH], sqrtMu[SIM_KEPLER_BATCH];
+    alignas(64) double dt[SIM_KEPLER_BATCH], chi[SIM_KEPLER_BATCH];
+    alignas(64) double nx[SIM_KEPLER_BATCH], ny[SIM_KEPLER_BATCH], nvx[SIM_KEPLER_BATCH], nvy[SIM_KEPLER_BATCH]; // after the step
+};
+
+// the body the orbits are around, it moves in a straight line during the step
+struct SimKeplerCenter
+{
+    double x, y;
+    double vx, vy;
+    double mass;
+};
+
+namespace sim
+{
+    // the sun as the center, false when there is no sun
+    bool getSunCenter(const SimBodies& bodies, SimKeplerCenter* center);
+
+    // advances the bodies by timeStep on two-body orbits around the center, in place, in the units of G,
+    // mass (may be nullptr for massless bodies) adds to the center's mass per body, bodies at the center move with it
+    // returns the most iterations a batch needed
+    uint32_t propagateKepler(SimKernel kernel, const SimKeplerCenter& center, double G, double timeStep, float* x, float* y, float* vx, float* vy, const float* mass, uint32_t count);
+}
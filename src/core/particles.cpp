@@ -0,0 +1,125 @@
+#include "particles.h"
+#include "gravity.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+
+namespace sim
+{
+    void clearParticles(SimParticles* particles)
+    {
+        for (SimArray<float>* a : { &particles->x, &particles->y, &particles->vx, &particles->vy, &particles->ax, &particles->ay })
+            a->clear();
+
+        particles->count = 0;
+        particles->forcesCurrent = false;
+    }
+
+    void addParticle(SimParticles* particles, const SimBodies& bodies, const SimVec2& pos, const SimVec2& vel)
+    {
+        const SimUnits& units = bodies.units;
+        uint32_t index = particles->count++;
+        uint32_t padded = paddedCount(particles->count);
+
+        for (SimArray<float>* a : { &particles->x, &particles->y, &particles->vx, &particles->vy, &particles->ax, &particles->ay })
+            a->resize(padded, 0.0f);
+
+        particles->x[index] = (float)(pos.x / units.length);
+        particles->y[index] = (float)(pos.y / units.length);
+        particles->vx[index] = (float)(vel.x * units.time / units.length);
+        particles->vy[index] = (float)(vel.y * units.time / units.length);
+        particles->forcesCurrent = false;
+    }
+
+    void removeParticles(SimParticles* particles, const uint8_t* remove)
+    {
+        uint32_t count = 0;
+        for (uint32_t i = 0; i < particles->count; i++)
+        {
+            if (remove[i]) continue;
+
+            particles->x[count] = particles->x[i];
+            particles->y[count] = particles->y[i];
+            particles->vx[count] = particles->vx[i];
+            particles->vy[count] = particles->vy[i];
+            particles->ax[count] = particles->ax[i];
+            particles->ay[count] = particles->ay[i];
+            count++;
+        }
+
+        if (count == particles->count) return;
+
+        for (SimArray<float>* a : { &particles->x, &particles->y, &particles->vx, &particles->vy, &particles->ax, &particles->ay })
+        {
+            std::fill(a->begin() + count, a->end(), 0.0f);
+            a->resize(paddedCount(count));
+        }
+
+        particles->count = count;
+    }
+
+    SimVec2 getParticlePosition(const SimParticles& particles, const SimBodies& bodies, uint32_t index)
+    {
+        float length = (float)bodies.units.length;
+        return { particles.x[index] * length, particles.y[index] * length };
+    }
+
+    void computeParticleForces(SimParticles* particles, const SimBodies& bodies)
+    {
+        computeParticleAccelerations(getKernel(), bodies, particles->x.data(), particles->y.data(), paddedCount(particles->count),
+            particles->ax.data(), particles->ay.data(), particles->softening);
+        particles->forcesCurrent = true;
+    }
+
+    void kickDriftParticles(SimParticles* particles, const SimBodies& bodies, double timeStep)
+    {
+        if (particles->count == 0) return;
+
+        if (!particles->forcesCurrent)
+            computeParticleForces(particles, bodies);
+
+        float dt = (float)timeStep;
+        float halfDt = 0.5f * dt;
+        float* x = particles->x.data();
+        float* y = particles->y.data();
+        float* vx = particles->vx.data();
+        float* vy = particles->vy.data();
+        const float* ax = particles->ax.data();
+        const float* ay = particles->ay.data();
+
+        parallelFor(0, particles->count, 16384, [&](uint32_t begin, uint32_t end, uint32_t worker)
+        {
+            for (uint32_t i = begin; i < end; i++)
+            {
+                vx[i] += ax[i] * halfDt;
+                vy[i] += ay[i] * halfDt;
+                x[i] += vx[i] * dt;
+                y[i] += vy[i] * dt;
+            }
+        });
+
+        particles->forcesCurrent = false;
+    }
+
+    void kickParticles(SimParticles* particles, const SimBodies& bodies, double timeStep)
+    {
+        if (particles->count == 0) return;
+
+        computeParticleForces(particles, bodies);
+
+        float halfDt = 0.5f * (float)timeStep;
+        float* vx = particles->vx.data();
+        float* vy = particles->vy.data();
+        const float* ax = particles->ax.data();
+        const float* ay = particles->ay.data();
+
+        parallelFor(0, particles->count, 16384, [&](uint32_t begin, uint32_t end, uint32_t worker)
+        {
+            for (uint32_t i = begin; i < end; i++)
+            {
+                vx[i] += ax[i] * halfDt;
+                vy[i] += ay[i] * halfDt;
+            }
+        });
+    }
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "bodies.h"
+
+// massless test particles, attracted by the bodies but exerting no force themselves,
+// so a belt costs O(bodies x particles) instead of O((bodies + particles)^2)
+// they move with kick-drift-kick leapfrog in the field of the bodies at the start and the end of every step,
+// whatever integrator moves the bodies
+
+struct SimParticles
+{
+    // in the units of the bodies, the size of the arrays is paddedCount(count), the padding of the positions and velocities is zero
+    SimArray<float> x, y;
+    SimArray<float> vx, vy;
+    SimArray<float> ax, ay;
+
+    uint32_t count = 0;
+    bool forcesCurrent = false; // ax and ay belong to the current positions of the particles and the bodies
+    float softening = 0.0f;     // plummer softening length of the forces from the bodies, in the units of the bodies
+};
+
+namespace sim
+{
+    void clearParticles(SimParticles* particles);
+    void addParticle(SimParticles* particles, const SimBodies& bodies, const SimVec2& pos, const SimVec2& vel); // si units
+    void removeParticles(SimParticles* particles, const uint8_t* remove); // every particle with remove[i] != 0
+    SimVec2 getParticlePosition(const SimParticles& particles, const SimBodies& bodies, uint32_t index); // si units
+
+    void computeParticleForces(SimParticles* particles, const SimBodies& bodies);
+
+    // first half kick and the drift, before the bodies move
+    void kickDriftParticles(SimParticles* particles, const SimBodies& bodies, double timeStep);
+
+    // second half kick with the bodies at the end of the step, the accelerations are reused by the next step
+    void kickParticles(SimParticles* particles, const SimBodies& bodies, double timeStep);
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "bodies.h"
+
+// precision of the state advanced by the splitting integrators
+// the bodies (float) are what the solvers and the renderer read, a float position at pluto's
+// 39 AU is only good to about half a kilometer, so small drifts vel * timeStep get rounded away
+// the kahan and double modes keep their own state and write the rounded positions back every step
+
+enum SimPrecision
+{
+    Sim_Precision_Float,  // the bodies are the state
+    Sim_Precision_Kahan,  // float positions and velocities with a compensation term, forces from the selected solver
+    Sim_Precision_Double, // double positions and velocities, double direct summation (other solvers: float forces)
+    Sim_Precision_Count,
+};
+
+// float plus the part of the additions it rounded away (kahan summation),
+// value - error is the sum to about twice the float precision
+struct SimKahan
+{
+    float value;
+    float error;
+};
+
+// P stores positions and velocities, V is the scalar the forces and updates are computed in
+template <typename P, typename V>
+struct SimState
+{
+    uint32_t count = 0; // bodies the state was loaded from, it is loaded again when the bodies change
+    bool forcesCurrent = false;
+    SimArray<P> x, y, vx, vy;
+    SimArray<V> ax, ay;
+    double potential = 0.0; // potential energy at the positions of ax and ay, nan when the solver doesn't sum it
+};
+
+typedef SimState<SimKahan, float> SimKahanState;
+typedef SimState<double, double> SimDoubleState;
+
+namespace sim
+{
+    inline void addTo(float* x, float delta) { *x += delta; }
+    inline void addTo(double* x, double delta) { *x += delta; }
+    inline void addTo(SimKahan* x, float delta)
+    {
+        float y = delta - x->error;
+        float t = x->value + y;
+        x->error = (t - x->value) - y;
+        x->value = t;
+    }
+
+    inline float value(float x) { return x; }
+    inline double value(double x) { return x; }
+    inline float value(const SimKahan& x) { return x.value - x.error; }
+
+    // the whole value, the diagnostics keep the kahan error term
+    inline double exact(float x) { return x; }
+    inline double exact(double x) { return x; }
+    inline double exact(const SimKahan& x) { return (double)x.value - x.error; }
+
+    // what the bodies store
+    inline float rounded(float x) { return x; }
+    inline float rounded(double x) { return (float)x; }
+    inline float rounded(const SimKahan& x) { return x.value; }
+
+    inline void load(float* x, float value) { *x = value; }
+    inline void load(double* x, float value) { *x = value; }
+    inline void load(SimKahan* x, float value) { *x = { value, 0.0f }; }
+
+    // a value computed in double, the kahan state keeps what the float rounds away as its error
+    inline void assign(float* x, double value) { *x = (float)value; }
+    inline void assign(double* x, double value) { *x = value; }
+    inline void assign(SimKahan* x, double value) { float v = (float)value; *x = { v, (float)(v - value) }; }
+
+    const char* getPrecisionName(SimPrecision precision);
+}
@@ -0,0 +1,190 @@
+#include "quadtree.h"
+#include "thread_pool.h"
+
+#include <cmath>
+#include <algorithm>
+
+#define SIM_QUADTREE_TASK_DEPTH 3   /* subtrees below this depth are built in parallel */
+#define SIM_QUADTREE_TASK_SIZE 4096 /* smaller subtrees are built by the task that reaches them */
+
+namespace sim
+{
+    static void computeLeafMoments(SimQuadNode* node, const uint32_t* order, const SimBodies& bodies)
+    {
+        double mass = 0.0, mx = 0.0, my = 0.0;
+        for (uint32_t k = node->begin; k < node->end; k++)
+        {
+            uint32_t i = order[k];
+            mass += bodies.mass[i];
+            mx += (double)bodies.mass[i] * bodies.x[i];
+            my += (double)bodies.mass[i] * bodies.y[i];
+        }
+
+        node->mass = mass;
+        node->comx = mass > 0.0 ? mx / mass : node->cx;
+        node->comy = mass > 0.0 ? my / mass : node->cy;
+        node->qxx = node->qxy = node->qyy = 0.0;
+        node->radius = 0.0;
+
+        for (uint32_t k = node->begin; k < node->end; k++)
+        {
+            uint32_t i = order[k];
+            double dx = bodies.x[i] - node->comx;
+            double dy = bodies.y[i] - node->comy;
+            double m = bodies.mass[i];
+
+            node->qxx += m * (2.0 * dx * dx - dy * dy);
+            node->qyy += m * (2.0 * dy * dy - dx * dx);
+            node->qxy += m * 3.0 * dx * dy;
+            node->radius = std::max(node->radius, std::sqrt(dx * dx + dy * dy));
+        }
+    }
+
+    static void computeParentMoments(SimQuadNode* node, const SimQuadNode* children)
+    {
+        double mass = 0.0, mx = 0.0, my = 0.0;
+        for (uint32_t c = 0; c < node->childCount; c++)
+        {
+            const SimQuadNode& child = children[c];
+            mass += child.mass;
+            mx += child.mass * child.comx;
+            my += child.mass * child.comy;
+        }
+
+        node->mass = mass;
+        node->comx = mass > 0.0 ? mx / mass : node->cx;
+        node->comy = mass > 0.0 ? my / mass : node->cy;
+        node->qxx = node->qxy = node->qyy = 0.0;
+        node->radius = 0.0;
+
+        // parallel axis theorem, shift every child's quadrupole to the parent's center of mass
+        for (uint32_t c = 0; c < node->childCount; c++)
+        {
+            const SimQuadNode& child = children[c];
+            double sx = child.comx - node->comx;
+            double sy = child.comy - node->comy;
+
+            node->qxx += child.qxx + child.mass * (2.0 * sx * sx - sy * sy);
+            node->qyy += child.qyy + child.mass * (2.0 * sy * sy - sx * sx);
+            node->qxy += child.qxy + child.mass * 3.0 * sx * sy;
+            node->radius = std::max(node->radius, std::sqrt(sx * sx + sy * sy) + child.radius);
+        }
+    }
+
+    // builds the subtree of nodes[nodeIndex], nodes below taskDepth are not split but collected in tasks
+    static void buildNode(std::vector<SimQuadNode>* nodes, uint32_t* order, const SimBodies& bodies, uint32_t nodeIndex, uint32_t depth, uint32_t leafSize,
+        uint32_t taskDepth, std::vector<uint32_t>* tasks)
+    {
+        SimQuadNode node = (*nodes)[nodeIndex];
+
+        if (node.end - node.begin <= leafSize || depth >= SIM_QUADTREE_MAX_DEPTH)
+        {
+            computeLeafMoments(&(*nodes)[nodeIndex], order, bodies);
+            return;
+        }
+
+        if (tasks && depth >= taskDepth && node.end - node.begin >= SIM_QUADTREE_TASK_SIZE)
+        {
+            tasks->push_back(nodeIndex);
+            return;
+        }
+
+        // split the range into the quadrants (y < cy, x < cx), (y < cy, x >= cx), (y >= cy, x < cx), (y >= cy, x >= cx)
+        uint32_t* first = order + node.begin;
+        uint32_t* last = order + node.end;
+        uint32_t* splitY = std::partition(first, last, [&](uint32_t i) { return bodies.y[i] < node.cy; });
+        uint32_t* splitLow = std::partition(first, splitY, [&](uint32_t i) { return bodies.x[i] < node.cx; });
+        uint32_t* splitHigh = std::partition(splitY, last, [&](uint32_t i) { return bodies.x[i] < node.cx; });
+
+        uint32_t* bounds[5] = { first, splitLow, splitY, splitHigh, last };
+
+        node.firstChild = (uint32_t)nodes->size();
+        node.childCount = 0;
+
+        for (uint32_t q = 0; q < 4; q++)
+        {
+            if (bounds[q] == bounds[q + 1]) continue;
+
+            SimQuadNode child{};
+            child.halfSize = node.halfSize * 0.5;
+            child.cx = node.cx + ((q & 1) ? child.halfSize : -child.halfSize);
+            child.cy = node.cy + ((q & 2) ? child.halfSize : -child.halfSize);
+            child.begin = (uint32_t)(bounds[q] - order);
+            child.end = (uint32_t)(bounds[q + 1] - order);
+
+            nodes->push_back(child);
+            node.childCount++;
+        }
+
+        (*nodes)[nodeIndex] = node;
+
+        for (uint32_t c = node.firstChild; c < node.firstChild + node.childCount; c++)
+            buildNode(nodes, order, bodies, c, depth + 1, leafSize, taskDepth, tasks);
+
+        // the moments of the nodes above the tasks are computed once the tasks are done
+        if (!tasks || depth >= taskDepth)
+            computeParentMoments(&(*nodes)[nodeIndex], nodes->data() + node.firstChild);
+    }
+
+    void buildQuadtree(SimQuadtree* tree, const SimBodies& bodies, uint32_t leafSize)
+    {
+        tree->nodes.clear();
+        tree->order.resize(bodies.count);
+
+        float minx = 0.0f, maxx = 0.0f, miny = 0.0f, maxy = 0.0f;
+        for (uint32_t i = 0; i < bodies.count; i++)
+        {
+            tree->order[i] = i;
+            minx = i == 0 ? bodies.x[i] : std::min(minx, bodies.x[i]);
+            maxx = i == 0 ? bodies.x[i] : std::max(maxx, bodies.x[i]);
+            miny = i == 0 ? bodies.y[i] : std::min(miny, bodies.y[i]);
+            maxy = i == 0 ? bodies.y[i] : std::max(maxy, bodies.y[i]);
+        }
+
+        SimQuadNode root{};
+        root.cx = 0.5 * ((double)minx + maxx);
+        root.cy = 0.5 * ((double)miny + maxy);
+        double size = std::max((double)maxx - minx, (double)maxy - miny);
+        root.halfSize = size > 0.0 ? size * 0.5001 : 1.0; // slightly larger so the bodies on the max edge are inside
+        root.begin = 0;
+        root.end = bodies.count;
+
+        tree->nodes.push_back(root);
+
+        // the top of the tree is built here, the big subtrees below it in parallel
+        std::vector<uint32_t> tasks;
+        buildNode(&tree->nodes, tree->order.data(), bodies, 0, 0, leafSize, SIM_QUADTREE_TASK_DEPTH, &tasks);
+
+        std::vector<std::vector<SimQuadNode>> subtrees(tasks.size());
+        parallelFor(0, (uint32_t)tasks.size(), 1, [&](uint32_t begin, uint32_t end, uint32_t worker)
+        {
+            for (uint32_t t = begin; t < end; t++)
+            {
+                subtrees[t].push_back(tree->nodes[tasks[t]]);
+                buildNode(&subtrees[t], tree->order.data(), bodies, 0, SIM_QUADTREE_TASK_DEPTH, leafSize, 0, nullptr);
+            }
+        });
+
+        // append the subtrees, their root replaces the task node
+        uint32_t topCount = (uint32_t)tree->nodes.size();
+        for (uint32_t t = 0; t < (uint32_t)tasks.size(); t++)
+        {
+            uint32_t offset = (uint32_t)tree->nodes.size() - 1;
+            for (SimQuadNode& node : subtrees[t])
+            {
+                if (!isLeaf(node))
+                    node.firstChild += offset;
+            }
+
+            tree->nodes[tasks[t]] = subtrees[t][0];
+            tree->nodes.insert(tree->nodes.end(), subtrees[t].begin() + 1, subtrees[t].end());
+        }
+
+        // children are stored after their parent
+        for (uint32_t k = topCount; k-- > 0;)
+        {
+            if (!isLeaf(tree->nodes[k]))
+                computeParentMoments(&tree->nodes[k], tree->nodes.data() + tree->nodes[k].firstChild);
+        }
+    }
+}
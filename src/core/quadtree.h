@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "bodies.h"
+
+// quadtree over the body positions, shared by the barnes-hut and the fast multipole solvers
+
+#define SIM_QUADTREE_LEAF_SIZE 8  /* max bodies in a leaf */
+#define SIM_QUADTREE_MAX_DEPTH 48 /* bodies at (nearly) the same position end up in one leaf */
+
+struct SimQuadNode
+{
+    double cx, cy;           // center of the cell
+    double halfSize;         // half the width of the (square) cell
+    double mass;
+    double comx, comy;       // center of mass
+    double qxx, qxy, qyy;    // quadrupole moment about the center of mass, Q = sum m (3 d d^T - |d|^2 I)
+    double radius;           // largest distance of a body in the cell from the center of mass
+    uint32_t firstChild;     // children are stored next to each other, 0 if the node is a leaf
+    uint32_t childCount;
+    uint32_t begin, end;     // bodies of the node are order[begin, end)
+};
+
+struct SimQuadtree
+{
+    std::vector<SimQuadNode> nodes; // nodes[0] is the root
+    std::vector<uint32_t> order;    // body indices, sorted so every node covers a contiguous range
+};
+
+namespace sim
+{
+    void buildQuadtree(SimQuadtree* tree, const SimBodies& bodies, uint32_t leafSize = SIM_QUADTREE_LEAF_SIZE);
+
+    inline bool isLeaf(const SimQuadNode& node) { return node.childCount == 0; }
+}
@@ -0,0 +1,215 @@
+#include "runner.h"
+#include "thread_pool.h"
+
+#include <chrono>
+#include <algorithm>
+
+namespace sim
+{
+    static double now()
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static void publish(SimRunner* runner)
+    {
+        SimSnapshot* snapshot = getBackBuffer(&runner->snapshots);
+        const SimWorld& world = runner->world;
+
+        // same sized copies reuse the storage of the buffer
+        snapshot->bodies = world.bodies;
+        snapshot->particleX = world.particles.x;
+        snapshot->particleY = world.particles.y;
+        snapshot->particleCount = world.particles.count;
+        snapshot->clock = runner->clock;
+        snapshot->settings = runner->settings;
+        snapshot->published = now();
+        snapshot->paused = runner->paused;
+
+        snapshot->time = world.time;
+        snapshot->steps = world.steps;
+        snapshot->evaluations = world.evaluations;
+        snapshot->hermiteBlocks = world.hermite.blocks;
+        snapshot->hermiteMinStep = world.hermite.minStep;
+        snapshot->dpAccepted = world.dormandPrince.accepted;
+        snapshot->dpRejected = world.dormandPrince.rejected;
+        snapshot->dpSteps = world.dormandPrince.steps;
+        snapshot->dpMinStep = world.dormandPrince.minStep;
+        snapshot->forceError = runner->forceError;
+        snapshot->threads = getThreadCount();
+        snapshot->merges = world.collisions.merges;
+        snapshot->bounces = world.collisions.bounces;
+        snapshot->fragmentations = world.collisions.fragmentations;
+        snapshot->absorbed = world.collisions.absorbed;
+        snapshot->encounterPairs = (uint32_t)world.encounters.pairs.size();
+        snapshot->historySamples = world.history.samples;
+        snapshot->ghosts = world.history.ghosts;
+        snapshot->diagnostics = world.diagnostics;
+
+        publishBuffer(&runner->snapshots);
+    }
+
+    static void execute(SimRunner* runner, const SimCommand& command)
+    {
+        SimWorld* world = &runner->world;
+        SimBodies* bodies = &world->bodies;
+
+        switch (command.type)
+        {
+            case Sim_Command_Settings:
+                // a step of 0 or less can't advance the clock, keep the last good settings
+                if (command.settings.timeStep > 0.0)
+                    runner->settings = command.settings;
+                break;
+            case Sim_Command_Clock:
+                runner->clock.speed = command.value;
+                runner->clock.budget = command.value2;
+                break;
+            case Sim_Command_Pause:
+                runner->paused = true;
+                break;
+            case Sim_Command_Play:
+                runner->paused = false;
+                break;
+            case Sim_Command_Restart:
+                *world = runner->initial;
+                resetClock(&runner->clock);
+                break;
+            case Sim_Command_RemoveSun:
+            {
+                int32_t sunIndex = findSun(*bodies);
+                if (sunIndex >= 0)
+                {
+                    removeBody(bodies, sunIndex);
+                    resetIntegrator(world);
+                }
+                break;
+            }
+            case Sim_Command_RemoveBody:
+                // the index comes from an older snapshot, the body may be gone already
+                if (command.index < bodies->count)
+                {
+                    removeBody(bodies, command.index);
+                    resetIntegrator(world);
+                }
+                break;
+            case Sim_Command_SetMass:
+                for (uint32_t i = 0; i < bodies->count; i++)
+                {
+                    if (command.index == UINT32_MAX || command.index == i)
+                        bodies->mass[i] = (float)(command.value / bodies->units.mass);
+                }
+                resetIntegrator(world);
+                break;
+            case Sim_Command_ZeroVelocities:
+                for (uint32_t i = 0; i < bodies->count; i++)
+                {
+                    if (bodies->sun[i]) continue;
+                    bodies->vx[i] = 0.0f;
+                    bodies->vy[i] = 0.0f;
+                }
+                resetIntegrator(world);
+                break;
+            case Sim_Command_MeasureForceError:
+                // compare the last force pass with direct summation on a subset of the bodies
+                if (world->ax.size() >= bodies->count)
+                    runner->forceError = measureForceError(*bodies, world->ax.data(), world->ay.data(), 1000);
+                break;
+            case Sim_Command_SetThreads:
+                setThreadCount(command.index);
+                break;
+            case Sim_Command_AddParticles:
+                // a different seed for every belt so they don't land on top of each other
+                addParticleBelt(world, command.index, (float)command.value, (float)command.value2, world->particles.count + 1);
+                break;
+            case Sim_Command_ClearParticles:
+                clearParticles(&world->particles);
+                break;
+        }
+    }
+
+    static void runnerMain(SimRunner* runner)
+    {
+        double last = now();
+        while (!runner->stop.load(std::memory_order_relaxed))
+        {
+            SimCommand command;
+            bool changed = false;
+            while (popQueue(&runner->commands, &command))
+            {
+                execute(runner, command);
+                changed = true;
+            }
+
+            double current = now();
+            double frameSeconds = current - last;
+            last = current;
+
+            if (!runner->paused && advanceClock(&runner->clock, &runner->world, runner->settings, frameSeconds) > 0)
+                changed = true;
+
+            if (changed)
+                publish(runner);
+
+            // sleep until the next step is due, short enough to pick up commands
+            SimClock& clock = runner->clock;
+            double wait = SIM_RUNNER_IDLE;
+            if (!runner->paused && clock.speed > 0.0)
+                wait = std::min(wait, (runner->settings.timeStep - clock.pending) / clock.speed);
+            if (wait > 0.0)
+                std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+        }
+    }
+
+    void startRunner(SimRunner* runner, const SimWorld& world, const SimSettings& settings)
+    {
+        runner->world = world;
+        runner->initial = world;
+        runner->settings = settings;
+        runner->stop.store(false);
+
+        // every buffer starts out with the initial state so the reader always has a valid one
+        for (uint32_t i = 0; i < 3; i++)
+            publish(runner);
+
+        runner->thread = std::thread(runnerMain, runner);
+    }
+
+    void stopRunner(SimRunner* runner)
+    {
+        runner->stop.store(true);
+        if (runner->thread.joinable())
+            runner->thread.join();
+    }
+
+    bool sendCommand(SimRunner* runner, const SimCommand& command)
+    {
+        return pushQueue(&runner->commands, command);
+    }
+
+    bool sendCommand(SimRunner* runner, SimCommandType type, uint32_t index, double value)
+    {
+        SimCommand command = {};
+        command.type = type;
+        command.index = index;
+        command.value = value;
+        return pushQueue(&runner->commands, command);
+    }
+
+    SimSnapshot* acquireSnapshot(SimRunner* runner)
+    {
+        return acquireBuffer(&runner->snapshots);
+    }
+
+    float getSnapshotAlpha(const SimSnapshot& snapshot)
+    {
+        const SimClock& clock = snapshot.clock;
+        double timeStep = snapshot.settings.timeStep;
+        if (snapshot.paused || timeStep <= 0.0)
+            return clock.alpha;
+
+        // the simulation thread owes this much more by now, it shows up as the next snapshot
+        double owed = clock.pending + (now() - snapshot.published) * clock.speed;
+        return (float)std::min(owed / timeStep, 1.0);
+    }
+}
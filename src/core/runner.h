@@ -0,0 +1,170 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+
+#include "simulation.h"
+#include "gravity.h"
+#include "clock.h"
+
+// runs the simulation on its own thread so a heavy step never stalls the rendering (and the other way around)
+// the simulation thread publishes snapshots of the bodies through a triple buffer and takes its orders
+// from a single producer single consumer queue, neither side ever blocks on the other
+
+#define SIM_RUNNER_QUEUE_SIZE 256 /* pending commands, pushing into a full queue fails */
+#define SIM_RUNNER_IDLE 0.002     /* longest sleep (s) of the simulation thread between looking at the queue */
+
+// three buffers, the writer fills its own, the reader reads its own and the middle one is swapped atomically
+// the writer never waits for the reader and the reader always gets the newest complete buffer
+template <typename T>
+struct SimTripleBuffer
+{
+    static const uint32_t Fresh = 4; // set in middle when the middle buffer wasn't read yet
+
+    T buffers[3];
+    std::atomic<uint32_t> middle{ 1 };
+    uint32_t back = 0;  // writer only
+    uint32_t front = 2; // reader only
+};
+
+template <typename T, uint32_t N>
+struct SimSpscQueue
+{
+    T items[N];
+    std::atomic<uint32_t> head{ 0 }; // next item to pop, consumer only writes it
+    std::atomic<uint32_t> tail{ 0 }; // next free slot, producer only writes it
+};
+
+enum SimCommandType
+{
+    Sim_Command_Settings,       // settings
+    Sim_Command_Clock,          // value is the speed, value2 the budget
+    Sim_Command_Pause,
+    Sim_Command_Play,
+    Sim_Command_Restart,        // back to the world the runner was started with
+    Sim_Command_RemoveSun,
+    Sim_Command_RemoveBody,     // index
+    Sim_Command_SetMass,        // index (UINT32_MAX for every body), value in kg
+    Sim_Command_ZeroVelocities, // every body but the sun
+    Sim_Command_MeasureForceError,
+    Sim_Command_SetThreads,     // index is the thread count
+    Sim_Command_AddParticles,   // index particles between value and value2 (meters) from the sun
+    Sim_Command_ClearParticles,
+};
+
+struct SimCommand
+{
+    SimCommandType type;
+    uint32_t index;
+    double value, value2;
+    SimSettings settings;
+};
+
+// everything the rendering and the ui read from the simulation
+struct SimSnapshot
+{
+    SimBodies bodies;
+    SimArray<float> particleX, particleY; // positions of the test particles, not interpolated
+    uint32_t particleCount = 0;
+    SimClock clock;          // previous positions and the interpolation state at the time of publishing
+    SimSettings settings;
+    double published = 0.0;  // wall time the snapshot was published at (s, steady clock)
+    bool paused = false;
+
+    double time = 0.0;
+    uint64_t steps = 0;
+    uint64_t evaluations = 0;
+    uint32_t hermiteBlocks = 0;
+    double hermiteMinStep = 0.0;
+    uint64_t dpAccepted = 0, dpRejected = 0;
+    uint32_t dpSteps = 0;
+    double dpMinStep = 0.0;
+    SimForceError forceError = { 0.0, 0.0, 0 };
+    uint32_t threads = 1;
+    uint64_t merges = 0, bounces = 0, fragmentations = 0, absorbed = 0;
+    uint32_t encounterPairs = 0; // regularized pairs of the last step
+    uint32_t historySamples = 0; // samples per body of the position history when gravity has a finite speed
+    uint32_t ghosts = 0;         // removed bodies whose gravity is still on its way
+    SimDiagnostics diagnostics;  // drift of the last steps when settings.diagnostics is on
+};
+
+struct SimRunner
+{
+    // simulation thread only
+    SimWorld world;
+    SimWorld initial;
+    SimSettings settings;
+    SimClock clock;
+    SimForceError forceError = { 0.0, 0.0, 0 };
+    bool paused = false;
+
+    SimTripleBuffer<SimSnapshot> snapshots;
+    SimSpscQueue<SimCommand, SIM_RUNNER_QUEUE_SIZE> commands;
+    std::atomic<bool> stop{ false };
+    std::thread thread;
+};
+
+namespace sim
+{
+    template <typename T>
+    T* getBackBuffer(SimTripleBuffer<T>* buffer)
+    {
+        return &buffer->buffers[buffer->back];
+    }
+
+    // hands the back buffer to the reader, the writer continues with the old middle buffer
+    template <typename T>
+    void publishBuffer(SimTripleBuffer<T>* buffer)
+    {
+        buffer->back = buffer->middle.exchange(buffer->back | SimTripleBuffer<T>::Fresh, std::memory_order_acq_rel) & 3;
+    }
+
+    // newest published buffer, the same one again when nothing was published since the last call
+    template <typename T>
+    T* acquireBuffer(SimTripleBuffer<T>* buffer)
+    {
+        if (buffer->middle.load(std::memory_order_relaxed) & SimTripleBuffer<T>::Fresh)
+            buffer->front = buffer->middle.exchange(buffer->front, std::memory_order_acq_rel) & 3;
+
+        return &buffer->buffers[buffer->front];
+    }
+
+    template <typename T, uint32_t N>
+    bool pushQueue(SimSpscQueue<T, N>* queue, const T& item)
+    {
+        uint32_t tail = queue->tail.load(std::memory_order_relaxed);
+        if (tail - queue->head.load(std::memory_order_acquire) == N)
+            return false;
+
+        queue->items[tail % N] = item;
+        queue->tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    template <typename T, uint32_t N>
+    bool popQueue(SimSpscQueue<T, N>* queue, T* item)
+    {
+        uint32_t head = queue->head.load(std::memory_order_relaxed);
+        if (head == queue->tail.load(std::memory_order_acquire))
+            return false;
+
+        *item = queue->items[head % N];
+        queue->head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // copies the world and starts the simulation thread, the first snapshot is ready when this returns
+    void startRunner(SimRunner* runner, const SimWorld& world, const SimSettings& settings);
+    void stopRunner(SimRunner* runner);
+
+    // never blocks, false when the queue is full and the command was dropped
+    bool sendCommand(SimRunner* runner, const SimCommand& command);
+    bool sendCommand(SimRunner* runner, SimCommandType type, uint32_t index = 0, double value = 0.0);
+
+    // newest snapshot, owned by the calling (single reader) thread until the next call
+    SimSnapshot* acquireSnapshot(SimRunner* runner);
+
+    // fraction of a step the rendering is past the snapshot's current positions
+    float getSnapshotAlpha(const SimSnapshot& snapshot);
+}
@@ -0,0 +1,316 @@
+#pragma once
+
+#include <stdint.h>
+#include <cmath>
+
+// thin wrappers over the vector instruction sets used by the physics kernels
+// the kernels are templates over these types, every instruction set has its own translation unit
+// compiled with the matching compiler flags, so a wrapper is only defined when its instructions are enabled
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SIM_SIMD_SSE2
+#endif
+
+#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+#include <immintrin.h>
+#define SIM_SIMD_AVX2
+#endif
+
+#if defined(__AVX512F__)
+#include <immintrin.h>
+#define SIM_SIMD_AVX512
+#endif
+
+// the wrappers live in an unnamed namespace, so every kernel instantiated with them has internal linkage
+// and the linker can never pick an avx2 compiled copy of a function for the sse2 or scalar paths
+namespace
+{
+
+// one lane, used for non x86 builds and as the portable fallback
+struct SimdScalar
+{
+    typedef float Reg;
+    static const uint32_t width = 1;
+
+    static Reg zero()                           { return 0.0f; }
+    static Reg set1(float a)                    { return a; }
+    static Reg load(const float* p)             { return *p; }
+    static Reg loadu(const float* p)            { return *p; }
+    static void store(float* p, Reg a)          { *p = a; }
+    static void storeu(float* p, Reg a)         { *p = a; }
+    static Reg add(Reg a, Reg b)                { return a + b; }
+    static Reg sub(Reg a, Reg b)                { return a - b; }
+    static Reg mul(Reg a, Reg b)                { return a * b; }
+    static Reg fmadd(Reg a, Reg b, Reg c)       { return a * b + c; }
+    static Reg fnmadd(Reg a, Reg b, Reg c)      { return c - a * b; }
+    static Reg min(Reg a, Reg b)                { return a < b ? a : b; } // b when either is nan, like minps
+    static Reg max(Reg a, Reg b)                { return a > b ? a : b; }
+    static Reg rsqrtNonZero(Reg a)              { return a > 0.0f ? 1.0f / std::sqrt(a) : 0.0f; }
+    static Reg truncate(Reg a)                  { return (float)(int32_t)a; }         // |a| < 2^31
+    static Reg gather(const float* p, Reg index) { return p[(int32_t)index]; }        // whole numbers below 2^24
+    static float sum(Reg a)                     { return a; }
+};
+
+// double lanes of the same instruction sets, for the solvers that need the precision (kepler.h, the double state of
+// the integrators), the comparisons give a Mask that select and any take, rsqrtNonZero is a full division here
+struct SimdScalarDouble
+{
+    typedef double Reg;
+    typedef bool Mask;
+    static const uint32_t width = 1;
+
+    static Reg set1(double a)                   { return a; }
+    static Reg zero()                           { return 0.0; }
+    static Reg load(const double* p)            { return *p; }
+    static void store(double* p, Reg a)         { *p = a; }
+    static Reg loadu(const double* p)           { return *p; }
+    static void storeu(double* p, Reg a)        { *p = a; }
+    static Reg add(Reg a, Reg b)                { return a + b; }
+    static Reg sub(Reg a, Reg b)                { return a - b; }
+    static Reg mul(Reg a, Reg b)                { return a * b; }
+    static Reg div(Reg a, Reg b)                { return a / b; }
+    static Reg fmadd(Reg a, Reg b, Reg c)       { return a * b + c; }
+    static Reg fnmadd(Reg a, Reg b, Reg c)      { return c - a * b; }
+    static Reg sqrt(Reg a)                      { return std::sqrt(a); }
+    static Reg abs(Reg a)                       { return std::fabs(a); }
+    static Reg max(Reg a, Reg b)                { return a > b ? a : b; }
+    static Mask greater(Reg a, Reg b)           { return a > b; }
+    static Reg select(Mask m, Reg a, Reg b)     { return m ? a : b; } // a where m is set
+    static bool any(Mask m)                     { return m; }
+    static Reg rsqrtNonZero(Reg a)              { return a > 0.0 ? 1.0 / std::sqrt(a) : 0.0; }
+    static double sum(Reg a)                    { return a; }
+};
+
+#ifdef SIM_SIMD_SSE2
+struct SimdSse2
+{
+    typedef __m128 Reg;
+    static const uint32_t width = 4;
+
+    static Reg zero()                           { return _mm_setzero_ps(); }
+    static Reg set1(float a)                    { return _mm_set1_ps(a); }
+    static Reg load(const float* p)             { return _mm_load_ps(p); }
+    static Reg loadu(const float* p)            { return _mm_loadu_ps(p); }
+    static void store(float* p, Reg a)          { _mm_store_ps(p, a); }
+    static void storeu(float* p, Reg a)         { _mm_storeu_ps(p, a); }
+    static Reg add(Reg a, Reg b)                { return _mm_add_ps(a, b); }
+    static Reg sub(Reg a, Reg b)                { return _mm_sub_ps(a, b); }
+    static Reg mul(Reg a, Reg b)                { return _mm_mul_ps(a, b); }
+    static Reg fmadd(Reg a, Reg b, Reg c)       { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+    static Reg fnmadd(Reg a, Reg b, Reg c)      { return _mm_sub_ps(c, _mm_mul_ps(a, b)); }
+    static Reg min(Reg a, Reg b)                { return _mm_min_ps(a, b); }
+    static Reg max(Reg a, Reg b)                { return _mm_max_ps(a, b); }
+    static Reg truncate(Reg a)                  { return _mm_cvtepi32_ps(_mm_cvttps_epi32(a)); }
+
+    // no gather instruction before avx2, one load per lane
+    static Reg gather(const float* p, Reg index)
+    {
+        alignas(16) int32_t i[4];
+        _mm_store_si128((__m128i*)i, _mm_cvttps_epi32(index));
+        return _mm_setr_ps(p[i[0]], p[i[1]], p[i[2]], p[i[3]]);
+    }
+
+    // rsqrtps gives ~12 bits, one newton step brings it to ~23 bits
+    static Reg rsqrtNonZero(Reg a)
+    {
+        Reg y = _mm_rsqrt_ps(a);
+        Reg ayy = _mm_mul_ps(_mm_mul_ps(a, y), y);
+        y = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), y), _mm_sub_ps(_mm_set1_ps(3.0f), ayy));
+        return _mm_and_ps(y, _mm_cmpgt_ps(a, _mm_setzero_ps()));
+    }
+
+    static float sum(Reg a)
+    {
+        Reg shuf = _mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1));
+        Reg sums = _mm_add_ps(a, shuf);
+        shuf = _mm_movehl_ps(shuf, sums);
+        return _mm_cvtss_f32(_mm_add_ss(sums, shuf));
+    }
+};
+
+struct SimdSse2Double
+{
+    typedef __m128d Reg;
+    typedef __m128d Mask;
+    static const uint32_t width = 2;
+
+    static Reg set1(double a)                   { return _mm_set1_pd(a); }
+    static Reg zero()                           { return _mm_setzero_pd(); }
+    static Reg load(const double* p)            { return _mm_load_pd(p); }
+    static void store(double* p, Reg a)         { _mm_store_pd(p, a); }
+    static Reg loadu(const double* p)           { return _mm_loadu_pd(p); }
+    static void storeu(double* p, Reg a)        { _mm_storeu_pd(p, a); }
+    static Reg add(Reg a, Reg b)                { return _mm_add_pd(a, b); }
+    static Reg sub(Reg a, Reg b)                { return _mm_sub_pd(a, b); }
+    static Reg mul(Reg a, Reg b)                { return _mm_mul_pd(a, b); }
+    static Reg div(Reg a, Reg b)                { return _mm_div_pd(a, b); }
+    static Reg fmadd(Reg a, Reg b, Reg c)       { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+    static Reg fnmadd(Reg a, Reg b, Reg c)      { return _mm_sub_pd(c, _mm_mul_pd(a, b)); }
+    static Reg sqrt(Reg a)                      { return _mm_sqrt_pd(a); }
+    static Reg abs(Reg a)                       { return _mm_andnot_pd(_mm_set1_pd(-0.0), a); }
+    static Reg max(Reg a, Reg b)                { return _mm_max_pd(a, b); }
+    static Mask greater(Reg a, Reg b)           { return _mm_cmpgt_pd(a, b); }
+    static Reg select(Mask m, Reg a, Reg b)     { return _mm_or_pd(_mm_and_pd(m, a), _mm_andnot_pd(m, b)); }
+    static bool any(Mask m)                     { return _mm_movemask_pd(m) != 0; }
+
+    static Reg rsqrtNonZero(Reg a)
+    {
+        return _mm_and_pd(_mm_div_pd(_mm_set1_pd(1.0), _mm_sqrt_pd(a)), _mm_cmpgt_pd(a, _mm_setzero_pd()));
+    }
+
+    static double sum(Reg a)
+    {
+        return _mm_cvtsd_f64(_mm_add_sd(a, _mm_unpackhi_pd(a, a)));
+    }
+};
+#endif
+
+#ifdef SIM_SIMD_AVX2
+struct SimdAvx2
+{
+    typedef __m256 Reg;
+    static const uint32_t width = 8;
+
+    static Reg zero()                           { return _mm256_setzero_ps(); }
+    static Reg set1(float a)                    { return _mm256_set1_ps(a); }
+    static Reg load(const float* p)             { return _mm256_load_ps(p); }
+    static Reg loadu(const float* p)            { return _mm256_loadu_ps(p); }
+    static void store(float* p, Reg a)          { _mm256_store_ps(p, a); }
+    static void storeu(float* p, Reg a)         { _mm256_storeu_ps(p, a); }
+    static Reg add(Reg a, Reg b)                { return _mm256_add_ps(a, b); }
+    static Reg sub(Reg a, Reg b)                { return _mm256_sub_ps(a, b); }
+    static Reg mul(Reg a, Reg b)                { return _mm256_mul_ps(a, b); }
+    static Reg fmadd(Reg a, Reg b, Reg c)       { return _mm256_fmadd_ps(a, b, c); }
+    static Reg fnmadd(Reg a, Reg b, Reg c)      { return _mm256_fnmadd_ps(a, b, c); }
+    static Reg min(Reg a, Reg b)                { return _mm256_min_ps(a, b); }
+    static Reg max(Reg a, Reg b)                { return _mm256_max_ps(a, b); }
+    static Reg truncate(Reg a)                  { return _mm256_round_ps(a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC); }
+    static Reg gather(const float* p, Reg index) { return _mm256_i32gather_ps(p, _mm256_cvttps_epi32(index), 4); }
+
+    static Reg rsqrtNonZero(Reg a)
+    {
+        Reg y = _mm256_rsqrt_ps(a);
+        Reg ayy = _mm256_mul_ps(_mm256_mul_ps(a, y), y);
+        y = _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), y), _mm256_sub_ps(_mm256_set1_ps(3.0f), ayy));
+        return _mm256_and_ps(y, _mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_GT_OQ));
+    }
+
+    static float sum(Reg a)
+    {
+        __m128 lo = _mm256_castps256_ps128(a);
+        __m128 hi = _mm256_extractf128_ps(a, 1);
+        lo = _mm_add_ps(lo, hi);
+        __m128 shuf = _mm_movehdup_ps(lo);
+        __m128 sums = _mm_add_ps(lo, shuf);
+        shuf = _mm_movehl_ps(shuf, sums);
+        return _mm_cvtss_f32(_mm_add_ss(sums, shuf));
+    }
+};
+
+struct SimdAvx2Double
+{
+    typedef __m256d Reg;
+    typedef __m256d Mask;
+    static const uint32_t width = 4;
+
+    static Reg set1(double a)                   { return _mm256_set1_pd(a); }
+    static Reg zero()                           { return _mm256_setzero_pd(); }
+    static Reg load(const double* p)            { return _mm256_load_pd(p); }
+    static void store(double* p, Reg a)         { _mm256_store_pd(p, a); }
+    static Reg loadu(const double* p)           { return _mm256_loadu_pd(p); }
+    static void storeu(double* p, Reg a)        { _mm256_storeu_pd(p, a); }
+    static Reg add(Reg a, Reg b)                { return _mm256_add_pd(a, b); }
+    static Reg sub(Reg a, Reg b)                { return _mm256_sub_pd(a, b); }
+    static Reg mul(Reg a, Reg b)                { return _mm256_mul_pd(a, b); }
+    static Reg div(Reg a, Reg b)                { return _mm256_div_pd(a, b); }
+    static Reg fmadd(Reg a, Reg b, Reg c)       { return _mm256_fmadd_pd(a, b, c); }
+    static Reg fnmadd(Reg a, Reg b, Reg c)      { return _mm256_fnmadd_pd(a, b, c); }
+    static Reg sqrt(Reg a)                      { return _mm256_sqrt_pd(a); }
+    static Reg abs(Reg a)                       { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+    static Reg max(Reg a, Reg b)                { return _mm256_max_pd(a, b); }
+    static Mask greater(Reg a, Reg b)           { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+    static Reg select(Mask m, Reg a, Reg b)     { return _mm256_blendv_pd(b, a, m); }
+    static bool any(Mask m)                     { return _mm256_movemask_pd(m) != 0; }
+
+    static Reg rsqrtNonZero(Reg a)
+    {
+        Reg y = _mm256_div_pd(_mm256_set1_pd(1.0), _mm256_sqrt_pd(a));
+        return _mm256_and_pd(y, _mm256_cmp_pd(a, _mm256_setzero_pd(), _CMP_GT_OQ));
+    }
+
+    static double sum(Reg a)
+    {
+        __m128d sums = _mm_add_pd(_mm256_castpd256_pd128(a), _mm256_extractf128_pd(a, 1));
+        return _mm_cvtsd_f64(_mm_add_sd(sums, _mm_unpackhi_pd(sums, sums)));
+    }
+};
+#endif
+
+#ifdef SIM_SIMD_AVX512
+struct SimdAvx512
+{
+    typedef __m512 Reg;
+    static const uint32_t width = 16;
+
+    static Reg zero()                           { return _mm512_setzero_ps(); }
+    static Reg set1(float a)                    { return _mm512_set1_ps(a); }
+    static Reg load(const float* p)             { return _mm512_load_ps(p); }
+    static Reg loadu(const float* p)            { return _mm512_loadu_ps(p); }
+    static void store(float* p, Reg a)          { _mm512_store_ps(p, a); }
+    static void storeu(float* p, Reg a)         { _mm512_storeu_ps(p, a); }
+    static Reg add(Reg a, Reg b)                { return _mm512_add_ps(a, b); }
+    static Reg sub(Reg a, Reg b)                { return _mm512_sub_ps(a, b); }
+    static Reg mul(Reg a, Reg b)                { return _mm512_mul_ps(a, b); }
+    static Reg fmadd(Reg a, Reg b, Reg c)       { return _mm512_fmadd_ps(a, b, c); }
+    static Reg fnmadd(Reg a, Reg b, Reg c)      { return _mm512_fnmadd_ps(a, b, c); }
+    static Reg min(Reg a, Reg b)                { return _mm512_min_ps(a, b); }
+    static Reg max(Reg a, Reg b)                { return _mm512_max_ps(a, b); }
+    static Reg truncate(Reg a)                  { return _mm512_roundscale_ps(a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC); }
+    static Reg gather(const float* p, Reg index) { return _mm512_i32gather_ps(_mm512_cvttps_epi32(index), p, 4); }
+
+    // rsqrt14 gives 14 bits, one newton step is enough for full float precision
+    static Reg rsqrtNonZero(Reg a)
+    {
+        __mmask16 nonZero = _mm512_cmp_ps_mask(a, _mm512_setzero_ps(), _CMP_GT_OQ);
+        Reg y = _mm512_maskz_rsqrt14_ps(nonZero, a);
+        Reg ayy = _mm512_mul_ps(_mm512_mul_ps(a, y), y);
+        return _mm512_maskz_mul_ps(nonZero, _mm512_mul_ps(_mm512_set1_ps(0.5f), y), _mm512_sub_ps(_mm512_set1_ps(3.0f), ayy));
+    }
+
+    static float sum(Reg a)                     { return _mm512_reduce_add_ps(a); }
+};
+
+struct SimdAvx512Double
+{
+    typedef __m512d Reg;
+    typedef __mmask8 Mask;
+    static const uint32_t width = 8;
+
+    static Reg set1(double a)                   { return _mm512_set1_pd(a); }
+    static Reg zero()                           { return _mm512_setzero_pd(); }
+    static Reg load(const double* p)            { return _mm512_load_pd(p); }
+    static void store(double* p, Reg a)         { _mm512_store_pd(p, a); }
+    static Reg loadu(const double* p)           { return _mm512_loadu_pd(p); }
+    static void storeu(double* p, Reg a)        { _mm512_storeu_pd(p, a); }
+    static Reg add(Reg a, Reg b)                { return _mm512_add_pd(a, b); }
+    static Reg sub(Reg a, Reg b)                { return _mm512_sub_pd(a, b); }
+    static Reg mul(Reg a, Reg b)                { return _mm512_mul_pd(a, b); }
+    static Reg div(Reg a, Reg b)                { return _mm512_div_pd(a, b); }
+    static Reg fmadd(Reg a, Reg b, Reg c)       { return _mm512_fmadd_pd(a, b, c); }
+    static Reg fnmadd(Reg a, Reg b, Reg c)      { return _mm512_fnmadd_pd(a, b, c); }
+    static Reg sqrt(Reg a)                      { return _mm512_sqrt_pd(a); }
+    static Reg abs(Reg a)                       { return _mm512_abs_pd(a); }
+    static Reg max(Reg a, Reg b)                { return _mm512_max_pd(a, b); }
+    static Mask greater(Reg a, Reg b)           { return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ); }
+    static Reg select(Mask m, Reg a, Reg b)     { return _mm512_mask_blend_pd(m, b, a); }
+    static bool any(Mask m)                     { return m != 0; }
+    static Reg rsqrtNonZero(Reg a)
+    {
+        return _mm512_maskz_div_pd(_mm512_cmp_pd_mask(a, _mm512_setzero_pd(), _CMP_GT_OQ), _mm512_set1_pd(1.0), _mm512_sqrt_pd(a));
+    }
+
+    static double sum(Reg a)                    { return _mm512_reduce_add_pd(a); }
+};
+#endif
+} // namespace
@@ -0,0 +1,372 @@
+#include "simulation.h"
+#include "gravity.h"
+#include "barnes_hut.h"
+#include "hermite.h"
+#include "thread_pool.h"
+#include "kepler.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace sim
+{
+    static SimBody makeBody(float mass, float radius, float distance, const SimVec2& pos, const SimVec2& vel, bool sun = false)
+    {
+        return { mass, distance, pos, vel, sun, radius };
+    }
+
+    void initSolarSystem(SimWorld* world, SimUnitSystem system)
+    {
+        // mass, radius, distance, position, vellocity, bool sun
+        const SimBody solarSystem[] =
+        {
+            makeBody(SUN_MASS, 6.957e8f, 0.0f, {0.0f, 0.0f}, {0.0f, 0.0f}, true),     // sun
+            makeBody(0.330e+24, 2.440e6f, 0.387 * AU, {0.387f * AU, 0.0f}, {0.0f, 47400.0f}), // mercury
+            makeBody(4.98e+24, 6.052e6f, 0.72f * AU, {0.72f * AU, 0.0f}, {0.0f, 35000.0f}),   // venus
+            makeBody(5.97e+24, 6.371e6f, AU, {AU, 0.0f}, {0.0f, 29800.0f}),                   // earth
+            makeBody(0.642e+24, 3.390e6f, 1.5f * AU, {1.5f * AU, 0.0f}, {0.0f, 24100.0f}),    // mars
+            makeBody(1868e+24, 6.991e7f, 5.2f * AU, {5.2f * AU, 0.0f}, {0.0f, 13100.0f}),     // jupiter
+            makeBody(568e+24, 5.823e7f, 9.5f * AU, {9.5f * AU, 0.0f}, {0.0f, 9700.0f}),       // saturn
+            makeBody(86.8e+24, 2.536e7f, 19.0f * AU, {19.0f * AU, 0.0f}, {0.0f, 6800.0f}),    // uranus
+            makeBody(102e+24, 2.462e7f, 30.0f * AU, {30.0f * AU, 0.0f}, {0.0f, 5400.0f}),     // neptune
+            makeBody(0.0130e+24, 1.188e6f, 39.0f * AU, {39.0f * AU, 0.0f}, {0.0f, 4700.0f}),  // pluto
+        };
+
+        clearBodies(&world->bodies, system);
+        clearParticles(&world->particles);
+        for (const SimBody& body : solarSystem)
+            addBody(&world->bodies, body);
+
+        world->time = 0.0;
+        world->steps = 0;
+        world->evaluations = 0;
+        world->collisions = SimCollisions{};
+        world->encounters = SimEncounters{};
+        world->diagnostics = SimDiagnostics{};
+        world->potential = std::nan("");
+        clearHistory(&world->history);
+        resetIntegrator(world);
+    }
+
+    // circular orbit around the sun (si units) uniform over the area of the ring between innerRadius and outerRadius
+    static SimBody sampleRing(const SimBodies& bodies, float innerRadius, float outerRadius, uint32_t* seed)
+    {
+        int32_t sun = findSun(bodies);
+        // without a sun the ring still goes around a sun's mass at the origin
+        SimBody center = {};
+        center.mass = (float)SUN_MASS;
+        if (sun >= 0)
+            center = getBody(bodies, sun);
+        double mu = G_CONSTANT * center.mass;
+
+        *seed = *seed * 1664525u + 1013904223u;
+        double u = (*seed >> 8) * (1.0 / 16777216.0);
+        *seed = *seed * 1664525u + 1013904223u;
+        double angle = (*seed >> 8) * (1.0 / 16777216.0) * 2.0 * 3.14159265358979;
+
+        double r = std::sqrt(innerRadius * (double)innerRadius + u * (outerRadius * (double)outerRadius - innerRadius * (double)innerRadius));
+        double v = std::sqrt(mu / r);
+
+        SimBody body{};
+        body.distance = (float)r;
+        body.pos = { (float)(center.pos.x + r * std::cos(angle)), (float)(center.pos.y + r * std::sin(angle)) };
+        body.vel = { (float)(center.vel.x - v * std::sin(angle)), (float)(center.vel.y + v * std::cos(angle)) };
+        return body;
+    }
+
+    void addAsteroidBelt(SimWorld* world, uint32_t count, float innerRadius, float outerRadius, uint32_t seed)
+    {
+        // in si units like the bodies added
+        for (uint32_t i = 0; i < count; i++)
+        {
+            SimBody body = sampleRing(world->bodies, innerRadius, outerRadius, &seed);
+
+            seed = seed * 1664525u + 1013904223u;
+            double massScale = (seed >> 8) * (1.0 / 16777216.0);
+            body.mass = (float)(1e15 * std::pow(1e4, massScale)); // 1e15 to 1e19 kg
+            addBody(&world->bodies, body);
+        }
+
+        world->forcesCurrent = false;
+    }
+
+    void addParticleBelt(SimWorld* world, uint32_t count, float innerRadius, float outerRadius, uint32_t seed)
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            SimBody particle = sampleRing(world->bodies, innerRadius, outerRadius, &seed);
+            addParticle(&world->particles, world->bodies, particle.pos, particle.vel);
+        }
+    }
+
+    void initSettings(SimSettings* settings)
+    {
+        settings->timeStep = 86400.0f;
+        settings->solver = Sim_Solver_Direct;
+        settings->theta = 0.5f;
+        settings->quadrupole = false;
+        settings->fmmOrder = 8;
+        settings->integrator = Sim_Integrator_Euler;
+        settings->hermiteEta = SIM_HERMITE_ETA;
+        settings->blockSteps = true;
+        settings->precision = Sim_Precision_Float;
+        settings->tolerance = SIM_DORMAND_PRINCE_TOLERANCE;
+        settings->keplerParticles = false;
+        settings->collisions = Sim_Collision_None;
+        settings->restitution = SIM_COLLISION_RESTITUTION;
+        settings->softening = 0.0f;
+        settings->encounterHill = 0.0f;
+        settings->deterministic = false;
+        settings->diagnostics = false;
+        settings->gravitySpeed = 0.0f;
+    }
+
+    const char* getSolverName(SimSolver solver)
+    {
+        switch (solver)
+        {
+        case Sim_Solver_Direct:    { return "direct"; }
+        case Sim_Solver_BarnesHut: { return "barnes-hut"; }
+        case Sim_Solver_Fmm:       { return "fmm"; }
+        default: break;
+        }
+
+        return "unknown";
+    }
+
+    const char* getPrecisionName(SimPrecision precision)
+    {
+        switch (precision)
+        {
+        case Sim_Precision_Float:  { return "float"; }
+        case Sim_Precision_Kahan:  { return "kahan"; }
+        case Sim_Precision_Double: { return "double"; }
+        default: break;
+        }
+
+        return "unknown";
+    }
+
+    void computeForces(SimWorld* world, const SimSettings& settings, double elapsed)
+    {
+        SimBodies& bodies = world->bodies;
+        world->ax.resize(paddedCount(bodies.count));
+        world->ay.resize(paddedCount(bodies.count));
+        world->potential = std::nan("");
+
+        // no potential energy, the field carries energy of its own
+        if (settings.gravitySpeed > 0.0f)
+        {
+            computeAccelerationsRetarded(getKernel(), world->history, bodies, settings.gravitySpeed, elapsed, world->ax.data(), world->ay.data());
+            return;
+        }
+
+        switch (settings.solver)
+        {
+        case Sim_Solver_BarnesHut:
+        {
+            computeAccelerationsBarnesHut(&world->tree, bodies, settings.theta, settings.quadrupole, world->ax.data(), world->ay.data());
+            break;
+        }
+        case Sim_Solver_Fmm:
+        {
+            computeAccelerationsFmm(&world->fmm, &world->tree, bodies, settings.fmmOrder, settings.theta, world->ax.data(), world->ay.data());
+            break;
+        }
+        default:
+        {
+            // every unordered pair once with the positions at the start of the step
+            computeAccelerationsPairwise(getKernel(), bodies, world->ax.data(), world->ay.data(), settings.deterministic, &world->potential);
+            break;
+        }
+        }
+    }
+
+    void step(SimWorld* world, const SimSettings& settings)
+    {
+        SimBodies& bodies = world->bodies;
+
+        const SimIntegratorDesc& integrator = getIntegrator(settings.integrator);
+        double timeStep = settings.timeStep / bodies.units.time;
+
+        bool collisions = settings.collisions != Sim_Collision_None;
+        if (collisions)
+            beginCollisions(&world->collisions, bodies, world->particles);
+
+        // analytic particles go around the sun as it is at the start of the step, in one call whatever the step
+        SimParticles& particles = world->particles;
+        float softening = (float)(settings.softening / bodies.units.length);
+        if (particles.softening != softening)
+        {
+            particles.softening = softening;
+            particles.forcesCurrent = false;
+        }
+
+        SimKeplerCenter center;
+        bool kepler = (settings.keplerParticles || settings.integrator == Sim_Integrator_Kepler) && getSunCenter(bodies, &center);
+        if (kepler)
+        {
+            propagateKepler(getKernel(), center, bodies.units.G, timeStep, particles.x.data(), particles.y.data(), particles.vx.data(), particles.vy.data(), nullptr, particles.count);
+            particles.forcesCurrent = false;
+        }
+        else
+        {
+            kickDriftParticles(&particles, bodies, timeStep);
+        }
+
+        // the step starts at the newest sample of the history, forces from before it was turned on or off are stale
+        bool retarded = settings.gravitySpeed > 0.0f && integrator.stages > 0;
+        if (retarded != (world->history.samples > 0))
+            world->forcesCurrent = false;
+        if (retarded)
+            syncHistory(&world->history, bodies, world->time / bodies.units.time, timeStep, settings.gravitySpeed);
+        else if (world->history.samples > 0)
+            clearHistory(&world->history);
+
+        integrator.step(world, settings, integrator, timeStep);
+
+        if (!kepler)
+            kickParticles(&particles, bodies, timeStep);
+
+        if (collisions)
+        {
+            findCollisions(&world->collisions, bodies, particles);
+            resolveCollisions(&world->collisions, world, settings.collisions, settings.restitution, timeStep);
+        }
+
+        // get distance of bodies from sun
+        int32_t sun = findSun(bodies);
+        const float* x = bodies.x.data();
+        const float* y = bodies.y.data();
+        if (sun >= 0)
+        {
+            parallelFor(0, bodies.count, 4096, [&](uint32_t begin, uint32_t end, uint32_t worker)
+            {
+                for (uint32_t i = begin; i < end; i++)
+                    bodies.distance[i] = std::sqrt((x[i] - x[sun]) * (x[i] - x[sun]) + (y[i] - y[sun]) * (y[i] - y[sun]));
+            });
+        }
+
+        if (retarded)
+            recordHistory(&world->history, bodies, (world->time + settings.timeStep) / bodies.units.time, settings.gravitySpeed);
+
+        world->time += settings.timeStep;
+        world->steps++;
+    }
+
+    void resetIntegrator(SimWorld* world)
+    {
+        resetHermite(&world->hermite);
+        resetDormandPrince(&world->dormandPrince);
+        world->kahanState.count = 0;
+        world->doubleState.count = 0;
+        world->forcesCurrent = false;
+        world->particles.forcesCurrent = false;
+        resetDiagnostics(&world->diagnostics);
+    }
+
+    double computeEnergy(const SimBodies& bodies)
+    {
+        double kinetic = 0.0, potential = 0.0;
+        for (uint32_t i = 0; i < bodies.count; i++)
+        {
+            kinetic += 0.5 * bodies.mass[i] * ((double)bodies.vx[i] * bodies.vx[i] + (double)bodies.vy[i] * bodies.vy[i]);
+
+            for (uint32_t j = i + 1; j < bodies.count; j++)
+            {
+                double dx = (double)bodies.x[j] - bodies.x[i];
+                double dy = (double)bodies.y[j] - bodies.y[i];
+                double r = std::sqrt(dx * dx + dy * dy);
+                if (r > 0.0)
+                    potential -= bodies.units.G * bodies.mass[i] * bodies.mass[j] / r;
+            }
+        }
+
+        return kinetic + potential;
+    }
+
+    // fnv-1a on 8 byte words in 4 independent lanes, so the multiplies don't wait on each other
+    static uint64_t hashBytes(uint64_t hash, const void* data, size_t size)
+    {
+        const uint64_t prime = 0x100000001b3ull;
+        const unsigned char* bytes = (const unsigned char*)data;
+
+        uint64_t lanes[4] = { hash, hash ^ 1, hash ^ 2, hash ^ 3 };
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32)
+        {
+            for (uint32_t l = 0; l < 4; l++)
+            {
+                uint64_t word;
+                memcpy(&word, bytes + i + l * 8, 8);
+                lanes[l] = (lanes[l] ^ word) * prime;
+            }
+        }
+
+        for (uint32_t l = 0; l < 4; l++)
+            hash = (hash ^ lanes[l]) * prime;
+        for (; i < size; i++)
+            hash = (hash ^ bytes[i]) * prime;
+
+        return hash;
+    }
+
+    template <typename T>
+    static uint64_t hashArray(uint64_t hash, const T* data, uint32_t count)
+    {
+        return hashBytes(hash, data, (size_t)count * sizeof(T));
+    }
+
+    template <typename P, typename V>
+    static uint64_t hashState(uint64_t hash, const SimState<P, V>& state, uint32_t count)
+    {
+        if (state.count != count) return hash;
+
+        hash = hashArray(hash, state.x.data(), count);
+        hash = hashArray(hash, state.y.data(), count);
+        hash = hashArray(hash, state.vx.data(), count);
+        return hashArray(hash, state.vy.data(), count);
+    }
+
+    uint64_t computeChecksum(const SimWorld& world)
+    {
+        const SimBodies& bodies = world.bodies;
+        const SimParticles& particles = world.particles;
+
+        uint64_t hash = 0xcbf29ce484222325ull;
+        hash = hashArray(hash, &bodies.count, 1);
+        hash = hashArray(hash, bodies.x.data(), bodies.count);
+        hash = hashArray(hash, bodies.y.data(), bodies.count);
+        hash = hashArray(hash, bodies.vx.data(), bodies.count);
+        hash = hashArray(hash, bodies.vy.data(), bodies.count);
+        hash = hashArray(hash, bodies.mass.data(), bodies.count);
+
+        hash = hashArray(hash, &particles.count, 1);
+        hash = hashArray(hash, particles.x.data(), particles.count);
+        hash = hashArray(hash, particles.y.data(), particles.count);
+        hash = hashArray(hash, particles.vx.data(), particles.count);
+        hash = hashArray(hash, particles.vy.data(), particles.count);
+
+        // the state the bodies are rounded from, only while it belongs to them
+        hash = hashState(hash, world.kahanState, bodies.count);
+        hash = hashState(hash, world.doubleState, bodies.count);
+        const SimDormandPrince& dp = world.dormandPrince;
+        if (dp.count == bodies.count && dp.x.size() == bodies.count)
+        {
+            hash = hashArray(hash, dp.x.data(), bodies.count);
+            hash = hashArray(hash, dp.y.data(), bodies.count);
+            hash = hashArray(hash, dp.vx.data(), bodies.count);
+            hash = hashArray(hash, dp.vy.data(), bodies.count);
+        }
+        const SimHermite& hermite = world.hermite;
+        if (hermite.count == bodies.count && hermite.x.size() == bodies.count)
+        {
+            hash = hashArray(hash, hermite.x.data(), bodies.count);
+            hash = hashArray(hash, hermite.y.data(), bodies.count);
+            hash = hashArray(hash, hermite.vx.data(), bodies.count);
+            hash = hashArray(hash, hermite.vy.data(), bodies.count);
+        }
+
+        return hash;
+    }
+}
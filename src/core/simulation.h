@@ -0,0 +1,106 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "bodies.h"
+#include "quadtree.h"
+#include "fmm.h"
+#include "hermite.h"
+#include "dormand_prince.h"
+#include "integrator.h"
+#include "precision.h"
+#include "particles.h"
+#include "collision.h"
+#include "encounter.h"
+#include "diagnostics.h"
+#include "history.h"
+
+// simulation core, no window/gl dependencies so it can be used by the headless mode
+
+
+enum SimSolver
+{
+    Sim_Solver_Direct,        // every pair, O(N^2)
+    Sim_Solver_BarnesHut,     // quadtree, O(N log N)
+    Sim_Solver_Fmm,           // fast multipole, O(N)
+    Sim_Solver_Count,
+};
+
+struct SimSettings
+{
+    float timeStep;          // seconds per step
+    SimSolver solver;
+    float theta;             // barnes-hut and fast multipole opening angle
+    bool quadrupole;         // barnes-hut quadrupole moments
+    uint32_t fmmOrder;       // fast multipole expansion order, also uses theta
+    SimIntegrator integrator;
+    float hermiteEta;        // hermite timestep accuracy, smaller is more accurate
+    bool blockSteps;         // hermite per body block steps, false moves every body with the smallest step
+    SimPrecision precision;  // state of the splitting integrators (euler, leapfrog, yoshida, forest-ruth)
+    float tolerance;         // dormand-prince relative error per step, the time step is only the output interval
+    bool keplerParticles;    // test particles follow two-body orbits around the sun (the planets don't perturb them)
+    SimCollisionResponse collisions; // what bodies that touch during a step do
+    float restitution;       // normal restitution of bounces, 1 is elastic
+    float softening;         // plummer softening length of the forces on the test particles in meters, 0 is off
+    float encounterHill;     // splitting integrators regularize pairs closer than this many hill radii, 0 is off
+    bool deterministic;      // direct summation sums in a fixed order, the same bits for any number of threads
+    bool diagnostics;        // energy, momentum and angular momentum drift after every step
+    float gravitySpeed;      // m/s gravity travels at (history.h), 0 is instantaneous, splitting integrators only,
+                             // replaces the solver with direct summation on the retarded positions
+};
+
+struct SimWorld
+{
+    SimBodies bodies;
+    SimParticles particles; // massless, moved by step() after the bodies
+    double time;         // simulated time in seconds
+    uint64_t steps;      // number of steps taken
+    uint64_t evaluations; // force evaluations of single bodies so far
+    bool forcesCurrent;   // ax and ay belong to the current positions, the next kick can reuse them
+
+    SimArray<float> ax, ay; // accelerations of the last force pass
+    double potential;       // potential energy at the positions of ax and ay, nan when the solver doesn't sum it
+    SimQuadtree tree;       // tree of the last barnes-hut/fast multipole force pass
+    SimFmm fmm;             // expansions of the last fast multipole force pass
+    SimHermite hermite;     // per body steps, accelerations and jerks of the hermite integrator
+    SimDormandPrince dormandPrince; // double state and stages of the adaptive integrator
+    SimKahanState kahanState;       // compensated state of the splitting integrators
+    SimDoubleState doubleState;     // double state of the splitting integrators
+    SimCollisions collisions;       // grid and totals of the collision stage
+    SimEncounters encounters;       // regularized close pairs of the splitting integrators
+    SimDiagnostics diagnostics;     // conservation of the last steps
+    SimHistory history;             // past positions of the bodies for the finite speed of gravity
+};
+
+namespace sim
+{
+    // sun, mercury, venus, earth, mars, jupiter, saturn, uranus, neptune, pluto (in that order),
+    // the bodies are stored in the given units
+    void initSolarSystem(SimWorld* world, SimUnitSystem system = Sim_Units_Astronomical);
+
+    // bodies on circular orbits around the sun between innerRadius and outerRadius (meters)
+    void addAsteroidBelt(SimWorld* world, uint32_t count, float innerRadius, float outerRadius, uint32_t seed = 1);
+
+    // massless test particles on circular orbits around the sun between innerRadius and outerRadius (meters)
+    void addParticleBelt(SimWorld* world, uint32_t count, float innerRadius, float outerRadius, uint32_t seed = 1);
+
+    void initSettings(SimSettings* settings);
+    const char* getSolverName(SimSolver solver);
+
+    // fills world->ax and world->ay with the solver selected in the settings, elapsed is the time since the start
+    // of the step (units of the bodies) the positions are at, the retarded positions are that much newer
+    void computeForces(SimWorld* world, const SimSettings& settings, double elapsed = 0.0);
+
+    void step(SimWorld* world, const SimSettings& settings);
+
+    // call after changing masses, positions or velocities outside of step()
+    void resetIntegrator(SimWorld* world);
+
+    // kinetic plus potential energy in double precision in the units of the bodies, O(N^2)
+    double computeEnergy(const SimBodies& bodies);
+
+    // hash of the bits of the state: positions, velocities and masses of the bodies and test particles and the double
+    // (or compensated) state of the integrator when it has one, O(N) and memory bound, equal checksums after every
+    // step mean two runs (serial and parallel, before and after an optimization) are bit for bit the same
+    uint64_t computeChecksum(const SimWorld& world);
+}
@@ -0,0 +1,205 @@
+#include "sweep.h"
+#include "thread_pool.h"
+
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+
+namespace sim
+{
+    const char* getSweepModeName(SimSweepMode mode)
+    {
+        switch (mode)
+        {
+        case Sim_Sweep_Grid:           { return "grid"; }
+        case Sim_Sweep_LatinHypercube: { return "lhs"; }
+        default: break;
+        }
+
+        return "unknown";
+    }
+
+    const char* getSweepKindName(SimSweepKind kind)
+    {
+        switch (kind)
+        {
+        case Sim_Sweep_TimeStep: { return "dt"; }
+        case Sim_Sweep_Mass:     { return "mass"; }
+        case Sim_Sweep_Velocity: { return "velocity"; }
+        default: break;
+        }
+
+        return "unknown";
+    }
+
+    // t in [0, 1] to a value of the parameter
+    static double interpolate(const SimSweepParameter& parameter, double t)
+    {
+        if (parameter.logarithmic && parameter.min > 0.0 && parameter.max > 0.0)
+            return parameter.min * std::pow(parameter.max / parameter.min, t);
+
+        return parameter.min + (parameter.max - parameter.min) * t;
+    }
+
+    static uint32_t random(uint32_t* seed)
+    {
+        *seed = *seed * 1664525u + 1013904223u;
+        return *seed >> 8;
+    }
+
+    std::vector<std::vector<double>> buildSweepPoints(const SimSweep& sweep)
+    {
+        std::vector<std::vector<double>> points;
+        uint32_t dimensions = (uint32_t)std::min(sweep.parameters.size(), (size_t)SIM_SWEEP_MAX_PARAMETERS);
+        if (dimensions == 0)
+            return points;
+
+        if (sweep.mode == Sim_Sweep_LatinHypercube)
+        {
+            uint32_t samples = sweep.samples;
+            points.assign(samples, std::vector<double>(dimensions));
+
+            // a shuffled stratum per point and parameter, a random offset within it
+            uint32_t seed = sweep.seed;
+            std::vector<uint32_t> strata(samples);
+            for (uint32_t p = 0; p < dimensions; p++)
+            {
+                for (uint32_t i = 0; i < samples; i++)
+                    strata[i] = i;
+                for (uint32_t i = samples; i > 1; i--)
+                    std::swap(strata[i - 1], strata[random(&seed) % i]);
+
+                for (uint32_t i = 0; i < samples; i++)
+                {
+                    double t = (strata[i] + random(&seed) * (1.0 / 16777216.0)) / samples;
+                    points[i][p] = interpolate(sweep.parameters[p], t);
+                }
+            }
+
+            return points;
+        }
+
+        // the last parameter changes fastest
+        uint64_t total = 1;
+        for (uint32_t p = 0; p < dimensions; p++)
+            total *= std::max(sweep.parameters[p].count, 1u);
+
+        points.assign(total, std::vector<double>(dimensions));
+        for (uint64_t i = 0; i < total; i++)
+        {
+            uint64_t rest = i;
+            for (uint32_t p = dimensions; p-- > 0; )
+            {
+                const SimSweepParameter& parameter = sweep.parameters[p];
+                uint32_t count = std::max(parameter.count, 1u);
+                uint32_t k = (uint32_t)(rest % count);
+                rest /= count;
+                points[i][p] = interpolate(parameter, count > 1 ? (double)k / (count - 1) : 0.0);
+            }
+        }
+
+        return points;
+    }
+
+    void applySweepPoint(const SimSweep& sweep, const double* values, SimWorld* world, SimSettings* settings)
+    {
+        SimBodies& bodies = world->bodies;
+        int32_t sun = findSun(bodies);
+        float sunVx = sun >= 0 ? bodies.vx[sun] : 0.0f;
+        float sunVy = sun >= 0 ? bodies.vy[sun] : 0.0f;
+
+        uint32_t dimensions = (uint32_t)std::min(sweep.parameters.size(), (size_t)SIM_SWEEP_MAX_PARAMETERS);
+        for (uint32_t p = 0; p < dimensions; p++)
+        {
+            const SimSweepParameter& parameter = sweep.parameters[p];
+            double value = values[p];
+
+            if (parameter.kind == Sim_Sweep_TimeStep)
+            {
+                settings->timeStep = (float)value;
+                continue;
+            }
+
+            for (uint32_t i = 0; i < bodies.count; i++)
+            {
+                bool selected = parameter.body == SIM_SWEEP_PLANETS ? (int32_t)i != sun : parameter.body == i;
+                if (!selected) continue;
+
+                if (parameter.kind == Sim_Sweep_Mass)
+                {
+                    bodies.mass[i] = (float)(bodies.mass[i] * value);
+                }
+                else if (parameter.kind == Sim_Sweep_Velocity && (int32_t)i != sun)
+                {
+                    bodies.vx[i] = (float)(sunVx + (bodies.vx[i] - sunVx) * value);
+                    bodies.vy[i] = (float)(sunVy + (bodies.vy[i] - sunVy) * value);
+                }
+            }
+        }
+
+        resetIntegrator(world);
+    }
+
+    void runSweep(const SimSweep& sweep, const SimSettings& settings, double duration, const SimSweepSetup& setup,
+        const std::vector<uint8_t>& done, const SimSweepCallback& callback)
+    {
+        std::vector<std::vector<double>> points = buildSweepPoints(sweep);
+
+        std::vector<uint32_t> todo;
+        for (uint32_t i = 0; i < (uint32_t)points.size(); i++)
+        {
+            if (i >= done.size() || !done[i])
+                todo.push_back(i);
+        }
+
+        std::mutex mutex;
+        parallelFor(0, (uint32_t)todo.size(), 1, [&](uint32_t begin, uint32_t end, uint32_t worker)
+        {
+            for (uint32_t k = begin; k < end; k++)
+            {
+                auto start = std::chrono::high_resolution_clock::now();
+
+                SimSweepResult result = {};
+                result.index = todo[k];
+                const std::vector<double>& values = points[result.index];
+                std::copy(values.begin(), values.end(), result.values);
+
+                SimWorld world;
+                setup(&world);
+                SimSettings pointSettings = settings;
+                pointSettings.diagnostics = true;
+                applySweepPoint(sweep, values.data(), &world, &pointSettings);
+
+                result.steps = pointSettings.timeStep > 0.0f ? (uint64_t)std::ceil(duration / pointSettings.timeStep) : 0;
+
+                // the bodies keep their order unless they merge, the sun is looked up again after every step then
+                double maxDistance2 = 0.0;
+                for (uint64_t i = 0; i < result.steps; i++)
+                {
+                    step(&world, pointSettings);
+
+                    const SimBodies& bodies = world.bodies;
+                    int32_t sun = findSun(bodies);
+                    float sx = sun >= 0 ? bodies.x[sun] : 0.0f;
+                    float sy = sun >= 0 ? bodies.y[sun] : 0.0f;
+                    for (uint32_t j = 0; j < bodies.count; j++)
+                    {
+                        double dx = bodies.x[j] - sx, dy = bodies.y[j] - sy;
+                        maxDistance2 = std::max(maxDistance2, dx * dx + dy * dy);
+                    }
+                }
+
+                result.energyDrift = getEnergyDrift(world.diagnostics);
+                result.angularDrift = getAngularDrift(world.diagnostics);
+                result.maxDistance = std::sqrt(maxDistance2) * world.bodies.units.length;
+                result.bodies = world.bodies.count;
+                result.checksum = computeChecksum(world);
+                result.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+                std::lock_guard<std::mutex> lock(mutex);
+                callback(result);
+            }
+        });
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <functional>
+
+#include "simulation.h"
+
+// parameter sweeps: a grid or a latin hypercube over the time step and the masses and velocities of the bodies,
+// every point is a world of its own run for the same number of steps, the points run side by side on the worker
+// threads (each point runs its force passes on the worker it landed on) and report a row of results when done
+
+#define SIM_SWEEP_MAX_PARAMETERS 16
+
+enum SimSweepMode
+{
+    Sim_Sweep_Grid,          // every combination of count values per parameter
+    Sim_Sweep_LatinHypercube, // samples points, every parameter range split into samples strata used once each
+    Sim_Sweep_Count,
+};
+
+enum SimSweepKind
+{
+    Sim_Sweep_TimeStep,      // settings.timeStep in seconds
+    Sim_Sweep_Mass,          // factor on the mass of a body
+    Sim_Sweep_Velocity,      // factor on the velocity of a body relative to the sun
+    Sim_Sweep_KindCount,
+};
+
+#define SIM_SWEEP_PLANETS UINT32_MAX /* body of a parameter that applies to every body but the sun */
+
+struct SimSweepParameter
+{
+    SimSweepKind kind;
+    uint32_t body;           // index in the initial bodies or SIM_SWEEP_PLANETS, unused for the time step
+    double min, max;
+    uint32_t count;          // values of a grid, min and max included, 1 is min alone
+    bool logarithmic;        // values evenly spaced in log(value)
+};
+
+struct SimSweep
+{
+    SimSweepMode mode = Sim_Sweep_Grid;
+    std::vector<SimSweepParameter> parameters;
+    uint32_t samples = 0;    // points of a latin hypercube
+    uint32_t seed = 1;
+};
+
+struct SimSweepResult
+{
+    uint32_t index;          // of the point, the same for every run of the same sweep
+    double values[SIM_SWEEP_MAX_PARAMETERS];
+    double energyDrift;      // relative, at the end of the run
+    double angularDrift;
+    double maxDistance;      // largest distance of any body from the sun after any step (m)
+    uint32_t bodies;         // left at the end (collisions)
+    uint64_t checksum;       // of the final state
+    uint64_t steps;          // run for the duration with the time step of the point
+    double seconds;
+};
+
+// called once per finished point, one call at a time
+typedef std::function<void(const SimSweepResult& result)> SimSweepCallback;
+
+// creates the world of a point before the parameters are applied
+typedef std::function<void(SimWorld* world)> SimSweepSetup;
+
+namespace sim
+{
+    const char* getSweepModeName(SimSweepMode mode);
+    const char* getSweepKindName(SimSweepKind kind);
+
+    // the points in index order, values[point][parameter]
+    std::vector<std::vector<double>> buildSweepPoints(const SimSweep& sweep);
+
+    // applies the values of a point to a fresh world and its settings
+    void applySweepPoint(const SimSweep& sweep, const double* values, SimWorld* world, SimSettings* settings);
+
+    // runs every point whose done[index] is 0 (done may be shorter than the points) for duration seconds and calls
+    // callback with its results, the points run in parallel on the worker threads, the passes inside a point on one
+    void runSweep(const SimSweep& sweep, const SimSettings& settings, double duration, const SimSweepSetup& setup,
+        const std::vector<uint8_t>& done, const SimSweepCallback& callback);
+}
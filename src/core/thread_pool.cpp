@@ -0,0 +1,232 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct PoolRange
+{
+    uint32_t begin, end;
+};
+
+struct PoolWorker
+{
+    std::mutex mutex;
+    std::deque<PoolRange> ranges; // the owner pops from the back, thieves take the (bigger) ranges at the front
+};
+
+struct PoolJob
+{
+    const SimTaskFunction* function;
+    uint32_t grain;
+    std::atomic<uint32_t> remaining; // indices not processed yet
+};
+
+struct Pool
+{
+    std::vector<std::thread> threads;
+    std::vector<std::unique_ptr<PoolWorker>> workers; // workers[0] is the thread calling parallelFor
+
+    std::mutex mutex; // guards everything below
+    std::condition_variable wake, done;
+    PoolJob* job = nullptr;
+    uint64_t generation = 0;
+    uint32_t active = 0; // workers inside the current job
+    bool stop = false;
+
+    std::mutex callMutex; // one parallelFor at a time
+    bool started = false;
+
+    ~Pool();
+};
+
+static Pool s_Pool;
+static thread_local bool s_InTask = false;
+
+static bool popRange(uint32_t worker, PoolRange* range)
+{
+    PoolWorker& w = *s_Pool.workers[worker];
+    std::lock_guard<std::mutex> lock(w.mutex);
+    if (w.ranges.empty()) return false;
+
+    *range = w.ranges.back();
+    w.ranges.pop_back();
+    return true;
+}
+
+static bool stealRange(uint32_t worker, PoolRange* range)
+{
+    uint32_t count = (uint32_t)s_Pool.workers.size();
+    for (uint32_t k = 1; k < count; k++)
+    {
+        PoolWorker& victim = *s_Pool.workers[(worker + k) % count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (victim.ranges.empty()) continue;
+
+        *range = victim.ranges.front();
+        victim.ranges.pop_front();
+        return true;
+    }
+
+    return false;
+}
+
+static void pushRange(uint32_t worker, PoolRange range)
+{
+    PoolWorker& w = *s_Pool.workers[worker];
+    std::lock_guard<std::mutex> lock(w.mutex);
+    w.ranges.push_back(range);
+}
+
+static void runJob(PoolJob* job, uint32_t worker)
+{
+    while (job->remaining.load(std::memory_order_acquire) > 0)
+    {
+        PoolRange range;
+        if (!popRange(worker, &range) && !stealRange(worker, &range))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        // keep the lower half, the upper halves can be stolen
+        while (range.end - range.begin > job->grain)
+        {
+            uint32_t mid = range.begin + (range.end - range.begin) / 2;
+            pushRange(worker, { mid, range.end });
+            range.end = mid;
+        }
+
+        (*job->function)(range.begin, range.end, worker);
+        job->remaining.fetch_sub(range.end - range.begin, std::memory_order_acq_rel);
+    }
+}
+
+static void workerMain(uint32_t worker)
+{
+    s_InTask = true;
+    uint64_t generation = 0;
+
+    while (true)
+    {
+        PoolJob* job = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(s_Pool.mutex);
+            s_Pool.wake.wait(lock, [&] { return s_Pool.stop || s_Pool.generation != generation; });
+            if (s_Pool.stop) return;
+
+            generation = s_Pool.generation;
+            job = s_Pool.job;
+            if (!job) continue; // woke up after the job was finished
+            s_Pool.active++;
+        }
+
+        runJob(job, worker);
+
+        {
+            std::lock_guard<std::mutex> lock(s_Pool.mutex);
+            s_Pool.active--;
+        }
+        s_Pool.done.notify_all();
+    }
+}
+
+static void stopThreads()
+{
+    {
+        std::lock_guard<std::mutex> lock(s_Pool.mutex);
+        s_Pool.stop = true;
+    }
+    s_Pool.wake.notify_all();
+
+    for (auto& thread : s_Pool.threads)
+        thread.join();
+
+    s_Pool.threads.clear();
+    s_Pool.workers.clear();
+    s_Pool.stop = false;
+}
+
+Pool::~Pool()
+{
+    if (!threads.empty())
+        stopThreads();
+}
+
+namespace sim
+{
+    uint32_t getHardwareThreadCount()
+    {
+        uint32_t count = std::thread::hardware_concurrency();
+        return count > 0 ? count : 1;
+    }
+
+    void setThreadCount(uint32_t count)
+    {
+        std::lock_guard<std::mutex> lock(s_Pool.callMutex);
+
+        if (count == 0)
+            count = getHardwareThreadCount();
+
+        s_Pool.started = true;
+        if (!s_Pool.workers.empty() && s_Pool.workers.size() == count)
+            return;
+
+        stopThreads();
+
+        for (uint32_t i = 0; i < count; i++)
+            s_Pool.workers.push_back(std::make_unique<PoolWorker>());
+
+        for (uint32_t i = 1; i < count; i++)
+            s_Pool.threads.emplace_back(workerMain, i);
+    }
+
+    uint32_t getThreadCount()
+    {
+        if (!s_Pool.started)
+            setThreadCount(0);
+
+        return (uint32_t)s_Pool.workers.size();
+    }
+
+    void parallelFor(uint32_t begin, uint32_t end, uint32_t grain, const SimTaskFunction& function)
+    {
+        if (end <= begin) return;
+        grain = std::max(grain, 1u);
+
+        if (s_InTask || end - begin <= grain || getThreadCount() == 1)
+        {
+            function(begin, end, 0);
+            return;
+        }
+
+        std::lock_guard<std::mutex> call(s_Pool.callMutex);
+
+        PoolJob job;
+        job.function = &function;
+        job.grain = grain;
+        job.remaining.store(end - begin);
+
+        pushRange(0, { begin, end });
+        {
+            std::lock_guard<std::mutex> lock(s_Pool.mutex);
+            s_Pool.job = &job;
+            s_Pool.generation++;
+        }
+        s_Pool.wake.notify_all();
+
+        s_InTask = true;
+        runJob(&job, 0);
+        s_InTask = false;
+
+        // the job lives on this stack, wait until no worker looks at it anymore
+        std::unique_lock<std::mutex> lock(s_Pool.mutex);
+        s_Pool.done.wait(lock, [] { return s_Pool.active == 0; });
+        s_Pool.job = nullptr;
+    }
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+#include <functional>
+
+// work stealing thread pool for the force and update passes
+// every worker owns a deque of index ranges, a range bigger than the grain is split in half and the
+// upper half is pushed so idle workers can steal it, which balances passes with uneven cost per body
+
+// called with a sub range [begin, end) and the index of the worker running it (0 is the calling thread)
+typedef std::function<void(uint32_t begin, uint32_t end, uint32_t worker)> SimTaskFunction;
+
+namespace sim
+{
+    // 0 uses every hardware thread, 1 runs everything on the calling thread
+    // must not be called while a parallelFor is running
+    void setThreadCount(uint32_t count);
+    uint32_t getThreadCount();
+    uint32_t getHardwareThreadCount();
+
+    // runs function over [begin, end) in ranges of at most grain indices and returns when all are done
+    // nested calls (from inside a task) run on the calling worker
+    void parallelFor(uint32_t begin, uint32_t end, uint32_t grain, const SimTaskFunction& function);
+}
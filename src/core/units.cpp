@@ -0,0 +1,31 @@
+#include "units.h"
+
+namespace sim
+{
+    SimUnits getUnits(SimUnitSystem system)
+    {
+        switch (system)
+        {
+        case Sim_Units_Astronomical:
+        {
+            // G from the si value (not k^2) so si and astronomical runs are the same physics
+            return { AU, DAY, SUN_MASS, G_CONSTANT * SUN_MASS * DAY * DAY / (AU * AU * AU) };
+        }
+        default: break;
+        }
+
+        return { 1.0, 1.0, 1.0, G_CONSTANT };
+    }
+
+    const char* getUnitSystemName(SimUnitSystem system)
+    {
+        switch (system)
+        {
+        case Sim_Units_Si:           { return "si"; }
+        case Sim_Units_Astronomical: { return "astronomical"; }
+        default: break;
+        }
+
+        return "unknown";
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+
+// unit systems of the simulation core, the bodies carry the units their numbers are in
+// in si units G * m1 * m2 is around 1e47 and 1 / r^3 around 1e-39 past pluto, both out of float range,
+// in astronomical units (AU, days, solar masses) every term stays near 1 and the float vector kernels are safe
+// the rest of the program talks si, conversion happens when bodies are added, read back or drawn
+
+#define G_CONSTANT 6.6743e-11 /* G Constant of attraction */
+#define AU 1.496e+11 /* 1 AU in meters */
+#define SUN_MASS 1.9891e+30 /* mass of the sun in kg */
+#define DAY 86400.0 /* 1 day in seconds */
+#define LIGHT_SPEED 299792458.0 /* speed of light in m/s */
+
+enum SimUnitSystem
+{
+    Sim_Units_Si,           // meters, seconds, kilograms
+    Sim_Units_Astronomical, // AU, days, solar masses, G is about k^2 (gaussian gravitational constant squared)
+    Sim_Units_Count,
+};
+
+// one unit of the system in si units, and G in the units of the system
+struct SimUnits
+{
+    double length;
+    double time;
+    double mass;
+    double G;
+};
+
+namespace sim
+{
+    SimUnits getUnits(SimUnitSystem system);
+    const char* getUnitSystemName(SimUnitSystem system);
+}
@@ -0,0 +1,729 @@
+#include "headless.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <filesystem>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "core/ensemble.h"
+#include "core/gravity.h"
+#include "core/sweep.h"
+#include "core/thread_pool.h"
+
+
+namespace headless
+{
+    static void printUsage()
+    {
+        printf("usage: solarSystem --headless --steps N --dt S [options]\n");
+        printf("  --steps N        number of simulation steps to run\n");
+        printf("  --dt S           time step in seconds (default 86400)\n");
+        printf("  --every K        write the state every K steps (default: final state only)\n");
+        printf("  --output f       write the state to a file instead of stdout\n");
+        printf("  --belt N         add an asteroid belt of N bodies between 2.2 and 3.2 AU\n");
+        printf("  --particles N    add N massless test particles between 2.2 and 3.2 AU\n");
+        printf("  --kuiper N       add N massless test particles between 30 and 50 AU\n");
+        printf("  --solver name    gravity solver: direct, barnes-hut, fmm (default direct)\n");
+        printf("  --theta T        barnes-hut and fmm opening angle (default 0.5)\n");
+        printf("  --quadrupole     use quadrupole moments in the barnes-hut solver\n");
+        printf("  --order P        fast multipole expansion order (default 8, max %d)\n", SIM_FMM_MAX_ORDER);
+        printf("  --integrator I   integrator: euler, leapfrog, yoshida4, yoshida6, forest-ruth, hermite,\n");
+        printf("                   dormand-prince, kepler (default euler), --dt is the largest hermite step\n");
+        printf("  --eta E          hermite timestep accuracy (default %.2f)\n", SIM_HERMITE_ETA);
+        printf("  --precision P    state of the splitting integrators: float, kahan, double (default float)\n");
+        printf("  --tolerance T    dormand-prince relative error per step (default %.0e), --dt is the output interval\n", SIM_DORMAND_PRINCE_TOLERANCE);
+        printf("  --kepler-particles  test particles follow two-body orbits around the sun instead of the field of every body\n");
+        printf("  --collisions C   response to bodies touching: none, merge, bounce, fragment (default none)\n");
+        printf("  --restitution E  normal restitution of bounces (default %.1f)\n", SIM_COLLISION_RESTITUTION);
+        printf("  --encounters H   regularize pairs closer than H hill radii in the splitting integrators (default off, %.0f works for steps of a day)\n", SIM_ENCOUNTER_HILL);
+        printf("  --softening L    plummer softening length of the forces on the test particles in meters (default 0)\n");
+        printf("  --gravity-speed S  gravity travels at S m/s in the splitting integrators, each body feels the others where\n");
+        printf("                   they were (default 0, instantaneous, %.0f is the speed of light)\n", LIGHT_SPEED);
+        printf("  --shared-steps   hermite moves every body with the smallest step instead of block steps\n");
+        printf("  --units U        units the core runs in: si, astronomical (default astronomical), the output is si\n");
+        printf("  --kernel K       vector kernel: reference, scalar, sse2, avx2, avx512 (default the widest this cpu runs,\n");
+        printf("                   or the SIM_KERNEL environment variable)\n");
+        printf("  --threads N      worker threads (default 0, every hardware thread)\n");
+        printf("  --deterministic  sum the direct summation forces in a fixed order, the same bits for any --threads\n");
+        printf("  --checksums      print a checksum of the state after every step to stderr (the final one is always printed)\n");
+        printf("  --diagnostics f  write the energy, momentum and angular momentum of every step and their drift to a file\n");
+        printf("  --force-error N  report the force error of the solver against direct summation on N bodies\n");
+        printf("  --ensemble K     run K copies of the solar system with perturbed positions and velocities instead (splitting\n");
+        printf("                   integrators, float), --output gets the outcome of every member\n");
+        printf("  --perturbation P relative perturbation of the ensemble members (default 1e-3), member 0 is unperturbed\n");
+        printf("  --eject-radius R distance from the sun in meters an ensemble member counts as ejected at (default %.0f AU)\n", SIM_ENSEMBLE_EJECT_RADIUS / AU);
+        printf("  --sweep f        run the points of a parameter sweep side by side, each for --steps times --dt seconds,\n");
+        printf("                   --output gets one row of results per point\n");
+        printf("  --resume         keep the points already in the --output of a sweep and run the rest, the sweep and the other\n");
+        printf("                   options have to be the ones the output was started with\n");
+    }
+
+    static void writeState(FILE* file, const SimWorld& world)
+    {
+        // si units whatever units the core runs in
+        const SimBodies& bodies = world.bodies;
+        for (uint32_t i = 0; i < bodies.count; i++)
+        {
+            SimBody body = sim::getBody(bodies, i);
+            fprintf(file, "%llu,%.9e,%u,%.9e,%.9e,%.9e,%.9e,%.9e\n",
+                (unsigned long long)world.steps, world.time, bodies.id[i], body.mass, body.pos.x, body.pos.y, body.vel.x, body.vel.y);
+        }
+    }
+
+    static void writeDiagnostics(FILE* file, const SimWorld& world)
+    {
+        // si units like the state
+        const SimUnits& units = world.bodies.units;
+        double energy = units.mass * units.length * units.length / (units.time * units.time);
+        double momentum = units.mass * units.length / units.time;
+        double angular = momentum * units.length;
+
+        const SimDiagnostics& d = world.diagnostics;
+        const SimConservation& c = d.last;
+        fprintf(file, "%llu,%.9e,%.15e,%.15e,%.15e,%.15e,%.15e,%.15e,%.6e,%.6e,%.6e\n",
+            (unsigned long long)world.steps, world.time, c.kinetic * energy, c.potential * energy, c.energy * energy,
+            c.px * momentum, c.py * momentum, c.angular * angular, sim::getEnergyDrift(d), sim::getMomentumDrift(d), sim::getAngularDrift(d));
+    }
+
+    bool isHeadless(int argc, char** argv)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            if (strcmp(argv[i], "--headless") == 0)
+                return true;
+        }
+
+        return false;
+    }
+
+    static bool parseSolver(SimSolver* solver, const char* name)
+    {
+        for (int i = 0; i < Sim_Solver_Count; i++)
+        {
+            if (strcmp(name, sim::getSolverName((SimSolver)i)) == 0)
+            {
+                *solver = (SimSolver)i;
+                return true;
+            }
+        }
+
+        printf("unknown solver '%s'\n", name);
+        return false;
+    }
+
+    static bool parseIntegrator(SimIntegrator* integrator, const char* name)
+    {
+        for (int i = 0; i < Sim_Integrator_Count; i++)
+        {
+            if (strcmp(name, sim::getIntegratorName((SimIntegrator)i)) == 0)
+            {
+                *integrator = (SimIntegrator)i;
+                return true;
+            }
+        }
+
+        printf("unknown integrator '%s'\n", name);
+        return false;
+    }
+
+    static bool parsePrecision(SimPrecision* precision, const char* name)
+    {
+        for (int i = 0; i < Sim_Precision_Count; i++)
+        {
+            if (strcmp(name, sim::getPrecisionName((SimPrecision)i)) == 0)
+            {
+                *precision = (SimPrecision)i;
+                return true;
+            }
+        }
+
+        printf("unknown precision '%s'\n", name);
+        return false;
+    }
+
+    static bool parseCollisions(SimCollisionResponse* response, const char* name)
+    {
+        for (int i = 0; i < Sim_Collision_Count; i++)
+        {
+            if (strcmp(name, sim::getCollisionResponseName((SimCollisionResponse)i)) == 0)
+            {
+                *response = (SimCollisionResponse)i;
+                return true;
+            }
+        }
+
+        printf("unknown collision response '%s'\n", name);
+        return false;
+    }
+
+    static bool parseUnits(SimUnitSystem* units, const char* name)
+    {
+        for (int i = 0; i < Sim_Units_Count; i++)
+        {
+            if (strcmp(name, sim::getUnitSystemName((SimUnitSystem)i)) == 0)
+            {
+                *units = (SimUnitSystem)i;
+                return true;
+            }
+        }
+
+        printf("unknown unit system '%s'\n", name);
+        return false;
+    }
+
+    // selected right away, the step always runs the current kernel (sim::getKernel)
+    static bool parseKernel(const char* name)
+    {
+        SimKernel kernel;
+        if (!sim::findKernel(name, &kernel))
+        {
+            printf("unknown kernel '%s'\n", name);
+            return false;
+        }
+
+        if (!sim::setKernel(kernel))
+        {
+            printf("the %s kernel is not compiled in (SIM_SIMD) or not supported by this cpu\n", name);
+            return false;
+        }
+
+        return true;
+    }
+
+    bool parseOptions(HeadlessOptions* options, int argc, char** argv)
+    {
+        *options = HeadlessOptions{};
+        sim::initSettings(&options->settings);
+
+        for (int i = 1; i < argc; i++)
+        {
+            const char* arg = argv[i];
+            const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+            // flags without a value
+            if (strcmp(arg, "--headless") == 0) continue;
+            if (strcmp(arg, "--quadrupole") == 0) { options->settings.quadrupole = true; continue; }
+            if (strcmp(arg, "--shared-steps") == 0) { options->settings.blockSteps = false; continue; }
+            if (strcmp(arg, "--kepler-particles") == 0) { options->settings.keplerParticles = true; continue; }
+            if (strcmp(arg, "--deterministic") == 0) { options->settings.deterministic = true; continue; }
+            if (strcmp(arg, "--checksums") == 0) { options->checksums = true; continue; }
+            if (strcmp(arg, "--resume") == 0) { options->resume = true; continue; }
+
+            if (!value)
+            {
+                printf("missing value for argument '%s'\n", arg);
+                return false;
+            }
+
+            if (strcmp(arg, "--steps") == 0)       { options->steps = strtoull(value, nullptr, 10); }
+            else if (strcmp(arg, "--dt") == 0)     { options->settings.timeStep = strtof(value, nullptr); }
+            else if (strcmp(arg, "--every") == 0)  { options->outputInterval = strtoull(value, nullptr, 10); }
+            else if (strcmp(arg, "--output") == 0) { options->outputPath = value; }
+            else if (strcmp(arg, "--belt") == 0)   { options->beltCount = (uint32_t)strtoul(value, nullptr, 10); }
+            else if (strcmp(arg, "--particles") == 0) { options->particleCount = (uint32_t)strtoul(value, nullptr, 10); }
+            else if (strcmp(arg, "--kuiper") == 0) { options->kuiperCount = (uint32_t)strtoul(value, nullptr, 10); }
+            else if (strcmp(arg, "--theta") == 0)  { options->settings.theta = strtof(value, nullptr); }
+            else if (strcmp(arg, "--order") == 0)  { options->settings.fmmOrder = (uint32_t)strtoul(value, nullptr, 10); }
+            else if (strcmp(arg, "--threads") == 0) { options->threads = (uint32_t)strtoul(value, nullptr, 10); }
+            else if (strcmp(arg, "--force-error") == 0) { options->errorSamples = (uint32_t)strtoul(value, nullptr, 10); }
+            else if (strcmp(arg, "--solver") == 0) { if (!parseSolver(&options->settings.solver, value)) return false; }
+            else if (strcmp(arg, "--integrator") == 0) { if (!parseIntegrator(&options->settings.integrator, value)) return false; }
+            else if (strcmp(arg, "--eta") == 0)    { options->settings.hermiteEta = strtof(value, nullptr); }
+            else if (strcmp(arg, "--units") == 0)  { if (!parseUnits(&options->units, value)) return false; }
+            else if (strcmp(arg, "--kernel") == 0) { if (!parseKernel(value)) return false; }
+            else if (strcmp(arg, "--precision") == 0) { if (!parsePrecision(&options->settings.precision, value)) return false; }
+            else if (strcmp(arg, "--tolerance") == 0) { options->settings.tolerance = strtof(value, nullptr); }
+            else if (strcmp(arg, "--collisions") == 0) { if (!parseCollisions(&options->settings.collisions, value)) return false; }
+            else if (strcmp(arg, "--restitution") == 0) { options->settings.restitution = strtof(value, nullptr); }
+            else if (strcmp(arg, "--encounters") == 0) { options->settings.encounterHill = strtof(value, nullptr); }
+            else if (strcmp(arg, "--softening") == 0) { options->settings.softening = strtof(value, nullptr); }
+            else if (strcmp(arg, "--gravity-speed") == 0) { options->settings.gravitySpeed = strtof(value, nullptr); }
+            else if (strcmp(arg, "--diagnostics") == 0) { options->diagnosticsPath = value; options->settings.diagnostics = true; }
+            else if (strcmp(arg, "--ensemble") == 0) { options->ensembleMembers = (uint32_t)strtoul(value, nullptr, 10); }
+            else if (strcmp(arg, "--perturbation") == 0) { options->perturbation = strtod(value, nullptr); }
+            else if (strcmp(arg, "--eject-radius") == 0) { options->ejectRadius = strtod(value, nullptr); }
+            else if (strcmp(arg, "--sweep") == 0) { options->sweepPath = value; }
+            else
+            {
+                printf("unknown argument '%s'\n", arg);
+                return false;
+            }
+
+            i++;
+        }
+
+        if (options->steps == 0 || options->settings.timeStep <= 0.0f)
+        {
+            printf("--steps and --dt must be greater than 0\n");
+            return false;
+        }
+
+        if (options->settings.fmmOrder < 1 || options->settings.fmmOrder > SIM_FMM_MAX_ORDER)
+        {
+            printf("--order must be between 1 and %d\n", SIM_FMM_MAX_ORDER);
+            return false;
+        }
+
+        if (options->settings.tolerance <= 0.0f)
+        {
+            printf("--tolerance must be greater than 0\n");
+            return false;
+        }
+
+        if (options->settings.encounterHill < 0.0f || options->settings.softening < 0.0f || options->settings.gravitySpeed < 0.0f)
+        {
+            printf("--encounters, --softening and --gravity-speed can't be negative\n");
+            return false;
+        }
+
+        if (options->ensembleMembers > 0 && options->settings.gravitySpeed > 0.0f)
+        {
+            printf("--ensemble steps its members with instantaneous gravity, without --gravity-speed\n");
+            return false;
+        }
+
+        if (options->ensembleMembers > 0 && sim::getIntegrator(options->settings.integrator).stages == 0)
+        {
+            printf("--ensemble steps its members with the splitting integrators (euler, leapfrog, yoshida4, yoshida6, forest-ruth), not %s\n",
+                sim::getIntegratorName(options->settings.integrator));
+            return false;
+        }
+
+        if (options->ensembleMembers > 0 && (options->beltCount > 0 || options->particleCount > 0 || options->kuiperCount > 0))
+        {
+            printf("--ensemble runs the planets only, without --belt, --particles and --kuiper\n");
+            return false;
+        }
+
+        if (options->resume && (!options->sweepPath || !options->outputPath))
+        {
+            printf("--resume needs --sweep and the --output of the sweep\n");
+            return false;
+        }
+
+        return true;
+    }
+
+    // the members run all their steps at once, the outcomes are written at the end
+    static void runEnsemble(FILE* file, const HeadlessOptions& options)
+    {
+        SimWorld world;
+        sim::initSolarSystem(&world, options.units);
+
+        SimEnsemble ensemble;
+        sim::initEnsemble(&ensemble, world.bodies, options.ensembleMembers, options.perturbation);
+
+        auto start = std::chrono::high_resolution_clock::now();
+
+        for (uint64_t done = 0; done < options.steps; )
+        {
+            uint32_t steps = (uint32_t)std::min<uint64_t>(options.steps - done, UINT32_MAX);
+            sim::stepEnsemble(&ensemble, options.settings.integrator, options.settings.timeStep, steps);
+            done += steps;
+        }
+
+        double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+        uint32_t ejected = 0, collided = 0;
+        fprintf(file, "member,ejected,collided,max_eccentricity,body,max_distance,min_separation\n");
+        for (uint32_t m = 0; m < ensemble.members; m++)
+        {
+            SimEnsembleOutcome outcome = sim::getEnsembleOutcome(ensemble, m, options.ejectRadius);
+            ejected += outcome.ejected;
+            collided += outcome.collided;
+            fprintf(file, "%u,%d,%d,%.6e,%u,%.9e,%.6e\n", m, outcome.ejected, outcome.collided, outcome.maxEccentricity, outcome.body,
+                outcome.maxDistance, outcome.minSeparation);
+        }
+
+        double years = ensemble.time / (365.25 * 86400.0);
+        fprintf(stderr, "%u members, %llu steps in %.3f s (%.0f member-years/s, %s, %u threads)\n", ensemble.members,
+            (unsigned long long)options.steps, seconds, ensemble.members * years / seconds, sim::getKernelName(sim::getKernel()), sim::getThreadCount());
+        fprintf(stderr, "%u ejected, %u collided\n", ejected, collided);
+    }
+
+    // sweep specification, one directive per line, # starts a comment:
+    //   grid                          every combination of the values of the parameters (the default)
+    //   lhs N [seed]                  N points of a latin hypercube
+    //   dt MIN MAX [COUNT] [log]      time step in seconds
+    //   mass BODY MIN MAX [COUNT] [log]      factor on the mass of body BODY (index or planets)
+    //   velocity BODY MIN MAX [COUNT] [log]  factor on the velocity of body BODY relative to the sun
+    static bool parseSweep(SimSweep* sweep, const char* path)
+    {
+        FILE* file = fopen(path, "r");
+        if (!file)
+        {
+            printf("failed to open sweep file '%s'\n", path);
+            return false;
+        }
+
+        *sweep = SimSweep{};
+        char line[512];
+        uint32_t number = 0;
+        bool ok = true;
+        while (ok && fgets(line, sizeof(line), file))
+        {
+            number++;
+            if (char* comment = strchr(line, '#'))
+                *comment = '\0';
+
+            std::vector<const char*> words;
+            for (char* word = strtok(line, " \t\r\n"); word; word = strtok(nullptr, " \t\r\n"))
+                words.push_back(word);
+            if (words.empty()) continue;
+
+            if (strcmp(words[0], "grid") == 0)
+            {
+                sweep->mode = Sim_Sweep_Grid;
+                continue;
+            }
+
+            if (strcmp(words[0], "lhs") == 0 && words.size() >= 2)
+            {
+                sweep->mode = Sim_Sweep_LatinHypercube;
+                sweep->samples = (uint32_t)strtoul(words[1], nullptr, 10);
+                if (words.size() >= 3)
+                    sweep->seed = (uint32_t)strtoul(words[2], nullptr, 10);
+                continue;
+            }
+
+            SimSweepParameter parameter = {};
+            parameter.count = 1;
+            size_t next = 1;
+            if (strcmp(words[0], "dt") == 0)
+                parameter.kind = Sim_Sweep_TimeStep;
+            else if (strcmp(words[0], "mass") == 0)
+                parameter.kind = Sim_Sweep_Mass;
+            else if (strcmp(words[0], "velocity") == 0)
+                parameter.kind = Sim_Sweep_Velocity;
+            else
+                parameter.kind = Sim_Sweep_KindCount;
+
+            if (parameter.kind != Sim_Sweep_TimeStep && parameter.kind != Sim_Sweep_KindCount && words.size() > next)
+            {
+                const char* body = words[next++];
+                parameter.body = strcmp(body, "planets") == 0 ? SIM_SWEEP_PLANETS : (uint32_t)strtoul(body, nullptr, 10);
+            }
+
+            if (parameter.kind == Sim_Sweep_KindCount || words.size() < next + 2 || sweep->parameters.size() >= SIM_SWEEP_MAX_PARAMETERS)
+            {
+                printf("%s:%u: can't read sweep directive '%s'\n", path, number, words[0]);
+                ok = false;
+                break;
+            }
+
+            parameter.min = strtod(words[next++], nullptr);
+            parameter.max = strtod(words[next++], nullptr);
+            for (; next < words.size(); next++)
+            {
+                if (strcmp(words[next], "log") == 0)
+                    parameter.logarithmic = true;
+                else
+                    parameter.count = (uint32_t)strtoul(words[next], nullptr, 10);
+            }
+
+            sweep->parameters.push_back(parameter);
+        }
+
+        fclose(file);
+
+        if (ok && (sweep->parameters.empty() || (sweep->mode == Sim_Sweep_LatinHypercube && sweep->samples == 0)))
+        {
+            printf("sweep '%s' has no points\n", path);
+            ok = false;
+        }
+
+        return ok;
+    }
+
+    static std::string sweepHeader(const SimSweep& sweep)
+    {
+        std::string header = "index";
+        for (const SimSweepParameter& parameter : sweep.parameters)
+        {
+            header += ",";
+            header += sim::getSweepKindName(parameter.kind);
+            if (parameter.kind != Sim_Sweep_TimeStep)
+                header += parameter.body == SIM_SWEEP_PLANETS ? std::string("_planets") : "_" + std::to_string(parameter.body);
+        }
+
+        return header + ",steps,energy_drift,angular_drift,max_distance,bodies,checksum,seconds";
+    }
+
+    // first line of a sweep output: a hash of everything its rows depend on, the points (mode, seed, ranges) and the
+    // run (steps, time step, settings, bodies and particles), so --resume never mixes in rows of another sweep or run
+    // (the threads and the kernel only change the seconds and the last bits of the checksums)
+    static std::string sweepSignature(const SimSweep& sweep, const HeadlessOptions& options)
+    {
+        std::string text;
+        char buffer[256];
+        snprintf(buffer, sizeof(buffer), "%d %u %u", (int)sweep.mode, sweep.samples, sweep.seed);
+        text += buffer;
+        for (const SimSweepParameter& parameter : sweep.parameters)
+        {
+            snprintf(buffer, sizeof(buffer), " %d %u %.17g %.17g %u %d", (int)parameter.kind, parameter.body, parameter.min, parameter.max,
+                parameter.count, (int)parameter.logarithmic);
+            text += buffer;
+        }
+
+        const SimSettings& settings = options.settings;
+        snprintf(buffer, sizeof(buffer), " | %llu %.9g %d %.9g %d %u %d %.9g %d %d %.9g %d %d %.9g %.9g %.9g %d %.9g",
+            (unsigned long long)options.steps, settings.timeStep, (int)settings.solver, settings.theta, (int)settings.quadrupole,
+            settings.fmmOrder, (int)settings.integrator, settings.hermiteEta, (int)settings.blockSteps, (int)settings.precision,
+            settings.tolerance, (int)settings.keplerParticles, (int)settings.collisions, settings.restitution, settings.softening,
+            settings.encounterHill, (int)settings.deterministic, settings.gravitySpeed);
+        text += buffer;
+        snprintf(buffer, sizeof(buffer), " | %d %u %u %u", (int)options.units, options.beltCount, options.particleCount, options.kuiperCount);
+        text += buffer;
+
+        // fnv-1a
+        uint64_t hash = 0xcbf29ce484222325ull;
+        for (char c : text)
+            hash = (hash ^ (unsigned char)c) * 0x100000001b3ull;
+
+        snprintf(buffer, sizeof(buffer), "# sweep %016llx", (unsigned long long)hash);
+        return buffer;
+    }
+
+    // every point is its own world run on one worker thread, the rows are written (and flushed) as the points finish,
+    // so a sweep that was stopped keeps every finished point and --resume runs only the others
+    static int runSweep(const HeadlessOptions& options)
+    {
+        SimSweep sweep;
+        if (!parseSweep(&sweep, options.sweepPath))
+            return -1;
+
+        std::string signature = sweepSignature(sweep, options);
+        std::string header = sweepHeader(sweep);
+        uint32_t points = (uint32_t)sim::buildSweepPoints(sweep).size();
+        size_t columns = 1 + sweep.parameters.size() + 7;
+        std::vector<uint8_t> done(points, 0);
+        size_t kept = 0;
+
+        // complete rows of the points of this sweep and run only, a row cut off by a stop is run again
+        bool append = false;
+        if (options.resume)
+        {
+            if (FILE* previous = fopen(options.outputPath, "rb"))
+            {
+                std::string text;
+                char buffer[4096];
+                size_t read;
+                while ((read = fread(buffer, 1, sizeof(buffer), previous)) > 0)
+                    text.append(buffer, read);
+                fclose(previous);
+
+                std::vector<std::string> lines;
+                size_t start = 0, end;
+                while ((end = text.find('\n', start)) != std::string::npos)
+                {
+                    lines.push_back(text.substr(start, end - start));
+                    start = end + 1;
+                }
+
+                // stopped before the header was out, nothing to keep
+                if (lines.size() >= 2)
+                {
+                    if (lines[0] != signature || lines[1] != header)
+                    {
+                        printf("'%s' is the output of a different sweep or different run options\n", options.outputPath);
+                        return -1;
+                    }
+
+                    for (size_t l = 2; l < lines.size(); l++)
+                    {
+                        const std::string& row = lines[l];
+                        if ((size_t)std::count(row.begin(), row.end(), ',') + 1 != columns) continue;
+
+                        uint32_t index = (uint32_t)strtoul(row.c_str(), nullptr, 10);
+                        if (index < points && !done[index])
+                        {
+                            done[index] = 1;
+                            kept++;
+                        }
+                    }
+
+                    // drop a row cut off by the stop, the point runs again
+                    append = true;
+                    if (start < text.size())
+                    {
+                        std::error_code error;
+                        std::filesystem::resize_file(options.outputPath, start, error);
+                        if (error)
+                        {
+                            printf("failed to cut the last row of '%s'\n", options.outputPath);
+                            return -1;
+                        }
+                    }
+                }
+            }
+        }
+
+        // a resumed sweep only appends, so the finished rows are never rewritten and can't be lost to another stop,
+        // binary so the offsets of the cut above are the bytes of the file
+        FILE* file = options.outputPath ? fopen(options.outputPath, append ? "ab" : "wb") : stdout;
+        if (!file)
+        {
+            printf("failed to open output file '%s'\n", options.outputPath);
+            return -1;
+        }
+
+        if (!append)
+            fprintf(file, "%s\n%s\n", signature.c_str(), header.c_str());
+        fflush(file);
+
+        sim::setThreadCount(options.threads);
+
+        auto setup = [&](SimWorld* world)
+        {
+            sim::initSolarSystem(world, options.units);
+            if (options.beltCount > 0)
+                sim::addAsteroidBelt(world, options.beltCount, 2.2f * AU, 3.2f * AU);
+            sim::addParticleBelt(world, options.particleCount, 2.2f * AU, 3.2f * AU, 3);
+            sim::addParticleBelt(world, options.kuiperCount, 30.0f * AU, 50.0f * AU, 2);
+        };
+
+        uint32_t finished = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+
+        double duration = (double)options.steps * options.settings.timeStep;
+        sim::runSweep(sweep, options.settings, duration, setup, done, [&](const SimSweepResult& result)
+        {
+            fprintf(file, "%u", result.index);
+            for (size_t p = 0; p < sweep.parameters.size(); p++)
+                fprintf(file, ",%.9e", result.values[p]);
+            fprintf(file, ",%llu,%.6e,%.6e,%.9e,%u,%016llx,%.3f\n", (unsigned long long)result.steps, result.energyDrift, result.angularDrift,
+                result.maxDistance, result.bodies, (unsigned long long)result.checksum, result.seconds);
+            fflush(file);
+            finished++;
+        });
+
+        double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+        if (file != stdout)
+            fclose(file);
+
+        fprintf(stderr, "%s sweep of %u points, %zu done before, %u run in %.3f s (%u threads)\n", sim::getSweepModeName(sweep.mode),
+            points, kept, finished, seconds, sim::getThreadCount());
+        return 0;
+    }
+
+    int run(int argc, char** argv)
+    {
+        HeadlessOptions options;
+        if (!parseOptions(&options, argc, argv))
+        {
+            printUsage();
+            return -1;
+        }
+
+        if (options.sweepPath)
+            return runSweep(options);
+
+        FILE* file = stdout;
+        if (options.outputPath)
+        {
+            file = fopen(options.outputPath, "w");
+            if (!file)
+            {
+                printf("failed to open output file '%s'\n", options.outputPath);
+                return -1;
+            }
+        }
+
+        FILE* diagnostics = nullptr;
+        if (options.diagnosticsPath)
+        {
+            diagnostics = fopen(options.diagnosticsPath, "w");
+            if (!diagnostics)
+            {
+                printf("failed to open diagnostics file '%s'\n", options.diagnosticsPath);
+                return -1;
+            }
+
+            fprintf(diagnostics, "step,time,kinetic,potential,energy,px,py,angular,energy_drift,momentum_drift,angular_drift\n");
+        }
+
+        sim::setThreadCount(options.threads);
+
+        if (options.ensembleMembers > 0)
+        {
+            runEnsemble(file, options);
+            if (file != stdout)
+                fclose(file);
+            if (diagnostics)
+                fclose(diagnostics);
+            return 0;
+        }
+
+        SimWorld world;
+        sim::initSolarSystem(&world, options.units);
+        if (options.beltCount > 0)
+            sim::addAsteroidBelt(&world, options.beltCount, 2.2f * AU, 3.2f * AU);
+        // a seed of their own, the one of the belt would start some particles on top of belt bodies
+        sim::addParticleBelt(&world, options.particleCount, 2.2f * AU, 3.2f * AU, 3);
+        sim::addParticleBelt(&world, options.kuiperCount, 30.0f * AU, 50.0f * AU, 2);
+
+        fprintf(file, "step,time,body,mass,x,y,vx,vy\n");
+
+        if (options.errorSamples > 0)
+        {
+            sim::computeForces(&world, options.settings);
+            SimForceError error = sim::measureForceError(world.bodies, world.ax.data(), world.ay.data(), options.errorSamples);
+            fprintf(stderr, "%s force error on %u bodies: rms %.3e, max %.3e\n", sim::getSolverName(options.settings.solver), error.samples, error.rms, error.max);
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+
+        for (uint64_t i = 0; i < options.steps; i++)
+        {
+            sim::step(&world, options.settings);
+
+            if (diagnostics)
+                writeDiagnostics(diagnostics, world);
+            if (options.checksums)
+                fprintf(stderr, "step %llu checksum %016llx\n", (unsigned long long)world.steps, (unsigned long long)sim::computeChecksum(world));
+            if (options.outputInterval != 0 && world.steps % options.outputInterval == 0 && world.steps != options.steps)
+                writeState(file, world);
+        }
+
+        double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+        writeState(file, world);
+
+        if (file != stdout)
+            fclose(file);
+        if (diagnostics)
+            fclose(diagnostics);
+
+        // timing goes to stderr so stdout stays a clean table
+        fprintf(stderr, "%llu steps in %.3f s (%.0f steps/s, %u threads), %llu force evaluations\n",
+            (unsigned long long)options.steps, seconds, options.steps / seconds, sim::getThreadCount(), (unsigned long long)world.evaluations);
+        // compare between runs with different --threads (and --deterministic) or builds
+        fprintf(stderr, "state checksum %016llx\n", (unsigned long long)sim::computeChecksum(world));
+        if (world.particles.count > 0)
+            fprintf(stderr, "%u test particles\n", world.particles.count);
+        if (options.settings.collisions != Sim_Collision_None)
+        {
+            const SimCollisions& collisions = world.collisions;
+            fprintf(stderr, "%llu merges, %llu bounces, %llu fragmentations, %llu particles absorbed, %u bodies left\n",
+                (unsigned long long)collisions.merges, (unsigned long long)collisions.bounces, (unsigned long long)collisions.fragmentations,
+                (unsigned long long)collisions.absorbed, world.bodies.count);
+        }
+        if (options.settings.encounterHill > 0.0f)
+            fprintf(stderr, "%llu regularized pair steps, %llu levi-civita steps\n", (unsigned long long)world.encounters.pairSteps, (unsigned long long)world.encounters.substeps);
+        if (diagnostics)
+        {
+            const SimDiagnostics& d = world.diagnostics;
+            fprintf(stderr, "energy drift %.3e, momentum drift %.3e, angular momentum drift %.3e (%llu potentials from the force pass, %llu summed)\n",
+                sim::getEnergyDrift(d), sim::getMomentumDrift(d), sim::getAngularDrift(d), (unsigned long long)d.fused, (unsigned long long)d.direct);
+        }
+        if (options.settings.integrator == Sim_Integrator_DormandPrince)
+            fprintf(stderr, "%llu adaptive steps accepted, %llu rejected\n", (unsigned long long)world.dormandPrince.accepted, (unsigned long long)world.dormandPrince.rejected);
+
+        return 0;
+    }
+}
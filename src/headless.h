@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "core/ensemble.h"
+#include "core/simulation.h"
+
+// headless mode, runs the simulation core without a window at full cpu speed
+// usage: solarSystem --headless --steps N --dt S [options], see printUsage() in headless.cpp
+
+struct HeadlessOptions
+{
+    uint64_t steps = 0;      // number of steps to run
+    uint64_t outputInterval = 0; // write the state every n steps, 0 writes only the final state
+    const char* outputPath = nullptr; // nullptr writes to stdout
+    uint32_t beltCount = 0;  // asteroids added to the solar system
+    uint32_t particleCount = 0; // massless test particles in the asteroid belt
+    uint32_t kuiperCount = 0; // massless test particles in the kuiper belt
+    uint32_t errorSamples = 0; // bodies compared with direct summation after the first force pass, 0 skips the check
+    uint32_t threads = 0;    // worker threads, 0 uses every hardware thread
+    bool checksums = false;  // print the checksum of the state after every step to stderr
+    const char* diagnosticsPath = nullptr; // energy and momentum of every step to this file, nullptr skips them
+    uint32_t ensembleMembers = 0; // perturbed copies of the solar system run side by side instead of one world, 0 runs the world
+    double perturbation = 1e-3; // relative perturbation of the ensemble members
+    double ejectRadius = SIM_ENSEMBLE_EJECT_RADIUS; // distance from the sun (m) an ensemble member counts as ejected at
+    const char* sweepPath = nullptr; // sweep specification (see parseSweep() in headless.cpp), nullptr runs one world
+    bool resume = false;     // keep the points already in the sweep output and run the others
+    SimUnitSystem units = Sim_Units_Astronomical; // units the core runs in, the output is si either way
+    SimSettings settings;    // sim::initSettings() and the flags
+};
+
+namespace headless
+{
+    bool isHeadless(int argc, char** argv);
+    bool parseOptions(HeadlessOptions* options, int argc, char** argv);
+    int run(int argc, char** argv);
+}
@@ -7,9 +7,11 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <cstdio>
+#include <cfloat>
 #include <cmath>
 #include <cstdint>
 #include <vector>
+#include <algorithm>
 #include <chrono>
 #include <ctime>
 #include <string>
@@ -19,6 +21,11 @@
 #include <imgui/imgui_impl_opengl3.h>
 
 #include "ogls.h"
+#include "headless.h"
+#include "core/simulation.h"
+#include "core/gravity.h"
+#include "core/thread_pool.h"
+#include "core/runner.h"
 
 
 // [SECTION]
@@ -37,9 +44,9 @@
 #define NEPTUNE_COLOR 0.06, 0.20, 0.53
 #define PLUTO_COLOR 0.91, 0.91, 0.91
 #define TRAIL_LINE_COLOR 0.43, 0.43, 0.43
+#define PARTICLE_COLOR 0.55, 0.50, 0.45
+#define DEBRIS_COLOR 0.60, 0.60, 0.60
 
-#define G_CONSTANT 6.6743e-11 /* G Constant of attraction */
-#define AU 1.496e+11 /* 1 AU in meters */
 #define SCREEN_SCALE static_cast<float>(2.67379679e-9) /* 400/1.496e+11 (aka 300px / 1AU) */
 
 #define PI (22.0f/7.0f) /* 3.1415... */
@@ -245,24 +252,20 @@ float clampAngle(float x)
 }
 
 
+// render data of a body, indexed by the body id, the physics state lives in SimWorld::bodies
 struct Planet
 {
-    float mass;          // mass of planet
-    float distance;      // distance from sun
     float radius;        // radius of planet, (visual only)
-    OglsVec2 pos;        // x, y pos of planet
-    OglsVec2 vel;        // x, y velocity of planet
     OglsVec3 color;
-    bool sun;
 
     OglsVertexBuffer* vertexBuffer;
     OglsVertexArray* vertexArray;
     BatchGroup trailBatch;
 };
 
-void initPlanet(Planet* planet, float mass, float distance, float radius, const OglsVec2& pos, const OglsVec2 vel, const OglsVec3& color, bool sun = false)
+void initPlanet(Planet* planet, float radius, const OglsVec3& color)
 {
-    *planet = { mass, distance, radius, pos, vel, color, sun };
+    *planet = { radius, color };
 
     ogls::createVertexBuffer(&planet->vertexBuffer, nullptr, sizeof(Vertex) * s_MaxTrailVertices, Ogls_BufferMode_Dynamic);
 
@@ -292,26 +295,71 @@ void uninitPlanet(Planet* planet)
     ogls::destroyVertexArray(planet->vertexArray);
 }
 
-OglsVec2 getPlanetAttraction(const Planet& p1, const Planet& p2)
+
+// test particles, one point each with the planet shader, the buffer grows with the particle count
+struct ParticleCloud
+{
+    OglsVertexBuffer* vertexBuffer;
+    OglsVertexArray* vertexArray;
+    std::vector<Vertex> vertices;
+    uint32_t capacity;
+};
+
+void initParticleCloud(ParticleCloud* cloud, uint32_t capacity)
+{
+    cloud->capacity = capacity;
+    ogls::createVertexBuffer(&cloud->vertexBuffer, nullptr, sizeof(Vertex) * capacity, Ogls_BufferMode_Dynamic);
+
+    std::vector<OglsVertexArrayAttribute> attributePtrs =
+    {
+        { 0, 2, sizeof(Vertex), Ogls_DataType_Float, (void*)0 },
+        { 1, 3, sizeof(Vertex), Ogls_DataType_Float, (void*)(2 * sizeof(float)) },
+    };
+
+    OglsVertexArrayCreateInfo vertexArrayCreatInfo{};
+    vertexArrayCreatInfo.vertexBuffer = cloud->vertexBuffer;
+    vertexArrayCreatInfo.indexBuffer = nullptr;
+    vertexArrayCreatInfo.pAttributes = attributePtrs.data();
+    vertexArrayCreatInfo.attributeCount = attributePtrs.size();
+
+    ogls::createVertexArray(&cloud->vertexArray, &vertexArrayCreatInfo);
+}
+
+void uninitParticleCloud(ParticleCloud* cloud)
 {
-    float distx = p1.pos.x - p2.pos.x;
-    float disty = p1.pos.y - p2.pos.y;
+    ogls::destroyVertexBuffer(cloud->vertexBuffer);
+    ogls::destroyVertexArray(cloud->vertexArray);
+}
 
-    // get the gravitational force using the grav. force formula
-    float distance = std::sqrt(std::pow(distx, 2) + std::pow(disty, 2));
-    float force = G_CONSTANT * p1.mass * p2.mass / std::pow(distance, 2);
+void drawParticles(ParticleCloud* cloud, const float* x, const float* y, uint32_t count, float drawScale, OglsVec3 color)
+{
+    if (count == 0) return;
+
+    if (count > cloud->capacity)
+    {
+        uninitParticleCloud(cloud);
+        initParticleCloud(cloud, std::max(count, cloud->capacity * 2));
+    }
 
-    // apply the force for the x and y forces
-    float theta = std::atan2(disty, distx);
-    float fx = force * std::cos(theta);
-    float fy = force * std::sin(theta);
+    cloud->vertices.resize(count);
+    for (uint32_t i = 0; i < count; i++)
+        cloud->vertices[i] = { { x[i] * drawScale, y[i] * drawScale }, color };
 
-    return { -fx, -fy };
+    ogls::bindVertexBufferSubData(cloud->vertexBuffer, count * sizeof(Vertex), 0, (float*)cloud->vertices.data());
+
+    ogls::bindVertexArray(cloud->vertexArray);
+    ogls::renderDrawMode(GL_POINTS, 0, count);
+    ogls::bindVertexArray(0);
 }
 
 
-int main(int argv, char** argc)
+int main(int argc, char** argv)
 {
+    if (headless::isHeadless(argc, argv))
+    {
+        return headless::run(argc, argv);
+    }
+
     if (!glfwInit())
     {
         printf("failed to initialize glfw\n");
@@ -396,44 +444,62 @@ int main(int argv, char** argc)
 
     // [SECTION]
     // planet initialization
-    // mass, distance, radius, position, vellocity, color, bool sun
+    // physics state comes from the simulation core, radius and color are visual only
+    SimWorld world;
+    sim::initSolarSystem(&world);
+
     Planet sun;
-    initPlanet(&sun, 1.9891e+30, 0.0f, 35.0f, {0.0f, 0.0f}, {0.0f, 0.0f}, { SUN_COLOR }, true);
+    initPlanet(&sun, 35.0f, { SUN_COLOR });
 
     Planet mercury;
-    initPlanet(&mercury, 0.330e+24, 0.387 * AU, 4.0f, {0.387f * AU, 0.0f}, {0.0f, 47400.0f}, { MERCURY_COLOR });
+    initPlanet(&mercury, 4.0f, { MERCURY_COLOR });
 
     Planet venus;
-    initPlanet(&venus, 4.98e+24, 0.72f * AU, 10.0f, {0.72f * AU, 0.0f}, {0.0f, 35000.0f}, { VENUS_COLOR });
+    initPlanet(&venus, 10.0f, { VENUS_COLOR });
 
     Planet earth;
-    initPlanet(&earth, 5.97e+24, AU, 11.0f, {AU, 0.0f}, {0.0f, 29800.0f}, { EARTH_COLOR });
+    initPlanet(&earth, 11.0f, { EARTH_COLOR });
 
     Planet mars;
-    initPlanet(&mars, 0.642e+24, 1.5f * AU, 8.0f, {1.5f * AU, 0.0f}, {0.0f, 24100.0f}, { MARS_COLOR });
+    initPlanet(&mars, 8.0f, { MARS_COLOR });
 
     Planet jupiter;
-    initPlanet(&jupiter, 1868e+24, 5.2f * AU, 30.0f, {5.2f * AU, 0.0f}, {0.0f, 13100.0f}, { JUPITER_COLOR });
+    initPlanet(&jupiter, 30.0f, { JUPITER_COLOR });
 
     Planet saturn;
-    initPlanet(&saturn, 568e+24, 9.5f * AU, 28.0f, {9.5f * AU, 0.0f}, {0.0f, 9700.0f}, { SATURN_COLOR });
+    initPlanet(&saturn, 28.0f, { SATURN_COLOR });
 
     Planet uranus;
-    initPlanet(&uranus, 86.8e+24, 19.0f * AU, 18.0f, {19.0f * AU, 0.0f}, {0.0f, 6800.0f}, { URANUS_COLOR });
+    initPlanet(&uranus, 18.0f, { URANUS_COLOR });
 
     Planet neptune;
-    initPlanet(&neptune, 102e+24, 30.0f * AU, 18.0f, {30.0f * AU, 0.0f}, {0.0f, 5400.0f}, { NEPTUNE_COLOR });
+    initPlanet(&neptune, 18.0f, { NEPTUNE_COLOR });
 
     Planet pluto;
-    initPlanet(&pluto, 0.0130e+24, 39.0f * AU, 3.0f, {39.0f * AU, 0.0f}, {0.0f, 4700.0f}, { PLUTO_COLOR });
+    initPlanet(&pluto, 3.0f, { PLUTO_COLOR });
 
     std::vector<Planet> planets = { sun, mercury, venus, earth, mars, jupiter, saturn, uranus, neptune, pluto };
+
+    // fragments and belt bodies have no planet of their own
+    Planet debris;
+    initPlanet(&debris, 2.0f, { DEBRIS_COLOR });
     std::vector<Planet> planetCopies = planets;
 
+    ParticleCloud particleCloud;
+    initParticleCloud(&particleCloud, 65536);
+
 
     float camx = 0.0f, camy = 0.0f;
     float scale = 1.0f;
-    float timeStep = 86400;
+    SimSettings settings;
+    sim::initSettings(&settings);
+    settings.diagnostics = true; // plotted in the settings window
+    bool settingsChanged = false;
+    double speed = SIM_CLOCK_SPEED, budget = SIM_CLOCK_BUDGET;
+
+    // the simulation runs on its own thread, the loop below only reads its snapshots and sends it commands
+    SimRunner runner;
+    sim::startRunner(&runner, world, settings);
     bool p_open = false, pressOnce = false;
     bool trailPaths = false;
     ImGuiTableFlags flags = ImGuiTableFlags_RowBg;
@@ -486,47 +552,28 @@ int main(int argv, char** argc)
 
         // [SECTION]
         // calculate planet positions and forces
-        if (!pause)
-        {
-            for (int i = 0; i < planets.size(); i++)
-            {
-                auto& planet = planets[i];
-                OglsVec2 sumOfForces = {0.0f, 0.0f};
-
-                // calculate planet pos and velocity based on forces on all other planet masses
-                for (int j = 0; j < planets.size(); j++)
-                {
-                    if (i == j) continue;
-                    if (planets[j].sun)
-                    {
-                        // get distance of planet from sun
-                        planet.distance = std::sqrt(std::pow(planet.pos.x - planets[j].pos.x, 2) + std::pow(planet.pos.y - planets[j].pos.y, 2));
-                    }
-
-                    // calculate planet forces of attraction
-                    OglsVec2 f = getPlanetAttraction(planet, planets[j]);
-                    sumOfForces.x += f.x;
-                    sumOfForces.y += f.y;
-                }
-
-                planet.vel.x += sumOfForces.x / planet.mass * timeStep;
-                planet.vel.y += sumOfForces.y / planet.mass * timeStep;
-
-                planet.pos.x += planet.vel.x * timeStep;
-                planet.pos.y += planet.vel.y * timeStep;
-            }
-        }
+        // newest state of the simulation thread, the drawing interpolates between its last two steps
+        SimSnapshot& snapshot = *sim::acquireSnapshot(&runner);
+        snapshot.clock.alpha = sim::getSnapshotAlpha(snapshot);
+        const SimBodies& bodies = snapshot.bodies;
 
+        // the bodies are in the units of the core, SCREEN_SCALE is per meter
+        float drawScale = (float)(bodies.units.length * SCREEN_SCALE);
         if (trailPaths)
         {
-            for (auto& planet : planets)
+            for (uint32_t i = 0; i < bodies.count; i++)
             {
-                drawTrail(&planet.trailBatch, { planet.pos.x * SCREEN_SCALE, planet.pos.y * SCREEN_SCALE }, {TRAIL_LINE_COLOR});
+                if (bodies.id[i] >= planets.size()) continue;
+                SimVec2 pos = sim::getInterpolatedPosition(snapshot.clock, bodies, i);
+                drawTrail(&planets[bodies.id[i]].trailBatch, { pos.x * drawScale, pos.y * drawScale }, {TRAIL_LINE_COLOR});
             }
         }
-        for (auto& planet : planets)
+        drawParticles(&particleCloud, snapshot.particleX.data(), snapshot.particleY.data(), snapshot.particleCount, drawScale, { PARTICLE_COLOR });
+        for (uint32_t i = 0; i < bodies.count; i++)
         {
-            drawPoly(&batch, { planet.pos.x * SCREEN_SCALE, planet.pos.y * SCREEN_SCALE }, planet.color, planet.radius, 32);
+            const Planet& planet = bodies.id[i] < planets.size() ? planets[bodies.id[i]] : debris;
+            SimVec2 pos = sim::getInterpolatedPosition(snapshot.clock, bodies, i);
+            drawPoly(&batch, { pos.x * drawScale, pos.y * drawScale }, planet.color, planet.radius, 32);
         }
 
 
@@ -566,25 +613,234 @@ int main(int argv, char** argc)
                 ImGui::TableNextColumn();
                 ImGui::Text("Velovity (m/s)");
 
-                for (int i = 0; i < planets.size(); i++)
+                for (uint32_t i = 0; i < bodies.count; i++)
                 {
+                    SimBody body = sim::getBody(bodies, i);
                     ImGui::TableNextRow();
                     ImGui::TableNextColumn();
-                    ImGui::Text("body %d:", i);
+                    ImGui::Text("body %u:", bodies.id[i]);
                     ImGui::TableNextColumn();
-                    ImGui::Text("%.3e", planets[i].mass);
+                    ImGui::Text("%.3e", body.mass);
                     ImGui::TableNextColumn();
-                    ImGui::Text("%.3e", planets[i].distance);
+                    ImGui::Text("%.3e", body.distance / AU);
                     ImGui::TableNextColumn();
-                    ImGui::Text("x:%.2f, y:%.2f", planets[i].vel.x, planets[i].vel.y);
+                    ImGui::Text("x:%.2f, y:%.2f", body.vel.x, body.vel.y);
                 }
                 ImGui::EndTable();
             }
 
+            // drift since the first step (or the last edit), tells whether the integrator and time step are good enough
+            settingsChanged |= ImGui::Checkbox("conservation", &settings.diagnostics);
+            const SimDiagnostics& diagnostics = snapshot.diagnostics;
+            if (settings.diagnostics && diagnostics.size > 0)
+            {
+                char overlay[32];
+                if (std::isnan(diagnostics.last.energy))
+                {
+                    ImGui::Text("energy: no potential from this solver above %d bodies", SIM_DIAGNOSTICS_MAX_DIRECT);
+                }
+                else
+                {
+                    snprintf(overlay, sizeof(overlay), "%.2e", sim::getEnergyDrift(diagnostics));
+                    ImGui::PlotLines("energy", diagnostics.energyDrift, (int)diagnostics.size, (int)diagnostics.head, overlay, FLT_MAX, FLT_MAX, ImVec2(0.0f, 50.0f));
+                }
+                snprintf(overlay, sizeof(overlay), "%.2e", sim::getMomentumDrift(diagnostics));
+                ImGui::PlotLines("momentum", diagnostics.momentumDrift, (int)diagnostics.size, (int)diagnostics.head, overlay, FLT_MAX, FLT_MAX, ImVec2(0.0f, 50.0f));
+                snprintf(overlay, sizeof(overlay), "%.2e", sim::getAngularDrift(diagnostics));
+                ImGui::PlotLines("angular momentum", diagnostics.angularDrift, (int)diagnostics.size, (int)diagnostics.head, overlay, FLT_MAX, FLT_MAX, ImVec2(0.0f, 50.0f));
+            }
+
             ImGui::NewLine();
             ImGui::Text("Options");
             ImGui::DragFloat("zoom", &scale, 0.5f, 0.5f);
-            ImGui::DragFloat("time step", &timeStep, 10.0f, 60.0f);
+            // the adaptive integrator picks its own steps, the time step is only how often it stops for a frame,
+            // clamped for typed in values too, a step of 0 or less would stall the clock
+            settingsChanged |= ImGui::DragFloat(settings.integrator == Sim_Integrator_DormandPrince ? "step interval" : "time step", &settings.timeStep, 10.0f, 60.0f, (float)(36525.0 * DAY), "%.0f", ImGuiSliderFlags_AlwaysClamp);
+            float speedDays = (float)(speed / DAY);
+            float budgetMs = (float)(budget * 1000.0);
+            bool clockChanged = ImGui::SliderFloat("days per second", &speedDays, 0.1f, 36525.0f, "%.1f", ImGuiSliderFlags_Logarithmic);
+            clockChanged |= ImGui::SliderFloat("physics budget (ms)", &budgetMs, 1.0f, 100.0f, "%.0f");
+            if (clockChanged)
+            {
+                speed = speedDays * DAY;
+                budget = budgetMs * 0.001;
+
+                SimCommand command = {};
+                command.type = Sim_Command_Clock;
+                command.value = speed;
+                command.value2 = budget;
+                sim::sendCommand(&runner, command);
+            }
+            if (ImGui::BeginCombo("gravity solver", sim::getSolverName(settings.solver)))
+            {
+                for (int i = 0; i < Sim_Solver_Count; i++)
+                {
+                    if (ImGui::Selectable(sim::getSolverName((SimSolver)i), settings.solver == i))
+                    {
+                        settings.solver = (SimSolver)i;
+                        settingsChanged = true;
+                    }
+                }
+                ImGui::EndCombo();
+            }
+            if (ImGui::BeginCombo("integrator", sim::getIntegratorName(settings.integrator)))
+            {
+                for (int i = 0; i < Sim_Integrator_Count; i++)
+                {
+                    if (ImGui::Selectable(sim::getIntegratorName((SimIntegrator)i), settings.integrator == i))
+                    {
+                        settings.integrator = (SimIntegrator)i;
+                        settingsChanged = true;
+                    }
+                }
+                ImGui::EndCombo();
+            }
+            if (sim::getIntegrator(settings.integrator).stages > 0 && ImGui::BeginCombo("precision", sim::getPrecisionName(settings.precision)))
+            {
+                for (int i = 0; i < Sim_Precision_Count; i++)
+                {
+                    if (ImGui::Selectable(sim::getPrecisionName((SimPrecision)i), settings.precision == i))
+                    {
+                        settings.precision = (SimPrecision)i;
+                        settingsChanged = true;
+                    }
+                }
+                ImGui::EndCombo();
+            }
+            if (settings.integrator == Sim_Integrator_Hermite)
+            {
+                // the time step is the largest block step, bodies that need it take power of two fractions of it
+                settingsChanged |= ImGui::SliderFloat("timestep accuracy", &settings.hermiteEta, 0.001f, 0.1f, "%.3f", ImGuiSliderFlags_Logarithmic);
+                settingsChanged |= ImGui::Checkbox("block time steps", &settings.blockSteps);
+                ImGui::Text("%u blocks per step, smallest step %.0f s", snapshot.hermiteBlocks, snapshot.hermiteMinStep * bodies.units.time);
+                ImGui::Text("force evaluations: %llu", (unsigned long long)snapshot.evaluations);
+            }
+            if (settings.integrator == Sim_Integrator_DormandPrince)
+            {
+                settingsChanged |= ImGui::SliderFloat("tolerance", &settings.tolerance, 1e-13f, 1e-4f, "%.0e", ImGuiSliderFlags_Logarithmic);
+                ImGui::Text("%u steps per interval, smallest step %.0f s", snapshot.dpSteps, snapshot.dpMinStep * bodies.units.time);
+                ImGui::Text("steps accepted: %llu, rejected: %llu", (unsigned long long)snapshot.dpAccepted, (unsigned long long)snapshot.dpRejected);
+                ImGui::Text("force evaluations: %llu", (unsigned long long)snapshot.evaluations);
+            }
+            if (settings.solver == Sim_Solver_BarnesHut)
+            {
+                settingsChanged |= ImGui::SliderFloat("opening angle", &settings.theta, 0.1f, 1.5f);
+                settingsChanged |= ImGui::Checkbox("quadrupole moments", &settings.quadrupole);
+            }
+            if (settings.solver == Sim_Solver_Fmm)
+            {
+                int order = (int)settings.fmmOrder;
+                settingsChanged |= ImGui::SliderFloat("opening angle", &settings.theta, 0.1f, 0.9f);
+                if (ImGui::SliderInt("expansion order", &order, 1, SIM_FMM_MAX_ORDER))
+                {
+                    settings.fmmOrder = (uint32_t)order;
+                    settingsChanged = true;
+                }
+            }
+            int threads = (int)snapshot.threads;
+            if (ImGui::SliderInt("threads", &threads, 1, (int)sim::getHardwareThreadCount()))
+                sim::sendCommand(&runner, Sim_Command_SetThreads, (uint32_t)threads);
+            if (settings.solver == Sim_Solver_Direct)
+            {
+                settingsChanged |= ImGui::Checkbox("deterministic sums", &settings.deterministic);
+                if (ImGui::IsItemHovered())
+                    ImGui::SetTooltip("the forces are summed in a fixed order, the same bits for any number of threads");
+            }
+            else
+            {
+                // compare the last force pass with direct summation on a subset of the bodies
+                if (ImGui::Button("Measure force error"))
+                    sim::sendCommand(&runner, Sim_Command_MeasureForceError);
+                const SimForceError& forceError = snapshot.forceError;
+                if (forceError.samples > 0)
+                    ImGui::Text("rms %.2e, max %.2e (%u bodies)", forceError.rms, forceError.max, forceError.samples);
+            }
+            if (ImGui::BeginCombo("collisions", sim::getCollisionResponseName(settings.collisions)))
+            {
+                for (int i = 0; i < Sim_Collision_Count; i++)
+                {
+                    if (ImGui::Selectable(sim::getCollisionResponseName((SimCollisionResponse)i), settings.collisions == i))
+                    {
+                        settings.collisions = (SimCollisionResponse)i;
+                        settingsChanged = true;
+                    }
+                }
+                ImGui::EndCombo();
+            }
+            if (settings.collisions == Sim_Collision_Bounce)
+                settingsChanged |= ImGui::SliderFloat("restitution", &settings.restitution, 0.0f, 1.0f);
+            if (settings.collisions != Sim_Collision_None)
+            {
+                ImGui::Text("merges: %llu, bounces: %llu, fragmentations: %llu", (unsigned long long)snapshot.merges, (unsigned long long)snapshot.bounces, (unsigned long long)snapshot.fragmentations);
+                ImGui::Text("particles absorbed: %llu", (unsigned long long)snapshot.absorbed);
+            }
+            if (sim::getIntegrator(settings.integrator).stages > 0)
+            {
+                // close pairs move on their own regularized orbits, the other bodies keep the time step
+                bool regularize = settings.encounterHill > 0.0f;
+                if (ImGui::Checkbox("regularize close encounters", &regularize))
+                {
+                    settings.encounterHill = regularize ? SIM_ENCOUNTER_HILL : 0.0f;
+                    settingsChanged = true;
+                }
+                if (regularize)
+                {
+                    ImGui::SameLine();
+                    ImGui::Text("%u pairs", snapshot.encounterPairs);
+                }
+
+                // every body feels the others where they were when their gravity left them, direct summation only
+                bool finite = settings.gravitySpeed > 0.0f;
+                if (ImGui::Checkbox("finite speed of gravity", &finite))
+                {
+                    settings.gravitySpeed = finite ? (float)LIGHT_SPEED : 0.0f;
+                    settingsChanged = true;
+                }
+                if (finite)
+                {
+                    float lightSpeeds = (float)(settings.gravitySpeed / LIGHT_SPEED);
+                    if (ImGui::SliderFloat("speed of gravity (c)", &lightSpeeds, 0.001f, 1.0f, "%.3f", ImGuiSliderFlags_Logarithmic))
+                    {
+                        settings.gravitySpeed = (float)(lightSpeeds * LIGHT_SPEED);
+                        settingsChanged = true;
+                    }
+                    ImGui::Text("%u samples per body, %u removed bodies still pulling", snapshot.historySamples, snapshot.ghosts);
+                }
+            }
+            // massless, they feel the planets but the planets don't feel them
+            ImGui::Text("test particles: %u", snapshot.particleCount);
+            ImGui::SameLine();
+            settingsChanged |= ImGui::Checkbox("two-body orbits", &settings.keplerParticles);
+            if (ImGui::IsItemHovered())
+                ImGui::SetTooltip("the particles follow analytic orbits around the sun, the planets don't perturb them");
+            float softening = settings.softening / 1000.0f;
+            if (ImGui::SliderFloat("particle softening (km)", &softening, 0.0f, 100000.0f, "%.0f", ImGuiSliderFlags_Logarithmic))
+            {
+                settings.softening = softening * 1000.0f;
+                settingsChanged = true;
+            }
+            if (ImGui::Button("Add 100k asteroid belt particles"))
+            {
+                SimCommand command = {};
+                command.type = Sim_Command_AddParticles;
+                command.index = 100000;
+                command.value = 2.2 * AU;
+                command.value2 = 3.2 * AU;
+                sim::sendCommand(&runner, command);
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Add 100k kuiper belt particles"))
+            {
+                SimCommand command = {};
+                command.type = Sim_Command_AddParticles;
+                command.index = 100000;
+                command.value = 30.0 * AU;
+                command.value2 = 50.0 * AU;
+                sim::sendCommand(&runner, command);
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Clear particles"))
+                sim::sendCommand(&runner, Sim_Command_ClearParticles);
             if (ImGui::Checkbox("trail paths", &trailPaths))
             {
                 for (auto& planet : planets)
@@ -607,21 +863,25 @@ int main(int argv, char** argc)
                 {
                     pause = false;
                     pauseName = "Pause";
+                    sim::sendCommand(&runner, Sim_Command_Play);
                     timer.play();
                 }
                 else
                 {
                     pause = true;
                     pauseName = "Play";
+                    sim::sendCommand(&runner, Sim_Command_Pause);
                     timer.pause();
                 }
             }
             if (ImGui::Button("Restart"))
             {
                 planets = planetCopies;
+                sim::sendCommand(&runner, Sim_Command_Restart);
                 camx = camy = 0.0f;
                 scale = 1.0f;
-                timeStep = 86400;
+                settings.timeStep = 86400;
+                settingsChanged = true;
                 timer.reset();
             }
 
@@ -629,48 +889,35 @@ int main(int argv, char** argc)
             ImGui::Text("Fun Stuff");
             if(ImGui::Button("Delete the sun"))
             {
-                for (int i = 0; i < planets.size(); i++)
-                {
-                    if (planets[i].sun)
-                    {
-                        planets.erase(planets.begin() + i);
-                        goto OUT;
-                    }
-
-                }
+                sim::sendCommand(&runner, Sim_Command_RemoveSun);
             }
             if (ImGui::IsItemHovered(ImGuiHoveredFlags_Stationary | ImGuiHoveredFlags_DelayNormal | ImGuiHoveredFlags_NoSharedDelay))
-                ImGui::SetTooltip("I know gravity takes time to travel through space so\nthe planets should still be orbiting around even after the\nsun is gone (similar to light), but I am too lazy to implement that right now");
+                ImGui::SetTooltip("with a finite speed of gravity (splitting integrators) the planets keep\norbiting where the sun was until the news of its removal reaches them,\nthe inner ones first (light takes about 8 minutes to reach the earth)");
 
             ImGui::SameLine();
             if(ImGui::Button("Delete a random planet"))
             {
-                if (planets.empty()) goto OUT;
-                if (planets.size() == 1 && planets[0].sun) goto OUT;
-                if (planets.size() == 1 ) { planets.erase(planets.begin()); goto OUT; }
+                if (bodies.count == 0) goto OUT;
+                if (bodies.count == 1 && bodies.sun[0]) goto OUT;
+                if (bodies.count == 1 ) { sim::sendCommand(&runner, Sim_Command_RemoveBody, 0); goto OUT; }
                 srand(time(0));
-                auto index = 1 + rand() % (planets.size() - 1);
-                planets.erase(planets.begin() + index);
+                auto index = 1 + rand() % (bodies.count - 1);
+                sim::sendCommand(&runner, Sim_Command_RemoveBody, index);
             }
             OUT:
 
             if (ImGui::Button("Make the mass of pluto the sun"))
             {
-                if (!planets.empty())
-                    planets.back().mass = 1.9891e+30;
+                if (bodies.count != 0)
+                    sim::sendCommand(&runner, Sim_Command_SetMass, bodies.count - 1, SUN_MASS);
             }
             if (ImGui::Button("Make all the planets have the mass of the sun"))
             {
-                for (auto& planet : planets)
-                    planet.mass = 1.9891e+30;
+                sim::sendCommand(&runner, Sim_Command_SetMass, UINT32_MAX, SUN_MASS);
             }
             if (ImGui::Button("set all planet velocity to 0"))
             {
-                for (auto& planet : planets)
-                {
-                    if (planet.sun) continue;
-                    planet.vel = { 0.0f, 0.0f };
-                }
+                sim::sendCommand(&runner, Sim_Command_ZeroVelocities);
             }
 
             fps++;
@@ -684,10 +931,28 @@ int main(int argv, char** argc)
             ImGui::NewLine();
             ImGui::Text("FPS: %d", fpsOut);
             ImGui::Text("Time elapsed: %f", timer.elapsed());
+            ImGui::Text("Simulated: %.2f years", snapshot.time / (365.25 * DAY));
+            ImGui::Text("Simulated per second: %.1f days (asked %.1f)", snapshot.clock.throughput / DAY, speed / DAY);
+            ImGui::Text("Steps per update: %u", snapshot.clock.substeps);
+            if (snapshot.clock.behind)
+            {
+                ImGui::SameLine();
+                ImGui::TextColored({ 1.0f, 0.4f, 0.4f, 1.0f }, "(over budget, running slower)");
+            }
 
             ImGui::End();
         }
 
+        // the settings go over as a whole, the queue keeps them in order with the other commands
+        if (settingsChanged)
+        {
+            SimCommand command = {};
+            command.type = Sim_Command_Settings;
+            command.settings = settings;
+            if (sim::sendCommand(&runner, command))
+                settingsChanged = false;
+        }
+
         ImGui::Render();
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
@@ -695,6 +960,8 @@ int main(int argv, char** argc)
         glfwPollEvents();
     }
 
+    sim::stopRunner(&runner);
+
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -708,6 +975,7 @@ int main(int argv, char** argc)
     {
         uninitPlanet(&planet);
     }
+    uninitParticleCloud(&particleCloud);
 
     glfwTerminate();
     return 0;